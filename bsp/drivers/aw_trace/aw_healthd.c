@@ -25,6 +25,8 @@
 #include <linux/kprobes.h>
 #include <linux/of.h>
 #include <linux/of_address.h>
+#include <linux/percpu.h>
+#include <linux/slab.h>
 
 #define CPU_NUMS 8
 #define STACK_SIZE 2048
@@ -32,13 +34,11 @@ struct hrtimer healthd_hrtimer;
 static u64 sched_info_count;
 static DEFINE_RAW_SPINLOCK(cpu_bt_lock);
 static struct task_struct *aw_healthd;
-static int check_tsk_status;
 static void __iomem *gic_base;
 unsigned long *entries[CPU_NUMS];
 unsigned char *stackbuf[CPU_NUMS];
 
 ktime_t sd_time[8];
-static LIST_HEAD(tsk_list);
 static LIST_HEAD(sched_info_list);
 static LIST_HEAD(tsk_data_free_list);
 static struct list_head *sched_info_pos;
@@ -65,14 +65,43 @@ u64 healthd_hrtimer_count;
 
 #define is_rt_tsk(tsk) (tsk->prio < 100 ? true : false)
 
-static u64 sd_prev_ktime[8];
+/*
+ * A context switch as recorded by the schedule hook, only copied there and
+ * formatted when sched_info is read.
+ */
+struct sched_rec {
+	u64 timestamp_us;
+	u64 sum_exec_runtime;
+	s64 rtime_us;
+	unsigned long nvcsw, ncsw;
+	pid_t prev_pid, next_pid;
+	int prev_prio, next_prio;
+	unsigned int prev_state;
+	u32 cpu;
+	char prev_comm[TASK_COMM_LEN];
+	char next_comm[TASK_COMM_LEN];
+};
+
+/* must be a power of 2 */
+#define SCHED_REC_RING_SIZE 512
+
+/*
+ * Per-CPU ring of sched_rec. The schedule hook is the only producer (on
+ * its own cpu, irqs off), healthd thread the only consumer, so no lock.
+ */
+struct sched_rec_ring {
+	unsigned int head;
+	unsigned int tail;
+	unsigned long dropped;
+	ktime_t prev_ktime;
+	struct sched_rec *recs;
+};
+
+static DEFINE_PER_CPU(struct sched_rec_ring, sched_rec_rings);
 
+/* dbuf is NULL for a sched record, see show_sched_info() */
 struct tsk_data {
-	int prev_pid, next_pid;
-	unsigned long ncsw, nvcsw;
-	s64 rtime_us;
-	u64 sum_exec_runtime;
-	struct task_struct *prev, *next;
+	struct sched_rec rec;
 	struct list_head list;
 	u32 dlen;
 	char *dbuf;
@@ -106,6 +135,7 @@ struct tsk_data *get_tsk_data(u32 len)
 		if (!tsk_data->dbuf) {
 			pr_err("kmalloc tsk_data dbuf failed, len=%d\n", len);
 			kfree(tsk_data);
+			return NULL;
 		}
 		tsk_data->dlen = len;
 	}
@@ -267,10 +297,10 @@ static void android_vh_alloc_pages_slowpath(void *p, gfp_t gfp_mask, unsigned in
 	}
 }
 
-char *print_task_flag(struct task_struct *p, char *buf)
+char *print_task_flag(unsigned int task_state, char *buf)
 {
 	int len = 0;
-	int state = p->__state & (TASK_REPORT_MAX -1);
+	int state = task_state & (TASK_REPORT_MAX -1);
 
 	if (state & TASK_RUNNING)
 		len += sprintf(buf + len, "R");
@@ -295,28 +325,20 @@ char *print_task_flag(struct task_struct *p, char *buf)
 static void  android_rvh_schedule(void *p, struct task_struct *prev, struct task_struct *next,
 				  struct rq *rq)
 {
+	struct sched_rec_ring *ring;
+	struct sched_rec *rec;
 	s64 rtime_us = 0;
-	int len = 0;
-	char buf[16];
-	char tbuf[256];
-	struct sched_entity *se = &prev->se;
-	struct tsk_data *tsk_data = NULL;
-	unsigned long ncsw;
-	unsigned long flags;
+	unsigned int head;
 	ktime_t now;
-	u32 cpu;
-	u64 timestamp_s, timestamp_us;
 
 	if (!rvh_schedule_enable)
 		return;
 
-	cpu = get_cpu();
-	put_cpu();
+	/* preemption is off in __schedule() */
+	ring = this_cpu_ptr(&sched_rec_rings);
 	now = ktime_get();
-	rtime_us = ktime_to_us(ktime_sub(now, sd_prev_ktime[cpu]));
-	sd_prev_ktime[cpu] = now;
-	if (check_tsk_status)
-		return;
+	rtime_us = ktime_to_us(ktime_sub(now, ring->prev_ktime));
+	ring->prev_ktime = now;
 
 	if (prev != next && !is_idle_task(prev)) {
 		//record message
@@ -327,43 +349,29 @@ static void  android_rvh_schedule(void *p, struct task_struct *prev, struct task
 		if ((prev->__state & TASK_INTERRUPTIBLE) && rtime_us > sched_rt_thr)
 			return;
 
-		ncsw = prev->nvcsw + prev->nivcsw;
-		timestamp_s = ktime_to_us(now) / 1000000;
-		timestamp_us = ktime_to_us(now) % 1000000;
-		len = snprintf(tbuf, 256,
-			       "[%u.%u][c%d]prev:%s(%d) exec=%lluus sum_exec=%llums ncsw=%lu prio=%d %s => next:%s(%d) prio=%d\n",
-			       timestamp_s,
-			       timestamp_us,
-			       cpu,
-			       prev->comm,
-			       prev->pid,
-			       rtime_us,
-			       se->sum_exec_runtime / 1000000,
-			       ncsw,
-			       prev->prio,
-			       print_task_flag(prev, buf),
-			       next->comm,
-			       next->pid,
-			       next->prio);
-
-		tsk_data = get_tsk_data(len + 1);
-		if (!tsk_data) {
-			pr_err("rvh_schedule get tsk_data fail\n");
+		head = ring->head;
+		if (!ring->recs || head - smp_load_acquire(&ring->tail) >= SCHED_REC_RING_SIZE) {
+			ring->dropped++;
 			return;
 		}
-		memcpy(tsk_data->dbuf, tbuf, len);
-		INIT_LIST_HEAD(&tsk_data->list);
-		raw_spin_lock_irqsave(&tsk_list_lock, flags);
-		list_add_tail(&tsk_data->list, &tsk_list);
-		raw_spin_unlock_irqrestore(&tsk_list_lock, flags);
-		tsk_data->prev_pid = prev->pid;
-		tsk_data->next_pid = next->pid;
-		tsk_data->prev = prev;
-		tsk_data->next = next;
-		tsk_data->rtime_us = rtime_us;
-		tsk_data->nvcsw = prev->nvcsw;
-		tsk_data->ncsw = prev->nvcsw + prev->nivcsw;
-		tsk_data->sum_exec_runtime = se->sum_exec_runtime;
+
+		rec = &ring->recs[head & (SCHED_REC_RING_SIZE - 1)];
+		rec->timestamp_us = ktime_to_us(now);
+		rec->cpu = smp_processor_id();
+		rec->prev_pid = prev->pid;
+		rec->prev_prio = prev->prio;
+		rec->prev_state = prev->__state;
+		rec->next_pid = next->pid;
+		rec->next_prio = next->prio;
+		rec->rtime_us = rtime_us;
+		rec->nvcsw = prev->nvcsw;
+		rec->ncsw = prev->nvcsw + prev->nivcsw;
+		rec->sum_exec_runtime = prev->se.sum_exec_runtime;
+		memcpy(rec->prev_comm, prev->comm, TASK_COMM_LEN);
+		memcpy(rec->next_comm, next->comm, TASK_COMM_LEN);
+
+		/* publish the record to check_tsk_data() */
+		smp_store_release(&ring->head, head + 1);
 	}
 }
 
@@ -460,6 +468,10 @@ static enum hrtimer_restart healthd_hrtimer_handle(struct hrtimer *hrtimer)
 noinline void free_tsk_data(struct tsk_data *tsk_data)
 {
 	list_del(&tsk_data->list);
+	if (!tsk_data->dbuf) {
+		kfree(tsk_data);
+		return;
+	}
 	//raw_spin_lock(&td_free_list_lock);
 	if (tsk_data->dlen <= 256) {
 		memset(tsk_data->dbuf, 0, tsk_data->dlen);
@@ -473,8 +485,6 @@ noinline void free_tsk_data(struct tsk_data *tsk_data)
 
 noinline void move_to_sched_info(struct tsk_data *tsk_data)
 {
-	if (!tsk_data->dbuf)
-		return;
 	list_del(&tsk_data->list);
 
 	list_add_tail(&tsk_data->list, &sched_info_list);
@@ -486,56 +496,81 @@ noinline void move_to_sched_info(struct tsk_data *tsk_data)
 	}
 }
 
-void check_tsk_data(void)
+/* whether a recorded switch of a task still looks unhealthy now */
+static bool check_sched_rec(struct sched_rec *rec, bool *tsk_died)
 {
-	struct tsk_data *tsk_data;
 	struct task_struct *tsk;
-	struct list_head *curr, *next;
-	u64 count = 0, tsk_died = 0, free_data = 0;
 	u64 exec_time_delta;
+	bool keep;
+
+	rcu_read_lock();
+	tsk = find_task_by_vpid(rec->prev_pid);
+	*tsk_died = !tsk;
+	if (!tsk) {
+		rcu_read_unlock();
+		return false;
+	}
+
+	keep = rec->ncsw == tsk->nvcsw + tsk->nivcsw
+	       || rec->rtime_us > sched_running_thr
+	       || (tsk->nvcsw == rec->nvcsw && rec->rtime_us < sched_rt_thr)
+	       || (is_rt_tsk(tsk) && rec->rtime_us > sched_rt_thr);
+	if (!keep) {
+		exec_time_delta = (tsk->se.sum_exec_runtime - rec->sum_exec_runtime)/1000000;
+		keep = (exec_time_delta * 3 > detect_period_ms) && rec->rtime_us > sched_hl_thr;
+	}
+	rcu_read_unlock();
+
+	return keep;
+}
+
+void check_tsk_data(void)
+{
+	struct sched_rec_ring *ring;
+	struct tsk_data *tsk_data;
+	unsigned int head, tail;
+	u64 count = 0, tsk_died = 0, free_data = 0, dropped = 0;
 	u64 delta_us;
 	ktime_t prev_t;
 	unsigned long flags;
+	bool died;
+	int cpu;
 
-	if (list_empty(&tsk_list)) {
-		pr_err("tsk list empty!\n");
-		return;
-	}
-	check_tsk_status = 1;
-
-	/* Attention the irq-off time!!! */
-	raw_spin_lock_irqsave(&tsk_list_lock, flags);
 	prev_t = ktime_get();
-	for (curr = tsk_list.next; curr != &tsk_list; curr = next) {
-		count++;
-		next = curr->next;
-		tsk_data = container_of(curr, struct tsk_data, list);
-		tsk = find_task_by_vpid(tsk_data->prev_pid);
-		if (!tsk) {
-			free_tsk_data(tsk_data);
-			tsk_died++;
-			continue;
-		}
-		if (tsk_data->ncsw == tsk->nvcsw + tsk->nivcsw
-		    || tsk_data->rtime_us > sched_running_thr
-		    || (tsk->nvcsw == tsk_data->nvcsw && tsk_data->rtime_us < sched_rt_thr)
-		    || (is_rt_tsk(tsk) && tsk_data->rtime_us > sched_rt_thr)) {
-			move_to_sched_info(tsk_data);
-			continue;
-		}
-		exec_time_delta = (tsk->se.sum_exec_runtime - tsk_data->sum_exec_runtime)/1000000;
-		if ((exec_time_delta * 3 > detect_period_ms) && tsk_data->rtime_us > sched_hl_thr) {
+	for_each_possible_cpu(cpu) {
+		ring = per_cpu_ptr(&sched_rec_rings, cpu);
+		head = smp_load_acquire(&ring->head);
+		for (tail = ring->tail; tail != head; tail++) {
+			count++;
+			if (!check_sched_rec(&ring->recs[tail & (SCHED_REC_RING_SIZE - 1)], &died)) {
+				if (died)
+					tsk_died++;
+				else
+					free_data++;
+				continue;
+			}
+
+			tsk_data = kmalloc(sizeof(*tsk_data), GFP_KERNEL);
+			if (!tsk_data) {
+				free_data++;
+				continue;
+			}
+			tsk_data->rec = ring->recs[tail & (SCHED_REC_RING_SIZE - 1)];
+			tsk_data->dbuf = NULL;
+			tsk_data->dlen = 0;
+			INIT_LIST_HEAD(&tsk_data->list);
+
+			raw_spin_lock_irqsave(&tsk_list_lock, flags);
 			move_to_sched_info(tsk_data);
-		} else {
-			free_data++;
-			free_tsk_data(tsk_data);
+			raw_spin_unlock_irqrestore(&tsk_list_lock, flags);
 		}
+		/* hand the slots back to the hook */
+		smp_store_release(&ring->tail, tail);
+		dropped += READ_ONCE(ring->dropped);
 	}
 	delta_us = ktime_to_us(ktime_sub(ktime_get(), prev_t));
-	pr_debug("total count:%u,print:%d, tsk died:%u, free data:%u, func time:%dus\n",
-	       count, count -(tsk_died + free_data),  tsk_died, free_data, delta_us);
-	raw_spin_unlock_irqrestore(&tsk_list_lock, flags);
-	check_tsk_status = 0;
+	pr_debug("total count:%llu,print:%llu, tsk died:%llu, free data:%llu, dropped:%llu, func time:%lluus\n",
+	       count, count -(tsk_died + free_data),  tsk_died, free_data, dropped, delta_us);
 }
 
 int healthd_thread_work(void *data)
@@ -613,6 +648,34 @@ void register_alloc_pages_kprobe(void)
 }
 */
 
+static int sched_rec_rings_alloc(void)
+{
+	struct sched_rec_ring *ring;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		ring = per_cpu_ptr(&sched_rec_rings, cpu);
+		ring->recs = kcalloc_node(SCHED_REC_RING_SIZE, sizeof(*ring->recs),
+					  GFP_KERNEL, cpu_to_node(cpu));
+		if (!ring->recs)
+			return -ENOMEM;
+	}
+
+	return 0;
+}
+
+static void sched_rec_rings_free(void)
+{
+	struct sched_rec_ring *ring;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		ring = per_cpu_ptr(&sched_rec_rings, cpu);
+		kfree(ring->recs);
+		ring->recs = NULL;
+	}
+}
+
 static int ah_register_vendor_hook(void)
 {
 	int ret, i;
@@ -636,6 +699,12 @@ static int ah_register_vendor_hook(void)
 		}
 	}
 
+	ret = sched_rec_rings_alloc();
+	if (ret) {
+		sched_rec_rings_free();
+		goto out;
+	}
+
 	ret = register_trace_android_rvh_schedule(android_rvh_schedule, NULL);
 	if (ret)
 		pr_err("%s: register schedule vendor hook failed\n");
@@ -696,6 +765,27 @@ static void *next_sched_info(struct seq_file *seq, void *v, loff_t *pos)
 	return NULL;
 }
 
+static void show_sched_rec(struct seq_file *seq, struct sched_rec *rec)
+{
+	char buf[16];
+
+	seq_printf(seq,
+		   "[%llu.%llu][c%u]prev:%s(%d) exec=%lldus sum_exec=%llums ncsw=%lu prio=%d %s => next:%s(%d) prio=%d\n",
+		   rec->timestamp_us / 1000000,
+		   rec->timestamp_us % 1000000,
+		   rec->cpu,
+		   rec->prev_comm,
+		   rec->prev_pid,
+		   rec->rtime_us,
+		   rec->sum_exec_runtime / 1000000,
+		   rec->ncsw,
+		   rec->prev_prio,
+		   print_task_flag(rec->prev_state, buf),
+		   rec->next_comm,
+		   rec->next_pid,
+		   rec->next_prio);
+}
+
 static int show_sched_info(struct seq_file *seq, void *v)
 {
 	struct tsk_data *tsk_data;
@@ -703,7 +793,10 @@ static int show_sched_info(struct seq_file *seq, void *v)
 	if (!sched_info_pos)
 		return 0;
 	tsk_data = container_of(sched_info_pos, struct tsk_data, list);
-	seq_puts(seq, tsk_data->dbuf);
+	if (tsk_data->dbuf)
+		seq_puts(seq, tsk_data->dbuf);
+	else
+		show_sched_rec(seq, &tsk_data->rec);
 
 	return 0;
 }
@@ -850,11 +943,15 @@ static void aw_healthd_exit(void)
 		kthread_stop(aw_healthd);
 	hrtimer_cancel(&healthd_hrtimer);
 	ah_unregister_vendor_hook();
+	/* the schedule hook stays registered, stop it recording first */
+	rvh_schedule_enable = 0;
+	synchronize_rcu();
+	sched_rec_rings_free();
 }
 
 module_init(aw_healthd_init);
 module_exit(aw_healthd_exit);
 
 MODULE_LICENSE("GPL v2");
-MODULE_VERSION("1.0.1");
+MODULE_VERSION("1.1.0");
 MODULE_AUTHOR("henryli<henryli@allwinnertech.com>");
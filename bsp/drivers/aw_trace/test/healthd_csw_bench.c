@@ -0,0 +1,194 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright(c) 2020 - 2023 Allwinner Technology Co.,Ltd. All rights reserved. */
+/*
+ * Context switch cost with the aw_healthd schedule hook off and on.
+ *
+ * Two processes pinned to the same cpu ping-pong one byte through a pair
+ * of pipes, like "perf bench sched pipe", so every round trip is two
+ * context switches. The run is repeated with
+ * /sys/kernel/debug/aw_healthd/rvh_schedule_enable set to 0 and to 1, the
+ * original value is restored at the end.
+ *
+ * usage: healthd_csw_bench [-c cpu] [-n loops] [-r runs]
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/wait.h>
+
+#define HOOK_ENABLE	"/sys/kernel/debug/aw_healthd/rvh_schedule_enable"
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int hook_get(void)
+{
+	char buf[16] = { 0 };
+	int fd = open(HOOK_ENABLE, O_RDONLY);
+
+	if (fd < 0)
+		return -1;
+	if (read(fd, buf, sizeof(buf) - 1) <= 0) {
+		close(fd);
+		return -1;
+	}
+	close(fd);
+	return atoi(buf);
+}
+
+static int hook_set(int enable)
+{
+	char buf[4];
+	int len = snprintf(buf, sizeof(buf), "%d", enable);
+	int fd = open(HOOK_ENABLE, O_WRONLY);
+
+	if (fd < 0) {
+		printf("open %s fail: %s\n", HOOK_ENABLE, strerror(errno));
+		return -1;
+	}
+	if (write(fd, buf, len) != len) {
+		printf("write %s fail: %s\n", HOOK_ENABLE, strerror(errno));
+		close(fd);
+		return -1;
+	}
+	close(fd);
+	return 0;
+}
+
+static int pin_cpu(int cpu)
+{
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return sched_setaffinity(0, sizeof(set), &set);
+}
+
+/* ns per context switch, 0 on failure */
+static uint64_t bench_pipe(int cpu, long loops)
+{
+	int ping[2], pong[2];
+	uint64_t start, wall;
+	char c = 0;
+	pid_t pid;
+	long i;
+
+	if (pipe(ping) || pipe(pong)) {
+		printf("pipe fail: %s\n", strerror(errno));
+		return 0;
+	}
+
+	pid = fork();
+	if (pid < 0) {
+		printf("fork fail: %s\n", strerror(errno));
+		return 0;
+	}
+	if (!pid) {
+		pin_cpu(cpu);
+		for (i = 0; i < loops; i++) {
+			if (read(ping[0], &c, 1) != 1 || write(pong[1], &c, 1) != 1)
+				_exit(1);
+		}
+		_exit(0);
+	}
+
+	if (pin_cpu(cpu))
+		printf("pin to cpu%d fail: %s\n", cpu, strerror(errno));
+
+	start = now_ns();
+	for (i = 0; i < loops; i++) {
+		if (write(ping[1], &c, 1) != 1 || read(pong[0], &c, 1) != 1)
+			break;
+	}
+	wall = now_ns() - start;
+
+	if (i != loops)
+		kill(pid, SIGKILL);
+	waitpid(pid, NULL, 0);
+	close(ping[0]);
+	close(ping[1]);
+	close(pong[0]);
+	close(pong[1]);
+
+	return i == loops ? wall / (loops * 2) : 0;
+}
+
+static void usage(const char *name)
+{
+	printf("usage: %s [-c cpu] [-n loops] [-r runs]\n", name);
+	printf("  -c  cpu both processes run on, default 0\n");
+	printf("  -n  round trips per run, default 100000\n");
+	printf("  -r  runs per setting, the best is reported, default 5\n");
+}
+
+int main(int argc, char *argv[])
+{
+	uint64_t best[2], ns;
+	long loops = 100000;
+	int cpu = 0, runs = 5;
+	int orig, enable, r, opt;
+
+	while ((opt = getopt(argc, argv, "c:n:r:h")) != -1) {
+		switch (opt) {
+		case 'c':
+			cpu = atoi(optarg);
+			break;
+		case 'n':
+			loops = atol(optarg);
+			break;
+		case 'r':
+			runs = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : -1;
+		}
+	}
+	if (loops <= 0 || runs <= 0) {
+		usage(argv[0]);
+		return -1;
+	}
+
+	orig = hook_get();
+	if (orig < 0) {
+		printf("no %s, is aw_healthd loaded and debugfs mounted?\n", HOOK_ENABLE);
+		return -1;
+	}
+
+	for (enable = 0; enable < 2; enable++) {
+		if (hook_set(enable))
+			return -1;
+		best[enable] = UINT64_MAX;
+		for (r = 0; r < runs; r++) {
+			ns = bench_pipe(cpu, loops);
+			if (!ns) {
+				hook_set(orig);
+				return -1;
+			}
+			if (ns < best[enable])
+				best[enable] = ns;
+		}
+		printf("hook %-3s %6llu ns per context switch\n", enable ? "on" : "off",
+		       (unsigned long long)best[enable]);
+	}
+	hook_set(orig);
+
+	printf("hook cost %lld ns per context switch\n",
+	       (long long)best[1] - (long long)best[0]);
+	return 0;
+}
@@ -1387,7 +1387,18 @@ static ssize_t sunxi_ss_status_show(struct device *dev,
 			"The flow %d state: %s\n"
 			, i, avail[sss->flows[i].available]
 		);
+#ifdef SS_ASYNC_ENABLE
+		snprintf(buf+strlen(buf), PAGE_SIZE-strlen(buf),
+			"The flow %d async: %s, requests: %llu\n"
+			, i, sss->flows[i].areq ? "Running" : "Idle"
+			, sss->flows[i].req_cnt
+		);
+#endif
 	}
+#ifdef SS_ASYNC_ENABLE
+	snprintf(buf+strlen(buf), PAGE_SIZE-strlen(buf),
+		"The async queue: %u/%u\n", sss->queue.qlen, sss->queue.max_qlen);
+#endif
 
 	return strlen(buf)
 		+ ss_reg_print(buf + strlen(buf), PAGE_SIZE - strlen(buf));
@@ -1434,6 +1445,7 @@ static int sunxi_ss_probe(struct platform_device *pdev)
 #endif
 
 	sss->pdevice = &pdev->dev;
+	spin_lock_init(&sss->lock);
 	snprintf(sss->dev_name, sizeof(sss->dev_name), SUNXI_SS_DEV_NAME);
 	platform_set_drvdata(pdev, sss);
 
@@ -1450,10 +1462,15 @@ static int sunxi_ss_probe(struct platform_device *pdev)
 	}
 
 	ss_dev = sss;
+#ifdef SS_ASYNC_ENABLE
+	ret = ss_async_init(sss);
+	if (ret != 0)
+		goto err2;
+#endif
 	ret = sunxi_ss_alg_register();
 	if (ret != 0) {
 		SS_ERR("sunxi_ss_alg_register() failed! return %d\n", ret);
-		goto err2;
+		goto err3;
 	}
 
 	sunxi_ss_sysfs_create(pdev);
@@ -1461,6 +1478,10 @@ static int sunxi_ss_probe(struct platform_device *pdev)
 	SS_DBG("SS is inited, base 0x%px, irq %d!\n", sss->base_addr, sss->irq);
 	return 0;
 
+err3:
+#ifdef SS_ASYNC_ENABLE
+	ss_async_exit(sss);
+#endif
 err2:
 	sunxi_ss_hw_exit(sss);
 err1:
@@ -1482,6 +1503,9 @@ static int sunxi_ss_remove(struct platform_device *pdev)
 	sunxi_ss_sysfs_remove(pdev);
 
 	sunxi_ss_alg_unregister();
+#ifdef SS_ASYNC_ENABLE
+	ss_async_exit(sss);
+#endif
 	sunxi_ss_hw_exit(sss);
 	sunxi_ss_res_release(sss);
 
@@ -1510,6 +1534,9 @@ static int sunxi_ss_suspend(struct device *dev)
 	sss->suspend = 1;
 	spin_unlock_irqrestore(&sss->lock, flags);
 
+#ifdef SS_ASYNC_ENABLE
+	ss_async_wait_idle(sss);
+#endif
 	sunxi_ss_hw_exit(sss);
 	ss_dev_unlock();
 
@@ -1528,6 +1555,10 @@ static int sunxi_ss_resume(struct device *dev)
 	spin_lock_irqsave(&ss_dev->lock, flags);
 	sss->suspend = 0;
 	spin_unlock_irqrestore(&sss->lock, flags);
+#ifdef SS_ASYNC_ENABLE
+	/* start what was queued while the CE was suspended */
+	queue_work(sss->workqueue, &sss->queue_work);
+#endif
 
 	return ret;
 }
@@ -28,6 +28,8 @@
 #include <linux/dmaengine.h>
 #include <linux/dma-mapping.h>
 #include <linux/dmapool.h>
+#include <linux/dma-buf.h>
+#include <linux/version.h>
 
 #include "sunxi_ce_cdev.h"
 
@@ -545,6 +547,201 @@ static int ioctl_aes_crypto(unsigned int cmd, unsigned long arg)
 }
 
 #ifdef SS_SUPPORT_CE_V5
+struct ce_dmabuf {
+	struct dma_buf *dmabuf;
+	struct dma_buf_attachment *attach;
+	struct sg_table *sgt;
+	enum dma_data_direction dir;
+};
+
+static void ce_dmabuf_put(struct ce_dmabuf *buf)
+{
+	if (!buf->dmabuf)
+		return;
+
+	if (buf->sgt)
+		dma_buf_unmap_attachment(buf->attach, buf->sgt, buf->dir);
+	if (buf->attach)
+		dma_buf_detach(buf->dmabuf, buf->attach);
+	dma_buf_put(buf->dmabuf);
+	memset(buf, 0, sizeof(*buf));
+}
+
+/*
+ * Map a window of a dma-buf for the CE. A task takes one address per
+ * buffer, so the window has to be contiguous in the dma address space.
+ */
+static int ce_dmabuf_get(crypto_dmabuf_desc_t *desc, enum dma_data_direction dir,
+			 struct ce_dmabuf *buf, unsigned long *phy)
+{
+	struct scatterlist *sg;
+	dma_addr_t start, end;
+	int i, ret;
+
+	buf->dmabuf = dma_buf_get(desc->fd);
+	if (IS_ERR(buf->dmabuf)) {
+		SS_ERR("dma_buf_get fd %d fail\n", desc->fd);
+		ret = PTR_ERR(buf->dmabuf);
+		buf->dmabuf = NULL;
+		return ret;
+	}
+
+	if (!desc->length || desc->offset >= buf->dmabuf->size ||
+	    desc->length > buf->dmabuf->size - desc->offset) {
+		SS_ERR("Invalid window: offset = 0x%x, length = 0x%x, size = 0x%zx\n",
+		       desc->offset, desc->length, buf->dmabuf->size);
+		ret = -EINVAL;
+		goto err;
+	}
+
+	buf->attach = dma_buf_attach(buf->dmabuf, ce_cdev->pdevice);
+	if (IS_ERR(buf->attach)) {
+		SS_ERR("dma_buf_attach fail\n");
+		ret = PTR_ERR(buf->attach);
+		buf->attach = NULL;
+		goto err;
+	}
+
+	buf->dir = dir;
+	buf->sgt = dma_buf_map_attachment(buf->attach, dir);
+	if (IS_ERR_OR_NULL(buf->sgt)) {
+		SS_ERR("dma_buf_map_attachment fail\n");
+		ret = buf->sgt ? PTR_ERR(buf->sgt) : -ENOMEM;
+		buf->sgt = NULL;
+		goto err;
+	}
+
+	start = sg_dma_address(buf->sgt->sgl);
+	end = start;
+	for_each_sgtable_dma_sg(buf->sgt, sg, i) {
+		if (sg_dma_address(sg) != end)
+			break;
+		end += sg_dma_len(sg);
+	}
+	if (desc->offset + desc->length > end - start) {
+		SS_ERR("dma-buf fd %d is not contiguous\n", desc->fd);
+		ret = -EINVAL;
+		goto err;
+	}
+
+	*phy = start + desc->offset;
+	SS_DBG("fd = %d, phy = 0x%lx, length = 0x%x\n", desc->fd, *phy, desc->length);
+	return 0;
+
+err:
+	ce_dmabuf_put(buf);
+	return ret;
+}
+
+static int ioctl_aes_crypto_fd(unsigned int cmd, unsigned long arg)
+{
+	crypto_aes_fd_req_ctx_t fd_req;
+	crypto_aes_req_ctx_t *aes_req_ctx;
+	struct ce_dmabuf src = {0}, dst = {0}, key = {0};
+	int ret;
+
+	SS_DBG("arg_size = 0x%x\n", _IOC_SIZE(cmd));
+	if (_IOC_SIZE(cmd) != sizeof(crypto_aes_fd_req_ctx_t)) {
+		SS_DBG("arg_size != sizeof(crypto_aes_fd_req_ctx_t)\n");
+		return -EINVAL;
+	}
+
+	if (copy_from_user(&fd_req, (crypto_aes_fd_req_ctx_t *)arg,
+			   sizeof(crypto_aes_fd_req_ctx_t))) {
+		SS_ERR("copy_from_user fail\n");
+		return -EFAULT;
+	}
+
+	/* no bounce buffer for the padding, the caller pads the last block */
+	if (!IS_ALIGNED(fd_req.src_buf.length, AES_BLOCK_SIZE) ||
+	    fd_req.dst_buf.length < fd_req.src_buf.length) {
+		SS_ERR("Invalid len: src = 0x%x, dst = 0x%x\n",
+		       fd_req.src_buf.length, fd_req.dst_buf.length);
+		return -EINVAL;
+	}
+
+	/* do_aes_crypto() indexes the flows with it */
+	if (fd_req.channel_id < 0 || fd_req.channel_id >= SS_FLOW_NUM) {
+		SS_ERR("Invalid channel_id: %d\n", fd_req.channel_id);
+		return -EINVAL;
+	}
+
+	ce_dev_lock();
+
+	aes_req_ctx = kzalloc(sizeof(crypto_aes_req_ctx_t), GFP_KERNEL);
+	if (!aes_req_ctx) {
+		SS_ERR("kzalloc aes_req_ctx fail\n");
+		ce_dev_unlock();
+		return -ENOMEM;
+	}
+
+	aes_req_ctx->bit_width = fd_req.bit_width;
+	aes_req_ctx->method = fd_req.method;
+	aes_req_ctx->aes_mode = fd_req.aes_mode;
+	aes_req_ctx->dir = fd_req.dir;
+	aes_req_ctx->channel_id = fd_req.channel_id;
+	aes_req_ctx->src_length = fd_req.src_buf.length;
+	aes_req_ctx->dst_length = fd_req.dst_buf.length;
+	aes_req_ctx->iv_length = fd_req.iv_length;
+	aes_req_ctx->ion_flag = 1;
+
+	if (fd_req.flags & CE_AES_FD_FLAG_KEY_DMABUF) {
+		/* the CE fetches key_length bytes, the window bounds them */
+		if (!fd_req.key_buf.length ||
+		    fd_req.key_buf.length > AES_MAX_KEY_SIZE) {
+			SS_ERR("Invalid key len: 0x%x\n", fd_req.key_buf.length);
+			ret = -EINVAL;
+			goto out;
+		}
+		ret = ce_dmabuf_get(&fd_req.key_buf, DMA_TO_DEVICE, &key,
+				    &aes_req_ctx->key_phy);
+		if (ret)
+			goto out;
+		aes_req_ctx->key_length = fd_req.key_buf.length;
+	} else {
+		aes_req_ctx->key_buffer = fd_req.key_buffer;
+		aes_req_ctx->key_length = fd_req.key_length;
+		ret = sunxi_copy_from_user(&aes_req_ctx->key_buffer, aes_req_ctx->key_length);
+		if (ret) {
+			SS_ERR("key_buffer copy_from_user fail\n");
+			aes_req_ctx->key_buffer = NULL;
+			goto out;
+		}
+	}
+
+	aes_req_ctx->iv_buf = fd_req.iv_buf;
+	ret = sunxi_copy_from_user(&aes_req_ctx->iv_buf, aes_req_ctx->iv_length);
+	if (ret) {
+		SS_ERR("iv_buffer copy_from_user fail\n");
+		aes_req_ctx->iv_buf = NULL;
+		goto out;
+	}
+
+	ret = ce_dmabuf_get(&fd_req.src_buf, DMA_TO_DEVICE, &src,
+			    &aes_req_ctx->src_phy);
+	if (ret)
+		goto out;
+
+	ret = ce_dmabuf_get(&fd_req.dst_buf, DMA_FROM_DEVICE, &dst,
+			    &aes_req_ctx->dst_phy);
+	if (ret)
+		goto out;
+
+	SS_DBG("do_aes_crypto start\n");
+	ret = do_aes_crypto(aes_req_ctx);
+	if (ret)
+		SS_ERR("do_aes_crypto fail\n");
+
+out:
+	/* unmap dst last, it may share the pages with src */
+	ce_dmabuf_put(&src);
+	ce_dmabuf_put(&dst);
+	ce_dmabuf_put(&key);
+	ce_release_resources((void *)aes_req_ctx, CE_IOC_AES_CRYPTO);
+
+	return ret;
+}
+
 static int ioctl_rsa_crypto(unsigned int cmd, unsigned long arg)
 {
 	crypto_rsa_req_ctx_t *rsa_req_ctx;
@@ -932,6 +1129,15 @@ static long sunxi_ce_ioctl(struct file *file, unsigned int cmd, unsigned long ar
 		}
 		break;
 	}
+	case CE_IOC_AES_CRYPTO_FD:
+	{
+		ret = ioctl_aes_crypto_fd(CE_IOC_AES_CRYPTO_FD, arg);
+		if (ret < 0) {
+			SS_ERR("aes crypto on dma-buf failed\n");
+			return ret;
+		}
+		break;
+	}
 #endif
 	default:
 		ret = -EINVAL;
@@ -1081,6 +1287,9 @@ static void __exit sunxi_ce_module_exit(void)
 module_init(sunxi_ce_module_init);
 module_exit(sunxi_ce_module_exit);
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 16, 0)
+MODULE_IMPORT_NS(DMA_BUF);
+#endif
 MODULE_AUTHOR("mintow");
 MODULE_VERSION("1.1.0");
 MODULE_DESCRIPTION("SUNXI CE Controller Driver");
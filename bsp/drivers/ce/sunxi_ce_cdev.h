@@ -27,6 +27,9 @@
 #include <linux/scatterlist.h>
 #include <linux/interrupt.h>
 #include <linux/cdev.h>
+#include <linux/workqueue.h>
+#include <linux/timer.h>
+#include <linux/wait.h>
 
 #define SUNXI_SS_DEV_NAME		"ce"
 #define SUNXI_CE_DEV_NODE_NAME		"allwinner,sunxi-ce"
@@ -140,6 +143,13 @@
 #define SS_RSA_MAX_SIZE			(4096/8) /* in Bytes. 4096 bits */
 #define SS_FLOW_NUM			4
 
+/* Only the CE v5 driver can run the symmetric requests asynchronously. */
+#if IS_ENABLED(CONFIG_AW_CE_ASYNC) && defined(SS_SUPPORT_CE_V5)
+#define SS_ASYNC_ENABLE			1
+#define SS_ASYNC_QUEUE_LEN		128
+#define SS_ASYNC_CHAIN_MAX		16 /* the tasks started by one doorbell */
+#endif
+
 #define SS_XTS_MODE_ENABLE              1
 
 #if defined(SS_RSA512_ENABLE) || defined(SS_RSA1024_ENABLE) \
@@ -336,6 +346,20 @@ typedef struct {
 	struct completion done;
 	ss_dma_info_t dma_src;
 	ss_dma_info_t dma_dst;
+
+	/* The task state, kept until the request is finished. */
+	u32 flow;
+	int len;
+	int src_len;
+	u8 *iv;
+	u8 *next_iv;
+#ifdef SS_SCATTER_ENABLE
+	ce_task_desc_t *task;
+#endif
+#ifdef SS_ASYNC_ENABLE
+	u8 iv_buf[AES_MAX_KEY_SIZE] ____cacheline_aligned;
+	u8 next_iv_buf[AES_MAX_KEY_SIZE] ____cacheline_aligned;
+#endif
 } ss_aes_req_ctx_t;
 
 /* The common context of AES and HASH */
@@ -434,6 +458,22 @@ typedef struct {
 	struct completion done;
 	u32 available;
 	u32 buf_pendding;
+#ifdef SS_ASYNC_ENABLE
+	struct crypto_async_request *areq; /* the first request of the chain */
+	struct crypto_async_request *chain[SS_ASYNC_CHAIN_MAX];
+	ce_task_desc_t *descs[SS_ASYNC_CHAIN_MAX]; /* preallocated in task_pool */
+	u32 chain_len;
+	u32 claimed;	/* hold by a synchronous request */
+	u32 irq_done;
+	u32 timeout;
+	u32 dropped;	/* lost to the CE reset for another flow */
+	u32 gen;	/* bumped for every chain put on the flow */
+	u32 armed;	/* gen of the chain started, done_work finishes it */
+	struct work_struct done_work;
+	struct timer_list timer;
+	u64 req_cnt;
+	u64 irq_cnt;
+#endif
 } ce_channel_t;
 
 typedef struct {
@@ -462,6 +502,14 @@ typedef struct {
 	u32 irq;
 	s32 suspend;
 	struct dma_pool	*task_pool;
+#ifdef SS_ASYNC_ENABLE
+	struct crypto_queue queue;
+	struct workqueue_struct *workqueue;
+	struct work_struct queue_work;
+	wait_queue_head_t flow_wait;
+	u64 chain_hist[SS_ASYNC_CHAIN_MAX]; /* irq count by tasks per irq */
+	struct dentry *debugfs;
+#endif
 } sunxi_ce_cdev_t;
 
 extern sunxi_ce_cdev_t	*ce_cdev;
@@ -489,6 +537,38 @@ typedef struct {
 	s32 channel_id;
 } crypto_aes_req_ctx_t;
 
+/* a window of a dma-buf, used instead of a user pointer */
+typedef struct {
+	s32 fd;
+	u32 offset;
+	u32 length;
+} crypto_dmabuf_desc_t;
+
+/* the key is the key_buf window of a dma-buf, not key_buffer */
+#define CE_AES_FD_FLAG_KEY_DMABUF	BIT(0)
+
+/*
+ * define the ctx for aes request on dma-buf, the data is never copied.
+ * src and dst may be the same buffer, their length must be aligned to
+ * AES_BLOCK_SIZE. The key comes from key_buf if CE_AES_FD_FLAG_KEY_DMABUF
+ * is set in flags, otherwise from key_buffer and key_length.
+ */
+typedef struct {
+	u32 bit_width;  /* the bitwidth of CFB/CTR mode */
+	u32 method;  /* symm method, such as AES/DES/3DES ... */
+	u32 aes_mode;
+	u32 dir;
+	crypto_dmabuf_desc_t src_buf;
+	crypto_dmabuf_desc_t dst_buf;
+	crypto_dmabuf_desc_t key_buf;
+	u8 *key_buffer;
+	u32 key_length;
+	u8 *iv_buf;
+	u32 iv_length;
+	s32 channel_id;
+	u32 flags;
+} crypto_aes_fd_req_ctx_t;
+
 /* define the ctx for rsa requtest */
 typedef struct {
 	u8 *sign_buffer;
@@ -596,6 +676,7 @@ struct sunxi_crypto_tmp {
 #define CE_IOC_HASH_CRYPTO		_IOW(CE_IOC_MAGIC, 4, crypto_hash_req_ctx_t)
 #define CE_IOC_RNG_CRYPTO		_IOW(CE_IOC_MAGIC, 5, crypto_rng_req_ctx_t)
 #define CE_IOC_ECC_CRYPTO		_IOW(CE_IOC_MAGIC, 6, crypto_ecc_req_ctx_t)
+#define CE_IOC_AES_CRYPTO_FD		_IOW(CE_IOC_MAGIC, 7, crypto_aes_fd_req_ctx_t)
 
 /* Inner functions declaration */
 void ce_dev_lock(void);
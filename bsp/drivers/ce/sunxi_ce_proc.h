@@ -31,6 +31,22 @@
 int ss_aes_key_valid(struct crypto_tfm *tfm, int len);
 int ss_aes_one_req(sunxi_ce_cdev_t *sss, struct skcipher_request *req);
 
+#ifdef SS_ASYNC_ENABLE
+int ss_async_init(sunxi_ce_cdev_t *sss);
+void ss_async_exit(sunxi_ce_cdev_t *sss);
+void ss_async_wait_idle(sunxi_ce_cdev_t *sss);
+int ss_aes_async_req(sunxi_ce_cdev_t *sss, struct skcipher_request *req);
+void ss_flow_claim(u32 flow);
+void ss_flow_unclaim(u32 flow);
+void ss_flow_reset(u32 flow);
+u32 ss_flow_dropped(u32 flow);
+#else
+static inline void ss_flow_claim(u32 flow) {}
+static inline void ss_flow_unclaim(u32 flow) {}
+static inline void ss_flow_reset(u32 flow) { ss_reset(); }
+static inline u32 ss_flow_dropped(u32 flow) { return 0; }
+#endif
+
 #ifdef SS_GCM_MODE_ENABLE
 int ss_aead_crypt(struct aead_request *req, int dir, int method, int mode);
 int ss_aead_one_req(sunxi_ce_cdev_t *sss, struct aead_request *req);
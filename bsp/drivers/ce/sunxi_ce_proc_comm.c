@@ -86,6 +86,11 @@ int ss_aes_crypt(struct skcipher_request *req, int dir, int method, int mode)
 	req_ctx->mode = mode;
 	req->base.flags |= SS_FLAG_AES;
 
+#ifdef SS_ASYNC_ENABLE
+	/* RSA/DH/ECC keep their big IV in ctx, so they stay synchronous. */
+	if (CE_METHOD_IS_AES(method))
+		return ss_aes_async_req(ss_dev, req);
+#endif
 	return ss_aes_one_req(ss_dev, req);
 }
 
@@ -269,7 +274,9 @@ static int ss_hash_one_req(sunxi_ce_cdev_t *sss, struct ahash_request *req)
 	req_ctx = ahash_request_ctx(req);
 	req_ctx->dma_src.sg = req->src;
 
+	ss_flow_claim(ctx->comm.flow);
 	ret = ss_hash_start(ctx, req_ctx, req->nbytes, 0);
+	ss_flow_unclaim(ctx->comm.flow);
 	if (ret < 0)
 		SS_ERR("ss_hash_start fail(%d)\n", ret);
 
@@ -350,6 +357,7 @@ int ss_hash_final(struct ahash_request *req)
 	ss_print_hex((s8 *)ctx->pad, 128, ctx->pad);
 
 	ss_dev_lock();
+	ss_flow_claim(ctx->comm.flow);
 #ifdef SS_HASH_HW_PADDING_ALIGN_CASE
 	if (ctx->tail_len == 0)
 		ss_hash_start(ctx, req_ctx, pad_len, 0);
@@ -377,6 +385,7 @@ int ss_hash_final(struct ahash_request *req)
 
 	ss_md_get(req->result, ctx->md, ctx->md_size);
 	ss_ctrl_stop();
+	ss_flow_unclaim(ctx->comm.flow);
 	ss_dev_unlock();
 
 #ifdef SS_SHA_SWAP_FINAL_ENABLE
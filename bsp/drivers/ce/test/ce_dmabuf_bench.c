@@ -0,0 +1,365 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright(c) 2020 - 2023 Allwinner Technology Co.,Ltd. All rights reserved. */
+/*
+ * Compare the copy and the dma-buf (zero-copy) ioctl of /dev/ce.
+ *
+ * Every size is encrypted with AES-256-CBC in both modes, the output of
+ * the two modes is compared, then the throughput and the cpu time the
+ * caller spent (user + kernel, the copies run in the ioctl) are printed.
+ *
+ * usage: ce_dmabuf_bench [-H heap] [-n loops] [-m max_size]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <linux/types.h>
+#include <linux/dma-buf.h>
+
+/* keep in sync with sunxi_ce_cdev.h */
+typedef struct {
+	uint32_t bit_width;
+	uint32_t method;
+	uint8_t *src_buffer;
+	uint32_t src_length;
+	uint8_t *dst_buffer;
+	uint32_t dst_length;
+	uint8_t *key_buffer;
+	uint32_t key_length;
+	uint8_t *iv_buf;
+	uint32_t iv_length;
+	uint32_t aes_mode;
+	uint32_t dir;
+	uint32_t ion_flag;
+	unsigned long src_phy;
+	unsigned long dst_phy;
+	unsigned long iv_phy;
+	unsigned long key_phy;
+	int32_t channel_id;
+} crypto_aes_req_ctx_t;
+
+typedef struct {
+	int32_t fd;
+	uint32_t offset;
+	uint32_t length;
+} crypto_dmabuf_desc_t;
+
+typedef struct {
+	uint32_t bit_width;
+	uint32_t method;
+	uint32_t aes_mode;
+	uint32_t dir;
+	crypto_dmabuf_desc_t src_buf;
+	crypto_dmabuf_desc_t dst_buf;
+	crypto_dmabuf_desc_t key_buf;
+	uint8_t *key_buffer;
+	uint32_t key_length;
+	uint8_t *iv_buf;
+	uint32_t iv_length;
+	int32_t channel_id;
+	uint32_t flags;
+} crypto_aes_fd_req_ctx_t;
+
+#define CE_IOC_MAGIC			'C'
+#define CE_IOC_REQUEST			_IOR(CE_IOC_MAGIC, 0, int)
+#define CE_IOC_FREE			_IOW(CE_IOC_MAGIC, 1, int)
+#define CE_IOC_AES_CRYPTO		_IOW(CE_IOC_MAGIC, 2, crypto_aes_req_ctx_t)
+#define CE_IOC_AES_CRYPTO_FD		_IOW(CE_IOC_MAGIC, 7, crypto_aes_fd_req_ctx_t)
+
+#define SS_METHOD_AES			0x0
+#define SS_AES_MODE_CBC			1
+#define SS_DIR_ENCRYPT			0
+
+/* from linux/dma-heap.h, missing in older toolchains */
+struct dma_heap_allocation_data {
+	__u64 len;
+	__u32 fd;
+	__u32 fd_flags;
+	__u64 heap_flags;
+};
+#define DMA_HEAP_IOCTL_ALLOC	_IOWR('H', 0x0, struct dma_heap_allocation_data)
+
+#define MIN_SIZE	(64 << 10)
+#define MAX_SIZE	(16 << 20)
+
+struct dmabuf {
+	int fd;
+	uint8_t *vaddr;
+	size_t size;
+};
+
+struct result {
+	double mbps;
+	double cpu_pct;
+	int err;
+};
+
+static int ce_fd = -1;
+static int channel_id;
+static uint8_t key[32];
+static uint8_t iv[16];
+
+static double now(clockid_t clk)
+{
+	struct timespec ts;
+
+	clock_gettime(clk, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int dmabuf_alloc(const char *heap, size_t size, struct dmabuf *buf)
+{
+	struct dma_heap_allocation_data data;
+	char path[64];
+	int heap_fd;
+
+	snprintf(path, sizeof(path), "/dev/dma_heap/%s", heap);
+	heap_fd = open(path, O_RDWR);
+	if (heap_fd < 0) {
+		printf("open %s fail: %s\n", path, strerror(errno));
+		return -1;
+	}
+
+	memset(&data, 0, sizeof(data));
+	data.len = size;
+	data.fd_flags = O_RDWR | O_CLOEXEC;
+	if (ioctl(heap_fd, DMA_HEAP_IOCTL_ALLOC, &data) < 0) {
+		printf("alloc %zu bytes from %s fail: %s\n", size, path, strerror(errno));
+		close(heap_fd);
+		return -1;
+	}
+	close(heap_fd);
+
+	buf->fd = data.fd;
+	buf->size = size;
+	buf->vaddr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, buf->fd, 0);
+	if (buf->vaddr == MAP_FAILED) {
+		printf("mmap dma-buf fail: %s\n", strerror(errno));
+		close(buf->fd);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void dmabuf_free(struct dmabuf *buf)
+{
+	munmap(buf->vaddr, buf->size);
+	close(buf->fd);
+}
+
+static void dmabuf_sync(struct dmabuf *buf, __u64 flags)
+{
+	struct dma_buf_sync sync = { .flags = flags };
+
+	ioctl(buf->fd, DMA_BUF_IOCTL_SYNC, &sync);
+}
+
+static int aes_copy(uint8_t *src, uint8_t *dst, size_t size)
+{
+	crypto_aes_req_ctx_t req;
+
+	memset(&req, 0, sizeof(req));
+	req.method = SS_METHOD_AES;
+	req.aes_mode = SS_AES_MODE_CBC;
+	req.dir = SS_DIR_ENCRYPT;
+	req.src_buffer = src;
+	req.src_length = size;
+	req.dst_buffer = dst;
+	req.dst_length = size;
+	req.key_buffer = key;
+	req.key_length = sizeof(key);
+	req.iv_buf = iv;
+	req.iv_length = sizeof(iv);
+	req.channel_id = channel_id;
+
+	return ioctl(ce_fd, CE_IOC_AES_CRYPTO, &req);
+}
+
+static int aes_zero_copy(struct dmabuf *src, struct dmabuf *dst, size_t size)
+{
+	crypto_aes_fd_req_ctx_t req;
+
+	memset(&req, 0, sizeof(req));
+	req.method = SS_METHOD_AES;
+	req.aes_mode = SS_AES_MODE_CBC;
+	req.dir = SS_DIR_ENCRYPT;
+	req.src_buf.fd = src->fd;
+	req.src_buf.length = size;
+	req.dst_buf.fd = dst->fd;
+	req.dst_buf.length = size;
+	req.key_buffer = key;
+	req.key_length = sizeof(key);
+	req.iv_buf = iv;
+	req.iv_length = sizeof(iv);
+	req.channel_id = channel_id;
+
+	return ioctl(ce_fd, CE_IOC_AES_CRYPTO_FD, &req);
+}
+
+static void bench_copy(uint8_t *src, uint8_t *dst, size_t size, int loops,
+		       struct result *res)
+{
+	double wall, cpu;
+	int i;
+
+	res->err = 0;
+	wall = now(CLOCK_MONOTONIC);
+	cpu = now(CLOCK_THREAD_CPUTIME_ID);
+	for (i = 0; i < loops; i++) {
+		if (aes_copy(src, dst, size) < 0) {
+			res->err = errno;
+			return;
+		}
+	}
+	cpu = now(CLOCK_THREAD_CPUTIME_ID) - cpu;
+	wall = now(CLOCK_MONOTONIC) - wall;
+
+	res->mbps = (double)size * loops / wall / (1 << 20);
+	res->cpu_pct = cpu * 100 / wall;
+}
+
+static void bench_zero_copy(struct dmabuf *src, struct dmabuf *dst, size_t size,
+			    int loops, struct result *res)
+{
+	double wall, cpu;
+	int i;
+
+	res->err = 0;
+	wall = now(CLOCK_MONOTONIC);
+	cpu = now(CLOCK_THREAD_CPUTIME_ID);
+	for (i = 0; i < loops; i++) {
+		if (aes_zero_copy(src, dst, size) < 0) {
+			res->err = errno;
+			return;
+		}
+	}
+	cpu = now(CLOCK_THREAD_CPUTIME_ID) - cpu;
+	wall = now(CLOCK_MONOTONIC) - wall;
+
+	res->mbps = (double)size * loops / wall / (1 << 20);
+	res->cpu_pct = cpu * 100 / wall;
+}
+
+static void print_result(const char *name, struct result *res)
+{
+	if (res->err)
+		printf("  %-10s %10s (%s)", name, "fail", strerror(res->err));
+	else
+		printf("  %-10s %7.1f MB/s cpu %5.1f%%", name, res->mbps, res->cpu_pct);
+}
+
+static void usage(const char *name)
+{
+	printf("usage: %s [-H heap] [-n loops] [-m max_size]\n", name);
+	printf("  -H  dma-heap of the zero-copy buffers, default reserved\n");
+	printf("  -n  loops per size, default 20\n");
+	printf("  -m  largest size in bytes, default %d\n", MAX_SIZE);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *heap = "reserved";
+	struct dmabuf src_buf, dst_buf;
+	struct result copy_res, zc_res;
+	uint8_t *src, *dst;
+	size_t max_size = MAX_SIZE;
+	size_t size;
+	int loops = 20;
+	int opt, ret = 0;
+
+	while ((opt = getopt(argc, argv, "H:n:m:h")) != -1) {
+		switch (opt) {
+		case 'H':
+			heap = optarg;
+			break;
+		case 'n':
+			loops = atoi(optarg);
+			break;
+		case 'm':
+			max_size = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : -1;
+		}
+	}
+	if (loops <= 0 || max_size < MIN_SIZE) {
+		usage(argv[0]);
+		return -1;
+	}
+
+	ce_fd = open("/dev/ce", O_RDWR);
+	if (ce_fd < 0) {
+		printf("open /dev/ce fail: %s\n", strerror(errno));
+		return -1;
+	}
+	if (ioctl(ce_fd, CE_IOC_REQUEST, &channel_id) < 0) {
+		printf("request ce channel fail: %s\n", strerror(errno));
+		close(ce_fd);
+		return -1;
+	}
+
+	memset(key, 0x5a, sizeof(key));
+	memset(iv, 0xa5, sizeof(iv));
+
+	src = malloc(max_size);
+	dst = malloc(max_size);
+	if (!src || !dst) {
+		printf("malloc %zu bytes fail\n", max_size);
+		ret = -1;
+		goto out;
+	}
+	if (dmabuf_alloc(heap, max_size, &src_buf)) {
+		ret = -1;
+		goto out;
+	}
+	if (dmabuf_alloc(heap, max_size, &dst_buf)) {
+		dmabuf_free(&src_buf);
+		ret = -1;
+		goto out;
+	}
+
+	for (size = 0; size < max_size; size++)
+		src[size] = rand();
+	dmabuf_sync(&src_buf, DMA_BUF_SYNC_START | DMA_BUF_SYNC_WRITE);
+	memcpy(src_buf.vaddr, src, max_size);
+	dmabuf_sync(&src_buf, DMA_BUF_SYNC_END | DMA_BUF_SYNC_WRITE);
+
+	printf("AES-256-CBC encrypt, %d loops, heap %s\n", loops, heap);
+	for (size = MIN_SIZE; size <= max_size; size <<= 2) {
+		bench_copy(src, dst, size, loops, &copy_res);
+		bench_zero_copy(&src_buf, &dst_buf, size, loops, &zc_res);
+
+		printf("%6zu KiB:", size >> 10);
+		print_result("copy", &copy_res);
+		print_result("zero-copy", &zc_res);
+
+		if (!copy_res.err && !zc_res.err) {
+			dmabuf_sync(&dst_buf, DMA_BUF_SYNC_START | DMA_BUF_SYNC_READ);
+			if (memcmp(dst, dst_buf.vaddr, size)) {
+				printf("  MISMATCH");
+				ret = -1;
+			}
+			dmabuf_sync(&dst_buf, DMA_BUF_SYNC_END | DMA_BUF_SYNC_READ);
+		}
+		printf("\n");
+	}
+
+	dmabuf_free(&dst_buf);
+	dmabuf_free(&src_buf);
+out:
+	free(dst);
+	free(src);
+	ioctl(ce_fd, CE_IOC_FREE, &channel_id);
+	close(ce_fd);
+	return ret;
+}
@@ -93,7 +93,14 @@ irqreturn_t sunxi_ce_irq_handler(int irq, void *dev_id)
 
 static int check_aes_ctx_vaild(crypto_aes_req_ctx_t *req)
 {
-	if (!req->src_buffer || !req->dst_buffer || !req->key_buffer) {
+	if (req->ion_flag) {
+		if (!req->src_phy || !req->dst_phy ||
+		    (!req->key_buffer && !req->key_phy)) {
+			SS_ERR("Invalid para: src_phy = 0x%lx, dst_phy = 0x%lx key_phy = 0x%lx\n",
+					req->src_phy, req->dst_phy, req->key_phy);
+			return -EINVAL;
+		}
+	} else if (!req->src_buffer || !req->dst_buffer || !req->key_buffer) {
 		SS_ERR("Invalid para: src = 0x%px, dst = 0x%px key = 0x%p\n",
 				req->src_buffer, req->dst_buffer, req->key_buffer);
 		return -EINVAL;
@@ -214,8 +221,9 @@ static int ce_task_data_init(crypto_aes_req_ctx_t *req, phys_addr_t src_phy,
 			ce_task_addr_set(NULL, ce_task_addr_get(prev->key_addr), ptask->key_addr);
 			ce_task_addr_set(NULL, ce_task_addr_get(prev->iv_addr), ptask->iv_addr);
 			ptask->data_len = 0;
-			ce_task_addr_set(NULL, ce_task_addr_get(prev->next_task_addr), ptask->iv_addr);
-			/* prev->next = (ce_task_desc_t *)(ptask_phy >> WORD_ALGIN); */
+			/* Link the task, only the last one raises the irq. */
+			ptask->comm_ctl &= ~CE_COMM_CTL_TASK_INT_MASK;
+			ce_task_addr_set(NULL, ptask_phy, prev->next_task_addr);
 			prev->next_virt = ptask;
 			ptask->task_phy_addr = ptask_phy;
 
@@ -303,7 +311,13 @@ static int aes_crypto_start(crypto_aes_req_ctx_t *req, u8 *src_buffer,
 	ce_aes_config(req, task);
 
 	/* task_key_set */
-	if (req->key_length) {
+	if (req->key_length && !req->key_buffer) {
+		/* the key is in a dma-buf, it is mapped by the caller */
+		ss_keyselect_set(CE_KEY_SELECT_INPUT, task);
+		ss_keysize_set(req->key_length, task);
+		ce_task_addr_set(NULL, req->key_phy, task->key_addr);
+		SS_DBG("key_phy_addr = 0x%lx\n", req->key_phy);
+	} else if (req->key_length) {
 		key_phy = dma_map_single(ce_cdev->pdevice,
 					req->key_buffer, req->key_length, DMA_TO_DEVICE);
 		SS_DBG("key = 0x%px, key_phy_addr = 0x%px\n", req->key_buffer, (void *)key_phy);
@@ -371,7 +385,7 @@ out:
 	ce_task_destroy(task);
 
 	/* key */
-	if (req->key_length) {
+	if (req->key_length && req->key_buffer) {
 		dma_unmap_single(ce_cdev->pdevice,
 			key_phy, req->key_length, DMA_FROM_DEVICE);
 	}
@@ -23,6 +23,9 @@
 #include <linux/dmaengine.h>
 #include <linux/dma-mapping.h>
 #include <linux/dmapool.h>
+#include <linux/workqueue.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include "../sunxi_ce_cdev.h"
 #include "../sunxi_ce_proc.h"
@@ -562,7 +565,7 @@ static int ss_aead_start(ss_aead_ctx_t *ctx, ss_aes_req_ctx_t *req_ctx)
 		msecs_to_jiffies(SS_WAIT_TIME));
 	if (ret == 0) {
 		SS_ERR("Timed out\n");
-		ss_reset();
+		ss_flow_reset(flow);
 		ret = -ETIMEDOUT;
 	}
 	ss_irq_disable(flow);
@@ -598,6 +601,10 @@ static int ss_aead_start(ss_aead_ctx_t *ctx, ss_aes_req_ctx_t *req_ctx)
 
 	SS_DBG("After CE, TSR: 0x%08x, ERR: 0x%08x\n",
 		ss_reg_rd(CE_REG_TSR), ss_reg_rd(CE_REG_ERR));
+	if (ss_flow_dropped(flow)) {
+		SS_ERR("Flow %d dropped by the CE reset\n", flow);
+		return -EIO;
+	}
 	if (ss_flow_err(flow)) {
 		SS_ERR("CE return error: %d\n", ss_flow_err(flow));
 		return -EINVAL;
@@ -606,16 +613,22 @@ static int ss_aead_start(ss_aead_ctx_t *ctx, ss_aes_req_ctx_t *req_ctx)
 	return 0;
 }
 
-static int ss_aes_start(ss_aes_ctx_t *ctx, ss_aes_req_ctx_t *req_ctx, int len)
+/*
+ * Fill req_ctx->task for req_ctx->flow, and map the buffers of the request.
+ * A task from task_pool has its task_phy_addr, and needn't be mapped.
+ */
+static void ss_aes_task_prepare(ss_aes_ctx_t *ctx, ss_aes_req_ctx_t *req_ctx)
 {
-	int ret = 0;
+	int len = req_ctx->len;
 	int src_len = len;
 	int align_size = 0;
-	u32 flow = ctx->comm.flow;
+	u32 flow = req_ctx->flow;
 	phys_addr_t phy_addr = 0;
-	ce_task_desc_t *task = &ss_dev->flows[flow].task;
+	ce_task_desc_t *task = req_ctx->task;
+	dma_addr_t task_phy = task->task_phy_addr;
 
 	ss_task_desc_init(task, flow);
+	task->task_phy_addr = task_phy;
 
 	ss_pending_clear(flow);
 	ss_irq_enable(flow);
@@ -665,18 +678,18 @@ static int ss_aes_start(ss_aes_ctx_t *ctx, ss_aes_req_ctx_t *req_ctx, int len)
 		ctx->key, ctx->key_size, DMA_MEM_TO_DEV);
 
 	if (ctx->iv_size > 0) {
-		phy_addr = virt_to_phys(ctx->iv);
-		SS_DBG("ctx->iv vir = 0x%px, phy = 0x%pa\n", ctx->iv, &phy_addr);
-		ss_iv_set(ctx->iv, ctx->iv_size, task);
+		phy_addr = virt_to_phys(req_ctx->iv);
+		SS_DBG("iv vir = 0x%px, phy = 0x%pa\n", req_ctx->iv, &phy_addr);
+		ss_iv_set(req_ctx->iv, ctx->iv_size, task);
 		dma_map_single(&ss_dev->pdev->dev,
-			ctx->iv, ctx->iv_size, DMA_MEM_TO_DEV);
+			req_ctx->iv, ctx->iv_size, DMA_MEM_TO_DEV);
 
-		phy_addr = virt_to_phys(ctx->next_iv);
-		SS_DBG("ctx->next_iv addr, vir = 0x%px, phy = 0x%pa\n",
-			ctx->next_iv, &phy_addr);
-		ss_cnt_set(ctx->next_iv, ctx->iv_size, task);
+		phy_addr = virt_to_phys(req_ctx->next_iv);
+		SS_DBG("next_iv addr, vir = 0x%px, phy = 0x%pa\n",
+			req_ctx->next_iv, &phy_addr);
+		ss_cnt_set(req_ctx->next_iv, ctx->iv_size, task);
 		dma_map_single(&ss_dev->pdev->dev,
-			ctx->next_iv, ctx->iv_size, DMA_DEV_TO_MEM);
+			req_ctx->next_iv, ctx->iv_size, DMA_DEV_TO_MEM);
 	}
 
 	align_size = ss_aes_align_size(req_ctx->type, req_ctx->mode);
@@ -728,27 +741,29 @@ static int ss_aes_start(ss_aes_ctx_t *ctx, ss_aes_req_ctx_t *req_ctx, int len)
 		ss_data_len_set(DIV_ROUND_UP(src_len, align_size) * align_size, task);
 #endif
 
+	req_ctx->src_len = src_len;
+
 	ce_print_task_desc(task);
-	/* Start CE controller. */
-	init_completion(&ss_dev->flows[flow].done);
-	dma_map_single(&ss_dev->pdev->dev, task, sizeof(ce_task_desc_t),
-		DMA_MEM_TO_DEV);
+	if (!task->task_phy_addr)
+		dma_map_single(&ss_dev->pdev->dev, task, sizeof(ce_task_desc_t),
+			DMA_MEM_TO_DEV);
 
 	SS_DBG("preCE, COMM: 0x%08x, SYM: 0x%08x, ASYM: 0x%08x, data_len:%d\n",
 		task->comm_ctl, task->sym_ctl, task->asym_ctl, task->data_len);
+}
 
-	ss_ctrl_start(task, req_ctx->type, req_ctx->mode);
+/* Unmap the buffers of the finished task, and check the result of flow. */
+static int ss_aes_task_finish(ss_aes_ctx_t *ctx, ss_aes_req_ctx_t *req_ctx)
+{
+	int len = req_ctx->len;
+	int src_len = req_ctx->src_len;
+	int align_size = ss_aes_align_size(req_ctx->type, req_ctx->mode);
+	u32 flow = req_ctx->flow;
+	ce_task_desc_t *task = req_ctx->task;
 
-	ret = wait_for_completion_timeout(&ss_dev->flows[flow].done,
-		msecs_to_jiffies(SS_WAIT_TIME));
-	if (ret == 0) {
-		SS_ERR("Timed out\n");
-		ss_reset();
-		ret = -ETIMEDOUT;
-	}
-	ss_irq_disable(flow);
-	dma_unmap_single(&ss_dev->pdev->dev, virt_to_phys(task),
-		sizeof(ce_task_desc_t), DMA_MEM_TO_DEV);
+	if (!task->task_phy_addr)
+		dma_unmap_single(&ss_dev->pdev->dev, virt_to_phys(task),
+			sizeof(ce_task_desc_t), DMA_MEM_TO_DEV);
 
 	/* Unpadding and unmap the dst sg. */
 	ss_aes_unpadding(task->ce_sg,
@@ -767,9 +782,9 @@ static int ss_aes_start(ss_aes_ctx_t *ctx, ss_aes_req_ctx_t *req_ctx, int len)
 		req_ctx->dma_src.sg, req_ctx->dma_src.nents, DMA_MEM_TO_DEV);
 
 	if (ctx->iv_size > 0) {
-		dma_unmap_single(&ss_dev->pdev->dev, virt_to_phys(ctx->iv),
+		dma_unmap_single(&ss_dev->pdev->dev, virt_to_phys(req_ctx->iv),
 			ctx->iv_size, DMA_MEM_TO_DEV);
-		dma_unmap_single(&ss_dev->pdev->dev, virt_to_phys(ctx->next_iv),
+		dma_unmap_single(&ss_dev->pdev->dev, virt_to_phys(req_ctx->next_iv),
 			ctx->iv_size, DMA_DEV_TO_MEM);
 	}
 	/* Backup the next IV from ctr_descriptor, except CBC/CTS/XTS mode. */
@@ -777,13 +792,17 @@ static int ss_aes_start(ss_aes_ctx_t *ctx, ss_aes_req_ctx_t *req_ctx, int len)
 		&& (req_ctx->mode != SS_AES_MODE_CBC)
 		&& (req_ctx->mode != SS_AES_MODE_CTS)
 		&& (req_ctx->mode != SS_AES_MODE_XTS))
-		memcpy(ctx->iv, ctx->next_iv, ctx->iv_size);
+		memcpy(req_ctx->iv, req_ctx->next_iv, ctx->iv_size);
 
 	dma_unmap_single(&ss_dev->pdev->dev,
 		virt_to_phys(ctx->key), ctx->key_size, DMA_MEM_TO_DEV);
 
 	SS_DBG("After CE, TSR: 0x%08x, ERR: 0x%08x\n",
 		ss_reg_rd(CE_REG_TSR), ss_reg_rd(CE_REG_ERR));
+	if (ss_flow_dropped(flow)) {
+		SS_ERR("Flow %d dropped by the CE reset\n", flow);
+		return -EIO;
+	}
 	if (ss_flow_err(flow)) {
 		SS_ERR("CE return error: %d\n", ss_flow_err(flow));
 		return -EINVAL;
@@ -792,6 +811,36 @@ static int ss_aes_start(ss_aes_ctx_t *ctx, ss_aes_req_ctx_t *req_ctx, int len)
 	return 0;
 }
 
+static int ss_aes_start(ss_aes_ctx_t *ctx, ss_aes_req_ctx_t *req_ctx, int len)
+{
+	int ret = 0;
+	u32 flow = ctx->comm.flow;
+	ce_task_desc_t *task = &ss_dev->flows[flow].task;
+
+	req_ctx->flow = flow;
+	req_ctx->len = len;
+	req_ctx->iv = ctx->iv;
+	req_ctx->next_iv = ctx->next_iv;
+	req_ctx->task = task;
+	task->task_phy_addr = 0;
+	ss_aes_task_prepare(ctx, req_ctx);
+
+	/* Start CE controller. */
+	init_completion(&ss_dev->flows[flow].done);
+	ss_ctrl_start(task, req_ctx->type, req_ctx->mode);
+
+	ret = wait_for_completion_timeout(&ss_dev->flows[flow].done,
+		msecs_to_jiffies(SS_WAIT_TIME));
+	if (ret == 0) {
+		SS_ERR("Timed out\n");
+		ss_flow_reset(flow);
+		ret = -ETIMEDOUT;
+	}
+	ss_irq_disable(flow);
+
+	return ss_aes_task_finish(ctx, req_ctx);
+}
+
 /* verify the key_len */
 int ss_aes_key_valid(struct crypto_tfm *tfm, int len)
 {
@@ -914,7 +963,7 @@ static int ss_rng_start(ss_aes_ctx_t *ctx, u8 *rdata, u32 dlen, u32 trng)
 		msecs_to_jiffies(SS_WAIT_TIME));
 	if (ret == 0) {
 		SS_ERR("Timed out\n");
-		ss_reset();
+		ss_flow_reset(flow);
 		ret = -ETIMEDOUT;
 	}
 	SS_DBG("After CE, TSR: 0x%08x, ERR: 0x%08x\n",
@@ -931,7 +980,7 @@ static int ss_rng_start(ss_aes_ctx_t *ctx, u8 *rdata, u32 dlen, u32 trng)
 	memcpy(rdata, buf, dlen);
 	kfree(buf);
 	ss_irq_disable(flow);
-	ret = dlen;
+	ret = ss_flow_dropped(flow) ? -EIO : dlen;
 
 	return ret;
 }
@@ -951,7 +1000,9 @@ int ss_rng_get_random(struct crypto_rng *tfm, u8 *rdata, u32 dlen, u32 trng)
 	}
 
 	ss_dev_lock();
+	ss_flow_claim(ctx->comm.flow);
 	ret = ss_rng_start(ctx, data, len, trng);
+	ss_flow_unclaim(ctx->comm.flow);
 	ss_dev_unlock();
 
 	SS_DBG("Get %d byte random.\n", ret);
@@ -1066,7 +1117,7 @@ static int ss_drbg_start(ss_drbg_ctx_t *ctx, u8 *src, u32 slen, u8 *rdata, u32 d
 		msecs_to_jiffies(SS_WAIT_TIME));
 	if (ret == 0) {
 		SS_ERR("Timed out\n");
-		ss_reset();
+		ss_flow_reset(flow);
 		ret = -ETIMEDOUT;
 	}
 	SS_DBG("After CE, TSR: 0x%08x, ERR: 0x%08x\n",
@@ -1089,7 +1140,7 @@ static int ss_drbg_start(ss_drbg_ctx_t *ctx, u8 *src, u32 slen, u8 *rdata, u32 d
 
 	memcpy(rdata, buf, dlen);
 	ss_irq_disable(flow);
-	ret = dlen;
+	ret = ss_flow_dropped(flow) ? -EIO : dlen;
 
 	if (ctx->person_size)
 		kfree(person);
@@ -1123,7 +1174,9 @@ int ss_drbg_get_random(struct crypto_rng *tfm, const u8 *src, u32 slen, u8 *rdat
 	memcpy(src_t, src, slen);
 
 	ss_dev_lock();
+	ss_flow_claim(ctx->comm.flow);
 	ret = ss_drbg_start(ctx, src_t, slen, data, len, mode);
+	ss_flow_unclaim(ctx->comm.flow);
 	ss_dev_unlock();
 
 	kfree(src_t);
@@ -1241,7 +1294,7 @@ u32 ss_hash_start(ss_hash_ctx_t *ctx, ss_aes_req_ctx_t *req_ctx, u32 len, u32 la
 	ret = wait_for_completion_timeout(&ss_dev->flows[flow].done, msecs_to_jiffies(SS_WAIT_TIME));
 	if (ret == 0) {
 		SS_ERR("Timed out\n");
-		ss_reset();
+		ss_flow_reset(flow);
 		ret = -ETIMEDOUT;
 	}
 	ss_irq_disable(flow);
@@ -1262,6 +1315,10 @@ u32 ss_hash_start(ss_hash_ctx_t *ctx, ss_aes_req_ctx_t *req_ctx, u32 len, u32 la
 	SS_DBG("After CE, dst data:\n");
 	ss_print_hex(digest, SHA512_DIGEST_SIZE, digest);
 
+	if (ss_flow_dropped(flow)) {
+		SS_ERR("Flow %d dropped by the CE reset\n", flow);
+		return -EIO;
+	}
 	if (ss_flow_err(flow)) {
 		SS_ERR("CE return error: %d\n", ss_flow_err(flow));
 		kfree(digest);
@@ -1350,7 +1407,9 @@ int ss_aead_one_req(sunxi_ce_cdev_t *sss, struct aead_request *req)
 	req_ctx->dma_src.sg = req->src;
 	req_ctx->dma_dst.sg = req->dst;
 
+	ss_flow_claim(ctx->comm.flow);
 	ret = ss_aead_start(ctx, req_ctx);
+	ss_flow_unclaim(ctx->comm.flow);
 	if (ret < 0)
 		SS_ERR("ss_aes_start fail(%d)\n", ret);
 
@@ -1387,7 +1446,9 @@ int ss_aes_one_req(sunxi_ce_cdev_t *sss, struct skcipher_request *req)
 	ss_rsa_preprocess(ctx, req_ctx, req->cryptlen);
 #endif
 
+	ss_flow_claim(ctx->comm.flow);
 	ret = ss_aes_start(ctx, req_ctx, req->cryptlen);
+	ss_flow_unclaim(ctx->comm.flow);
 	if (ret < 0)
 		SS_ERR("ss_aes_start fail(%d)\n", ret);
 
@@ -1405,6 +1466,433 @@ int ss_aes_one_req(sunxi_ce_cdev_t *sss, struct skcipher_request *req)
 	return ret;
 }
 
+#ifdef SS_ASYNC_ENABLE
+/*
+ * The skcipher requests are put in ss_dev->queue, and started on any flow
+ * which is neither running a chain nor claimed by a synchronous user.
+ * Up to SS_ASYNC_CHAIN_MAX requests of the same task type are linked by
+ * next_task_addr, so that they are started by one doorbell, and only the
+ * last task raises the irq. The irq finishes the chain in done_work.
+ */
+static void ss_async_complete(struct crypto_async_request *areq, int err)
+{
+	local_bh_disable();
+	areq->complete(areq, err);
+	local_bh_enable();
+}
+
+/* The tasks of a chain must go to the same queue of ss_ctrl_start(). */
+static int ss_async_task_type(struct crypto_async_request *areq)
+{
+	ss_aes_req_ctx_t *req_ctx = skcipher_request_ctx(skcipher_request_cast(areq));
+
+	return req_ctx->mode == SS_AES_MODE_XTS;
+}
+
+static void ss_async_prepare(sunxi_ce_cdev_t *sss, u32 flow, int index,
+	struct skcipher_request *req)
+{
+	struct crypto_skcipher *tfm = crypto_skcipher_reqtfm(req);
+	ss_aes_ctx_t *ctx = crypto_skcipher_ctx(tfm);
+	ss_aes_req_ctx_t *req_ctx = skcipher_request_ctx(req);
+	u32 iv_size = crypto_skcipher_ivsize(tfm);
+
+	/* The requests of one tfm may run at the same time,
+	 * so the IV is kept in req_ctx instead of ctx. */
+	req_ctx->flow = flow;
+	req_ctx->iv = req_ctx->iv_buf;
+	req_ctx->next_iv = req_ctx->next_iv_buf;
+	req_ctx->task = sss->flows[flow].descs[index];
+	ctx->iv_size = iv_size;
+	if (iv_size > 0)
+		memcpy(req_ctx->iv_buf, req->iv, iv_size);
+
+	ss_aes_task_prepare(ctx, req_ctx);
+}
+
+static void ss_async_start(sunxi_ce_cdev_t *sss, u32 flow)
+{
+	int i;
+	ce_channel_t *chan = &sss->flows[flow];
+	ss_aes_req_ctx_t *req_ctx = NULL;
+	unsigned long flags = 0;
+
+	for (i = 0; i < chan->chain_len; i++)
+		ss_async_prepare(sss, flow, i, skcipher_request_cast(chan->chain[i]));
+
+	/* Link the tasks, the last one raises the irq. */
+	for (i = 0; i < chan->chain_len - 1; i++) {
+		chan->descs[i]->comm_ctl &= ~CE_COMM_CTL_TASK_INT_MASK;
+		ce_task_addr_set(NULL, chan->descs[i + 1]->task_phy_addr,
+			chan->descs[i]->next_task_addr);
+	}
+
+	/* From here on the irq, the timer and a reset may finish the chain. */
+	spin_lock_irqsave(&sss->lock, flags);
+	chan->armed = chan->gen;
+	spin_unlock_irqrestore(&sss->lock, flags);
+	chan->req_cnt += chan->chain_len;
+	mod_timer(&chan->timer, jiffies + msecs_to_jiffies(SS_WAIT_TIME));
+
+	req_ctx = skcipher_request_ctx(skcipher_request_cast(chan->areq));
+	ss_ctrl_start(chan->descs[0], req_ctx->type, req_ctx->mode);
+}
+
+static void ss_async_queue_work(struct work_struct *work)
+{
+	sunxi_ce_cdev_t *sss = container_of(work, sunxi_ce_cdev_t, queue_work);
+	struct crypto_async_request *areq = NULL;
+	struct crypto_async_request *backlog[SS_ASYNC_CHAIN_MAX];
+	ce_channel_t *chan = NULL;
+	unsigned long flags = 0;
+	int nbacklog = 0;
+	int i;
+	u32 flow;
+
+	while (1) {
+		spin_lock_irqsave(&sss->lock, flags);
+		for (flow = 0; flow < SS_FLOW_NUM; flow++) {
+			if (!sss->flows[flow].areq && !sss->flows[flow].claimed)
+				break;
+		}
+		/* Held back while suspended, the resume kicks the queue again. */
+		if (sss->suspend || (flow == SS_FLOW_NUM) || (sss->queue.qlen == 0)) {
+			spin_unlock_irqrestore(&sss->lock, flags);
+			return;
+		}
+
+		chan = &sss->flows[flow];
+		chan->chain_len = 0;
+		/* A done_work queued for the last chain must not take this one. */
+		chan->gen++;
+		chan->timeout = 0;
+		chan->dropped = 0;
+		WRITE_ONCE(chan->irq_done, 0);
+		nbacklog = 0;
+		while (chan->chain_len < SS_ASYNC_CHAIN_MAX) {
+			areq = list_first_entry_or_null(&sss->queue.list,
+				struct crypto_async_request, list);
+			if ((areq == NULL) || (chan->chain_len &&
+				(ss_async_task_type(areq) !=
+					ss_async_task_type(chan->areq))))
+				break;
+
+			backlog[nbacklog] = crypto_get_backlog(&sss->queue);
+			if (backlog[nbacklog])
+				nbacklog++;
+			crypto_dequeue_request(&sss->queue);
+			if (chan->chain_len == 0)
+				chan->areq = areq;
+			chan->chain[chan->chain_len++] = areq;
+		}
+		spin_unlock_irqrestore(&sss->lock, flags);
+
+		for (i = 0; i < nbacklog; i++)
+			ss_async_complete(backlog[i], -EINPROGRESS);
+
+		SS_DBG("Start %d requests on flow %d\n", chan->chain_len, flow);
+		ss_async_start(sss, flow);
+	}
+}
+
+static void ss_async_done_work(struct work_struct *work)
+{
+	ce_channel_t *chan = container_of(work, ce_channel_t, done_work);
+	sunxi_ce_cdev_t *sss = ss_dev;
+	u32 flow = chan - sss->flows;
+	struct crypto_async_request *chain[SS_ASYNC_CHAIN_MAX];
+	struct skcipher_request *req = NULL;
+	ss_aes_req_ctx_t *req_ctx = NULL;
+	ss_aes_ctx_t *ctx = NULL;
+	unsigned long flags = 0;
+	int ret[SS_ASYNC_CHAIN_MAX];
+	int chain_len = 0;
+	int i;
+
+	/* The irq and the timer may both queue this work for one chain,
+	 * and a late one may find the next chain not started yet. */
+	spin_lock_irqsave(&sss->lock, flags);
+	if ((chan->areq == NULL) || (chan->armed != chan->gen) ||
+		(!READ_ONCE(chan->irq_done) && !chan->timeout)) {
+		spin_unlock_irqrestore(&sss->lock, flags);
+		return;
+	}
+	chain_len = chan->chain_len;
+	spin_unlock_irqrestore(&sss->lock, flags);
+
+	del_timer_sync(&chan->timer);
+	if (chan->dropped) {
+		SS_ERR("Flow %d dropped by the CE reset\n", flow);
+	} else if (!READ_ONCE(chan->irq_done)) {
+		SS_ERR("Flow %d timed out\n", flow);
+		ss_flow_reset(flow);
+	} else {
+		chan->irq_cnt++;
+		sss->chain_hist[chain_len - 1]++;
+	}
+
+	for (i = 0; i < chain_len; i++) {
+		chain[i] = chan->chain[i];
+		req = skcipher_request_cast(chain[i]);
+		req_ctx = skcipher_request_ctx(req);
+		ctx = crypto_skcipher_ctx(crypto_skcipher_reqtfm(req));
+
+		ret[i] = ss_aes_task_finish(ctx, req_ctx);
+		if (chan->dropped)
+			ret[i] = -EIO;
+		else if (!READ_ONCE(chan->irq_done))
+			ret[i] = -ETIMEDOUT;
+		else if (ctx->iv_size > 0)
+			memcpy(req->iv, req_ctx->iv_buf, ctx->iv_size);
+	}
+
+	spin_lock_irqsave(&sss->lock, flags);
+	chan->areq = NULL;
+	chan->chain_len = 0;
+	spin_unlock_irqrestore(&sss->lock, flags);
+
+	/* Refill the flow before completing, the caller may wait for it. */
+	wake_up(&sss->flow_wait);
+	queue_work(sss->workqueue, &sss->queue_work);
+
+	for (i = 0; i < chain_len; i++)
+		ss_async_complete(chain[i], ret[i]);
+}
+
+static void ss_async_timeout(struct timer_list *t)
+{
+	ce_channel_t *chan = from_timer(chan, t, timer);
+
+	chan->timeout = 1;
+	queue_work(ss_dev->workqueue, &chan->done_work);
+}
+
+int ss_aes_async_req(sunxi_ce_cdev_t *sss, struct skcipher_request *req)
+{
+	int ret = 0;
+	unsigned long flags = 0;
+	ss_aes_req_ctx_t *req_ctx = skcipher_request_ctx(req);
+
+	if (!req->src || !req->dst) {
+		SS_ERR("Invalid sg: src = 0x%px, dst = 0x%px\n", req->src, req->dst);
+		return -EINVAL;
+	}
+
+	req_ctx->dma_src.sg = req->src;
+	req_ctx->dma_dst.sg = req->dst;
+	req_ctx->len = req->cryptlen;
+
+	spin_lock_irqsave(&sss->lock, flags);
+	ret = crypto_enqueue_request(&sss->queue, &req->base);
+	spin_unlock_irqrestore(&sss->lock, flags);
+
+	queue_work(sss->workqueue, &sss->queue_work);
+	return ret;
+}
+
+static bool ss_flow_try_claim(ce_channel_t *chan)
+{
+	bool ret = false;
+	unsigned long flags = 0;
+
+	spin_lock_irqsave(&ss_dev->lock, flags);
+	if (!chan->areq && !chan->claimed) {
+		chan->claimed = 1;
+		chan->dropped = 0;
+		ret = true;
+	}
+	spin_unlock_irqrestore(&ss_dev->lock, flags);
+
+	return ret;
+}
+
+/* Take the flow from the queue, before a synchronous request uses it. */
+void ss_flow_claim(u32 flow)
+{
+	wait_event(ss_dev->flow_wait, ss_flow_try_claim(&ss_dev->flows[flow]));
+}
+
+void ss_flow_unclaim(u32 flow)
+{
+	unsigned long flags = 0;
+
+	spin_lock_irqsave(&ss_dev->lock, flags);
+	ss_dev->flows[flow].claimed = 0;
+	spin_unlock_irqrestore(&ss_dev->lock, flags);
+
+	queue_work(ss_dev->workqueue, &ss_dev->queue_work);
+}
+
+/*
+ * The CE has one reset for all the flows. Reset it for the hung @flow, then
+ * fail what the other flows had in flight with -EIO: an async chain is
+ * finished by its done_work, a synchronous user is woken up and finds the
+ * flow dropped. Nothing is left waiting for an irq the reset threw away.
+ */
+void ss_flow_reset(u32 flow)
+{
+	sunxi_ce_cdev_t *sss = ss_dev;
+	unsigned long flags = 0;
+	u32 i;
+
+	ss_reset();
+
+	spin_lock_irqsave(&sss->lock, flags);
+	for (i = 0; i < SS_FLOW_NUM; i++) {
+		ce_channel_t *chan = &sss->flows[i];
+
+		if (i == flow)
+			continue;
+		/* A chain not started yet goes to the CE after the reset. */
+		if (chan->areq && (chan->armed == chan->gen)) {
+			chan->dropped = 1;
+			chan->timeout = 1;
+			queue_work(sss->workqueue, &chan->done_work);
+		} else if (chan->claimed) {
+			chan->dropped = 1;
+			complete(&chan->done);
+		}
+	}
+	spin_unlock_irqrestore(&sss->lock, flags);
+}
+
+u32 ss_flow_dropped(u32 flow)
+{
+	return READ_ONCE(ss_dev->flows[flow].dropped);
+}
+
+static bool ss_async_idle(sunxi_ce_cdev_t *sss)
+{
+	int i;
+	bool ret = true;
+	unsigned long flags = 0;
+
+	spin_lock_irqsave(&sss->lock, flags);
+	/* While suspended the queued requests wait for the resume. */
+	if (sss->queue.qlen && !sss->suspend)
+		ret = false;
+	for (i = 0; i < SS_FLOW_NUM; i++) {
+		if (sss->flows[i].areq)
+			ret = false;
+	}
+	spin_unlock_irqrestore(&sss->lock, flags);
+
+	return ret;
+}
+
+void ss_async_wait_idle(sunxi_ce_cdev_t *sss)
+{
+	wait_event(sss->flow_wait, ss_async_idle(sss));
+}
+
+static void ss_async_chain_show_line(struct seq_file *m, const char *name,
+	u64 desc_cnt, u64 irq_cnt)
+{
+	u64 avg = 0;
+	u32 rem = 0;
+
+	if (irq_cnt)
+		avg = div_u64_rem(div64_u64(desc_cnt * 100, irq_cnt), 100, &rem);
+	seq_printf(m, "%-6s %-12llu %-12llu %llu.%02u\n",
+		name, desc_cnt, irq_cnt, avg, rem);
+}
+
+static int ss_async_chain_show(struct seq_file *m, void *data)
+{
+	sunxi_ce_cdev_t *sss = m->private;
+	u64 desc_cnt = 0;
+	u64 irq_cnt = 0;
+	char name[8];
+	int i;
+
+	seq_puts(m, "flow   tasks        irqs         tasks/irq\n");
+	for (i = 0; i < SS_FLOW_NUM; i++) {
+		snprintf(name, sizeof(name), "%d", i);
+		ss_async_chain_show_line(m, name,
+			sss->flows[i].req_cnt, sss->flows[i].irq_cnt);
+		desc_cnt += sss->flows[i].req_cnt;
+		irq_cnt += sss->flows[i].irq_cnt;
+	}
+	ss_async_chain_show_line(m, "all", desc_cnt, irq_cnt);
+
+	seq_puts(m, "\ntasks/irq  count\n");
+	for (i = 0; i < SS_ASYNC_CHAIN_MAX; i++)
+		seq_printf(m, "%-10d %llu\n", i + 1, sss->chain_hist[i]);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(ss_async_chain);
+
+static void ss_async_free_descs(sunxi_ce_cdev_t *sss)
+{
+	int i, j;
+	ce_task_desc_t *task = NULL;
+
+	for (i = 0; i < SS_FLOW_NUM; i++) {
+		for (j = 0; j < SS_ASYNC_CHAIN_MAX; j++) {
+			task = sss->flows[i].descs[j];
+			if (task)
+				dma_pool_free(sss->task_pool, task, task->task_phy_addr);
+			sss->flows[i].descs[j] = NULL;
+		}
+	}
+}
+
+int ss_async_init(sunxi_ce_cdev_t *sss)
+{
+	int i, j;
+	dma_addr_t task_phy = 0;
+	ce_task_desc_t *task = NULL;
+
+	crypto_init_queue(&sss->queue, SS_ASYNC_QUEUE_LEN);
+	init_waitqueue_head(&sss->flow_wait);
+	INIT_WORK(&sss->queue_work, ss_async_queue_work);
+	for (i = 0; i < SS_FLOW_NUM; i++) {
+		INIT_WORK(&sss->flows[i].done_work, ss_async_done_work);
+		timer_setup(&sss->flows[i].timer, ss_async_timeout, 0);
+
+		for (j = 0; j < SS_ASYNC_CHAIN_MAX; j++) {
+			task = dma_pool_zalloc(sss->task_pool, GFP_KERNEL, &task_phy);
+			if (task == NULL) {
+				SS_ERR("Failed to alloc the task of flow %d\n", i);
+				ss_async_free_descs(sss);
+				return -ENOMEM;
+			}
+			task->task_phy_addr = task_phy;
+			sss->flows[i].descs[j] = task;
+		}
+	}
+
+	/* dm-crypt may write back pages through us, so it must not block on
+	 * memory reclaim. */
+	sss->workqueue = alloc_workqueue("sunxi-ce",
+		WQ_HIGHPRI | WQ_UNBOUND | WQ_MEM_RECLAIM, SS_FLOW_NUM + 1);
+	if (sss->workqueue == NULL) {
+		SS_ERR("Failed to alloc workqueue\n");
+		ss_async_free_descs(sss);
+		return -ENOMEM;
+	}
+
+	sss->debugfs = debugfs_create_dir("sunxi-ce", NULL);
+	debugfs_create_file("chain_stat", 0444, sss->debugfs, sss,
+		&ss_async_chain_fops);
+
+	return 0;
+}
+
+void ss_async_exit(sunxi_ce_cdev_t *sss)
+{
+	int i;
+
+	debugfs_remove_recursive(sss->debugfs);
+	ss_async_wait_idle(sss);
+	destroy_workqueue(sss->workqueue);
+	for (i = 0; i < SS_FLOW_NUM; i++)
+		del_timer_sync(&sss->flows[i].timer);
+	ss_async_free_descs(sss);
+}
+#endif /* SS_ASYNC_ENABLE */
+
 irqreturn_t sunxi_ss_irq_handler(int irq, void *dev_id)
 {
 	int i;
@@ -1417,6 +1905,14 @@ irqreturn_t sunxi_ss_irq_handler(int irq, void *dev_id)
 		if (pending & (CE_CHAN_PENDING << (2 * i))) {
 			SS_DBG("Chan %d completed. pending: %#x\n", i, pending);
 			ss_pending_clear(i);
+#ifdef SS_ASYNC_ENABLE
+			if (READ_ONCE(sss->flows[i].areq)) {
+				WRITE_ONCE(sss->flows[i].irq_done, 1);
+				queue_work(sss->workqueue,
+					&sss->flows[i].done_work);
+				continue;
+			}
+#endif
 			complete(&sss->flows[i].done);
 		}
 	}
@@ -1444,6 +1940,7 @@ int ce_trng_get_random(u8 *buf, u32 rng_len, u32 flag)
 	}
 	SS_DBG("Task addr, vir = 0x%px, phy = 0x%x\n", task, ptask);
 
+	ss_flow_claim(flow);
 	ss_new_task_desc_init(task, flow);
 	task->task_phy_addr = ptask;
 
@@ -1477,7 +1974,7 @@ int ce_trng_get_random(u8 *buf, u32 rng_len, u32 flag)
 		SS_ERR("Timed out\n");
 		SS_ERR("ERR: 0x%08x\n", ss_reg_rd(CE_REG_ERR));
 		dma_pool_free(ss_dev->task_pool, task, ptask);
-		ss_reset();
+		ss_flow_reset(flow);
 		ret = -ETIMEDOUT;
 	}
 	SS_DBG("After CE, TSR: 0x%08x, ERR: 0x%08x\n",
@@ -1489,7 +1986,9 @@ int ce_trng_get_random(u8 *buf, u32 rng_len, u32 flag)
 	dma_unmap_single(&ss_dev->pdev->dev, virt_to_phys(buf),
 		rng_len, DMA_DEV_TO_MEM);
 
+	ret = ss_flow_dropped(flow) ? -EIO : 0;
 	ss_irq_disable(flow);
+	ss_flow_unclaim(flow);
 
-	return 0;
+	return ret;
 }
@@ -15,9 +15,13 @@
 #include <linux/types.h>
 #include <linux/delay.h>
 #include <linux/io.h>
+#include <linux/spinlock.h>
 
 #include "sunxi_ce_reg.h"
 
+/* ICR and TSK/TLR are shared by all the flows, which may run on any cpu. */
+static DEFINE_SPINLOCK(ss_reg_lock);
+
 inline u32 ss_readl(u32 offset)
 {
 	return readl(ss_membase() + offset);
@@ -169,18 +173,26 @@ int ss_pending_get(void)
 
 void ss_irq_enable(int flow)
 {
-	int val = ss_readl(CE_REG_ICR);
+	int val = 0;
+	unsigned long flags = 0;
 
+	spin_lock_irqsave(&ss_reg_lock, flags);
+	val = ss_readl(CE_REG_ICR);
 	val |= CE_CHAN_INT_ENABLE << flow;
 	ss_writel(CE_REG_ICR, val);
+	spin_unlock_irqrestore(&ss_reg_lock, flags);
 }
 
 void ss_irq_disable(int flow)
 {
-	int val = ss_readl(CE_REG_ICR);
+	int val = 0;
+	unsigned long flags = 0;
 
+	spin_lock_irqsave(&ss_reg_lock, flags);
+	val = ss_readl(CE_REG_ICR);
 	val &= ~(CE_CHAN_INT_ENABLE << flow);
 	ss_writel(CE_REG_ICR, val);
+	spin_unlock_irqrestore(&ss_reg_lock, flags);
 }
 
 void ss_md_get(char *dst, char *src, int size)
@@ -362,6 +374,7 @@ void ss_ecc_op_mode_set(int mode, ce_task_desc_t *task)
 void ss_ctrl_start(ce_task_desc_t *task, int type, int mode)
 {
 	phys_addr_t task_phy;
+	unsigned long flags = 0;
 
 	if (task->task_phy_addr) {
 		task_phy = task->task_phy_addr;
@@ -369,6 +382,7 @@ void ss_ctrl_start(ce_task_desc_t *task, int type, int mode)
 		task_phy = virt_to_phys(task);
 	}
 
+	spin_lock_irqsave(&ss_reg_lock, flags);
 	if (task_phy > 0xffffffff) {
 		ss_writel(CE_REG_TSK0, task_phy & 0xffffffff);
 		ss_writel(CE_REG_TSK1, ((unsigned long long)task_phy >> 32));
@@ -384,11 +398,13 @@ void ss_ctrl_start(ce_task_desc_t *task, int type, int mode)
 		ss_writel(CE_REG_TLR, 0x1 << CE_REG_TLR_SYMM_TYPE_SHIFT);
 	else
 		ss_writel(CE_REG_TLR, 0x1 << CE_REG_TLR_ASYM_TYPE_SHIFT);
+	spin_unlock_irqrestore(&ss_reg_lock, flags);
 }
 
 void ss_ctrl_hash_start(ce_new_task_desc_t *task, int type, int mode)
 {
 	phys_addr_t task_phy;
+	unsigned long flags = 0;
 
 	if (task->task_phy_addr) {
 		task_phy = task->task_phy_addr;
@@ -396,6 +412,7 @@ void ss_ctrl_hash_start(ce_new_task_desc_t *task, int type, int mode)
 		task_phy = virt_to_phys(task);
 	}
 
+	spin_lock_irqsave(&ss_reg_lock, flags);
 	if (task_phy > 0xffffffff) {
 		ss_writel(CE_REG_TSK0, task_phy & 0xffffffff);
 		ss_writel(CE_REG_TSK1, ((unsigned long long)task_phy >> 32));
@@ -404,6 +421,7 @@ void ss_ctrl_hash_start(ce_new_task_desc_t *task, int type, int mode)
 	}
 
 	ss_writel(CE_REG_TLR, 0x1 << CE_REG_TLR_HASH_RBG_TYPE_SHIFT);
+	spin_unlock_irqrestore(&ss_reg_lock, flags);
 }
 
 void ss_ctrl_stop(void)
@@ -494,6 +512,7 @@ void ss_rng_method_set(int hash_type, int type, ce_new_task_desc_t *task)
 void ss_hash_rng_ctrl_start(ce_new_task_desc_t *task)
 {
 	phys_addr_t task_phy;
+	unsigned long flags = 0;
 
 	if (task->task_phy_addr) {
 		task_phy = task->task_phy_addr;
@@ -501,6 +520,7 @@ void ss_hash_rng_ctrl_start(ce_new_task_desc_t *task)
 		task_phy = virt_to_phys(task);
 	}
 
+	spin_lock_irqsave(&ss_reg_lock, flags);
 	if (task_phy > 0xffffffff) {
 		ss_writel(CE_REG_TSK0, task_phy & 0xffffffff);
 		ss_writel(CE_REG_TSK1, ((unsigned long long)task_phy >> 32));
@@ -509,6 +529,7 @@ void ss_hash_rng_ctrl_start(ce_new_task_desc_t *task)
 	}
 
 	ss_writel(CE_REG_TLR, 0x1 << CE_REG_TLR_HASH_RBG_TYPE_SHIFT);
+	spin_unlock_irqrestore(&ss_reg_lock, flags);
 	task->task_phy_addr = task_phy;
 }
 
@@ -0,0 +1,367 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/* Copyright(c) 2020 - 2023 Allwinner Technology Co.,Ltd. All rights reserved. */
+/*
+ * memcpy benchmark for the sunxi dma, in the style of dmatest
+ *
+ * Every iteration preps, submits and issues one memcpy, then waits for
+ * its callback and checks the copy. The time from prep to issue is the
+ * software cost of a transfer and is reported per channel.
+ *
+ *   echo 4096 > /sys/module/sunxi_dma_bench/parameters/buf_size
+ *   echo 1 > /sys/module/sunxi_dma_bench/parameters/reuse
+ *   echo 1 > /sys/module/sunxi_dma_bench/parameters/run
+ *
+ * With lines set, every transfer is an interleaved copy of lines x
+ * buf_size bytes between buffers of src_stride and dst_stride bytes per
+ * line, and the check also makes sure the gaps between the lines of the
+ * destination are left alone.
+ *
+ *   echo 64 > /sys/module/sunxi_dma_bench/parameters/lines
+ *   echo 8192 > /sys/module/sunxi_dma_bench/parameters/dst_stride
+ */
+
+#include <linux/dma-mapping.h>
+#include <linux/dmaengine.h>
+#include <linux/kthread.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+
+#define BENCH_DRIVER_NAME	"sun6i-dma"
+#define BENCH_MAX_CHANNELS	16
+#define BENCH_GAP_PATTERN	0xa5
+
+static unsigned int iterations = 1000;
+module_param(iterations, uint, 0644);
+MODULE_PARM_DESC(iterations, "transfers per channel (default: 1000)");
+
+static unsigned int buf_size = SZ_4K;
+module_param(buf_size, uint, 0644);
+MODULE_PARM_DESC(buf_size, "bytes per transfer (default: 4096)");
+
+static unsigned int channels = 1;
+module_param(channels, uint, 0644);
+MODULE_PARM_DESC(channels, "channels run in parallel (default: 1)");
+
+static bool reuse;
+module_param(reuse, bool, 0644);
+MODULE_PARM_DESC(reuse, "prep once with DMA_CTRL_REUSE and resubmit (default: N)");
+
+static bool verify = true;
+module_param(verify, bool, 0644);
+MODULE_PARM_DESC(verify, "check the data of every transfer (default: Y)");
+
+static unsigned int lines;
+module_param(lines, uint, 0644);
+MODULE_PARM_DESC(lines, "lines of an interleaved copy, 0 for a memcpy (default: 0)");
+
+static unsigned int src_stride;
+module_param(src_stride, uint, 0644);
+MODULE_PARM_DESC(src_stride, "source bytes per line, 0 for buf_size (default: 0)");
+
+static unsigned int dst_stride;
+module_param(dst_stride, uint, 0644);
+MODULE_PARM_DESC(dst_stride, "destination bytes per line, 0 for buf_size (default: 0)");
+
+static unsigned int timeout_ms = 3000;
+module_param(timeout_ms, uint, 0644);
+MODULE_PARM_DESC(timeout_ms, "transfer timeout in msec (default: 3000)");
+
+struct bench_thread {
+	struct dma_chan *chan;
+	struct task_struct *task;
+	struct completion cmp;
+	struct completion finished;
+	void *src, *dst;
+	dma_addr_t src_dma, dst_dma;
+	size_t src_len, dst_len;
+	struct dma_interleaved_template *xt;
+	u64 prep_min, prep_max, prep_total;
+	u64 xfer_total;
+	unsigned int done;
+	unsigned int errors;
+	int ret;
+};
+
+static DEFINE_MUTEX(bench_lock);
+
+static bool bench_filter(struct dma_chan *chan, void *param)
+{
+	return !strcmp(dev_driver_string(chan->device->dev), BENCH_DRIVER_NAME);
+}
+
+static void bench_callback(void *param)
+{
+	struct bench_thread *t = param;
+
+	complete(&t->cmp);
+}
+
+static void bench_fill(struct bench_thread *t, unsigned int iter)
+{
+	u8 *src = t->src;
+	size_t i;
+
+	for (i = 0; i < t->src_len; i++)
+		src[i] = (u8)(i + iter);
+	memset(t->dst, lines ? BENCH_GAP_PATTERN : 0, t->dst_len);
+}
+
+static bool bench_check(struct bench_thread *t)
+{
+	size_t sstride = src_stride ? : buf_size;
+	size_t dstride = dst_stride ? : buf_size;
+	u8 *src = t->src, *dst = t->dst;
+	size_t l, i;
+
+	if (!lines)
+		return !memcmp(src, dst, buf_size);
+
+	for (l = 0; l < lines; l++) {
+		if (memcmp(src + l * sstride, dst + l * dstride, buf_size))
+			return false;
+		for (i = buf_size; i < dstride; i++)
+			if (dst[l * dstride + i] != BENCH_GAP_PATTERN)
+				return false;
+	}
+
+	return true;
+}
+
+static struct dma_async_tx_descriptor *bench_prep(struct bench_thread *t,
+						  unsigned long flags)
+{
+	if (!t->xt)
+		return dmaengine_prep_dma_memcpy(t->chan, t->dst_dma, t->src_dma,
+						 buf_size, flags);
+
+	t->xt->src_start = t->src_dma;
+	t->xt->dst_start = t->dst_dma;
+	return dmaengine_prep_interleaved_dma(t->chan, t->xt, flags);
+}
+
+/* one chunk per frame, a frame per line */
+static struct dma_interleaved_template *bench_alloc_xt(void)
+{
+	struct dma_interleaved_template *xt;
+
+	xt = kzalloc(struct_size(xt, sgl, 1), GFP_KERNEL);
+	if (!xt)
+		return NULL;
+
+	xt->dir = DMA_MEM_TO_MEM;
+	xt->numf = lines;
+	xt->frame_size = 1;
+	xt->src_inc = true;
+	xt->dst_inc = true;
+	xt->src_sgl = true;
+	xt->dst_sgl = true;
+	xt->sgl[0].size = buf_size;
+	xt->sgl[0].src_icg = (src_stride ? : buf_size) - buf_size;
+	xt->sgl[0].dst_icg = (dst_stride ? : buf_size) - buf_size;
+
+	return xt;
+}
+
+static int bench_thread_fn(void *data)
+{
+	struct bench_thread *t = data;
+	struct dma_chan *chan = t->chan;
+	struct dma_async_tx_descriptor *tx = NULL;
+	unsigned long flags = DMA_PREP_INTERRUPT;
+	dma_cookie_t cookie;
+	u64 start, issued, end;
+	unsigned int i;
+
+	if (reuse)
+		flags |= DMA_CTRL_REUSE;
+
+	t->prep_min = U64_MAX;
+	for (i = 0; i < iterations && !kthread_should_stop(); i++) {
+		if (verify)
+			bench_fill(t, i);
+		reinit_completion(&t->cmp);
+
+		start = ktime_get_ns();
+		if (!tx) {
+			tx = bench_prep(t, flags);
+			if (!tx) {
+				t->ret = -ENOMEM;
+				break;
+			}
+			if (reuse && dmaengine_desc_set_reuse(tx)) {
+				t->ret = -EOPNOTSUPP;
+				break;
+			}
+			tx->callback = bench_callback;
+			tx->callback_param = t;
+		}
+		cookie = dmaengine_submit(tx);
+		dma_async_issue_pending(chan);
+		issued = ktime_get_ns();
+
+		if (!wait_for_completion_timeout(&t->cmp,
+						 msecs_to_jiffies(timeout_ms))) {
+			t->ret = -ETIMEDOUT;
+			break;
+		}
+		end = ktime_get_ns();
+
+		if (dma_async_is_tx_complete(chan, cookie, NULL, NULL) != DMA_COMPLETE ||
+		    (verify && !bench_check(t)))
+			t->errors++;
+
+		t->prep_min = min(t->prep_min, issued - start);
+		t->prep_max = max(t->prep_max, issued - start);
+		t->prep_total += issued - start;
+		t->xfer_total += end - start;
+		t->done++;
+
+		if (!reuse)
+			tx = NULL;
+		else
+			/* the completion tasklet has to hand the desc back first */
+			dmaengine_synchronize(chan);
+	}
+
+	if (tx && reuse)
+		dmaengine_desc_free(tx);
+
+	complete(&t->finished);
+	return 0;
+}
+
+static void bench_report(struct bench_thread *t)
+{
+	u64 avg, mbps;
+
+	if (!t->done) {
+		pr_info("%s: no transfer done, ret %d\n",
+			dma_chan_name(t->chan), t->ret);
+		return;
+	}
+
+	avg = div_u64(t->prep_total, t->done);
+	mbps = t->xfer_total ? div64_u64((u64)buf_size * (lines ? : 1) *
+					 t->done * 1000, t->xfer_total) : 0;
+	pr_info("%s: %u x %u x %u bytes%s, prep+issue min/avg/max %llu/%llu/%llu ns, %llu MB/s, %u errors, ret %d\n",
+		dma_chan_name(t->chan), t->done, lines ? : 1, buf_size,
+		reuse ? " reused" : "", t->prep_min, avg, t->prep_max,
+		mbps, t->errors, t->ret);
+}
+
+static int bench_run(void)
+{
+	struct bench_thread *threads;
+	struct bench_thread *t;
+	struct device *dev;
+	dma_cap_mask_t mask;
+	unsigned int i, nr = 0;
+	int ret = 0;
+
+	if (!buf_size || !IS_ALIGNED(buf_size, 4) || !iterations ||
+	    !channels || channels > BENCH_MAX_CHANNELS)
+		return -EINVAL;
+	if (lines && ((src_stride && src_stride < buf_size) ||
+		      (dst_stride && dst_stride < buf_size)))
+		return -EINVAL;
+
+	threads = kcalloc(channels, sizeof(*threads), GFP_KERNEL);
+	if (!threads)
+		return -ENOMEM;
+
+	dma_cap_zero(mask);
+	dma_cap_set(lines ? DMA_INTERLEAVE : DMA_MEMCPY, mask);
+
+	for (nr = 0; nr < channels; nr++) {
+		t = &threads[nr];
+		t->chan = dma_request_channel(mask, bench_filter, NULL);
+		if (!t->chan)
+			break;
+
+		dev = t->chan->device->dev;
+		init_completion(&t->cmp);
+		init_completion(&t->finished);
+		t->src_len = (size_t)(src_stride ? : buf_size) * (lines ? : 1);
+		t->dst_len = (size_t)(dst_stride ? : buf_size) * (lines ? : 1);
+		t->src = dma_alloc_coherent(dev, t->src_len, &t->src_dma, GFP_KERNEL);
+		t->dst = dma_alloc_coherent(dev, t->dst_len, &t->dst_dma, GFP_KERNEL);
+		if (lines)
+			t->xt = bench_alloc_xt();
+		if (!t->src || !t->dst || (lines && !t->xt)) {
+			ret = -ENOMEM;
+			nr++;
+			goto out;
+		}
+	}
+	if (!nr) {
+		pr_err("no %s %s channel\n", BENCH_DRIVER_NAME,
+		       lines ? "interleave" : "memcpy");
+		ret = -ENODEV;
+		goto out;
+	}
+
+	for (i = 0; i < nr; i++) {
+		t = &threads[i];
+		t->task = kthread_run(bench_thread_fn, t, "%s-bench",
+				      dma_chan_name(t->chan));
+		if (IS_ERR(t->task)) {
+			ret = PTR_ERR(t->task);
+			t->task = NULL;
+			break;
+		}
+		get_task_struct(t->task);
+	}
+
+	for (i = 0; i < nr; i++) {
+		t = &threads[i];
+		if (!t->task)
+			continue;
+		wait_for_completion(&t->finished);
+		kthread_stop(t->task);
+		put_task_struct(t->task);
+		bench_report(t);
+	}
+
+out:
+	for (i = 0; i < nr; i++) {
+		t = &threads[i];
+		dev = t->chan->device->dev;
+		if (t->src)
+			dma_free_coherent(dev, t->src_len, t->src, t->src_dma);
+		if (t->dst)
+			dma_free_coherent(dev, t->dst_len, t->dst, t->dst_dma);
+		kfree(t->xt);
+		dma_release_channel(t->chan);
+	}
+	kfree(threads);
+
+	return ret;
+}
+
+static int bench_run_set(const char *val, const struct kernel_param *kp)
+{
+	bool start;
+	int ret;
+
+	ret = kstrtobool(val, &start);
+	if (ret || !start)
+		return ret;
+
+	mutex_lock(&bench_lock);
+	ret = bench_run();
+	mutex_unlock(&bench_lock);
+
+	return ret;
+}
+
+static const struct kernel_param_ops bench_run_ops = {
+	.set = bench_run_set,
+	.get = param_get_bool,
+};
+
+static bool run;
+module_param_cb(run, &bench_run_ops, &run, 0200);
+MODULE_PARM_DESC(run, "write 1 to run the benchmark");
+
+MODULE_DESCRIPTION("Allwinner DMA memcpy benchmark");
+MODULE_LICENSE("GPL");
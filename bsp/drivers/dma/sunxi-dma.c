@@ -9,6 +9,7 @@
  */
 
 #include <linux/clk.h>
+#include <linux/debugfs.h>
 #include <linux/delay.h>
 #include <linux/dmaengine.h>
 #include <linux/dmapool.h>
@@ -18,8 +19,10 @@
 #include <linux/of_device.h>
 #include <linux/platform_device.h>
 #include <linux/reset.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/types.h>
+#include <linux/version.h>
 #include <virt-dma.h>
 #include "sunxi-dma.h"
 
@@ -138,6 +141,19 @@
 #define DMA_IRQ_CPU_ENABLE_MASK		0xFF
 #define DMA_IRQ_MCU_DISABLE_MASK 	0xFF00
 
+/*
+ * Descriptors and LLIs of finished transfers are kept per vchan and
+ * handed out again on the next prep, instead of going back to kfree and
+ * the dma pool. Up to SUNXI_DMA_LLI_PREALLOC LLIs are allocated when a
+ * client requests the channel.
+ */
+#define SUNXI_DMA_DESC_CACHE		8
+#define SUNXI_DMA_LLI_CACHE		64
+#define SUNXI_DMA_LLI_PREALLOC		16
+
+/* irq to callback latency, bucket n counts latencies below 2^n us */
+#define SUNXI_DMA_LAT_BUCKETS		16
+
 /* forward declaration */
 struct sun6i_dma_dev;
 
@@ -217,6 +233,20 @@ struct sun6i_desc {
 	struct virt_dma_desc	vd;
 	dma_addr_t		p_lli;
 	struct sun6i_dma_lli	*v_lli;
+	struct sun6i_dma_lli	*v_last;
+	u32			nr_lli;
+	bool			cyclic;
+
+	/* client callback, called from sun6i_dma_callback() */
+	struct dmaengine_desc_callback cb;
+	u32			pchan_idx;
+	u64			irq_ns;
+};
+
+struct sun6i_dma_lat {
+	atomic_long_t		hist[SUNXI_DMA_LAT_BUCKETS];
+	atomic_long_t		restart;
+	u64			max_ns;
 };
 
 struct sun6i_pchan {
@@ -224,7 +254,7 @@ struct sun6i_pchan {
 	void __iomem		*base;
 	struct sun6i_vchan	*vchan;
 	struct sun6i_desc	*desc;
-	struct sun6i_desc	*done;
+	struct sun6i_dma_lat	lat;
 };
 
 struct sun6i_vchan {
@@ -236,6 +266,13 @@ struct sun6i_vchan {
 	u8			irq_type;
 	bool			cyclic;
 	struct sunxi_dma_desc	*extend_desc;
+
+	/* recycled descriptors and LLIs, protected by cache_lock */
+	spinlock_t		cache_lock;
+	struct list_head	free_descs;
+	u32			nr_free_descs;
+	struct sun6i_dma_lli	*free_lli;
+	u32			nr_free_lli;
 };
 
 struct sun6i_dma_dev {
@@ -258,6 +295,7 @@ struct sun6i_dma_dev {
 	u32			num_pchans;
 	u32			num_vchans;
 	u32			max_request;
+	struct dentry		*debugfs;
 };
 
 static struct device *chan2dev(struct dma_chan *chan)
@@ -511,9 +549,154 @@ static void *sun6i_dma_lli_add(struct sun6i_dma_lli *prev,
 	next->p_lli_next = LLI_LAST_ITEM;
 	next->v_lli_next = NULL;
 
+	if (txd) {
+		txd->v_last = next;
+		txd->nr_lli++;
+	}
+
 	return next;
 }
 
+static struct sun6i_desc *sun6i_dma_desc_get(struct sun6i_vchan *vchan)
+{
+	struct sun6i_desc *txd = NULL;
+	unsigned long flags;
+
+	spin_lock_irqsave(&vchan->cache_lock, flags);
+	if (!list_empty(&vchan->free_descs)) {
+		txd = list_first_entry(&vchan->free_descs,
+				       struct sun6i_desc, vd.node);
+		list_del(&txd->vd.node);
+		vchan->nr_free_descs--;
+	}
+	spin_unlock_irqrestore(&vchan->cache_lock, flags);
+
+	if (txd)
+		memset(txd, 0, sizeof(*txd));
+	else
+		txd = kzalloc(sizeof(*txd), GFP_NOWAIT);
+
+	return txd;
+}
+
+static struct sun6i_dma_lli *sun6i_dma_lli_get(struct sun6i_dma_dev *sdev,
+					       struct sun6i_vchan *vchan,
+					       dma_addr_t *p_lli)
+{
+	struct sun6i_dma_lli *lli;
+	unsigned long flags;
+
+	spin_lock_irqsave(&vchan->cache_lock, flags);
+	lli = vchan->free_lli;
+	if (lli) {
+		vchan->free_lli = lli->v_lli_next;
+		vchan->nr_free_lli--;
+	}
+	spin_unlock_irqrestore(&vchan->cache_lock, flags);
+
+	if (lli) {
+		*p_lli = lli->this_phy;
+		return lli;
+	}
+
+	lli = dma_pool_alloc(sdev->pool, GFP_NOWAIT, p_lli);
+	if (lli)
+		lli->this_phy = *p_lli;
+
+	return lli;
+}
+
+/*
+ * Give the descriptor and its LLI chain back to the vchan. The chain is
+ * spliced as a whole in O(1), what does not fit in the cache is freed.
+ */
+static void sun6i_dma_desc_put(struct sun6i_dma_dev *sdev,
+			       struct sun6i_vchan *vchan,
+			       struct sun6i_desc *txd)
+{
+	struct sun6i_dma_lli *v_lli = txd->v_lli, *v_next;
+	unsigned long flags;
+
+	spin_lock_irqsave(&vchan->cache_lock, flags);
+	if (v_lli && vchan->nr_free_lli + txd->nr_lli <= SUNXI_DMA_LLI_CACHE) {
+		txd->v_last->v_lli_next = vchan->free_lli;
+		vchan->free_lli = v_lli;
+		vchan->nr_free_lli += txd->nr_lli;
+		v_lli = NULL;
+	}
+	if (vchan->nr_free_descs < SUNXI_DMA_DESC_CACHE) {
+		list_add(&txd->vd.node, &vchan->free_descs);
+		vchan->nr_free_descs++;
+		txd = NULL;
+	}
+	spin_unlock_irqrestore(&vchan->cache_lock, flags);
+
+	while (v_lli) {
+		v_next = v_lli->v_lli_next;
+		dma_pool_free(sdev->pool, v_lli, v_lli->this_phy);
+		v_lli = v_next;
+	}
+	kfree(txd);
+}
+
+static void sun6i_dma_cache_fill(struct sun6i_dma_dev *sdev,
+				 struct sun6i_vchan *vchan)
+{
+	struct sun6i_dma_lli *lli;
+	struct sun6i_desc *txd;
+	dma_addr_t p_lli;
+	unsigned long flags;
+	int i;
+
+	for (i = 0; i < SUNXI_DMA_DESC_CACHE; i++) {
+		txd = kzalloc(sizeof(*txd), GFP_KERNEL);
+		if (!txd)
+			return;
+		spin_lock_irqsave(&vchan->cache_lock, flags);
+		list_add(&txd->vd.node, &vchan->free_descs);
+		vchan->nr_free_descs++;
+		spin_unlock_irqrestore(&vchan->cache_lock, flags);
+	}
+
+	for (i = 0; i < SUNXI_DMA_LLI_PREALLOC; i++) {
+		lli = dma_pool_alloc(sdev->pool, GFP_KERNEL, &p_lli);
+		if (!lli)
+			return;
+		lli->this_phy = p_lli;
+		spin_lock_irqsave(&vchan->cache_lock, flags);
+		lli->v_lli_next = vchan->free_lli;
+		vchan->free_lli = lli;
+		vchan->nr_free_lli++;
+		spin_unlock_irqrestore(&vchan->cache_lock, flags);
+	}
+}
+
+static void sun6i_dma_cache_drain(struct sun6i_dma_dev *sdev,
+				  struct sun6i_vchan *vchan)
+{
+	struct sun6i_dma_lli *v_lli, *v_next;
+	struct sun6i_desc *txd, *tmp;
+	unsigned long flags;
+	LIST_HEAD(head);
+
+	spin_lock_irqsave(&vchan->cache_lock, flags);
+	list_splice_init(&vchan->free_descs, &head);
+	vchan->nr_free_descs = 0;
+	v_lli = vchan->free_lli;
+	vchan->free_lli = NULL;
+	vchan->nr_free_lli = 0;
+	spin_unlock_irqrestore(&vchan->cache_lock, flags);
+
+	list_for_each_entry_safe(txd, tmp, &head, vd.node)
+		kfree(txd);
+
+	while (v_lli) {
+		v_next = v_lli->v_lli_next;
+		dma_pool_free(sdev->pool, v_lli, v_lli->this_phy);
+		v_lli = v_next;
+	}
+}
+
 static inline void sun6i_dma_dump_lli(struct sun6i_vchan *vchan,
 				      struct sun6i_dma_lli *lli)
 {
@@ -531,30 +714,15 @@ static void sun6i_dma_free_desc(struct virt_dma_desc *vd)
 {
 	struct sun6i_desc *txd = to_sun6i_desc(&vd->tx);
 	struct sun6i_dma_dev *sdev = to_sun6i_dma_dev(vd->tx.chan->device);
-	struct sun6i_dma_lli *v_lli, *v_next;
-	dma_addr_t p_lli, p_next;
+	struct sun6i_vchan *vchan = to_sun6i_vchan(vd->tx.chan);
 
 	if (unlikely(!txd))
 		return;
 
-	p_lli = txd->p_lli;
-	v_lli = txd->v_lli;
-
-	while (v_lli) {
-		v_next = v_lli->v_lli_next;
-		p_next = v_lli->p_lli_next;
-
-		dma_pool_free(sdev->pool, v_lli, p_lli);
-
-		v_lli = v_next;
-		p_lli = p_next;
-	}
-
 	txd->vd.tx.callback = NULL;
 	txd->vd.tx.callback_result = NULL;
 	txd->vd.tx.callback_param = NULL;
-	kfree(txd);
-	txd = NULL;
+	sun6i_dma_desc_put(sdev, vchan, txd);
 }
 
 static int sun6i_dma_start_desc(struct sun6i_vchan *vchan)
@@ -569,14 +737,13 @@ static int sun6i_dma_start_desc(struct sun6i_vchan *vchan)
 
 	if (!desc) {
 		pchan->desc = NULL;
-		pchan->done = NULL;
 		return -EAGAIN;
 	}
 
 	list_del(&desc->node);
 
 	pchan->desc = to_sun6i_desc(&desc->tx);
-	pchan->done = NULL;
+	pchan->desc->pchan_idx = pchan->idx;
 
 	sun6i_dma_dump_lli(vchan, pchan->desc->v_lli);
 
@@ -585,11 +752,14 @@ static int sun6i_dma_start_desc(struct sun6i_vchan *vchan)
 
 	vchan->irq_type = vchan->cyclic ? (DMA_IRQ_PKG | DMA_IRQ_TIMEOUT) : DMA_IRQ_QUEUE;
 
+	/* the irq and the tasklet may start channels sharing this register */
+	spin_lock(&sdev->lock);
 	irq_val = sdev->cfg->read_irq_enable(sdev, irq_reg);
 	irq_val &= ~((DMA_IRQ_HALF | DMA_IRQ_PKG | DMA_IRQ_QUEUE | DMA_IRQ_TIMEOUT) <<
 			(irq_offset * DMA_IRQ_CHAN_WIDTH));
 	irq_val |= vchan->irq_type << (irq_offset * DMA_IRQ_CHAN_WIDTH);
 	sdev->cfg->irq_enable(sdev, irq_reg, irq_val);
+	spin_unlock(&sdev->lock);
 
 	writel(pchan->desc->p_lli, pchan->base + DMA_CHAN_LLI_ADDR);
 	writel(DMA_CHAN_ENABLE_START, pchan->base + DMA_CHAN_ENABLE);
@@ -608,27 +778,10 @@ static void sun6i_dma_tasklet(unsigned long data)
 	unsigned int pchan_alloc = 0;
 	unsigned int pchan_idx;
 
-	list_for_each_entry(vchan, &sdev->slave.channels, vc.chan.device_node) {
-		spin_lock_irq(&vchan->vc.lock);
-
-		pchan = vchan->phy;
-
-		if (pchan && pchan->done) {
-			if (sun6i_dma_start_desc(vchan)) {
-				/*
-				 * No current txd associated with this channel
-				 */
-				dev_dbg(sdev->slave.dev, "pchan %u: free\n",
-					pchan->idx);
-
-				/* Mark this channel free */
-				vchan->phy = NULL;
-				pchan->vchan = NULL;
-			}
-		}
-		spin_unlock_irq(&vchan->vc.lock);
-	}
-
+	/*
+	 * Busy pchans are restarted from the irq, only hand the idle ones to
+	 * the pending vchans here.
+	 */
 	spin_lock_irq(&sdev->lock);
 	for (pchan_idx = 0; pchan_idx < sdev->num_pchans; pchan_idx++) {
 		pchan = &sdev->pchans[pchan_idx];
@@ -659,20 +812,124 @@ static void sun6i_dma_tasklet(unsigned long data)
 		vchan = pchan->vchan;
 		if (vchan) {
 			spin_lock_irq(&vchan->vc.lock);
-			sun6i_dma_start_desc(vchan);
+			if (sun6i_dma_start_desc(vchan)) {
+				/* terminated meanwhile, give the pchan back */
+				spin_lock(&sdev->lock);
+				vchan->phy = NULL;
+				pchan->vchan = NULL;
+				spin_unlock(&sdev->lock);
+			}
 			spin_unlock_irq(&vchan->vc.lock);
 		}
 	}
 }
 
+/*
+ * Complete the running desc and start the next issued one of the vchan
+ * on the same pchan right away. Returns true if the pchan went idle while
+ * other vchans are waiting for one.
+ */
+static bool sun6i_dma_chan_done(struct sun6i_dma_dev *sdev,
+				struct sun6i_vchan *vchan,
+				struct sun6i_pchan *pchan)
+{
+	bool wake = false;
+
+	spin_lock(&vchan->vc.lock);
+	if (pchan->desc && pchan->vchan == vchan) {
+		pchan->desc->irq_ns = ktime_get_ns();
+		vchan_cookie_complete(&pchan->desc->vd);
+
+		if (sun6i_dma_start_desc(vchan)) {
+			dev_dbg(sdev->slave.dev, "pchan %u: free\n", pchan->idx);
+
+			spin_lock(&sdev->lock);
+			vchan->phy = NULL;
+			pchan->vchan = NULL;
+			wake = !list_empty(&sdev->pending);
+			spin_unlock(&sdev->lock);
+		} else {
+			atomic_long_inc(&pchan->lat.restart);
+		}
+	}
+	spin_unlock(&vchan->vc.lock);
+
+	return wake;
+}
+
+static void sun6i_dma_lat_account(struct sun6i_pchan *pchan, u64 irq_ns)
+{
+	struct sun6i_dma_lat *lat = &pchan->lat;
+	u64 delta = ktime_get_ns() - irq_ns;
+	unsigned int bucket;
+
+	bucket = min_t(unsigned int, fls64(div_u64(delta, NSEC_PER_USEC)),
+		       SUNXI_DMA_LAT_BUCKETS - 1);
+	atomic_long_inc(&lat->hist[bucket]);
+	if (delta > READ_ONCE(lat->max_ns))
+		WRITE_ONCE(lat->max_ns, delta);
+}
+
+/*
+ * The callbacks of finished descs run in the vchan tasklet of virt-dma,
+ * which drains all the descs completed since its last run in one go.
+ * sun6i_dma_tx_submit() routes them through here to account the delay.
+ */
+static void sun6i_dma_callback(void *param, const struct dmaengine_result *result)
+{
+	struct sun6i_desc *txd = param;
+	struct sun6i_dma_dev *sdev = to_sun6i_dma_dev(txd->vd.tx.chan->device);
+
+	if (txd->irq_ns && txd->pchan_idx < sdev->num_pchans)
+		sun6i_dma_lat_account(&sdev->pchans[txd->pchan_idx], txd->irq_ns);
+	txd->irq_ns = 0;
+
+	dmaengine_desc_callback_invoke(&txd->cb, result);
+}
+
+static dma_cookie_t sun6i_dma_tx_submit(struct dma_async_tx_descriptor *tx)
+{
+	struct sun6i_desc *txd = to_sun6i_desc(tx);
+
+	/* cyclic callbacks are called from the irq directly */
+	if (!txd->cyclic) {
+		if (tx->callback_result != sun6i_dma_callback) {
+			dmaengine_desc_get_callback(tx, &txd->cb);
+		} else if (tx->callback) {
+			/* a reused desc got a new callback */
+			txd->cb.callback = tx->callback;
+			txd->cb.callback_result = NULL;
+			txd->cb.callback_param = tx->callback_param;
+		}
+		tx->callback = NULL;
+		tx->callback_result = sun6i_dma_callback;
+		tx->callback_param = txd;
+	}
+
+	return vchan_tx_submit(tx);
+}
+
+static struct dma_async_tx_descriptor *sun6i_dma_tx_prep(struct sun6i_vchan *vchan,
+							 struct sun6i_desc *txd,
+							 unsigned long flags)
+{
+	struct dma_async_tx_descriptor *tx;
+
+	tx = vchan_tx_prep(&vchan->vc, &txd->vd, flags);
+	tx->tx_submit = sun6i_dma_tx_submit;
+
+	return tx;
+}
+
 static irqreturn_t sun6i_dma_interrupt(int irq, void *dev_id)
 {
 	struct sun6i_dma_dev *sdev = dev_id;
 	struct sun6i_vchan *vchan;
 	struct sun6i_pchan *pchan;
 	int j, ret = IRQ_NONE;
-	u32 status;
+	u32 status, idx;
 	u32 i, count;
+	bool wake = false;
 
 	/* The actual @num_pchans may be less than 8, so need to
 	* ensure that the for loop logic is correct.
@@ -691,7 +948,10 @@ static irqreturn_t sun6i_dma_interrupt(int irq, void *dev_id)
 		sdev->cfg->clear_irq_status(sdev, i, status);
 
 		for (j = 0; (j < sdev->cfg->channum_per_reg) && status; j++) {
-			pchan = sdev->pchans + j;
+			idx = i * sdev->cfg->channum_per_reg + j;
+			if (idx >= sdev->num_pchans)
+				break;
+			pchan = sdev->pchans + idx;
 			vchan = pchan->vchan;
 			if (!pchan->desc)
 				goto next;
@@ -710,12 +970,7 @@ static irqreturn_t sun6i_dma_interrupt(int irq, void *dev_id)
 					if (cb)
 						cb(cb_data);
 				} else {
-					spin_lock(&vchan->vc.lock);
-					if (pchan->desc) {
-						vchan_cookie_complete(&pchan->desc->vd);
-						pchan->done = pchan->desc;
-					}
-					spin_unlock(&vchan->vc.lock);
+					wake |= sun6i_dma_chan_done(sdev, vchan, pchan);
 				}
 			} else if (vchan && (status & DMA_IRQ_TIMEOUT) && (vchan->cyclic)) {
 					sunxi_dma_timeout_callback cb = NULL;
@@ -731,14 +986,40 @@ next:
 			status = status >> DMA_IRQ_CHAN_WIDTH;
 		}
 
-		if (!atomic_read(&sdev->tasklet_shutdown))
-			tasklet_schedule(&sdev->task);
 		ret = IRQ_HANDLED;
 	}
 
+	if (wake && !atomic_read(&sdev->tasklet_shutdown))
+		tasklet_schedule(&sdev->task);
+
 	return ret;
 }
 
+static int sun6i_dma_latency_show(struct seq_file *s, void *unused)
+{
+	struct sun6i_dma_dev *sdev = s->private;
+	struct sun6i_dma_lat *lat;
+	unsigned int i, b;
+
+	seq_puts(s, "irq to callback latency, column n counts < 2^n us\n");
+	seq_puts(s, "pchan restart");
+	for (b = 0; b < SUNXI_DMA_LAT_BUCKETS - 1; b++)
+		seq_printf(s, " %6lu", BIT(b));
+	seq_printf(s, " %6s %8s\n", "more", "max_us");
+
+	for (i = 0; i < sdev->num_pchans; i++) {
+		lat = &sdev->pchans[i].lat;
+		seq_printf(s, "%5u %7lu", i, atomic_long_read(&lat->restart));
+		for (b = 0; b < SUNXI_DMA_LAT_BUCKETS; b++)
+			seq_printf(s, " %6lu", atomic_long_read(&lat->hist[b]));
+		seq_printf(s, " %8llu\n",
+			   div_u64(READ_ONCE(lat->max_ns), NSEC_PER_USEC));
+	}
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(sun6i_dma_latency);
+
 static int set_config(struct sun6i_dma_dev *sdev,
 			struct dma_slave_config *sconfig,
 			enum dma_transfer_direction direction,
@@ -795,36 +1076,13 @@ static int set_config(struct sun6i_dma_dev *sdev,
 	return 0;
 }
 
-static struct dma_async_tx_descriptor *sun6i_dma_prep_dma_memcpy(
-		struct dma_chan *chan, dma_addr_t dest, dma_addr_t src,
-		size_t len, unsigned long flags)
+/* fill a memory to memory LLI, the bus width follows the alignment */
+static void sun6i_dma_lli_memcpy(struct sun6i_dma_dev *sdev,
+				 struct sun6i_dma_lli *v_lli,
+				 dma_addr_t dest, dma_addr_t src, size_t len)
 {
-	struct sun6i_dma_dev *sdev = to_sun6i_dma_dev(chan->device);
-	struct sun6i_vchan *vchan = to_sun6i_vchan(chan);
-	struct sun6i_dma_lli *v_lli;
-	struct sun6i_desc *txd;
-	dma_addr_t p_lli;
 	s8 burst, width;
 
-	dev_dbg(chan2dev(chan),
-		"%s; chan: %d, dest: %pad, src: %pad, len: %zu. flags: 0x%08lx\n",
-		__func__, vchan->vc.chan.chan_id, &dest, &src, len, flags);
-
-	if (!len)
-		return NULL;
-
-	txd = kzalloc(sizeof(*txd), GFP_NOWAIT);
-	if (!txd)
-		return NULL;
-
-
-	v_lli = dma_pool_alloc(sdev->pool, GFP_NOWAIT, &p_lli);
-	if (!v_lli) {
-		dev_err(sdev->slave.dev, "Failed to alloc lli memory\n");
-		goto err_txd_free;
-	}
-	v_lli->this_phy = p_lli;
-
 	v_lli->src = src;
 	v_lli->dst = dest;
 	v_lli->len = len;
@@ -840,24 +1098,196 @@ static struct dma_async_tx_descriptor *sun6i_dma_prep_dma_memcpy(
 	}
 
 	burst = convert_burst(8);
-	width = convert_buswidth(DMA_SLAVE_BUSWIDTH_4_BYTES);
+	if (IS_ALIGNED(dest | src | len, 4))
+		width = convert_buswidth(DMA_SLAVE_BUSWIDTH_4_BYTES);
+	else
+		width = convert_buswidth(DMA_SLAVE_BUSWIDTH_1_BYTE);
 	v_lli->cfg = DMA_CHAN_CFG_SRC_WIDTH(width) |
 		DMA_CHAN_CFG_DST_WIDTH(width);
 
 	sdev->cfg->set_burst_length(&v_lli->cfg, burst, burst);
 	sdev->cfg->set_drq(&v_lli->cfg, DRQ_SDRAM, DRQ_SDRAM);
 	sdev->cfg->set_mode(&v_lli->cfg, LINEAR_MODE, LINEAR_MODE);
+}
+
+/* append a memory to memory LLI to the chain of @txd */
+static int sun6i_dma_lli_chain(struct sun6i_dma_dev *sdev,
+			       struct sun6i_vchan *vchan,
+			       struct sun6i_desc *txd,
+			       struct sun6i_dma_lli **prev,
+			       dma_addr_t dest, dma_addr_t src, size_t len)
+{
+	struct sun6i_dma_lli *v_lli;
+	dma_addr_t p_lli;
 
-	sun6i_dma_lli_add(NULL, v_lli, p_lli, txd);
+	v_lli = sun6i_dma_lli_get(sdev, vchan, &p_lli);
+	if (!v_lli) {
+		dev_err(sdev->slave.dev, "Failed to alloc lli memory\n");
+		return -ENOMEM;
+	}
+	p_lli = (u32)SET_DESC_HIGH_ADDR(p_lli);
 
+	sun6i_dma_lli_memcpy(sdev, v_lli, dest, src, len);
+	*prev = sun6i_dma_lli_add(*prev, v_lli, p_lli, txd);
 	sun6i_dma_dump_lli(vchan, v_lli);
 
-	return vchan_tx_prep(&vchan->vc, &txd->vd, flags);
+	return 0;
+}
 
-err_txd_free:
-	kfree(txd);
+static struct dma_async_tx_descriptor *sun6i_dma_prep_dma_memcpy(
+		struct dma_chan *chan, dma_addr_t dest, dma_addr_t src,
+		size_t len, unsigned long flags)
+{
+	struct sun6i_dma_dev *sdev = to_sun6i_dma_dev(chan->device);
+	struct sun6i_vchan *vchan = to_sun6i_vchan(chan);
+	struct sun6i_dma_lli *prev = NULL;
+	struct sun6i_desc *txd;
+
+	dev_dbg(chan2dev(chan),
+		"%s; chan: %d, dest: %pad, src: %pad, len: %zu. flags: 0x%08lx\n",
+		__func__, vchan->vc.chan.chan_id, &dest, &src, len, flags);
+
+	if (!len)
+		return NULL;
+
+	txd = sun6i_dma_desc_get(vchan);
+	if (!txd)
+		return NULL;
+
+	if (sun6i_dma_lli_chain(sdev, vchan, txd, &prev, dest, src, len)) {
+		sun6i_dma_desc_put(sdev, vchan, txd);
+		return NULL;
+	}
+
+	return sun6i_dma_tx_prep(vchan, txd, flags);
+}
+
+/*
+ * 2D copy, one LLI per chunk of every frame. Chunks that continue the
+ * previous one on both sides, like the lines of a frame without a gap,
+ * are merged into one LLI.
+ */
+static struct dma_async_tx_descriptor *sun6i_dma_prep_interleaved(
+		struct dma_chan *chan, struct dma_interleaved_template *xt,
+		unsigned long flags)
+{
+	struct sun6i_dma_dev *sdev = to_sun6i_dma_dev(chan->device);
+	struct sun6i_vchan *vchan = to_sun6i_vchan(chan);
+	struct sun6i_dma_lli *prev = NULL;
+	struct sun6i_desc *txd;
+	dma_addr_t src, dst, run_src = 0, run_dst = 0;
+	size_t run_len = 0, size, f, c;
+
+	if (!xt->numf || !xt->frame_size || xt->dir != DMA_MEM_TO_MEM ||
+	    !xt->src_inc || !xt->dst_inc)
+		return NULL;
+
+	dev_dbg(chan2dev(chan),
+		"%s; chan: %d, dest: %pad, src: %pad, frames: %zu x %zu. flags: 0x%08lx\n",
+		__func__, vchan->vc.chan.chan_id, &xt->dst_start, &xt->src_start,
+		xt->numf, xt->frame_size, flags);
+
+	txd = sun6i_dma_desc_get(vchan);
+	if (!txd)
+		return NULL;
+
+	src = xt->src_start;
+	dst = xt->dst_start;
+	for (f = 0; f < xt->numf; f++) {
+		for (c = 0; c < xt->frame_size; c++) {
+			size = xt->sgl[c].size;
+			if (run_len && src == run_src + run_len &&
+			    dst == run_dst + run_len) {
+				run_len += size;
+			} else if (size) {
+				if (run_len && sun6i_dma_lli_chain(sdev, vchan, txd, &prev,
+								   run_dst, run_src, run_len))
+					goto err_lli_free;
+				run_src = src;
+				run_dst = dst;
+				run_len = size;
+			}
+			src += size + dmaengine_get_src_icg(xt, &xt->sgl[c]);
+			dst += size + dmaengine_get_dst_icg(xt, &xt->sgl[c]);
+		}
+	}
+
+	if (!run_len ||
+	    sun6i_dma_lli_chain(sdev, vchan, txd, &prev, run_dst, run_src, run_len))
+		goto err_lli_free;
+
+	return sun6i_dma_tx_prep(vchan, txd, flags);
+
+err_lli_free:
+	sun6i_dma_desc_put(sdev, vchan, txd);
+	return NULL;
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 18, 0) && \
+	LINUX_VERSION_CODE < KERNEL_VERSION(6, 3, 0)
+static struct dma_async_tx_descriptor *sun6i_dma_prep_dma_memcpy_sg(
+		struct dma_chan *chan,
+		struct scatterlist *dst_sg, unsigned int dst_nents,
+		struct scatterlist *src_sg, unsigned int src_nents,
+		unsigned long flags)
+{
+	struct sun6i_dma_dev *sdev = to_sun6i_dma_dev(chan->device);
+	struct sun6i_vchan *vchan = to_sun6i_vchan(chan);
+	struct sun6i_dma_lli *prev = NULL;
+	struct sun6i_desc *txd;
+	dma_addr_t src, dst;
+	size_t src_avail, dst_avail, len;
+
+	if (!dst_sg || !src_sg || !dst_nents || !src_nents)
+		return NULL;
+
+	txd = sun6i_dma_desc_get(vchan);
+	if (!txd)
+		return NULL;
+
+	dst = sg_dma_address(dst_sg);
+	dst_avail = sg_dma_len(dst_sg);
+	src = sg_dma_address(src_sg);
+	src_avail = sg_dma_len(src_sg);
+
+	for (;;) {
+		len = min(dst_avail, src_avail);
+		if (len) {
+			if (sun6i_dma_lli_chain(sdev, vchan, txd, &prev, dst, src, len))
+				goto err_lli_free;
+			dst += len;
+			src += len;
+			dst_avail -= len;
+			src_avail -= len;
+		}
+
+		if (!dst_avail) {
+			if (!--dst_nents)
+				break;
+			dst_sg = sg_next(dst_sg);
+			dst = sg_dma_address(dst_sg);
+			dst_avail = sg_dma_len(dst_sg);
+		}
+
+		if (!src_avail) {
+			if (!--src_nents)
+				break;
+			src_sg = sg_next(src_sg);
+			src = sg_dma_address(src_sg);
+			src_avail = sg_dma_len(src_sg);
+		}
+	}
+
+	if (!txd->v_lli)
+		goto err_lli_free;
+
+	return sun6i_dma_tx_prep(vchan, txd, flags);
+
+err_lli_free:
+	sun6i_dma_desc_put(sdev, vchan, txd);
 	return NULL;
 }
+#endif
 
 static inline struct sun6i_vchan *to_sun6i_dma_chan(struct dma_chan *c)
 {
@@ -895,16 +1325,15 @@ static struct dma_async_tx_descriptor *sun6i_dma_prep_slave_sg(
 		return NULL;
 	}
 
-	txd = kzalloc(sizeof(*txd), GFP_NOWAIT);
+	txd = sun6i_dma_desc_get(vchan);
 	if (!txd)
 		return NULL;
 
 	for_each_sg(sgl, sg, sg_len, i) {
-		v_lli = dma_pool_alloc(sdev->pool, GFP_NOWAIT, &p_lli);
+		v_lli = sun6i_dma_lli_get(sdev, vchan, &p_lli);
 		if (!v_lli)
 			goto err_lli_free;
 
-		v_lli->this_phy = p_lli;
 		p_lli = (u32)SET_DESC_HIGH_ADDR(p_lli);
 		v_lli->len = sg_dma_len(sg);
 
@@ -977,12 +1406,10 @@ static struct dma_async_tx_descriptor *sun6i_dma_prep_slave_sg(
 	for (prev = txd->v_lli; prev; prev = prev->v_lli_next)
 		sun6i_dma_dump_lli(vchan, prev);
 
-	return vchan_tx_prep(&vchan->vc, &txd->vd, flags);
+	return sun6i_dma_tx_prep(vchan, txd, flags);
 
 err_lli_free:
-	for (prev = txd->v_lli; prev; prev = prev->v_lli_next)
-		dma_pool_free(sdev->pool, prev, prev->this_phy);
-	kfree(txd);
+	sun6i_dma_desc_put(sdev, vchan, txd);
 	return NULL;
 }
 
@@ -1023,17 +1450,16 @@ static struct dma_async_tx_descriptor *sun6i_dma_prep_dma_cyclic(
 	if (is_bmode && (vchan->extend_desc))
 		lli_cfg |= BMODE;
 
-	txd = kzalloc(sizeof(*txd), GFP_NOWAIT);
+	txd = sun6i_dma_desc_get(vchan);
 	if (!txd)
 		return NULL;
 
 	for (i = 0; i < periods; i++) {
-		v_lli = dma_pool_alloc(sdev->pool, GFP_NOWAIT, &p_lli);
+		v_lli = sun6i_dma_lli_get(sdev, vchan, &p_lli);
 		if (!v_lli) {
 			dev_err(sdev->slave.dev, "Failed to alloc lli memory\n");
 			goto err_lli_free;
 		}
-		v_lli->this_phy = p_lli;
 		v_lli->len = period_len;
 
 		if (dir == DMA_MEM_TO_DEV) {
@@ -1092,14 +1518,13 @@ static struct dma_async_tx_descriptor *sun6i_dma_prep_dma_cyclic(
 
 	prev->p_lli_next = txd->p_lli;		/* cyclic list */
 
+	txd->cyclic = true;
 	vchan->cyclic = true;
 
-	return vchan_tx_prep(&vchan->vc, &txd->vd, flags);
+	return sun6i_dma_tx_prep(vchan, txd, flags);
 
 err_lli_free:
-	for (prev = txd->v_lli; prev; prev = prev->v_lli_next)
-		dma_pool_free(sdev->pool, prev, prev->this_phy);
-	kfree(txd);
+	sun6i_dma_desc_put(sdev, vchan, txd);
 	return NULL;
 }
 
@@ -1118,6 +1543,7 @@ static int sun6i_dma_pause(struct dma_chan *chan)
 	struct sun6i_dma_dev *sdev = to_sun6i_dma_dev(chan->device);
 	struct sun6i_vchan *vchan = to_sun6i_vchan(chan);
 	struct sun6i_pchan *pchan = vchan->phy;
+	unsigned long flags;
 
 	dev_dbg(chan2dev(chan), "vchan %p: pause\n", &vchan->vc);
 
@@ -1125,9 +1551,10 @@ static int sun6i_dma_pause(struct dma_chan *chan)
 		writel(DMA_CHAN_PAUSE_PAUSE,
 		       pchan->base + DMA_CHAN_PAUSE);
 	} else {
-		spin_lock(&sdev->lock);
+		/* also taken from the irq, which restarts pchans */
+		spin_lock_irqsave(&sdev->lock, flags);
 		list_del_init(&vchan->node);
-		spin_unlock(&sdev->lock);
+		spin_unlock_irqrestore(&sdev->lock, flags);
 	}
 
 	return 0;
@@ -1166,9 +1593,9 @@ static int sun6i_dma_terminate_all(struct dma_chan *chan)
 	unsigned long flags;
 	LIST_HEAD(head);
 
-	spin_lock(&sdev->lock);
+	spin_lock_irqsave(&sdev->lock, flags);
 	list_del_init(&vchan->node);
-	spin_unlock(&sdev->lock);
+	spin_unlock_irqrestore(&sdev->lock, flags);
 
 	spin_lock_irqsave(&vchan->vc.lock, flags);
 
@@ -1192,7 +1619,6 @@ static int sun6i_dma_terminate_all(struct dma_chan *chan)
 		vchan->phy = NULL;
 		pchan->vchan = NULL;
 		pchan->desc = NULL;
-		pchan->done = NULL;
 	}
 
 	spin_unlock_irqrestore(&vchan->vc.lock, flags);
@@ -1267,6 +1693,17 @@ static void sun6i_dma_issue_pending(struct dma_chan *chan)
 	spin_unlock_irqrestore(&vchan->vc.lock, flags);
 }
 
+static int sun6i_dma_alloc_chan_resources(struct dma_chan *chan)
+{
+	struct sun6i_dma_dev *sdev = to_sun6i_dma_dev(chan->device);
+	struct sun6i_vchan *vchan = to_sun6i_vchan(chan);
+
+	/* best effort, prep falls back to the allocator when it runs dry */
+	sun6i_dma_cache_fill(sdev, vchan);
+
+	return 0;
+}
+
 static void sun6i_dma_free_chan_resources(struct dma_chan *chan)
 {
 	struct sun6i_dma_dev *sdev = to_sun6i_dma_dev(chan->device);
@@ -1278,6 +1715,7 @@ static void sun6i_dma_free_chan_resources(struct dma_chan *chan)
 	spin_unlock_irqrestore(&sdev->lock, flags);
 
 	vchan_free_chan_resources(&vchan->vc);
+	sun6i_dma_cache_drain(sdev, vchan);
 }
 
 static struct dma_chan *sun6i_dma_of_xlate(struct of_phandle_args *dma_spec,
@@ -1794,17 +2232,30 @@ static int sun6i_dma_probe(struct platform_device *pdev)
 	INIT_LIST_HEAD(&sdc->pending);
 	spin_lock_init(&sdc->lock);
 
+#if !IS_ENABLED(CONFIG_AW_DMA_PUBLIC_MEMCPY)
 	dma_cap_set(DMA_PRIVATE, sdc->slave.cap_mask);
+#endif
 	dma_cap_set(DMA_MEMCPY, sdc->slave.cap_mask);
+	dma_cap_set(DMA_INTERLEAVE, sdc->slave.cap_mask);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 18, 0) && \
+	LINUX_VERSION_CODE < KERNEL_VERSION(6, 3, 0)
+	dma_cap_set(DMA_MEMCPY_SG, sdc->slave.cap_mask);
+#endif
 	dma_cap_set(DMA_SLAVE, sdc->slave.cap_mask);
 	dma_cap_set(DMA_CYCLIC, sdc->slave.cap_mask);
 
 	INIT_LIST_HEAD(&sdc->slave.channels);
+	sdc->slave.device_alloc_chan_resources	= sun6i_dma_alloc_chan_resources;
 	sdc->slave.device_free_chan_resources	= sun6i_dma_free_chan_resources;
 	sdc->slave.device_tx_status		= sun6i_dma_tx_status;
 	sdc->slave.device_issue_pending		= sun6i_dma_issue_pending;
 	sdc->slave.device_prep_slave_sg		= sun6i_dma_prep_slave_sg;
 	sdc->slave.device_prep_dma_memcpy	= sun6i_dma_prep_dma_memcpy;
+	sdc->slave.device_prep_interleaved_dma	= sun6i_dma_prep_interleaved;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 18, 0) && \
+	LINUX_VERSION_CODE < KERNEL_VERSION(6, 3, 0)
+	sdc->slave.device_prep_dma_memcpy_sg	= sun6i_dma_prep_dma_memcpy_sg;
+#endif
 	sdc->slave.device_prep_dma_cyclic	= sun6i_dma_prep_dma_cyclic;
 	sdc->slave.copy_align			= DMAENGINE_ALIGN_4_BYTES;
 	sdc->slave.device_config		= sun6i_dma_config;
@@ -1817,6 +2268,7 @@ static int sun6i_dma_probe(struct platform_device *pdev)
 	sdc->slave.directions			= BIT(DMA_DEV_TO_MEM) |
 						  BIT(DMA_MEM_TO_DEV);
 	sdc->slave.residue_granularity		= DMA_RESIDUE_GRANULARITY_BURST;
+	sdc->slave.descriptor_reuse		= true;
 	sdc->slave.dev = &pdev->dev;
 
 	sdc->num_pchans = sdc->cfg->nr_max_channels;
@@ -1866,6 +2318,8 @@ static int sun6i_dma_probe(struct platform_device *pdev)
 		struct sun6i_vchan *vchan = &sdc->vchans[i];
 
 		INIT_LIST_HEAD(&vchan->node);
+		spin_lock_init(&vchan->cache_lock);
+		INIT_LIST_HEAD(&vchan->free_descs);
 		vchan->vc.desc_free = sun6i_dma_free_desc;
 		vchan_init(&vchan->vc, &sdc->slave);
 	}
@@ -1930,6 +2384,10 @@ static int sun6i_dma_probe(struct platform_device *pdev)
 	if (sdc->cfg->clock_autogate_enable)
 		sdc->cfg->clock_autogate_enable(sdc);
 
+	sdc->debugfs = debugfs_create_dir(dev_name(&pdev->dev), NULL);
+	debugfs_create_file("latency", 0444, sdc->debugfs, sdc,
+			    &sun6i_dma_latency_fops);
+
 	/*
 	 * when multi core,like ARM64 and RISCV,share a single controller.
 	 * the irq should be limited reported to only one core.
@@ -1967,6 +2425,7 @@ static int sun6i_dma_remove(struct platform_device *pdev)
 {
 	struct sun6i_dma_dev *sdc = platform_get_drvdata(pdev);
 
+	debugfs_remove_recursive(sdc->debugfs);
 	of_dma_controller_free(pdev->dev.of_node);
 	dma_async_device_unregister(&sdc->slave);
 
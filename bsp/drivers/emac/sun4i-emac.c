@@ -16,6 +16,8 @@
 
 /* #define DEBUG */
 #include <linux/clk.h>
+#include <linux/dma-mapping.h>
+#include <linux/dmaengine.h>
 #include <linux/etherdevice.h>
 #include <linux/ethtool.h>
 #include <linux/gpio.h>
@@ -38,7 +40,7 @@
 #include <linux/reset.h>
 
 #define DRV_NAME		"sun4i-emac"
-#define DRV_VERSION		"1.0.3"
+#define DRV_VERSION		"1.0.4"
 
 #define EMAC_MAX_FRAME_LEN	0x0600
 
@@ -149,6 +151,11 @@ static int watchdog = 5000;
 module_param(watchdog, int, 0400);
 MODULE_PARM_DESC(watchdog, "transmit timeout in milliseconds");
 
+/* Frames of at least this size go through the dma, if the DT provides one */
+static int dma_thresh = 256;
+module_param(dma_thresh, int, 0644);
+MODULE_PARM_DESC(dma_thresh, "frames of at least this many bytes use dma, 0 for pio only");
+
 /* EMAC register address locking.
  *
  * The EMAC uses an address register to control where data written
@@ -171,6 +178,14 @@ MODULE_PARM_DESC(watchdog, "transmit timeout in milliseconds");
  * devices, EMACA and EMACB.
  */
 
+struct emac_xstats {
+	u64 rx_dma_frames;
+	u64 rx_pio_frames;
+	u64 tx_dma_frames;
+	u64 tx_pio_frames;
+	u64 dma_fallbacks;
+};
+
 struct emac_board_info {
 	struct clk		*clk;
 	struct device		*dev;
@@ -181,8 +196,25 @@ struct emac_board_info {
 	u32			msg_enable;
 	struct net_device	*ndev;
 	struct sk_buff		*skb_last;
+	int			rxlen_last;
 	u16			tx_fifo_stat;
 
+	/*
+	 * Optional dma for the fifos. One transfer at a time per direction,
+	 * the fifo is owned by the dma until its callback ran.
+	 */
+	struct dma_chan		*rx_chan;
+	struct dma_chan		*tx_chan;
+	dma_addr_t		rx_dma_addr;
+	u32			rx_dma_len;
+	bool			rx_dma_done;
+	struct sk_buff		*tx_dma_skb;
+	dma_addr_t		tx_dma_addr;
+	u32			tx_dma_len;
+	unsigned long		tx_dma_channel;
+	struct emac_xstats	xstats;
+	struct work_struct	tx_timeout_work;
+
 	int			emacrx_completed_flag;
 
 	struct napi_struct	napi;
@@ -358,6 +390,250 @@ static void emac_inblk_32bit(void __iomem *reg, void *data, int count)
 	readsl(reg, data, round_up(count, 4) / 4);
 }
 
+static bool emac_use_dma(struct dma_chan *chan, unsigned int len)
+{
+	int thresh = READ_ONCE(dma_thresh);
+
+	return chan && thresh > 0 && len >= thresh;
+}
+
+static void emac_rx_dma_done(void *arg)
+{
+	struct emac_board_info *db = arg;
+
+	dma_unmap_single(db->dev, db->rx_dma_addr, db->rx_dma_len,
+			 DMA_FROM_DEVICE);
+	smp_store_release(&db->rx_dma_done, true);
+
+	/* the frame is handed up from napi */
+	napi_schedule(&db->napi);
+}
+
+/* Start moving one received frame to the skb, the rx fifo is in dma mode */
+static int emac_dma_inblk_32bit(struct emac_board_info *db,
+				struct sk_buff *skb, void *rdptr, u32 rxlen)
+{
+	struct dma_async_tx_descriptor *desc;
+	u32 len = round_up(rxlen, 4);
+	dma_addr_t addr;
+
+	addr = dma_map_single(db->dev, rdptr, len, DMA_FROM_DEVICE);
+	if (dma_mapping_error(db->dev, addr))
+		goto err;
+
+	desc = dmaengine_prep_slave_single(db->rx_chan, addr, len,
+					   DMA_DEV_TO_MEM,
+					   DMA_PREP_INTERRUPT | DMA_CTRL_ACK);
+	if (!desc)
+		goto unmap;
+
+	desc->callback = emac_rx_dma_done;
+	desc->callback_param = db;
+
+	db->skb_last = skb;
+	db->rxlen_last = rxlen;
+	db->rx_dma_addr = addr;
+	db->rx_dma_len = len;
+	db->rx_dma_done = false;
+
+	dmaengine_submit(desc);
+	dma_async_issue_pending(db->rx_chan);
+	db->xstats.rx_dma_frames++;
+
+	return 0;
+
+unmap:
+	dma_unmap_single(db->dev, addr, len, DMA_FROM_DEVICE);
+err:
+	db->xstats.dma_fallbacks++;
+	return -EIO;
+}
+
+static void emac_tx_start(struct emac_board_info *db, unsigned long channel,
+			  unsigned int len)
+{
+	/* TX control: First packet immediately send, second packet queue */
+	if (channel == 0) {
+		/* set TX len */
+		writel(len, db->membase + EMAC_TX_PL0_REG);
+		/* start translate from fifo to phy */
+		writel(readl(db->membase + EMAC_TX_CTL0_REG) | 1,
+		       db->membase + EMAC_TX_CTL0_REG);
+	} else {
+		/* set TX len */
+		writel(len, db->membase + EMAC_TX_PL1_REG);
+		/* start translate from fifo to phy */
+		writel(readl(db->membase + EMAC_TX_CTL1_REG) | 1,
+		       db->membase + EMAC_TX_CTL1_REG);
+	}
+}
+
+static void emac_tx_dma_done(void *arg)
+{
+	struct emac_board_info *db = arg;
+	struct net_device *dev = db->ndev;
+	struct sk_buff *skb;
+	unsigned long flags;
+
+	raw_spin_lock_irqsave(&db->lock, flags);
+	skb = db->tx_dma_skb;
+	if (!skb) {
+		raw_spin_unlock_irqrestore(&db->lock, flags);
+		return;
+	}
+
+	writel(readl(db->membase + EMAC_TX_MODE_REG) & ~EMAC_TX_MODE_DMA_EN,
+	       db->membase + EMAC_TX_MODE_REG);
+	emac_tx_start(db, db->tx_dma_channel, skb->len);
+	db->tx_dma_skb = NULL;
+	if ((db->tx_fifo_stat & 3) != 3)
+		netif_wake_queue(dev);
+	raw_spin_unlock_irqrestore(&db->lock, flags);
+
+	dma_unmap_single(db->dev, db->tx_dma_addr, db->tx_dma_len,
+			 DMA_TO_DEVICE);
+	dev->stats.tx_bytes += skb->len;
+	dev_consume_skb_any(skb);
+}
+
+/* Start filling a tx channel from the skb, called with db->lock held */
+static int emac_dma_outblk_32bit(struct emac_board_info *db,
+				 struct sk_buff *skb, unsigned long channel)
+{
+	struct dma_async_tx_descriptor *desc;
+	u32 len = round_up(skb->len, 4);
+	dma_addr_t addr;
+
+	addr = dma_map_single(db->dev, skb->data, len, DMA_TO_DEVICE);
+	if (dma_mapping_error(db->dev, addr))
+		goto err;
+
+	desc = dmaengine_prep_slave_single(db->tx_chan, addr, len,
+					   DMA_MEM_TO_DEV,
+					   DMA_PREP_INTERRUPT | DMA_CTRL_ACK);
+	if (!desc)
+		goto unmap;
+
+	desc->callback = emac_tx_dma_done;
+	desc->callback_param = db;
+
+	db->tx_dma_skb = skb;
+	db->tx_dma_addr = addr;
+	db->tx_dma_len = len;
+	db->tx_dma_channel = channel;
+
+	writel(readl(db->membase + EMAC_TX_MODE_REG) | EMAC_TX_MODE_DMA_EN,
+	       db->membase + EMAC_TX_MODE_REG);
+	dmaengine_submit(desc);
+	dma_async_issue_pending(db->tx_chan);
+	db->xstats.tx_dma_frames++;
+
+	return 0;
+
+unmap:
+	dma_unmap_single(db->dev, addr, len, DMA_TO_DEVICE);
+err:
+	db->xstats.dma_fallbacks++;
+	return -EIO;
+}
+
+/* Drop the transfers still in flight, napi and the queue are stopped */
+static void emac_dma_stop(struct emac_board_info *db)
+{
+	if (db->rx_chan) {
+		dmaengine_terminate_sync(db->rx_chan);
+		if (db->skb_last) {
+			if (!db->rx_dma_done)
+				dma_unmap_single(db->dev, db->rx_dma_addr,
+						 db->rx_dma_len, DMA_FROM_DEVICE);
+			dev_kfree_skb(db->skb_last);
+			db->skb_last = NULL;
+		}
+	}
+
+	if (db->tx_chan) {
+		dmaengine_terminate_sync(db->tx_chan);
+		if (db->tx_dma_skb) {
+			dma_unmap_single(db->dev, db->tx_dma_addr,
+					 db->tx_dma_len, DMA_TO_DEVICE);
+			dev_kfree_skb(db->tx_dma_skb);
+			db->tx_dma_skb = NULL;
+		}
+	}
+}
+
+static struct dma_chan *emac_request_dma(struct emac_board_info *db,
+					 const char *name,
+					 struct dma_slave_config *conf)
+{
+	struct dma_chan *chan;
+
+	chan = dma_request_chan(db->dev, name);
+	if (IS_ERR(chan))
+		return chan;
+
+	if (dmaengine_slave_config(chan, conf)) {
+		dma_release_channel(chan);
+		return ERR_PTR(-EINVAL);
+	}
+
+	return chan;
+}
+
+/* The dma is optional, without "dmas" in the DT the fifos stay on pio */
+static int emac_configure_dma(struct emac_board_info *db)
+{
+	struct dma_slave_config conf = {};
+	struct resource *regs;
+	struct dma_chan *chan;
+
+	regs = platform_get_resource(db->pdev, IORESOURCE_MEM, 0);
+	if (!regs)
+		return 0;
+
+	conf.direction = DMA_DEV_TO_MEM;
+	conf.src_addr = regs->start + EMAC_RX_IO_DATA_REG;
+	conf.src_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
+	conf.dst_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
+	conf.src_maxburst = 1;
+	conf.dst_maxburst = 1;
+	chan = emac_request_dma(db, "rx", &conf);
+	if (PTR_ERR(chan) == -EPROBE_DEFER)
+		return -EPROBE_DEFER;
+	db->rx_chan = IS_ERR(chan) ? NULL : chan;
+
+	memset(&conf, 0, sizeof(conf));
+	conf.direction = DMA_MEM_TO_DEV;
+	conf.dst_addr = regs->start + EMAC_TX_IO_DATA_REG;
+	conf.src_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
+	conf.dst_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
+	conf.src_maxburst = 1;
+	conf.dst_maxburst = 1;
+	chan = emac_request_dma(db, "tx", &conf);
+	if (PTR_ERR(chan) == -EPROBE_DEFER) {
+		if (db->rx_chan)
+			dma_release_channel(db->rx_chan);
+		db->rx_chan = NULL;
+		return -EPROBE_DEFER;
+	}
+	db->tx_chan = IS_ERR(chan) ? NULL : chan;
+
+	dev_info(db->dev, "rx fifo on %s, tx fifo on %s\n",
+		 db->rx_chan ? "dma" : "pio", db->tx_chan ? "dma" : "pio");
+
+	return 0;
+}
+
+static void emac_release_dma(struct emac_board_info *db)
+{
+	if (db->rx_chan)
+		dma_release_channel(db->rx_chan);
+	if (db->tx_chan)
+		dma_release_channel(db->tx_chan);
+	db->rx_chan = NULL;
+	db->tx_chan = NULL;
+}
+
 /* ethtool ops */
 static void emac_get_drvinfo(struct net_device *dev,
 			      struct ethtool_drvinfo *info)
@@ -380,6 +656,52 @@ static void emac_set_msglevel(struct net_device *dev, u32 value)
 	db->msg_enable = value;
 }
 
+#define EMAC_STAT(m)	\
+	{ #m, offsetof(struct emac_board_info, xstats.m) }
+
+static const struct {
+	char name[ETH_GSTRING_LEN];
+	int offset;
+} emac_gstrings_stats[] = {
+	EMAC_STAT(rx_dma_frames),
+	EMAC_STAT(rx_pio_frames),
+	EMAC_STAT(tx_dma_frames),
+	EMAC_STAT(tx_pio_frames),
+	EMAC_STAT(dma_fallbacks),
+};
+
+static int emac_get_sset_count(struct net_device *dev, int sset)
+{
+	switch (sset) {
+	case ETH_SS_STATS:
+		return ARRAY_SIZE(emac_gstrings_stats);
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
+static void emac_get_strings(struct net_device *dev, u32 stringset, u8 *data)
+{
+	int i;
+
+	if (stringset != ETH_SS_STATS)
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(emac_gstrings_stats); i++)
+		memcpy(data + i * ETH_GSTRING_LEN, emac_gstrings_stats[i].name,
+		       ETH_GSTRING_LEN);
+}
+
+static void emac_get_ethtool_stats(struct net_device *dev,
+				   struct ethtool_stats *stats, u64 *data)
+{
+	struct emac_board_info *db = netdev_priv(dev);
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(emac_gstrings_stats); i++)
+		data[i] = *(u64 *)((u8 *)db + emac_gstrings_stats[i].offset);
+}
+
 static const struct ethtool_ops emac_ethtool_ops = {
 	.get_drvinfo	= emac_get_drvinfo,
 	.get_link	= ethtool_op_get_link,
@@ -387,6 +709,9 @@ static const struct ethtool_ops emac_ethtool_ops = {
 	.set_link_ksettings = phy_ethtool_set_link_ksettings,
 	.get_msglevel	= emac_get_msglevel,
 	.set_msglevel	= emac_set_msglevel,
+	.get_sset_count	= emac_get_sset_count,
+	.get_strings	= emac_get_strings,
+	.get_ethtool_stats = emac_get_ethtool_stats,
 };
 
 static unsigned int emac_setup(struct net_device *ndev)
@@ -543,27 +868,47 @@ static void emac_init_device(struct net_device *dev)
 	raw_spin_unlock_irqrestore(&db->lock, flags);
 }
 
-/* Our watchdog timed out. Called by the networking layer */
-static void emac_timeout(struct net_device *dev, unsigned int txqueue)
+/*
+ * Reset after a tx timeout. The dma may still own a fifo and terminating
+ * it sleeps, so this runs from a work rather than the watchdog. emac_stop
+ * waits for it, the device stays up meanwhile.
+ */
+static void emac_tx_timeout_work(struct work_struct *work)
 {
-	struct emac_board_info *db = netdev_priv(dev);
+	struct emac_board_info *db = container_of(work, struct emac_board_info,
+						  tx_timeout_work);
+	struct net_device *dev = db->ndev;
 	unsigned long flags;
 
-	if (netif_msg_timer(db))
-		dev_err(db->dev, "tx time out.\n");
+	if (!netif_running(dev))
+		return;
 
-	/* Save previous register address */
-	raw_spin_lock_irqsave(&db->lock, flags);
+	napi_disable(&db->napi);
+	/* drop the frames in flight, their fifo is reset below */
+	emac_dma_stop(db);
 
-	netif_stop_queue(dev);
+	raw_spin_lock_irqsave(&db->lock, flags);
 	emac_reset(db);
+	db->tx_fifo_stat = 0;
+	raw_spin_unlock_irqrestore(&db->lock, flags);
 	emac_init_device(dev);
+
+	napi_enable(&db->napi);
 	/* We can accept TX packets again */
 	netif_trans_update(dev);
 	netif_wake_queue(dev);
+}
 
-	/* Restore previous register address */
-	raw_spin_unlock_irqrestore(&db->lock, flags);
+/* Our watchdog timed out. Called by the networking layer */
+static void emac_timeout(struct net_device *dev, unsigned int txqueue)
+{
+	struct emac_board_info *db = netdev_priv(dev);
+
+	if (netif_msg_timer(db))
+		dev_err(db->dev, "tx time out.\n");
+
+	netif_stop_queue(dev);
+	schedule_work(&db->tx_timeout_work);
 }
 
 /* Hardware start transmission.
@@ -576,40 +921,35 @@ static netdev_tx_t emac_start_xmit(struct sk_buff *skb, struct net_device *dev)
 	unsigned long flags;
 
 	channel = db->tx_fifo_stat & 3;
-	if (channel == 3)
-		return 1;
+	if (channel == 3 || db->tx_dma_skb)
+		return NETDEV_TX_BUSY;
 
 	channel = (channel == 1 ? 1 : 0);
 
 	raw_spin_lock_irqsave(&db->lock, flags);
 
 	writel(channel, db->membase + EMAC_TX_INS_REG);
+	db->tx_fifo_stat |= 1 << channel;
+
+	/* the channel is started from the dma callback */
+	if (emac_use_dma(db->tx_chan, skb->len) &&
+	    IS_ALIGNED((unsigned long)skb->data, 4) &&
+	    !emac_dma_outblk_32bit(db, skb, channel)) {
+		/* TX_INS_REG has to stay put until the fifo is filled */
+		netif_stop_queue(dev);
+		netif_trans_update(dev);
+		raw_spin_unlock_irqrestore(&db->lock, flags);
+		return NETDEV_TX_OK;
+	}
 
 	emac_outblk_32bit(db->membase + EMAC_TX_IO_DATA_REG,
 			skb->data, skb->len);
 	dev->stats.tx_bytes += skb->len;
+	db->xstats.tx_pio_frames++;
 
-	db->tx_fifo_stat |= 1 << channel;
-	/* TX control: First packet immediately send, second packet queue */
-	if (channel == 0) {
-		/* set TX len */
-		writel(skb->len, db->membase + EMAC_TX_PL0_REG);
-		/* start translate from fifo to phy */
-		writel(readl(db->membase + EMAC_TX_CTL0_REG) | 1,
-		       db->membase + EMAC_TX_CTL0_REG);
-
-		/* save the time stamp */
-		netif_trans_update(dev);
-	} else if (channel == 1) {
-		/* set TX len */
-		writel(skb->len, db->membase + EMAC_TX_PL1_REG);
-		/* start translate from fifo to phy */
-		writel(readl(db->membase + EMAC_TX_CTL1_REG) | 1,
-		       db->membase + EMAC_TX_CTL1_REG);
-
-		/* save the time stamp */
-		netif_trans_update(dev);
-	}
+	emac_tx_start(db, channel, skb->len);
+	/* save the time stamp */
+	netif_trans_update(dev);
 
 	if ((db->tx_fifo_stat & 3) == 3) {
 		/* Second packet */
@@ -640,7 +980,8 @@ static void emac_tx_done(struct net_device *dev, struct emac_board_info *db,
 	if (netif_msg_tx_done(db))
 		dev_dbg(db->dev, "tx done, NSR %02x\n", tx_status);
 
-	netif_wake_queue(dev);
+	if (!db->tx_dma_skb)
+		netif_wake_queue(dev);
 }
 
 /* Received a packet and pass to upper layer
@@ -650,11 +991,30 @@ static int emac_rx(struct net_device *dev, int limit)
 	struct emac_board_info *db = netdev_priv(dev);
 	struct sk_buff *skb;
 	u8 *rdptr;
-	bool good_packet;
-	static int rxlen_last;
+	bool good_packet, use_dma;
 	unsigned int reg_val;
 	u32 rxhdr, rxstatus, rxcount, rxlen, work_done = 0;
 
+	if (db->skb_last) {
+		/* the rx fifo is owned by the dma until its callback */
+		if (!smp_load_acquire(&db->rx_dma_done))
+			return 0;
+
+		reg_val = readl(db->membase + EMAC_RX_CTL_REG);
+		reg_val &= ~EMAC_RX_CTL_DMA_EN;
+		writel(reg_val, db->membase + EMAC_RX_CTL_REG);
+
+		dev->stats.rx_bytes += db->rxlen_last;
+
+		/* Pass to upper layer */
+		skb = db->skb_last;
+		db->skb_last = NULL;
+		skb->protocol = eth_type_trans(skb, dev);
+		napi_gro_receive(&db->napi, skb);
+		dev->stats.rx_packets++;
+		work_done++;
+	}
+
 	/* Check packet ready or not */
 	while (work_done < limit) {
 		/* race warning: the first packet might arrive with
@@ -667,22 +1027,6 @@ static int emac_rx(struct net_device *dev, int limit)
 		if (netif_msg_rx_status(db))
 			dev_dbg(db->dev, "RXCount: %x\n", rxcount);
 
-		if ((db->skb_last != NULL) && (rxlen_last > 0)) {
-			dev->stats.rx_bytes += rxlen_last;
-
-			/* Pass to upper layer */
-			db->skb_last->protocol = eth_type_trans(db->skb_last,
-								dev);
-			netif_rx(db->skb_last);
-			dev->stats.rx_packets++;
-			db->skb_last = NULL;
-			rxlen_last = 0;
-
-			reg_val = readl(db->membase + EMAC_RX_CTL_REG);
-			reg_val &= ~EMAC_RX_CTL_DMA_EN;
-			writel(reg_val, db->membase + EMAC_RX_CTL_REG);
-		}
-
 		if (!rxcount) {
 			db->emacrx_completed_flag = 1;
 			reg_val = readl(db->membase + EMAC_INT_CTL_REG);
@@ -767,19 +1111,39 @@ static int emac_rx(struct net_device *dev, int limit)
 
 		/* Move data from EMAC */
 		if (good_packet) {
+			use_dma = emac_use_dma(db->rx_chan, rxlen);
+
 			skb = netdev_alloc_skb(dev, rxlen + 4);
-			if (!skb)
+			if (!skb) {
+				dev->stats.rx_dropped++;
 				continue;
-			skb_reserve(skb, 2);
+			}
+			/* the dma wants a word aligned buffer */
+			if (!use_dma)
+				skb_reserve(skb, 2);
 			rdptr = (u8 *) skb_put(skb, rxlen - 4);
 
 			/* Read received packet from RX SRAM */
 			if (netif_msg_rx_status(db))
 				dev_dbg(db->dev, "RxLen %x\n", rxlen);
 
+			if (use_dma) {
+				reg_val = readl(db->membase + EMAC_RX_CTL_REG);
+				reg_val |= EMAC_RX_CTL_DMA_EN;
+				writel(reg_val, db->membase + EMAC_RX_CTL_REG);
+				/* napi is scheduled again from the dma callback */
+				if (!emac_dma_inblk_32bit(db, skb, rdptr, rxlen))
+					return work_done;
+
+				/* take this one by the cpu */
+				reg_val &= ~EMAC_RX_CTL_DMA_EN;
+				writel(reg_val, db->membase + EMAC_RX_CTL_REG);
+			}
+
 			emac_inblk_32bit(db->membase + EMAC_RX_IO_DATA_REG,
 					rdptr, rxlen);
 			dev->stats.rx_bytes += rxlen;
+			db->xstats.rx_pio_frames++;
 
 			/* Pass to upper layer */
 			skb->protocol = eth_type_trans(skb, dev);
@@ -793,8 +1157,12 @@ static int emac_rx(struct net_device *dev, int limit)
 
 static void emac_irq_disable(struct emac_board_info *db)
 {
-	/* Disable all interrupts */
-	writel(0, db->membase + EMAC_INT_CTL_REG);
+	u32 reg_val;
+
+	/* Disable the rx interrupt, tx completions keep coming */
+	reg_val = readl(db->membase + EMAC_INT_CTL_REG);
+	reg_val &= ~(0x01 << 8);
+	writel(reg_val, db->membase + EMAC_INT_CTL_REG);
 }
 
 static void emac_irq_enable(struct emac_board_info *db)
@@ -957,9 +1325,12 @@ static int emac_stop(struct net_device *ndev)
 		dev_dbg(db->dev, "shutting down %s\n", ndev->name);
 
 	netif_stop_queue(ndev);
+	cancel_work_sync(&db->tx_timeout_work);
 	napi_disable(&db->napi);
 	netif_carrier_off(ndev);
 
+	emac_dma_stop(db);
+
 	phy_stop(db->phy_dev);
 
 	emac_mdio_remove(ndev);
@@ -978,13 +1349,23 @@ static int emac_stop(struct net_device *ndev)
 static int emac_poll(struct napi_struct *napi, int budget)
 {
 	struct emac_board_info *db = container_of(napi, struct emac_board_info, napi);
+	unsigned long flags;
 	int work_done;
 
 	work_done = emac_rx(db->ndev, budget);
 
-	if (work_done < budget) {
-		napi_complete(napi);
+	if (work_done < budget && napi_complete_done(napi, work_done)) {
+		raw_spin_lock_irqsave(&db->lock, flags);
 		emac_irq_enable(db);
+		/* a frame landing after the last FBC read raised no schedule */
+		if (db->emacrx_completed_flag &&
+		    readl(db->membase + EMAC_RX_FBC_REG) &&
+		    napi_schedule_prep(napi)) {
+			db->emacrx_completed_flag = 0;
+			emac_irq_disable(db);
+			__napi_schedule(napi);
+		}
+		raw_spin_unlock_irqrestore(&db->lock, flags);
 	}
 
 	return work_done;
@@ -1081,6 +1462,10 @@ static int emac_probe(struct platform_device *pdev)
 		goto out_clkput;
 	}
 
+	ret = emac_configure_dma(db);
+	if (ret)
+		goto out_clkput;
+
 	db->phyrst = of_get_named_gpio_flags(np, "phy-rst", 0, &flag);
 	db->rst_active_low = (flag == OF_GPIO_ACTIVE_LOW) ? 1 : 0;
 
@@ -1088,7 +1473,7 @@ static int emac_probe(struct platform_device *pdev)
 		if (gpio_request(db->phyrst, "phy-rst") < 0) {
 			pr_err("gmac gpio request fail!\n");
 			ret = -EINVAL;
-			goto out_clkput;
+			goto out_dma;
 		}
 	}
 
@@ -1119,6 +1504,7 @@ static int emac_probe(struct platform_device *pdev)
 	netif_carrier_off(ndev);
 
 	netif_napi_add(ndev, &db->napi, emac_poll, NAPI_POLL_WEIGHT);
+	INIT_WORK(&db->tx_timeout_work, emac_tx_timeout_work);
 
 	ret = register_netdev(ndev);
 	if (ret) {
@@ -1139,6 +1525,8 @@ static int emac_probe(struct platform_device *pdev)
 out_powerput:
 	netif_napi_del(&db->napi);
 	emac_power_put(db);
+out_dma:
+	emac_release_dma(db);
 out_clkput:
 	clk_put(db->clk);
 out_release_sram:
@@ -1161,6 +1549,7 @@ static int emac_remove(struct platform_device *pdev)
 
 	unregister_netdev(ndev);
 	netif_napi_del(&db->napi);
+	emac_release_dma(db);
 
 	iounmap(db->sram_remap);
 
@@ -24,9 +24,12 @@
 #if IS_ENABLED(CONFIG_G2D_ROTATE)
 #include "g2d_rotate.h"
 #endif
+#include "g2d_queue.h"
 #include "linux/pm_runtime.h"
 #include "linux/pm_domain.h"
 #include "linux/hwspinlock.h"
+#include <linux/file.h>
+#include <linux/sync_file.h>
 
 #if IS_ENABLED(CONFIG_PM_GENERIC_DOMAINS)
 #define PM_ARRAY_SIZE  8
@@ -172,44 +175,240 @@ void g2d_free(void *virt_addr, void *phy_addr, unsigned int size)
 #endif
 }
 
+/*
+ * dma-buf attachment cache
+ *
+ * Compositors blit between the same few swapchain buffers all the time, so
+ * keep their attachment mapped instead of paying an iommu map and tlb
+ * invalidate for every blit. Entries are keyed by the dma-buf inode and hold
+ * a dma-buf reference. An entry is dropped once userspace has released the
+ * buffer (the cache holds the last file reference), when it falls off the
+ * end of the lru, or when the last g2d user closes the device.
+ *
+ * The reference of the cache keeps the exporter from ever seeing the
+ * release, so a reaper looks for released buffers every
+ * G2D_DMABUF_CACHE_REAP_MS while the cache has entries, a closed buffer
+ * does not stay pinned until the next blit.
+ *
+ * CPU access to a cached buffer must be bracketed by DMA_BUF_IOCTL_SYNC as
+ * usual, the exporter then syncs every mapped attachment including ours.
+ */
+struct g2d_dmabuf_entry {
+	struct list_head lru;
+	unsigned long ino;
+	struct dma_buf *buf;
+	struct dma_buf_attachment *attachment;
+	struct sg_table *sgt;
+	dma_addr_t dma_addr;
+	__u32 users;
+};
+
+struct g2d_dmabuf_cache {
+	struct mutex lock;
+	struct list_head lru;
+	__u32 cnt;
+	bool enable;
+	__u64 hit;
+	__u64 miss;
+	__u64 evict;
+	/* benchmark: time spent in g2d_dma_map/unmap */
+	__u64 map_cnt;
+	__u64 map_ns;
+	__u64 unmap_ns;
+	struct delayed_work reap;
+};
+
+static void g2d_dmabuf_cache_reap(struct work_struct *work);
+
+static struct g2d_dmabuf_cache dmabuf_cache = {
+	.lock = __MUTEX_INITIALIZER(dmabuf_cache.lock),
+	.lru = LIST_HEAD_INIT(dmabuf_cache.lru),
+	.enable = true,
+	.reap = __DELAYED_WORK_INITIALIZER(dmabuf_cache.reap,
+					   g2d_dmabuf_cache_reap, 0),
+};
+
+static int __g2d_dma_map(struct dma_buf *dmabuf,
+			 struct dma_buf_attachment **p_attachment,
+			 struct sg_table **p_sgt)
+{
+	struct dma_buf_attachment *attachment;
+	struct sg_table *sgt;
+
+	attachment = dma_buf_attach(dmabuf, dmabuf_dev);
+	if (IS_ERR(attachment)) {
+		G2D_WARN("dma_buf_attach failed\n");
+		return -1;
+	}
+	sgt = dma_buf_map_attachment(attachment, DMA_TO_DEVICE);
+	if (IS_ERR_OR_NULL(sgt)) {
+		G2D_WARN("dma_buf_map_attachment failed\n");
+		dma_buf_detach(dmabuf, attachment);
+		return -1;
+	}
+
+	*p_attachment = attachment;
+	*p_sgt = sgt;
+	return 0;
+}
+
+/* dmabuf_cache.lock held */
+static void g2d_dmabuf_entry_free(struct g2d_dmabuf_entry *entry)
+{
+	list_del(&entry->lru);
+	dmabuf_cache.cnt--;
+	dmabuf_cache.evict++;
+	dma_buf_unmap_attachment(entry->attachment, entry->sgt, DMA_TO_DEVICE);
+	dma_buf_detach(entry->buf, entry->attachment);
+	dma_buf_put(entry->buf);
+	kfree(entry);
+}
+
+/*
+ * dmabuf_cache.lock held. Drop idle entries whose buffer has been released
+ * by everybody else, and the oldest idle entries beyond the cache size.
+ */
+static void g2d_dmabuf_cache_trim(__u32 max_cnt)
+{
+	struct g2d_dmabuf_entry *entry, *tmp;
+
+	list_for_each_entry_safe_reverse(entry, tmp, &dmabuf_cache.lru, lru) {
+		if (entry->users)
+			continue;
+		if (dmabuf_cache.cnt > max_cnt ||
+		    file_count(entry->buf->file) == 1)
+			g2d_dmabuf_entry_free(entry);
+	}
+}
+
+static struct g2d_dmabuf_entry *g2d_dmabuf_cache_get(struct dma_buf *dmabuf)
+{
+	unsigned long ino = file_inode(dmabuf->file)->i_ino;
+	struct g2d_dmabuf_entry *entry;
+
+	mutex_lock(&dmabuf_cache.lock);
+	list_for_each_entry(entry, &dmabuf_cache.lru, lru) {
+		if (entry->ino == ino && entry->buf == dmabuf) {
+			entry->users++;
+			list_move(&entry->lru, &dmabuf_cache.lru);
+			dmabuf_cache.hit++;
+			mutex_unlock(&dmabuf_cache.lock);
+			/* the entry holds its own reference */
+			dma_buf_put(dmabuf);
+			return entry;
+		}
+	}
+	dmabuf_cache.miss++;
+	mutex_unlock(&dmabuf_cache.lock);
+
+	entry = kzalloc(sizeof(*entry), GFP_KERNEL);
+	if (!entry)
+		return NULL;
+	if (__g2d_dma_map(dmabuf, &entry->attachment, &entry->sgt)) {
+		kfree(entry);
+		return NULL;
+	}
+	entry->ino = ino;
+	entry->buf = dmabuf;
+	entry->dma_addr = sg_dma_address(entry->sgt->sgl);
+	entry->users = 1;
+
+	mutex_lock(&dmabuf_cache.lock);
+	list_add(&entry->lru, &dmabuf_cache.lru);
+	dmabuf_cache.cnt++;
+	g2d_dmabuf_cache_trim(G2D_DMABUF_CACHE_SIZE);
+	schedule_delayed_work(&dmabuf_cache.reap,
+			      msecs_to_jiffies(G2D_DMABUF_CACHE_REAP_MS));
+	mutex_unlock(&dmabuf_cache.lock);
+
+	return entry;
+}
+
+static void g2d_dmabuf_cache_put(struct g2d_dmabuf_entry *entry)
+{
+	mutex_lock(&dmabuf_cache.lock);
+	entry->users--;
+	g2d_dmabuf_cache_trim(dmabuf_cache.enable ? G2D_DMABUF_CACHE_SIZE : 0);
+	mutex_unlock(&dmabuf_cache.lock);
+}
+
+static void g2d_dmabuf_cache_flush(void)
+{
+	mutex_lock(&dmabuf_cache.lock);
+	g2d_dmabuf_cache_trim(0);
+	mutex_unlock(&dmabuf_cache.lock);
+}
+
+/* evict the idle entries of buffers userspace closed since the last run */
+static void g2d_dmabuf_cache_reap(struct work_struct *work)
+{
+	mutex_lock(&dmabuf_cache.lock);
+	g2d_dmabuf_cache_trim(dmabuf_cache.enable ? G2D_DMABUF_CACHE_SIZE : 0);
+	if (dmabuf_cache.cnt)
+		schedule_delayed_work(&dmabuf_cache.reap,
+				      msecs_to_jiffies(G2D_DMABUF_CACHE_REAP_MS));
+	mutex_unlock(&dmabuf_cache.lock);
+}
+
+static void g2d_dmabuf_cache_account(ktime_t start, bool map)
+{
+	__u64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	mutex_lock(&dmabuf_cache.lock);
+	if (map) {
+		dmabuf_cache.map_ns += ns;
+		dmabuf_cache.map_cnt++;
+	} else {
+		dmabuf_cache.unmap_ns += ns;
+	}
+	mutex_unlock(&dmabuf_cache.lock);
+}
+
 int g2d_dma_map(int fd, struct dmabuf_item *item)
 {
+	struct g2d_dmabuf_entry *entry;
 	struct dma_buf *dmabuf;
 	struct dma_buf_attachment *attachment;
 	struct sg_table *sgt;
+	ktime_t start = 0;
 	int ret = -1;
 
 	if (fd < 0) {
 		G2D_WARN("dma_buf_id %d is invalid\n", fd);
 		goto exit;
 	}
+	if (g_time_info == 1)
+		start = ktime_get();
 	dmabuf = dma_buf_get(fd);
 	if (IS_ERR(dmabuf)) {
 		G2D_WARN("dma_buf_get failed, fd=%d\n", fd);
 		goto exit;
 	}
 
-	attachment = dma_buf_attach(dmabuf, dmabuf_dev);
-	if (IS_ERR(attachment)) {
-		G2D_WARN("dma_buf_attach failed\n");
-		goto err_buf_put;
-	}
-	sgt = dma_buf_map_attachment(attachment, DMA_TO_DEVICE);
-	if (IS_ERR_OR_NULL(sgt)) {
-		G2D_WARN("dma_buf_map_attachment failed\n");
-		goto err_buf_detach;
+	if (dmabuf_cache.enable) {
+		entry = g2d_dmabuf_cache_get(dmabuf);
+		if (!entry)
+			goto err_buf_put;
+		item->entry = entry;
+		item->buf = entry->buf;
+		item->sgt = entry->sgt;
+		item->attachment = entry->attachment;
+		item->dma_addr = entry->dma_addr;
+	} else {
+		if (__g2d_dma_map(dmabuf, &attachment, &sgt))
+			goto err_buf_put;
+		item->entry = NULL;
+		item->buf = dmabuf;
+		item->sgt = sgt;
+		item->attachment = attachment;
+		item->dma_addr = sg_dma_address(sgt->sgl);
 	}
-
 	item->fd = fd;
-	item->buf = dmabuf;
-	item->sgt = sgt;
-	item->attachment = attachment;
-	item->dma_addr = sg_dma_address(sgt->sgl);
 	ret = 0;
+	if (g_time_info == 1)
+		g2d_dmabuf_cache_account(start, true);
 	goto exit;
 
-err_buf_detach:
-	dma_buf_detach(dmabuf, attachment);
 err_buf_put:
 	dma_buf_put(dmabuf);
 exit:
@@ -218,9 +417,23 @@ exit:
 
 void g2d_dma_unmap(struct dmabuf_item *item)
 {
-	dma_buf_unmap_attachment(item->attachment, item->sgt, DMA_TO_DEVICE);
-	dma_buf_detach(item->buf, item->attachment);
-	dma_buf_put(item->buf);
+	ktime_t start = 0;
+
+	if (g_time_info == 1)
+		start = ktime_get();
+
+	if (item->entry) {
+		g2d_dmabuf_cache_put(item->entry);
+		item->entry = NULL;
+	} else {
+		dma_buf_unmap_attachment(item->attachment, item->sgt,
+					 DMA_TO_DEVICE);
+		dma_buf_detach(item->buf, item->attachment);
+		dma_buf_put(item->buf);
+	}
+
+	if (g_time_info == 1)
+		g2d_dmabuf_cache_account(start, false);
 }
 
 __s32 g2d_set_info(g2d_image_enh *g2d_img, struct dmabuf_item *item)
@@ -525,6 +738,17 @@ EXPORT_SYMBOL_GPL(g2d_open);
 int g2d_release(struct inode *inode, struct file *file)
 {
 	mutex_lock(&para.mutex);
+#if IS_ENABLED(CONFIG_G2D_ASYNC_QUEUE)
+	/*
+	 * The last user must not gate the clocks under queued jobs. They take
+	 * para.mutex to run, so wait for them with it dropped.
+	 */
+	while (para.user_cnt == 1 && para.queue && g2d_queue_depth(para.queue)) {
+		mutex_unlock(&para.mutex);
+		g2d_queue_flush(para.queue);
+		mutex_lock(&para.mutex);
+	}
+#endif
 	para.user_cnt--;
 	if (para.user_cnt == 0) {
 #ifndef CONFIG_PM_GENERIC_DOMAINS
@@ -535,6 +759,7 @@ int g2d_release(struct inode *inode, struct file *file)
 #ifndef CONFIG_PM_GENERIC_DOMAINS
 		g2d_bsp_close();
 #endif
+		g2d_dmabuf_cache_flush();
 	}
 
 	mutex_unlock(&para.mutex);
@@ -637,6 +862,7 @@ irqreturn_t g2d_handle_irq(int irq, void *dev_id)
 #if G2D_MIXER_RCQ_USED == 1
 	if (g2d_top_rcq_task_irq_query()) {
 		g2d_top_mixer_reset();
+		g2d_queue_irq_done(para.queue, 0);
 		g2d_ext_hd.finish_flag = 1;
 		wake_up(&g2d_ext_hd.queue);
 		return IRQ_HANDLED;
@@ -644,6 +870,7 @@ irqreturn_t g2d_handle_irq(int irq, void *dev_id)
 #else
 	if (g2d_mixer_irq_query()) {
 		g2d_top_mixer_reset();
+		g2d_queue_irq_done(para.queue, 0);
 		g2d_ext_hd.finish_flag = 1;
 		wake_up(&g2d_ext_hd.queue);
 		return IRQ_HANDLED;
@@ -694,11 +921,255 @@ int g2d_ioctl_mutex_unlock(void)
 }
 EXPORT_SYMBOL_GPL(g2d_ioctl_mutex_unlock);
 
+#if IS_ENABLED(CONFIG_G2D_ASYNC_QUEUE)
+static int g2d_async_job_run(struct g2d_job *job)
+{
+	struct g2d_mixer_task *p_task = job->priv;
+	int ret;
+
+	ret = g2d_ioctl_mutex_lock();
+	if (ret < 0)
+		return -EBUSY;
+
+#if IS_ENABLED(CONFIG_PM_GENERIC_DOMAINS)
+	pm_runtime_get_sync(para.dev);
+#endif
+	g2d_ext_hd.finish_flag = 0;
+	g2d_queue_job_arm(job);
+	ret = p_task->apply(p_task);
+	p_task->destory(p_task);
+	job->priv = NULL;
+#if IS_ENABLED(CONFIG_PM_GENERIC_DOMAINS)
+	pm_runtime_put_sync(para.dev);
+#endif
+	g2d_ioctl_mutex_unlock();
+
+	return ret ? -EIO : 0;
+}
+
+/* only reached with a task that never ran */
+static void g2d_async_job_release(struct g2d_job *job)
+{
+	struct g2d_mixer_task *p_task = job->priv;
+
+	if (!p_task)
+		return;
+
+	mutex_lock(&para.mutex);
+	p_task->destory(p_task);
+	mutex_unlock(&para.mutex);
+	job->priv = NULL;
+}
+
+static struct mixer_para *g2d_async_get_para(struct g2d_async_submit *submit,
+					     unsigned int *frame_len)
+{
+	void __user *uptr = u64_to_user_ptr(submit->para);
+	struct mixer_para *p_para;
+
+	*frame_len = 1;
+	if (submit->cmd == G2D_CMD_MIXER_TASK) {
+		if (!submit->frame_cnt)
+			return ERR_PTR(-EINVAL);
+		*frame_len = submit->frame_cnt;
+	}
+
+	p_para = kcalloc(*frame_len, sizeof(*p_para), GFP_KERNEL);
+	if (!p_para)
+		return ERR_PTR(-ENOMEM);
+
+	switch (submit->cmd) {
+	case G2D_CMD_MIXER_TASK:
+		if (copy_from_user(p_para, uptr, sizeof(*p_para) * *frame_len))
+			goto err_fault;
+		break;
+	case G2D_CMD_BITBLT_H:
+		{
+			g2d_blt_h blit_para;
+
+			if (copy_from_user(&blit_para, uptr, sizeof(blit_para)))
+				goto err_fault;
+			/* rotation runs on the rotate module, not queued */
+			if (blit_para.flag_h & 0xff00) {
+				kfree(p_para);
+				return ERR_PTR(-EINVAL);
+			}
+			memcpy(&p_para->dst_image_h, &blit_para.dst_image_h,
+			       sizeof(g2d_image_enh));
+			memcpy(&p_para->src_image_h, &blit_para.src_image_h,
+			       sizeof(g2d_image_enh));
+			p_para->flag_h = blit_para.flag_h;
+			p_para->op_flag = OP_BITBLT;
+			break;
+		}
+	case G2D_CMD_BLD_H:
+		{
+			g2d_bld bld_para;
+
+			if (copy_from_user(&bld_para, uptr, sizeof(bld_para)))
+				goto err_fault;
+			memcpy(&p_para->dst_image_h, &bld_para.dst_image,
+			       sizeof(g2d_image_enh));
+			memcpy(&p_para->src_image_h, &bld_para.src_image[0],
+			       sizeof(g2d_image_enh));
+			/* ptn use as src */
+			memcpy(&p_para->ptn_image_h, &bld_para.src_image[1],
+			       sizeof(g2d_image_enh));
+			memcpy(&p_para->ck_para, &bld_para.ck_para, sizeof(g2d_ck));
+			p_para->bld_cmd = bld_para.bld_cmd;
+			p_para->op_flag = OP_BLEND;
+			break;
+		}
+	case G2D_CMD_FILLRECT_H:
+		{
+			g2d_fillrect_h fill_para;
+
+			if (copy_from_user(&fill_para, uptr, sizeof(fill_para)))
+				goto err_fault;
+			memcpy(&p_para->dst_image_h, &fill_para.dst_image_h,
+			       sizeof(g2d_image_enh));
+			p_para->op_flag = OP_FILLRECT;
+			break;
+		}
+	case G2D_CMD_MASK_H:
+		{
+			g2d_maskblt mask_para;
+
+			if (copy_from_user(&mask_para, uptr, sizeof(mask_para)))
+				goto err_fault;
+			memcpy(&p_para->ptn_image_h, &mask_para.ptn_image_h,
+			       sizeof(g2d_image_enh));
+			memcpy(&p_para->mask_image_h, &mask_para.mask_image_h,
+			       sizeof(g2d_image_enh));
+			memcpy(&p_para->dst_image_h, &mask_para.dst_image_h,
+			       sizeof(g2d_image_enh));
+			memcpy(&p_para->src_image_h, &mask_para.src_image_h,
+			       sizeof(g2d_image_enh));
+			p_para->back_flag = mask_para.back_flag;
+			p_para->fore_flag = mask_para.fore_flag;
+			p_para->op_flag = OP_MASK;
+			break;
+		}
+	default:
+		kfree(p_para);
+		return ERR_PTR(-EINVAL);
+	}
+
+	return p_para;
+
+err_fault:
+	kfree(p_para);
+	return ERR_PTR(-EFAULT);
+}
+
+/*
+ * Build the rcq of the job in the caller context, because the dma-buf fds
+ * only resolve there, then queue it and hand back a sync_file out fence.
+ * The hardware part runs from the queue worker and the fence is signalled
+ * by g2d_handle_irq().
+ */
+static long g2d_ioctl_async_submit(struct file *file, unsigned long arg)
+{
+	struct g2d_async_submit submit;
+	struct g2d_mixer_task *p_task;
+	struct mixer_para *p_para;
+	struct sync_file *sync_file;
+	struct dma_fence *fence;
+	struct g2d_job *job;
+	unsigned int frame_len;
+	int fd, ret;
+
+	if (!para.queue)
+		return -ENODEV;
+
+	if (copy_from_user(&submit, (void __user *)arg, sizeof(submit)))
+		return -EFAULT;
+
+	job = kzalloc(sizeof(*job), GFP_KERNEL);
+	if (!job)
+		return -ENOMEM;
+
+	if (submit.in_fence >= 0) {
+		job->in_fence = sync_file_get_fence(submit.in_fence);
+		if (!job->in_fence) {
+			G2D_WARN("invalid in fence %d\n", submit.in_fence);
+			ret = -EINVAL;
+			goto err_free_job;
+		}
+	}
+
+	p_para = g2d_async_get_para(&submit, &frame_len);
+	if (IS_ERR(p_para)) {
+		ret = PTR_ERR(p_para);
+		goto err_put_fence;
+	}
+
+	mutex_lock(&para.mutex);
+	p_task = g2d_mixer_get_inst(create_mixer_task(&para, p_para, frame_len));
+	mutex_unlock(&para.mutex);
+	kfree(p_para);
+	if (!p_task) {
+		ret = -EINVAL;
+		goto err_put_fence;
+	}
+
+	job->priv = p_task;
+	job->run = g2d_async_job_run;
+	job->release = g2d_async_job_release;
+
+	fd = get_unused_fd_flags(O_CLOEXEC);
+	if (fd < 0) {
+		ret = fd;
+		goto err_release;
+	}
+
+	fence = g2d_queue_submit(para.queue, job, file->f_flags & O_NONBLOCK);
+	if (IS_ERR(fence)) {
+		ret = PTR_ERR(fence);
+		goto err_put_fd;
+	}
+
+	/* the job belongs to the queue from here on */
+	sync_file = sync_file_create(fence);
+	dma_fence_put(fence);
+	if (!sync_file) {
+		put_unused_fd(fd);
+		return -ENOMEM;
+	}
+
+	submit.out_fence = fd;
+	if (copy_to_user((void __user *)arg, &submit, sizeof(submit))) {
+		fput(sync_file->file);
+		put_unused_fd(fd);
+		return -EFAULT;
+	}
+	fd_install(fd, sync_file->file);
+
+	return 0;
+
+err_put_fd:
+	put_unused_fd(fd);
+err_release:
+	g2d_async_job_release(job);
+err_put_fence:
+	if (job->in_fence)
+		dma_fence_put(job->in_fence);
+err_free_job:
+	kfree(job);
+	return ret;
+}
+#endif
+
 long g2d_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 {
 	int ret = -1;
 	struct timespec64 test_start, test_end;
 
+#if IS_ENABLED(CONFIG_G2D_ASYNC_QUEUE)
+	/* must not hold para.mutex, the submit may wait for ring space */
+	if (cmd == G2D_CMD_ASYNC_SUBMIT)
+		return g2d_ioctl_async_submit(file, arg);
+#endif
 
 	if (g_time_info == 1)
 		ktime_get_real_ts64(&test_start);
@@ -1075,9 +1546,83 @@ static ssize_t g2d_func_runtime_store(struct device *dev,
 static DEVICE_ATTR(func_runtime, 0660,
 		   g2d_func_runtime_show, g2d_func_runtime_store);
 
+static ssize_t g2d_dmabuf_cache_show(struct device *dev,
+				     struct device_attribute *attr, char *buf)
+{
+	ssize_t count;
+	__u64 map_cnt;
+
+	mutex_lock(&dmabuf_cache.lock);
+	map_cnt = dmabuf_cache.map_cnt ? dmabuf_cache.map_cnt : 1;
+	count = sprintf(buf,
+			"enable=%d entries=%u/%u hit=%llu miss=%llu evict=%llu\n"
+			"maps=%llu map=%llu ns unmap=%llu ns per buffer\n",
+			dmabuf_cache.enable, dmabuf_cache.cnt,
+			G2D_DMABUF_CACHE_SIZE, dmabuf_cache.hit,
+			dmabuf_cache.miss, dmabuf_cache.evict,
+			dmabuf_cache.map_cnt,
+			div64_u64(dmabuf_cache.map_ns, map_cnt),
+			div64_u64(dmabuf_cache.unmap_ns, map_cnt));
+	mutex_unlock(&dmabuf_cache.lock);
+
+	return count;
+}
+
+/*
+ * "1"/"0": enable/disable the cache, disabling flushes idle entries.
+ * "reset": clear statistics. Map overhead is only sampled while
+ * func_runtime is enabled, so a benchmark run is: echo 1 > func_runtime,
+ * echo reset > dmabuf_cache, run the workload, cat dmabuf_cache, then
+ * repeat with the cache disabled.
+ */
+static ssize_t g2d_dmabuf_cache_store(struct device *dev,
+				      struct device_attribute *attr,
+				      const char *buf, size_t count)
+{
+	mutex_lock(&dmabuf_cache.lock);
+	if (strncasecmp(buf, "reset", 5) == 0) {
+		dmabuf_cache.hit = 0;
+		dmabuf_cache.miss = 0;
+		dmabuf_cache.evict = 0;
+		dmabuf_cache.map_cnt = 0;
+		dmabuf_cache.map_ns = 0;
+		dmabuf_cache.unmap_ns = 0;
+	} else if (strncasecmp(buf, "1", 1) == 0) {
+		dmabuf_cache.enable = true;
+	} else if (strncasecmp(buf, "0", 1) == 0) {
+		dmabuf_cache.enable = false;
+		g2d_dmabuf_cache_trim(0);
+	} else {
+		G2D_WARN("Error input\n");
+	}
+	mutex_unlock(&dmabuf_cache.lock);
+
+	return count;
+}
+
+static DEVICE_ATTR(dmabuf_cache, 0660,
+		   g2d_dmabuf_cache_show, g2d_dmabuf_cache_store);
+
+#if IS_ENABLED(CONFIG_G2D_ASYNC_QUEUE)
+static ssize_t g2d_queue_show(struct device *dev,
+			     struct device_attribute *attr, char *buf)
+{
+	if (!para.queue)
+		return sprintf(buf, "no queue\n");
+	return g2d_queue_stat_show(para.queue, buf);
+}
+
+static DEVICE_ATTR(queue, 0440, g2d_queue_show, NULL);
+
+#endif
+
 static struct attribute *g2d_attributes[] = {
 	&dev_attr_debug.attr,
 	&dev_attr_func_runtime.attr,
+	&dev_attr_dmabuf_cache.attr,
+#if IS_ENABLED(CONFIG_G2D_ASYNC_QUEUE)
+	&dev_attr_queue.attr,
+#endif
 	NULL
 };
 
@@ -1212,6 +1757,12 @@ static int g2d_probe(struct platform_device *pdev)
 	mutex_init(&info->mutex);
 	mutex_init(&global_lock);
 
+#if IS_ENABLED(CONFIG_G2D_ASYNC_QUEUE)
+	info->queue = g2d_queue_create("g2d");
+	if (!info->queue)
+		G2D_WARN("async queue create fail\n");
+#endif
+
 	ret = sysfs_create_group(&g2d_dev->kobj, &g2d_attribute_group);
 	if (ret < 0)
 		G2D_ERR("sysfs_create_file fail\n");
@@ -1255,6 +1806,14 @@ static int g2d_remove(struct platform_device *pdev)
 	pm_runtime_disable(para.dev);
 #endif
 
+#if IS_ENABLED(CONFIG_G2D_ASYNC_QUEUE)
+	g2d_queue_destroy(para.queue);
+	para.queue = NULL;
+#endif
+
+	cancel_delayed_work_sync(&dmabuf_cache.reap);
+	g2d_dmabuf_cache_flush();
+
 	free_irq(para.irq, NULL);
 	platform_set_drvdata(pdev, NULL);
 
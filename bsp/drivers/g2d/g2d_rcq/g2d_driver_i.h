@@ -44,6 +44,13 @@
 #define G2D_IOMMU_MASTER_ID 3
 #endif
 
+/* number of dma-buf attachments kept mapped across blits */
+#define G2D_DMABUF_CACHE_SIZE 32
+/* how often the cache looks for buffers userspace has closed */
+#define G2D_DMABUF_CACHE_REAP_MS 500
+
+struct g2d_dmabuf_entry;
+
 struct dmabuf_item {
 	struct list_head list;
 	int fd;
@@ -52,8 +59,11 @@ struct dmabuf_item {
 	struct sg_table *sgt;
 	dma_addr_t dma_addr;
 	unsigned long long id;
+	struct g2d_dmabuf_entry *entry;
 };
 
+struct g2d_queue;
+
 struct info_mem {
 	unsigned long phy_addr;
 	void *virt_addr;
@@ -74,6 +84,7 @@ typedef struct {
 	struct clk *bus_clk;
 	struct clk *mbus_clk;
 	struct reset_control *reset;
+	struct g2d_queue *queue;
 } __g2d_info_t;
 
 typedef struct {
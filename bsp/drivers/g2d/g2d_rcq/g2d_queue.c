@@ -0,0 +1,297 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright(c) 2020 - 2023 Allwinner Technology Co.,Ltd. All rights reserved. */
+/*
+ * Copyright (c) 2007-2019 Allwinnertech Co., Ltd.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+#include "g2d_driver_i.h"
+#include "g2d_queue.h"
+#include "../syncfence.h"
+
+/*
+ * Jobs are executed strictly in submission order by a single worker, so the
+ * out fences of one queue are allocated on one timeline and every completion
+ * advances the timeline by exactly one.
+ *
+ * @head: index of the oldest job (the running one, if any)
+ * @tail: index of the next free slot
+ * @running: job whose hardware completion irq is pending
+ * @submit_lock: serialises fence seqno allocation against enqueue
+ */
+struct g2d_queue {
+	struct g2d_job *ring[G2D_QUEUE_DEPTH];
+	u32 head;
+	u32 tail;
+	u32 seqno;
+	struct g2d_job *running;
+	spinlock_t lock;
+	struct mutex submit_lock;
+	wait_queue_head_t space_wq;
+	struct fence_timeline *timeline;
+	struct kthread_worker *worker;
+	struct kthread_work work;
+
+	u64 submitted;
+	u64 completed;
+	u64 irq_completed;
+	u64 failed;
+	u32 max_depth;
+};
+
+static u32 __g2d_queue_depth(struct g2d_queue *q)
+{
+	return q->tail - q->head;
+}
+
+u32 g2d_queue_depth(struct g2d_queue *q)
+{
+	unsigned long flags;
+	u32 depth;
+
+	spin_lock_irqsave(&q->lock, flags);
+	depth = __g2d_queue_depth(q);
+	spin_unlock_irqrestore(&q->lock, flags);
+
+	return depth;
+}
+
+/* q->lock held */
+static void g2d_queue_signal(struct g2d_queue *q, struct g2d_job *job, int err)
+{
+	if (err) {
+		dma_fence_set_error(job->out_fence, err);
+		q->failed++;
+	}
+	fence_timeline_signal(q->timeline, 1);
+	q->completed++;
+}
+
+void g2d_queue_job_arm(struct g2d_job *job)
+{
+	struct g2d_queue *q = job->queue;
+	unsigned long flags;
+
+	spin_lock_irqsave(&q->lock, flags);
+	q->running = job;
+	spin_unlock_irqrestore(&q->lock, flags);
+}
+
+bool g2d_queue_irq_done(struct g2d_queue *q, int err)
+{
+	struct g2d_job *job;
+	unsigned long flags;
+
+	if (!q)
+		return false;
+
+	spin_lock_irqsave(&q->lock, flags);
+	job = q->running;
+	if (job) {
+		q->running = NULL;
+		g2d_queue_signal(q, job, err);
+		q->irq_completed++;
+	}
+	spin_unlock_irqrestore(&q->lock, flags);
+
+	return job != NULL;
+}
+
+static int g2d_queue_wait_in_fence(struct g2d_job *job)
+{
+	long timeout;
+	int ret;
+
+	if (!job->in_fence)
+		return 0;
+
+	timeout = dma_fence_wait_timeout(job->in_fence, false,
+					 msecs_to_jiffies(G2D_FENCE_WAIT_MS));
+	if (timeout < 0)
+		return timeout;
+	if (timeout == 0) {
+		G2D_WARN("in fence wait timeout\n");
+		return -ETIMEDOUT;
+	}
+
+	ret = dma_fence_get_status(job->in_fence);
+	return ret < 0 ? ret : 0;
+}
+
+static void g2d_queue_job_free(struct g2d_job *job)
+{
+	if (job->release)
+		job->release(job);
+	if (job->in_fence)
+		dma_fence_put(job->in_fence);
+	dma_fence_put(job->out_fence);
+	kfree(job);
+}
+
+static void g2d_queue_work(struct kthread_work *work)
+{
+	struct g2d_queue *q = container_of(work, struct g2d_queue, work);
+	struct g2d_job *job;
+	unsigned long flags;
+	int ret;
+
+	for (;;) {
+		spin_lock_irqsave(&q->lock, flags);
+		job = __g2d_queue_depth(q) ?
+			q->ring[q->head & (G2D_QUEUE_DEPTH - 1)] : NULL;
+		spin_unlock_irqrestore(&q->lock, flags);
+		if (!job)
+			break;
+
+		ret = g2d_queue_wait_in_fence(job);
+		if (!ret)
+			ret = job->run(job);
+
+		/*
+		 * Normally the irq has signalled the fence already. Complete
+		 * it here for jobs that failed, timed out or never started.
+		 */
+		spin_lock_irqsave(&q->lock, flags);
+		if (q->running == job)
+			q->running = NULL;
+		if (!dma_fence_is_signaled(job->out_fence))
+			g2d_queue_signal(q, job, ret);
+		q->ring[q->head & (G2D_QUEUE_DEPTH - 1)] = NULL;
+		q->head++;
+		spin_unlock_irqrestore(&q->lock, flags);
+
+		wake_up(&q->space_wq);
+		g2d_queue_job_free(job);
+	}
+}
+
+struct dma_fence *g2d_queue_submit(struct g2d_queue *q, struct g2d_job *job,
+				   bool nonblock)
+{
+	struct dma_fence *fence;
+	unsigned long flags;
+	u32 depth;
+	int ret;
+
+	mutex_lock(&q->submit_lock);
+
+	if (nonblock) {
+		if (g2d_queue_depth(q) >= G2D_QUEUE_DEPTH) {
+			ret = -EAGAIN;
+			goto err_unlock;
+		}
+	} else {
+		ret = wait_event_interruptible(q->space_wq,
+				g2d_queue_depth(q) < G2D_QUEUE_DEPTH);
+		if (ret)
+			goto err_unlock;
+	}
+
+	fence = fence_timeline_create_fence(q->timeline, q->seqno + 1);
+	if (!fence) {
+		ret = -ENOMEM;
+		goto err_unlock;
+	}
+
+	job->queue = q;
+	job->out_fence = fence;
+	dma_fence_get(fence);
+
+	spin_lock_irqsave(&q->lock, flags);
+	q->ring[q->tail & (G2D_QUEUE_DEPTH - 1)] = job;
+	q->tail++;
+	q->seqno++;
+	q->submitted++;
+	depth = __g2d_queue_depth(q);
+	if (depth > q->max_depth)
+		q->max_depth = depth;
+	spin_unlock_irqrestore(&q->lock, flags);
+
+	mutex_unlock(&q->submit_lock);
+
+	kthread_queue_work(q->worker, &q->work);
+
+	return fence;
+
+err_unlock:
+	mutex_unlock(&q->submit_lock);
+	return ERR_PTR(ret);
+}
+
+ssize_t g2d_queue_stat_show(struct g2d_queue *q, char *buf)
+{
+	unsigned long flags;
+	ssize_t count;
+
+	spin_lock_irqsave(&q->lock, flags);
+	count = sprintf(buf,
+			"depth=%u/%u max_depth=%u submitted=%llu completed=%llu irq_completed=%llu failed=%llu\n",
+			__g2d_queue_depth(q), G2D_QUEUE_DEPTH, q->max_depth,
+			q->submitted, q->completed, q->irq_completed, q->failed);
+	spin_unlock_irqrestore(&q->lock, flags);
+
+	return count;
+}
+
+struct g2d_queue *g2d_queue_create(const char *name)
+{
+	struct g2d_queue *q;
+
+	q = kzalloc(sizeof(*q), GFP_KERNEL);
+	if (!q)
+		return NULL;
+
+	spin_lock_init(&q->lock);
+	mutex_init(&q->submit_lock);
+	init_waitqueue_head(&q->space_wq);
+	kthread_init_work(&q->work, g2d_queue_work);
+
+	q->timeline = fence_timeline_create(name);
+	if (!q->timeline)
+		goto err_free;
+
+	q->worker = kthread_create_worker(0, "%s", name);
+	if (IS_ERR(q->worker)) {
+		G2D_ERR("create %s worker fail\n", name);
+		goto err_timeline;
+	}
+	sched_set_fifo(q->worker->task);
+
+	return q;
+
+err_timeline:
+	fence_timeline_put(q->timeline);
+err_free:
+	kfree(q);
+	return NULL;
+}
+
+void g2d_queue_flush(struct g2d_queue *q)
+{
+	if (!q)
+		return;
+
+	/* a submit in progress has queued the work once it drops the lock */
+	mutex_lock(&q->submit_lock);
+	kthread_flush_work(&q->work);
+	mutex_unlock(&q->submit_lock);
+}
+
+void g2d_queue_destroy(struct g2d_queue *q)
+{
+	if (!q)
+		return;
+
+	kthread_flush_work(&q->work);
+	kthread_destroy_worker(q->worker);
+	fence_timeline_destroy(q->timeline);
+	kfree(q);
+}
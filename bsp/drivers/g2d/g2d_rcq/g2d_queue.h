@@ -0,0 +1,105 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright(c) 2020 - 2023 Allwinner Technology Co.,Ltd. All rights reserved. */
+/*
+ * Copyright (c) 2007-2019 Allwinnertech Co., Ltd.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+#ifndef _G2D_QUEUE_H
+#define _G2D_QUEUE_H
+
+#include <linux/dma-fence.h>
+#include <linux/kthread.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+
+/* must be a power of 2 */
+#define G2D_QUEUE_DEPTH		16
+#define G2D_FENCE_WAIT_MS	3000
+
+struct g2d_queue;
+
+/*
+ * g2d job
+ * @run: program the hardware and wait for it, called from the queue worker.
+ *       Must call g2d_queue_job_arm() under the hardware lock right before
+ *       the hardware is started, so that the completion irq is routed
+ *       to this job. Returns 0 or -errno, which ends up in the out fence.
+ * @release: free @priv, called once for every submitted job
+ */
+struct g2d_job {
+	struct g2d_queue *queue;
+	struct dma_fence *in_fence;
+	struct dma_fence *out_fence;
+	void *priv;
+	int (*run)(struct g2d_job *job);
+	void (*release)(struct g2d_job *job);
+};
+
+#if IS_ENABLED(CONFIG_G2D_ASYNC_QUEUE)
+
+/*
+ * @name       :g2d_queue_create
+ * @brief      :create a job ring with its own fence timeline and worker
+ * @param[IN]  :name:name of worker and fence timeline
+ * @return     :queue pointer, NULL if fail
+ */
+struct g2d_queue *g2d_queue_create(const char *name);
+
+/*
+ * @name       :g2d_queue_destroy
+ * @brief      :wait for all queued jobs and free the queue
+ * @param[IN]  :q:queue
+ */
+void g2d_queue_destroy(struct g2d_queue *q);
+
+/*
+ * @name       :g2d_queue_flush
+ * @brief      :wait until every job submitted so far has run and signalled
+ * @param[IN]  :q:queue, may be NULL
+ */
+void g2d_queue_flush(struct g2d_queue *q);
+
+/*
+ * @name       :g2d_queue_submit
+ * @brief      :put a job on the ring, ownership of @job moves to the queue
+ * @param[IN]  :q:queue
+ * @param[IN]  :job:job, in_fence may be NULL
+ * @param[IN]  :nonblock:return -EAGAIN instead of waiting if ring is full
+ * @return     :out fence with one reference for the caller, or ERR_PTR
+ */
+struct dma_fence *g2d_queue_submit(struct g2d_queue *q, struct g2d_job *job,
+				   bool nonblock);
+
+void g2d_queue_job_arm(struct g2d_job *job);
+
+/*
+ * @name       :g2d_queue_irq_done
+ * @brief      :signal the out fence of the running job from irq context
+ * @param[IN]  :q:queue, may be NULL
+ * @param[IN]  :err:0 or error of the hardware
+ * @return     :true if a job was completed
+ */
+bool g2d_queue_irq_done(struct g2d_queue *q, int err);
+
+u32 g2d_queue_depth(struct g2d_queue *q);
+ssize_t g2d_queue_stat_show(struct g2d_queue *q, char *buf);
+
+#else
+
+static inline bool g2d_queue_irq_done(struct g2d_queue *q, int err)
+{
+	return false;
+}
+
+#endif /* CONFIG_G2D_ASYNC_QUEUE */
+
+#endif /* _G2D_QUEUE_H */
@@ -0,0 +1,271 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright(c) 2020 - 2023 Allwinner Technology Co.,Ltd. All rights reserved. */
+/*
+ * KUnit tests for the g2d asynchronous job queue
+ *
+ * Jobs run against a mocked completion irq: an hrtimer plays the role of
+ * g2d_handle_irq(), so no g2d hardware is needed and the suite runs under
+ * QEMU. In fences come from a syncfence timeline the tests advance by hand.
+ */
+
+#include <kunit/test.h>
+#include <linux/completion.h>
+#include <linux/hrtimer.h>
+#include <linux/slab.h>
+#include "g2d_driver_i.h"
+#include "g2d_queue.h"
+#include "../syncfence.h"
+
+/* job index the mocked run fails without starting the hardware */
+#define MOCK_NO_FAIL		U32_MAX
+
+struct g2d_queue_test_ctx {
+	struct g2d_queue *queue;
+	struct fence_timeline *in_timeline;
+	struct hrtimer irq_timer;
+	struct completion irq_done;
+	atomic_t ran;
+	atomic_t irq_cnt;
+	u32 fail_idx;
+	u32 order[G2D_QUEUE_DEPTH];
+	struct dma_fence *fences[G2D_QUEUE_DEPTH];
+};
+
+static enum hrtimer_restart mock_irq(struct hrtimer *timer)
+{
+	struct g2d_queue_test_ctx *ctx =
+		container_of(timer, struct g2d_queue_test_ctx, irq_timer);
+
+	if (g2d_queue_irq_done(ctx->queue, 0))
+		atomic_inc(&ctx->irq_cnt);
+	complete(&ctx->irq_done);
+
+	return HRTIMER_NORESTART;
+}
+
+static int mock_run(struct g2d_job *job)
+{
+	struct g2d_queue_test_ctx *ctx = job->priv;
+	u32 idx = (u32)job->out_fence->seqno - 1;
+	int ran = atomic_inc_return(&ctx->ran) - 1;
+
+	if (ran < G2D_QUEUE_DEPTH)
+		ctx->order[ran] = idx;
+	if (idx == ctx->fail_idx)
+		return -EIO;
+
+	reinit_completion(&ctx->irq_done);
+	g2d_queue_job_arm(job);
+	hrtimer_start(&ctx->irq_timer, us_to_ktime(100), HRTIMER_MODE_REL);
+	if (!wait_for_completion_timeout(&ctx->irq_done,
+					 msecs_to_jiffies(WAIT_CMD_TIME_MS))) {
+		hrtimer_cancel(&ctx->irq_timer);
+		return -ETIMEDOUT;
+	}
+
+	return 0;
+}
+
+/* the queue owns and frees the job, so it is not a kunit allocation */
+static struct dma_fence *g2d_queue_test_submit(struct g2d_queue_test_ctx *ctx,
+					       struct dma_fence *in_fence)
+{
+	struct g2d_job *job;
+	struct dma_fence *fence;
+
+	job = kzalloc(sizeof(*job), GFP_KERNEL);
+	if (!job) {
+		if (in_fence)
+			dma_fence_put(in_fence);
+		return ERR_PTR(-ENOMEM);
+	}
+	job->priv = ctx;
+	job->run = mock_run;
+	job->in_fence = in_fence;
+
+	fence = g2d_queue_submit(ctx->queue, job, true);
+	if (IS_ERR(fence)) {
+		if (in_fence)
+			dma_fence_put(in_fence);
+		kfree(job);
+	}
+
+	return fence;
+}
+
+static long g2d_queue_test_wait(struct dma_fence *fence)
+{
+	return dma_fence_wait_timeout(fence, false,
+				      msecs_to_jiffies(G2D_FENCE_WAIT_MS));
+}
+
+static void g2d_queue_test_order(struct kunit *test)
+{
+	struct g2d_queue_test_ctx *ctx = test->priv;
+	struct dma_fence *in_fence;
+	unsigned int i;
+
+	for (i = 0; i < G2D_QUEUE_DEPTH; i++) {
+		/* the first job holds the whole ring back until released */
+		in_fence = i ? NULL :
+			   fence_timeline_create_fence(ctx->in_timeline, 1);
+		ctx->fences[i] = g2d_queue_test_submit(ctx, in_fence);
+		KUNIT_ASSERT_FALSE(test, IS_ERR(ctx->fences[i]));
+	}
+	KUNIT_EXPECT_EQ(test, g2d_queue_depth(ctx->queue), (u32)G2D_QUEUE_DEPTH);
+	KUNIT_EXPECT_EQ(test, atomic_read(&ctx->ran), 0);
+
+	fence_timeline_signal(ctx->in_timeline, 1);
+
+	for (i = 0; i < G2D_QUEUE_DEPTH; i++) {
+		KUNIT_ASSERT_GT(test, g2d_queue_test_wait(ctx->fences[i]), 0L);
+		KUNIT_EXPECT_EQ(test, dma_fence_get_status(ctx->fences[i]), 1);
+		if (i)
+			KUNIT_EXPECT_FALSE(test,
+				ktime_before(ctx->fences[i]->timestamp,
+					     ctx->fences[i - 1]->timestamp));
+	}
+
+	g2d_queue_flush(ctx->queue);
+	KUNIT_EXPECT_EQ(test, atomic_read(&ctx->ran), G2D_QUEUE_DEPTH);
+	for (i = 0; i < G2D_QUEUE_DEPTH; i++)
+		KUNIT_EXPECT_EQ(test, ctx->order[i], i);
+	/* every out fence came from the mocked irq, not the worker */
+	KUNIT_EXPECT_EQ(test, atomic_read(&ctx->irq_cnt), G2D_QUEUE_DEPTH);
+	KUNIT_EXPECT_EQ(test, g2d_queue_depth(ctx->queue), 0U);
+}
+
+static void g2d_queue_test_full(struct kunit *test)
+{
+	struct g2d_queue_test_ctx *ctx = test->priv;
+	struct dma_fence *in_fence, *fence;
+	unsigned int i;
+
+	for (i = 0; i < G2D_QUEUE_DEPTH; i++) {
+		in_fence = i ? NULL :
+			   fence_timeline_create_fence(ctx->in_timeline, 1);
+		ctx->fences[i] = g2d_queue_test_submit(ctx, in_fence);
+		KUNIT_ASSERT_FALSE(test, IS_ERR(ctx->fences[i]));
+	}
+
+	fence = g2d_queue_test_submit(ctx, NULL);
+	KUNIT_EXPECT_EQ(test, PTR_ERR_OR_ZERO(fence), -EAGAIN);
+	if (!IS_ERR(fence))
+		dma_fence_put(fence);
+
+	/* room again once the ring moves */
+	fence_timeline_signal(ctx->in_timeline, 1);
+	KUNIT_ASSERT_GT(test, g2d_queue_test_wait(ctx->fences[0]), 0L);
+	g2d_queue_flush(ctx->queue);
+
+	fence = g2d_queue_test_submit(ctx, NULL);
+	KUNIT_ASSERT_FALSE(test, IS_ERR(fence));
+	KUNIT_EXPECT_GT(test, g2d_queue_test_wait(fence), 0L);
+	KUNIT_EXPECT_EQ(test, dma_fence_get_status(fence), 1);
+	dma_fence_put(fence);
+}
+
+static void g2d_queue_test_run_error(struct kunit *test)
+{
+	struct g2d_queue_test_ctx *ctx = test->priv;
+	unsigned int i;
+
+	ctx->fail_idx = 1;
+	for (i = 0; i < 3; i++) {
+		ctx->fences[i] = g2d_queue_test_submit(ctx, NULL);
+		KUNIT_ASSERT_FALSE(test, IS_ERR(ctx->fences[i]));
+	}
+	for (i = 0; i < 3; i++)
+		KUNIT_ASSERT_GT(test, g2d_queue_test_wait(ctx->fences[i]), 0L);
+
+	/* the worker completes the failed job, the next one still runs */
+	KUNIT_EXPECT_EQ(test, dma_fence_get_status(ctx->fences[0]), 1);
+	KUNIT_EXPECT_EQ(test, dma_fence_get_status(ctx->fences[1]), -EIO);
+	KUNIT_EXPECT_EQ(test, dma_fence_get_status(ctx->fences[2]), 1);
+	KUNIT_EXPECT_EQ(test, atomic_read(&ctx->irq_cnt), 2);
+}
+
+static void g2d_queue_test_in_fence_error(struct kunit *test)
+{
+	struct g2d_queue_test_ctx *ctx = test->priv;
+	struct dma_fence *in_fence;
+
+	in_fence = fence_timeline_create_fence(ctx->in_timeline, 1);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, in_fence);
+	dma_fence_get(in_fence);
+	ctx->fences[0] = g2d_queue_test_submit(ctx, in_fence);
+	KUNIT_ASSERT_FALSE(test, IS_ERR(ctx->fences[0]));
+	ctx->fences[1] = g2d_queue_test_submit(ctx, NULL);
+	KUNIT_ASSERT_FALSE(test, IS_ERR(ctx->fences[1]));
+
+	dma_fence_set_error(in_fence, -EINVAL);
+	fence_timeline_signal(ctx->in_timeline, 1);
+	dma_fence_put(in_fence);
+
+	/* the job is never run, its out fence carries the error */
+	KUNIT_ASSERT_GT(test, g2d_queue_test_wait(ctx->fences[0]), 0L);
+	KUNIT_ASSERT_GT(test, g2d_queue_test_wait(ctx->fences[1]), 0L);
+	KUNIT_EXPECT_EQ(test, dma_fence_get_status(ctx->fences[0]), -EINVAL);
+	KUNIT_EXPECT_EQ(test, dma_fence_get_status(ctx->fences[1]), 1);
+	KUNIT_EXPECT_EQ(test, atomic_read(&ctx->ran), 1);
+	KUNIT_EXPECT_EQ(test, ctx->order[0], 1U);
+}
+
+static int g2d_queue_test_init(struct kunit *test)
+{
+	struct g2d_queue_test_ctx *ctx;
+
+	ctx = kunit_kzalloc(test, sizeof(*ctx), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, ctx);
+	test->priv = ctx;
+
+	ctx->fail_idx = MOCK_NO_FAIL;
+	init_completion(&ctx->irq_done);
+	hrtimer_init(&ctx->irq_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	ctx->irq_timer.function = mock_irq;
+
+	ctx->in_timeline = fence_timeline_create("g2d-test-in");
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, ctx->in_timeline);
+	ctx->queue = g2d_queue_create("g2d-test");
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, ctx->queue);
+
+	return 0;
+}
+
+static void g2d_queue_test_exit(struct kunit *test)
+{
+	struct g2d_queue_test_ctx *ctx = test->priv;
+	unsigned int i;
+
+	/* exit also runs when init failed half way */
+	if (!ctx || !ctx->in_timeline)
+		return;
+
+	/* let a job a failed case left behind its in fence go */
+	fence_timeline_signal(ctx->in_timeline, 1);
+	g2d_queue_destroy(ctx->queue);
+	hrtimer_cancel(&ctx->irq_timer);
+
+	for (i = 0; i < G2D_QUEUE_DEPTH; i++) {
+		if (!IS_ERR_OR_NULL(ctx->fences[i]))
+			dma_fence_put(ctx->fences[i]);
+	}
+	fence_timeline_destroy(ctx->in_timeline);
+}
+
+static struct kunit_case g2d_queue_test_cases[] = {
+	KUNIT_CASE(g2d_queue_test_order),
+	KUNIT_CASE(g2d_queue_test_full),
+	KUNIT_CASE(g2d_queue_test_run_error),
+	KUNIT_CASE(g2d_queue_test_in_fence_error),
+	{},
+};
+
+static struct kunit_suite g2d_queue_test_suite = {
+	.name = "sunxi_g2d_queue",
+	.init = g2d_queue_test_init,
+	.exit = g2d_queue_test_exit,
+	.test_cases = g2d_queue_test_cases,
+};
+
+kunit_test_suite(g2d_queue_test_suite);
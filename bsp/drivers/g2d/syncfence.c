@@ -24,6 +24,8 @@
 #include <linux/sync_file.h>
 #include <linux/miscdevice.h>
 
+#include "syncfence.h"
+
 /*
  * struct syncfence_create_data
  * @value:	the seqno to initialise the fence with
@@ -75,7 +77,7 @@ static inline struct fence_timeline *dma_fence_parent(struct dma_fence *fence)
 	return container_of(fence->lock, struct fence_timeline, lock);
 }
 
-static struct fence_timeline *fence_timeline_create(const char *name)
+struct fence_timeline *fence_timeline_create(const char *name)
 {
 	unsigned long flags;
 	struct fence_timeline *timeline;
@@ -88,6 +90,7 @@ static struct fence_timeline *fence_timeline_create(const char *name)
 	timeline->context = dma_fence_context_alloc(1);
 	strlcpy(timeline->name, name, sizeof(timeline->name));
 	INIT_LIST_HEAD(&timeline->pt_list);
+	spin_lock_init(&timeline->lock);
 
 	/* add the new timeline into timeline_list_head */
 	spin_lock_irqsave(&timeline_list_lock, flags);
@@ -116,7 +119,7 @@ static void fence_timeline_get(struct fence_timeline *timeline)
 	kref_get(&timeline->ref);
 }
 
-static void fence_timeline_put(struct fence_timeline *timeline)
+void fence_timeline_put(struct fence_timeline *timeline)
 {
 	kref_put(&timeline->ref, fence_timeline_free);
 }
@@ -181,11 +184,13 @@ static const struct dma_fence_ops timeline_fence_ops = {
 	.timeline_value_str = timeline_fence_timeline_value_str,
 };
 
-static void fence_timeline_signal(struct fence_timeline *timeline, unsigned int inc)
+/* may be called from the completion irq handler */
+void fence_timeline_signal(struct fence_timeline *timeline, unsigned int inc)
 {
+	unsigned long flags;
 	struct syncfence *pt, *next;
 
-	spin_lock_irq(&timeline->lock);
+	spin_lock_irqsave(&timeline->lock, flags);
 
 	timeline->value += inc;
 
@@ -197,7 +202,7 @@ static void fence_timeline_signal(struct fence_timeline *timeline, unsigned int
 		dma_fence_signal_locked(&pt->base);
 	}
 
-	spin_unlock_irq(&timeline->lock);
+	spin_unlock_irqrestore(&timeline->lock, flags);
 }
 
 static struct syncfence *syncfence_create(struct fence_timeline *timeline,
@@ -224,6 +229,31 @@ static struct syncfence *syncfence_create(struct fence_timeline *timeline,
 	return fence;
 }
 
+struct dma_fence *fence_timeline_create_fence(struct fence_timeline *timeline,
+		unsigned int value)
+{
+	struct syncfence *fence = syncfence_create(timeline, value);
+
+	return fence ? &fence->base : NULL;
+}
+
+/* signal all pending fences with -ENOENT and drop the timeline */
+void fence_timeline_destroy(struct fence_timeline *timeline)
+{
+	struct syncfence *fence, *next;
+
+	spin_lock_irq(&timeline->lock);
+
+	list_for_each_entry_safe(fence, next, &timeline->pt_list, link) {
+		dma_fence_set_error(&fence->base, -ENOENT);
+		dma_fence_signal_locked(&fence->base);
+	}
+
+	spin_unlock_irq(&timeline->lock);
+
+	fence_timeline_put(timeline);
+}
+
 static int syncfence_open(struct inode *inode, struct file *file)
 {
 	struct fence_timeline *timeline;
@@ -241,18 +271,8 @@ static int syncfence_open(struct inode *inode, struct file *file)
 static int syncfence_release(struct inode *inode, struct file *file)
 {
 	struct fence_timeline *timeline = file->private_data;
-	struct syncfence *fence, *next;
-
-	spin_lock_irq(&timeline->lock);
 
-	list_for_each_entry_safe(fence, next, &timeline->pt_list, link) {
-		dma_fence_set_error(&fence->base, -ENOENT);
-		dma_fence_signal_locked(&fence->base);
-	}
-
-	spin_unlock_irq(&timeline->lock);
-
-	fence_timeline_put(timeline);
+	fence_timeline_destroy(timeline);
 	return 0;
 }
 
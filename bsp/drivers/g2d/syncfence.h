@@ -0,0 +1,29 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright(c) 2020 - 2023 Allwinner Technology Co.,Ltd. All rights reserved. */
+/*
+ * Allwinner SoCs display driver.
+ *
+ * Copyright (C) 2018 Allwinner.
+ *
+ * This file is licensed under the terms of the GNU General Public
+ * License version 2.  This program is licensed "as is" without any
+ * warranty of any kind, whether express or implied.
+ */
+#ifndef __G2D_SYNCFENCE_H__
+#define __G2D_SYNCFENCE_H__
+
+#include <linux/dma-fence.h>
+
+struct fence_timeline;
+
+struct fence_timeline *fence_timeline_create(const char *name);
+void fence_timeline_put(struct fence_timeline *timeline);
+void fence_timeline_destroy(struct fence_timeline *timeline);
+void fence_timeline_signal(struct fence_timeline *timeline, unsigned int inc);
+struct dma_fence *fence_timeline_create_fence(struct fence_timeline *timeline,
+		unsigned int value);
+
+int syncfence_init(void);
+void syncfence_exit(void);
+
+#endif /* __G2D_SYNCFENCE_H__ */
@@ -38,6 +38,18 @@
 #include <linux/of_net.h>
 #include <linux/of_mdio.h>
 #include <linux/version.h>
+#include <linux/bpf.h>
+#include <linux/bpf_trace.h>
+#include <linux/filter.h>
+#include <net/xdp.h>
+#include <net/tso.h>
+#include <linux/dim.h>
+#include <linux/hrtimer.h>
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 6, 0)
+#include <net/page_pool/helpers.h>
+#else
+#include <net/page_pool.h>
+#endif
 #include <sunxi-sid.h>
 #if IS_ENABLED(CONFIG_AW_EPHY)
 #include <linux/pwm.h>
@@ -57,14 +69,44 @@
 
 #define SUNXI_GMAC_DMA_DESC_RX		256
 #define SUNXI_GMAC_DMA_DESC_TX		256
-#define SUNXI_GMAC_BUDGET		(sunxi_gmac_dma_desc_rx / 4)
-#define SUNXI_GMAC_TX_THRESH		(sunxi_gmac_dma_desc_tx / 4)
+#define SUNXI_GMAC_DMA_DESC_MIN		64
+#define SUNXI_GMAC_DMA_DESC_MAX		4096
+#define SUNXI_GMAC_BUDGET(chip)		((chip)->dma_desc_rx / 4)
+#define SUNXI_GMAC_TX_THRESH(chip)	((chip)->dma_desc_tx / 4)
+/*
+ * Software tso takes a header and a payload descriptor per segment, plus
+ * one more per frag boundary. The queue is stopped while the ring cannot
+ * take that much.
+ */
+#define SUNXI_GMAC_TSO_MAX_SEGS		16
+#define SUNXI_GMAC_TX_MAX_DESCS		(SUNXI_GMAC_TSO_MAX_SEGS * 2 + MAX_SKB_FRAGS + 1)
+#define SUNXI_GMAC_TX_WAKE_THRESH(chip)	max_t(int, SUNXI_GMAC_TX_THRESH(chip), SUNXI_GMAC_TX_MAX_DESCS)
+
+/*
+ * The mac has no rx watchdog, interrupts are coalesced in software: the
+ * irq stays masked for rx-usecs after napi is done, tx only asks for an
+ * irq every tx-frames packets and a timer reaps the rest after tx-usecs.
+ */
+#define SUNXI_GMAC_COAL_USECS_MAX	10000
+#define SUNXI_GMAC_COAL_FRAMES_MAX	256
+#define SUNXI_GMAC_TX_COAL_USECS	1000
 
 #define SUNXI_GMAC_HASH_TABLE_SIZE	64
 #define SUNXI_GMAC_MAX_BUF_SZ		(SZ_2K - 1)
+/* Rx buffers are page_pool pages, an skb is built around the page in place */
+#define SUNXI_GMAC_RX_HEADROOM		(XDP_PACKET_HEADROOM + NET_IP_ALIGN)
+#define SUNXI_GMAC_RX_BUF_SZ		min_t(unsigned int, SUNXI_GMAC_MAX_BUF_SZ, \
+					      SKB_WITH_OVERHEAD(PAGE_SIZE) - \
+					      SUNXI_GMAC_RX_HEADROOM)
 /* Under the premise that each descriptor currently transmits 2k data, jumbo frame max is 8100 */
 #define SUNXI_GMAC_MAX_MTU_SZ		8100
 
+/* Verdicts of the rx xdp program, as seen by the rx ring */
+#define SUNXI_GMAC_XDP_PASS		0
+#define SUNXI_GMAC_XDP_CONSUMED		BIT(0)
+#define SUNXI_GMAC_XDP_TX		BIT(1)
+#define SUNXI_GMAC_XDP_REDIRECT		BIT(2)
+
 /* SUNXI_GMAC_FRAME_FILTER  register value */
 #define SUNXI_GMAC_FRAME_FILTER_PR	0x80000000	/* Promiscuous Mode */
 #define SUNXI_GMAC_FRAME_FILTER_HUC	0x00000100	/* Hash Unicast */
@@ -452,6 +494,12 @@ struct sunxi_gmac_extra_stats {
 	unsigned long poll_n;
 	unsigned long sched_timer_n;
 	unsigned long normal_irq_n;
+
+	/* XDP verdicts */
+	unsigned long xdp_pass;
+	unsigned long xdp_drop;
+	unsigned long xdp_tx;
+	unsigned long xdp_redirect;
 };
 
 struct sunxi_gmac;
@@ -463,9 +511,27 @@ struct sunxi_gmac_ephy_ops {
 	void (*hardware_deinit)(struct sunxi_gmac *chip);
 };
 
+struct sunxi_gmac_rx_buf {
+	struct page *page;
+};
+
+enum sunxi_gmac_tx_map {
+	SUNXI_GMAC_TX_MAP_NONE = 0,	/* tso header, or XDP_TX page mapped by the pool */
+	SUNXI_GMAC_TX_MAP_SINGLE,
+	SUNXI_GMAC_TX_MAP_PAGE,
+};
+
+struct sunxi_gmac_tx_buf {
+	struct xdp_frame *xdpf;
+	enum sunxi_gmac_tx_map map;
+};
+
 struct sunxi_gmac {
 	struct sunxi_gmac_dma_desc *dma_tx;	/* Tx dma descriptor */
-	struct sk_buff **tx_skb;		/* Tx socket buffer array */
+	struct sk_buff **tx_skb;		/* Tx socket buffer array, at the last desc */
+	struct sunxi_gmac_tx_buf *tx_buf;	/* Tx mapping and xdp frame array */
+	char *tso_hdrs;				/* Tx tso headers, one per desc */
+	dma_addr_t tso_hdrs_phy;
 	unsigned int tx_clean;			/* Tx ring buffer data consumer */
 	unsigned int tx_dirty;			/* Tx ring buffer data provider */
 	dma_addr_t dma_tx_phy;			/* Tx dma physical address */
@@ -473,7 +539,23 @@ struct sunxi_gmac {
 	unsigned long buf_sz;			/* Size of buffer specified by current descriptor */
 
 	struct sunxi_gmac_dma_desc *dma_rx;	/* Rx dma descriptor */
-	struct sk_buff **rx_skb;			/* Rx socket buffer array */
+	int dma_desc_rx;			/* Rx ring size, a power of 2 */
+	int dma_desc_tx;			/* Tx ring size, a power of 2 */
+	struct sunxi_gmac_rx_buf *rx_buf;	/* Rx page array */
+	struct page_pool *page_pool;		/* Rx page recycling */
+	struct xdp_rxq_info xdp_rxq;
+	struct bpf_prog *xdp_prog;
+
+	/* interrupt coalescing */
+	u32 rx_coal_usecs;
+	u32 tx_coal_usecs;
+	u32 tx_coal_frames;
+	u32 tx_coal_count;			/* packets since the last tx irq */
+	struct hrtimer rx_coal_timer;
+	struct hrtimer tx_coal_timer;
+	bool rx_dim_enabled;
+	struct dim rx_dim;
+	u16 rx_dim_events;
 	unsigned int rx_clean;			/* Rx ring buffer data consumer */
 	unsigned int rx_dirty;			/* Rx ring buffer data provider */
 	dma_addr_t dma_rx_phy;			/* Rx dma physical address */
@@ -543,6 +625,7 @@ struct sunxi_gmac {
 #endif
 
 	struct sk_buff *skb;	/* for jumbo frame */
+	unsigned int rx_offset;	/* bytes of the jumbo frame received so far */
 
 	u32 irq_affinity;
 };
@@ -844,7 +927,8 @@ static int sunxi_gmac_dma_init(void *iobase)
 	writel(value, iobase + SUNXI_GMAC_BASIC_CTL1);
 
 	/* Mask interrupts by writing to CSR7 */
-	writel(SUNXI_GMAC_RX_INT | SUNXI_GMAC_TX_UNF_INT, iobase + SUNXI_GMAC_INT_EN);
+	writel(SUNXI_GMAC_RX_INT | SUNXI_GMAC_TX_INT | SUNXI_GMAC_TX_UNF_INT,
+	       iobase + SUNXI_GMAC_INT_EN);
 
 	return 0;
 }
@@ -978,7 +1062,8 @@ static void sunxi_gmac_tx_poll(void *iobase)
 
 static void sunxi_gmac_irq_enable(void *iobase)
 {
-	writel(SUNXI_GMAC_RX_INT | SUNXI_GMAC_TX_UNF_INT, iobase + SUNXI_GMAC_INT_EN);
+	writel(SUNXI_GMAC_RX_INT | SUNXI_GMAC_TX_INT | SUNXI_GMAC_TX_UNF_INT,
+	       iobase + SUNXI_GMAC_INT_EN);
 }
 
 static void sunxi_gmac_irq_disable(void *iobase)
@@ -1200,7 +1285,9 @@ static ssize_t sunxi_gmac_extra_rx_stats_show(struct device *dev,
 			"rx_gmac_overflow: %lu\nrx_watchdog: %lu\n"
 			"da_rx_filter_fail: %lu\nsa_rx_filter_fail: %lu\n"
 			"rx_missed_cntr: %lu\nrx_overflow_cntr: %lu\n"
-			"rx_vlan: %lu\n\n",
+			"rx_vlan: %lu\n"
+			"xdp_pass: %lu\nxdp_drop: %lu\n"
+			"xdp_tx: %lu\nxdp_redirect: %lu\n\n",
 			chip->xstats.rx_desc, chip->xstats.sa_filter_fail,
 			chip->xstats.overflow_error, chip->xstats.ipc_csum_error,
 			chip->xstats.rx_collision, chip->xstats.rx_crc,
@@ -1209,7 +1296,9 @@ static ssize_t sunxi_gmac_extra_rx_stats_show(struct device *dev,
 			chip->xstats.rx_gmac_overflow, chip->xstats.rx_length,
 			chip->xstats.da_rx_filter_fail, chip->xstats.sa_rx_filter_fail,
 			chip->xstats.rx_missed_cntr, chip->xstats.rx_overflow_cntr,
-			chip->xstats.rx_vlan);
+			chip->xstats.rx_vlan,
+			chip->xstats.xdp_pass, chip->xstats.xdp_drop,
+			chip->xstats.xdp_tx, chip->xstats.xdp_redirect);
 }
 /* eg: cat extra_rx_stats */
 static DEVICE_ATTR(extra_rx_stats, 0444, sunxi_gmac_extra_rx_stats_show, NULL);
@@ -1573,24 +1662,23 @@ static void sunxi_gmac_rx_refill(struct net_device *ndev)
 {
 	struct sunxi_gmac *chip = netdev_priv(ndev);
 	struct sunxi_gmac_dma_desc *desc;
-	struct sk_buff *skb = NULL;
+	struct page *page;
 	dma_addr_t dma_addr;
 
-	while (circ_space(chip->rx_clean, chip->rx_dirty, sunxi_gmac_dma_desc_rx) > 0) {
+	while (circ_space(chip->rx_clean, chip->rx_dirty, chip->dma_desc_rx) > 0) {
 		int entry = chip->rx_clean;
 
 		/* Find the dirty's desc and clean it */
 		desc = chip->dma_rx + entry;
 
-		if (chip->rx_skb[entry] == NULL) {
-			skb = netdev_alloc_skb_ip_align(ndev, chip->buf_sz);
-
-			if (unlikely(skb == NULL))
+		if (chip->rx_buf[entry].page == NULL) {
+			/* pages come back mapped and synced for the device */
+			page = page_pool_dev_alloc_pages(chip->page_pool);
+			if (unlikely(page == NULL))
 				break;
 
-			chip->rx_skb[entry] = skb;
-			dma_addr = dma_map_single(chip->dev, skb->data,
-							chip->buf_sz, DMA_FROM_DEVICE);
+			chip->rx_buf[entry].page = page;
+			dma_addr = page_pool_get_dma_addr(page) + SUNXI_GMAC_RX_HEADROOM;
 
 			trace_sunxi_gmac_rx_desc(chip->rx_dirty, chip->tx_dirty, dma_addr,
 					chip->ndev->name);
@@ -1600,7 +1688,7 @@ static void sunxi_gmac_rx_refill(struct net_device *ndev)
 
 		dma_wmb();
 		sunxi_gmac_desc_set_own(desc);
-		chip->rx_clean = circ_inc(chip->rx_clean, sunxi_gmac_dma_desc_rx);
+		chip->rx_clean = circ_inc(chip->rx_clean, chip->dma_desc_rx);
 	}
 }
 
@@ -1613,23 +1701,29 @@ static void sunxi_gmac_rx_refill(struct net_device *ndev)
 static int sunxi_gmac_dma_desc_init(struct net_device *ndev)
 {
 	struct sunxi_gmac *chip = netdev_priv(ndev);
-	struct device *dev = &ndev->dev;
 
-	chip->rx_skb = devm_kzalloc(dev, sizeof(chip->rx_skb[0]) * sunxi_gmac_dma_desc_rx,
+	/* plain allocations, the rings are freed and rebuilt on a ring resize */
+	chip->rx_buf = kzalloc(sizeof(chip->rx_buf[0]) * chip->dma_desc_rx,
 				GFP_KERNEL);
-	if (!chip->rx_skb) {
-		netdev_err(ndev, "Error: Alloc rx_skb failed\n");
+	if (!chip->rx_buf) {
+		netdev_err(ndev, "Error: Alloc rx_buf failed\n");
 		goto rx_skb_err;
 	}
-	chip->tx_skb = devm_kzalloc(dev, sizeof(chip->tx_skb[0]) * sunxi_gmac_dma_desc_tx,
+	chip->tx_skb = kzalloc(sizeof(chip->tx_skb[0]) * chip->dma_desc_tx,
 				GFP_KERNEL);
 	if (!chip->tx_skb) {
 		netdev_err(ndev, "Error: Alloc tx_skb failed\n");
 		goto tx_skb_err;
 	}
+	chip->tx_buf = kzalloc(sizeof(chip->tx_buf[0]) * chip->dma_desc_tx,
+				GFP_KERNEL);
+	if (!chip->tx_buf) {
+		netdev_err(ndev, "Error: Alloc tx_buf failed\n");
+		goto tx_buf_err;
+	}
 
 	chip->dma_tx = dma_alloc_coherent(chip->dev,
-					sunxi_gmac_dma_desc_tx *
+					chip->dma_desc_tx *
 					sizeof(struct sunxi_gmac_dma_desc),
 					&chip->dma_tx_phy,
 					GFP_KERNEL);
@@ -1639,7 +1733,7 @@ static int sunxi_gmac_dma_desc_init(struct net_device *ndev)
 	}
 
 	chip->dma_rx = dma_alloc_coherent(chip->dev,
-					sunxi_gmac_dma_desc_rx *
+					chip->dma_desc_rx *
 					sizeof(struct sunxi_gmac_dma_desc),
 					&chip->dma_rx_phy,
 					GFP_KERNEL);
@@ -1648,66 +1742,152 @@ static int sunxi_gmac_dma_desc_init(struct net_device *ndev)
 		goto dma_rx_err;
 	}
 
-	/* Set the size of buffer depend on the MTU & max buf size */
-	chip->buf_sz = SUNXI_GMAC_MAX_BUF_SZ;
+	chip->tso_hdrs = dma_alloc_coherent(chip->dev,
+					chip->dma_desc_tx * TSO_HEADER_SIZE,
+					&chip->tso_hdrs_phy,
+					GFP_KERNEL);
+	if (!chip->tso_hdrs) {
+		netdev_err(ndev, "Error: Alloc tso_hdrs failed\n");
+		goto tso_hdrs_err;
+	}
+
+	/* Set the size of buffer depend on the page & max buf size */
+	chip->buf_sz = SUNXI_GMAC_RX_BUF_SZ;
 	return 0;
 
+tso_hdrs_err:
+	dma_free_coherent(chip->dev, chip->dma_desc_rx * sizeof(struct sunxi_gmac_dma_desc),
+			  chip->dma_rx, chip->dma_rx_phy);
 dma_rx_err:
-	dma_free_coherent(chip->dev, sunxi_gmac_dma_desc_rx * sizeof(struct sunxi_gmac_dma_desc),
+	dma_free_coherent(chip->dev, chip->dma_desc_tx * sizeof(struct sunxi_gmac_dma_desc),
 			  chip->dma_tx, chip->dma_tx_phy);
 dma_tx_err:
+	kfree(chip->tx_buf);
+tx_buf_err:
 	kfree(chip->tx_skb);
 tx_skb_err:
-	kfree(chip->rx_skb);
+	kfree(chip->rx_buf);
 rx_skb_err:
 	return -ENOMEM;
 }
 
+static int sunxi_gmac_page_pool_create(struct sunxi_gmac *chip)
+{
+	struct page_pool_params pp_params = {
+		.flags		= PP_FLAG_DMA_MAP | PP_FLAG_DMA_SYNC_DEV,
+		.order		= 0,
+		.pool_size	= chip->dma_desc_rx,
+		.nid		= dev_to_node(chip->dev),
+		.dev		= chip->dev,
+		/* XDP_TX sends the rx page back out as it is */
+		.dma_dir	= chip->xdp_prog ? DMA_BIDIRECTIONAL : DMA_FROM_DEVICE,
+		.offset		= SUNXI_GMAC_RX_HEADROOM,
+		.max_len	= chip->buf_sz,
+	};
+	int ret;
+
+	chip->page_pool = page_pool_create(&pp_params);
+	if (IS_ERR(chip->page_pool)) {
+		ret = PTR_ERR(chip->page_pool);
+		chip->page_pool = NULL;
+		return ret;
+	}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 11, 0)
+	ret = xdp_rxq_info_reg(&chip->xdp_rxq, chip->ndev, 0, chip->napi.napi_id);
+#else
+	ret = xdp_rxq_info_reg(&chip->xdp_rxq, chip->ndev, 0);
+#endif
+	if (ret)
+		goto rxq_err;
+
+	ret = xdp_rxq_info_reg_mem_model(&chip->xdp_rxq, MEM_TYPE_PAGE_POOL,
+					 chip->page_pool);
+	if (ret) {
+		xdp_rxq_info_unreg(&chip->xdp_rxq);
+		goto rxq_err;
+	}
+
+	return 0;
+
+rxq_err:
+	page_pool_destroy(chip->page_pool);
+	chip->page_pool = NULL;
+	return ret;
+}
+
 static void sunxi_gmac_free_rx_skb(struct sunxi_gmac *chip)
 {
 	int i;
 
-	for (i = 0; i < sunxi_gmac_dma_desc_rx; i++) {
-		if (chip->rx_skb[i] != NULL) {
-			struct sunxi_gmac_dma_desc *desc = chip->dma_rx + i;
+	if (chip->skb) {
+		dev_kfree_skb_any(chip->skb);
+		chip->skb = NULL;
+	}
+	chip->rx_offset = 0;
 
-			dma_unmap_single(chip->dev, (u32)sunxi_gmac_desc_buf_get_addr(desc),
-					 sunxi_gmac_desc_buf_get_len(desc),
-					 DMA_FROM_DEVICE);
-			dev_kfree_skb_any(chip->rx_skb[i]);
-			chip->rx_skb[i] = NULL;
+	for (i = 0; i < chip->dma_desc_rx; i++) {
+		if (chip->rx_buf[i].page != NULL) {
+			page_pool_put_full_page(chip->page_pool, chip->rx_buf[i].page, false);
+			chip->rx_buf[i].page = NULL;
 		}
 	}
+
+	if (xdp_rxq_info_is_reg(&chip->xdp_rxq))
+		xdp_rxq_info_unreg(&chip->xdp_rxq);
+	page_pool_destroy(chip->page_pool);
+	chip->page_pool = NULL;
+}
+
+/* Undo the mapping of one tx desc and give back its xdp frame */
+static void sunxi_gmac_tx_unmap(struct sunxi_gmac *chip, unsigned int entry)
+{
+	struct sunxi_gmac_tx_buf *tx_buf = chip->tx_buf + entry;
+	struct sunxi_gmac_dma_desc *desc = chip->dma_tx + entry;
+
+	if (tx_buf->map == SUNXI_GMAC_TX_MAP_SINGLE)
+		dma_unmap_single(chip->dev, (u32)sunxi_gmac_desc_buf_get_addr(desc),
+				 sunxi_gmac_desc_buf_get_len(desc), DMA_TO_DEVICE);
+	else if (tx_buf->map == SUNXI_GMAC_TX_MAP_PAGE)
+		dma_unmap_page(chip->dev, (u32)sunxi_gmac_desc_buf_get_addr(desc),
+			       sunxi_gmac_desc_buf_get_len(desc), DMA_TO_DEVICE);
+	tx_buf->map = SUNXI_GMAC_TX_MAP_NONE;
+
+	if (tx_buf->xdpf) {
+		xdp_return_frame(tx_buf->xdpf);
+		tx_buf->xdpf = NULL;
+	}
 }
 
 static void sunxi_gmac_free_tx_skb(struct sunxi_gmac *chip)
 {
 	int i;
 
-	for (i = 0; i < sunxi_gmac_dma_desc_tx; i++) {
-		if (chip->tx_skb[i] != NULL) {
-			struct sunxi_gmac_dma_desc *desc = chip->dma_tx + i;
+	for (i = 0; i < chip->dma_desc_tx; i++) {
+		sunxi_gmac_tx_unmap(chip, i);
 
-			if (sunxi_gmac_desc_buf_get_addr(desc))
-				dma_unmap_single(chip->dev, (u32)sunxi_gmac_desc_buf_get_addr(desc),
-						 sunxi_gmac_desc_buf_get_len(desc),
-						 DMA_TO_DEVICE);
+		if (chip->tx_skb[i] != NULL) {
 			dev_kfree_skb_any(chip->tx_skb[i]);
 			chip->tx_skb[i] = NULL;
 		}
 	}
+
+	netdev_reset_queue(chip->ndev);
 }
 
 static void sunxi_gmac_dma_desc_deinit(struct sunxi_gmac *chip)
 {
 	/* Free the region of consistent memory previously allocated for the DMA */
-	dma_free_coherent(chip->dev, sunxi_gmac_dma_desc_tx * sizeof(struct sunxi_gmac_dma_desc),
+	dma_free_coherent(chip->dev, chip->dma_desc_tx * sizeof(struct sunxi_gmac_dma_desc),
 			  chip->dma_tx, chip->dma_tx_phy);
-	dma_free_coherent(chip->dev, sunxi_gmac_dma_desc_rx * sizeof(struct sunxi_gmac_dma_desc),
+	dma_free_coherent(chip->dev, chip->dma_desc_rx * sizeof(struct sunxi_gmac_dma_desc),
 			  chip->dma_rx, chip->dma_rx_phy);
+	dma_free_coherent(chip->dev, chip->dma_desc_tx * TSO_HEADER_SIZE,
+			  chip->tso_hdrs, chip->tso_hdrs_phy);
 
-	kfree(chip->rx_skb);
+	kfree(chip->rx_buf);
 	kfree(chip->tx_skb);
+	kfree(chip->tx_buf);
 }
 
 static int sunxi_gmac_stop(struct net_device *ndev)
@@ -1716,6 +1896,9 @@ static int sunxi_gmac_stop(struct net_device *ndev)
 
 	netif_stop_queue(ndev);
 	napi_disable(&chip->napi);
+	hrtimer_cancel(&chip->rx_coal_timer);
+	hrtimer_cancel(&chip->tx_coal_timer);
+	cancel_work_sync(&chip->rx_dim.work);
 
 	netif_carrier_off(ndev);
 
@@ -1816,16 +1999,23 @@ static int sunxi_gmac_open(struct net_device *ndev)
 	sunxi_gmac_init(chip->base, txmode, rxmode);
 	sunxi_gmac_set_mac_addr_to_reg(chip->base, (unsigned char *)ndev->dev_addr, 0);
 
-	memset(chip->dma_tx, 0, sunxi_gmac_dma_desc_tx * sizeof(struct sunxi_gmac_dma_desc));
-	memset(chip->dma_rx, 0, sunxi_gmac_dma_desc_rx * sizeof(struct sunxi_gmac_dma_desc));
+	memset(chip->dma_tx, 0, chip->dma_desc_tx * sizeof(struct sunxi_gmac_dma_desc));
+	memset(chip->dma_rx, 0, chip->dma_desc_rx * sizeof(struct sunxi_gmac_dma_desc));
 
-	sunxi_gmac_desc_init_chain(chip->dma_rx, (unsigned long)chip->dma_rx_phy, sunxi_gmac_dma_desc_rx);
-	sunxi_gmac_desc_init_chain(chip->dma_tx, (unsigned long)chip->dma_tx_phy, sunxi_gmac_dma_desc_tx);
+	sunxi_gmac_desc_init_chain(chip->dma_rx, (unsigned long)chip->dma_rx_phy, chip->dma_desc_rx);
+	sunxi_gmac_desc_init_chain(chip->dma_tx, (unsigned long)chip->dma_tx_phy, chip->dma_desc_tx);
 
 	chip->rx_clean = 0;
 	chip->rx_dirty = 0;
 	chip->tx_clean = 0;
 	chip->tx_dirty = 0;
+	chip->tx_coal_count = 0;
+
+	ret = sunxi_gmac_page_pool_create(chip);
+	if (ret) {
+		netdev_err(ndev, "Error: Create rx page pool failed\n");
+		goto mac_reset_err;
+	}
 	sunxi_gmac_rx_refill(ndev);
 
 	/* Extra statistics */
@@ -2065,8 +2255,8 @@ static void sunxi_gmac_tx_err(struct sunxi_gmac *chip)
 	sunxi_gmac_disable_tx(chip->base);
 
 	sunxi_gmac_free_tx_skb(chip);
-	memset(chip->dma_tx, 0, sunxi_gmac_dma_desc_tx * sizeof(struct sunxi_gmac_dma_desc));
-	sunxi_gmac_desc_init_chain(chip->dma_tx, (unsigned long)chip->dma_tx_phy, sunxi_gmac_dma_desc_tx);
+	memset(chip->dma_tx, 0, chip->dma_desc_tx * sizeof(struct sunxi_gmac_dma_desc));
+	sunxi_gmac_desc_init_chain(chip->dma_tx, (unsigned long)chip->dma_tx_phy, chip->dma_desc_tx);
 	chip->tx_dirty = 0;
 	chip->tx_clean = 0;
 	sunxi_gmac_enable_tx(chip->base, chip->dma_tx_phy);
@@ -2103,15 +2293,30 @@ static irqreturn_t sunxi_gmac_interrupt(int irq, void *dev_id)
 	return IRQ_HANDLED;
 }
 
-static void sunxi_gmac_tx_complete(struct sunxi_gmac *chip)
+/*
+ * Reap the tx ring after tx-usecs even if no tx irq comes, the packets
+ * coalesced without one would sit there otherwise.
+ */
+static void sunxi_gmac_tx_coal_arm(struct sunxi_gmac *chip)
+{
+	u32 usecs = chip->tx_coal_usecs ?: SUNXI_GMAC_TX_COAL_USECS;
+
+	if (!hrtimer_active(&chip->tx_coal_timer))
+		hrtimer_start(&chip->tx_coal_timer,
+			      ns_to_ktime(usecs * NSEC_PER_USEC),
+			      HRTIMER_MODE_REL);
+}
+
+static void sunxi_gmac_tx_complete(struct sunxi_gmac *chip, int budget)
 {
 	unsigned int entry = 0;
+	unsigned int pkts_compl = 0, bytes_compl = 0;
 	struct sk_buff *skb = NULL;
 	struct sunxi_gmac_dma_desc *desc = NULL;
 	int tx_stat;
 
 	spin_lock_bh(&chip->tx_lock);
-	while (circ_cnt(chip->tx_dirty, chip->tx_clean, sunxi_gmac_dma_desc_tx) > 0) {
+	while (circ_cnt(chip->tx_dirty, chip->tx_clean, chip->dma_desc_tx) > 0) {
 		entry = chip->tx_clean;
 		desc = chip->dma_tx + entry;
 
@@ -2127,150 +2332,421 @@ static void sunxi_gmac_tx_complete(struct sunxi_gmac *chip)
 			 * These stats will be parsed by net framework layer
 			 * use ifconfig -a in linux cmdline to view
 			 */
-			if (likely(!tx_stat))
+			if (likely(!tx_stat)) {
 				chip->ndev->stats.tx_packets++;
-			else
+				/* skbs count their bytes in xmit, for BQL */
+				if (chip->tx_buf[entry].xdpf)
+					chip->ndev->stats.tx_bytes +=
+						chip->tx_buf[entry].xdpf->len;
+			} else {
 				chip->ndev->stats.tx_errors++;
+			}
 		}
 
-		dma_unmap_single(chip->dev, (u32)sunxi_gmac_desc_buf_get_addr(desc),
-				 sunxi_gmac_desc_buf_get_len(desc), DMA_TO_DEVICE);
+		sunxi_gmac_tx_unmap(chip, entry);
 
 		skb = chip->tx_skb[entry];
 		chip->tx_skb[entry] = NULL;
 		sunxi_gmac_desc_init(desc);
 
 		/* Find next dirty desc */
-		chip->tx_clean = circ_inc(entry, sunxi_gmac_dma_desc_tx);
+		chip->tx_clean = circ_inc(entry, chip->dma_desc_tx);
 
 		if (unlikely(skb == NULL))
 			continue;
 
-		dev_kfree_skb(skb);
+		/* freed in bulk when called from napi */
+		pkts_compl++;
+		bytes_compl += skb->len;
+		napi_consume_skb(skb, budget);
 	}
 
+	netdev_completed_queue(chip->ndev, pkts_compl, bytes_compl);
+
+	if (circ_cnt(chip->tx_dirty, chip->tx_clean, chip->dma_desc_tx) > 0)
+		sunxi_gmac_tx_coal_arm(chip);
+
 	if (unlikely(netif_queue_stopped(chip->ndev)) &&
-		circ_space(chip->tx_dirty, chip->tx_clean, sunxi_gmac_dma_desc_tx) >
-		SUNXI_GMAC_TX_THRESH) {
+		circ_space(chip->tx_dirty, chip->tx_clean, chip->dma_desc_tx) >
+		SUNXI_GMAC_TX_WAKE_THRESH(chip)) {
 		netif_wake_queue(chip->ndev);
 	}
 	spin_unlock_bh(&chip->tx_lock);
 }
 
-static netdev_tx_t sunxi_gmac_xmit(struct sk_buff *skb, struct net_device *ndev)
+/* Point one tx desc at a buffer, its own bit is set once the whole skb is queued */
+static struct sunxi_gmac_dma_desc *sunxi_gmac_tx_desc_fill(struct sunxi_gmac *chip,
+		unsigned int entry, dma_addr_t dma_addr, unsigned int len,
+		enum sunxi_gmac_tx_map map)
 {
-	struct sunxi_gmac *chip = netdev_priv(ndev);
-	struct sunxi_gmac_dma_desc *desc, *first;
-	unsigned int entry, len, tmp_len = 0;
-	unsigned char *data_addr = skb->data;
-	int i, csum_insert;
-	int nfrags = skb_shinfo(skb)->nr_frags;
-	dma_addr_t dma_addr;
+	struct sunxi_gmac_dma_desc *desc = chip->dma_tx + entry;
 
-	spin_lock_bh(&chip->tx_lock);
-	if (unlikely(circ_space(chip->tx_dirty, chip->tx_clean,
-		sunxi_gmac_dma_desc_tx) < (nfrags + 1))) {
-		if (!netif_queue_stopped(ndev)) {
-			netdev_err(ndev, "Error: Tx Ring full when queue awake\n");
-			netif_stop_queue(ndev);
-		}
-		spin_unlock_bh(&chip->tx_lock);
+	trace_sunxi_gmac_tx_desc(chip->tx_clean, entry, dma_addr, chip->ndev->name);
 
-		return NETDEV_TX_BUSY;
+	sunxi_gmac_desc_buf_set(desc, dma_addr, len);
+	chip->tx_buf[entry].map = map;
+
+	return desc;
+}
+
+/* Unmap the descs from @first up to @end after a mapping error */
+static void sunxi_gmac_tx_unwind(struct sunxi_gmac *chip, unsigned int first,
+				 unsigned int end)
+{
+	for (; first != end; first = circ_inc(first, chip->dma_desc_tx)) {
+		sunxi_gmac_tx_unmap(chip, first);
+		sunxi_gmac_desc_init(chip->dma_tx + first);
 	}
+}
 
-	csum_insert = (skb->ip_summed == CHECKSUM_PARTIAL);
-	entry = chip->tx_dirty;
-	first = chip->dma_tx + entry;
-	desc = chip->dma_tx + entry;
+/* Map the linear part and every frag, a desc holds at most 2K */
+static int sunxi_gmac_tx_map_skb(struct sunxi_gmac *chip, struct sk_buff *skb,
+				 unsigned int *entry)
+{
+	struct sunxi_gmac_dma_desc *first, *desc;
+	unsigned int len, off, tmp_len;
+	dma_addr_t dma_addr;
+	int i;
+
+	first = chip->dma_tx + *entry;
+	desc = first;
 
 	len = skb_headlen(skb);
-	chip->tx_skb[entry] = skb;
+	for (off = 0; off < len; off += tmp_len) {
+		tmp_len = min_t(unsigned int, len - off, SUNXI_GMAC_MAX_BUF_SZ);
+		dma_addr = dma_map_single(chip->dev, skb->data + off, tmp_len, DMA_TO_DEVICE);
+		if (dma_mapping_error(chip->dev, dma_addr))
+			return -ENOMEM;
 
-	trace_sunxi_gmac_skb_dump(skb, chip->ndev->name, 1);
+		desc = sunxi_gmac_tx_desc_fill(chip, *entry, dma_addr, tmp_len,
+					       SUNXI_GMAC_TX_MAP_SINGLE);
+		*entry = circ_inc(*entry, chip->dma_desc_tx);
+	}
 
-	/* Every desc max size is 2K */
-	while (len != 0) {
-		desc = chip->dma_tx + entry;
-		tmp_len = ((len > SUNXI_GMAC_MAX_BUF_SZ) ?  SUNXI_GMAC_MAX_BUF_SZ : len);
+	for (i = 0; i < skb_shinfo(skb)->nr_frags; i++) {
+		const skb_frag_t *frag = &skb_shinfo(skb)->frags[i];
 
-		dma_addr = dma_map_single(chip->dev, data_addr, tmp_len, DMA_TO_DEVICE);
-		if (dma_mapping_error(chip->dev, dma_addr)) {
-			ndev->stats.tx_dropped++;
-			dev_kfree_skb(skb);
-			spin_unlock_bh(&chip->tx_lock);
-			return -ENOMEM;
+		len = skb_frag_size(frag);
+		for (off = 0; off < len; off += tmp_len) {
+			tmp_len = min_t(unsigned int, len - off, SUNXI_GMAC_MAX_BUF_SZ);
+			dma_addr = skb_frag_dma_map(chip->dev, frag, off, tmp_len,
+						    DMA_TO_DEVICE);
+			if (dma_mapping_error(chip->dev, dma_addr))
+				return -ENOMEM;
+
+			desc = sunxi_gmac_tx_desc_fill(chip, *entry, dma_addr, tmp_len,
+						       SUNXI_GMAC_TX_MAP_PAGE);
+			*entry = circ_inc(*entry, chip->dma_desc_tx);
 		}
+	}
 
-		trace_sunxi_gmac_tx_desc(chip->tx_clean, chip->tx_dirty, dma_addr,
-				chip->ndev->name);
+	sunxi_gmac_desc_tx_close(first, desc, skb->ip_summed == CHECKSUM_PARTIAL);
 
-		sunxi_gmac_desc_buf_set(desc, dma_addr, tmp_len);
-		/* Don't set the first's own bit, here */
-		if (first != desc) {
-			chip->tx_skb[entry] = NULL;
-			sunxi_gmac_desc_set_own(desc);
+	return 0;
+}
+
+/*
+ * Software tso: every segment gets its headers built in the tso header
+ * buffer of its first desc, the payload is mapped from the skb in place.
+ * The mac inserts the ip and tcp checksums of each segment.
+ */
+static int sunxi_gmac_tx_map_tso(struct sunxi_gmac *chip, struct sk_buff *skb,
+				 unsigned int *entry)
+{
+	struct sunxi_gmac_dma_desc *seg, *desc;
+	int hdr_len, total_len, data_left, size;
+	dma_addr_t dma_addr;
+	struct tso_t tso;
+
+	hdr_len = tso_start(skb, &tso);
+	total_len = skb->len - hdr_len;
+
+	while (total_len > 0) {
+		data_left = min_t(int, skb_shinfo(skb)->gso_size, total_len);
+		total_len -= data_left;
+
+		tso_build_hdr(skb, chip->tso_hdrs + *entry * TSO_HEADER_SIZE, &tso,
+			      data_left, total_len == 0);
+		seg = sunxi_gmac_tx_desc_fill(chip, *entry,
+					      chip->tso_hdrs_phy + *entry * TSO_HEADER_SIZE,
+					      hdr_len, SUNXI_GMAC_TX_MAP_NONE);
+		desc = seg;
+		*entry = circ_inc(*entry, chip->dma_desc_tx);
+
+		while (data_left > 0) {
+			size = min_t(int, tso.size, data_left);
+			dma_addr = dma_map_single(chip->dev, tso.data, size, DMA_TO_DEVICE);
+			if (dma_mapping_error(chip->dev, dma_addr))
+				return -ENOMEM;
+
+			desc = sunxi_gmac_tx_desc_fill(chip, *entry, dma_addr, size,
+						       SUNXI_GMAC_TX_MAP_SINGLE);
+			*entry = circ_inc(*entry, chip->dma_desc_tx);
+
+			data_left -= size;
+			tso_build_data(skb, &tso, size);
 		}
 
-		entry = circ_inc(entry, sunxi_gmac_dma_desc_tx);
-		data_addr += tmp_len;
-		len -= tmp_len;
+		/* each segment is a frame of its own for the mac */
+		sunxi_gmac_desc_tx_close(seg, desc, 1);
 	}
 
-	for (i = 0; i < nfrags; i++) {
-		const skb_frag_t *frag = &skb_shinfo(skb)->frags[i];
+	return 0;
+}
 
-		len = skb_frag_size(frag);
-		desc = chip->dma_tx + entry;
-		dma_addr = skb_frag_dma_map(chip->dev, frag, 0, len, DMA_TO_DEVICE);
-		if (dma_mapping_error(chip->dev, dma_addr)) {
-			ndev->stats.tx_dropped++;
-			dev_kfree_skb(skb);
-			spin_unlock_bh(&chip->tx_lock);
-			return -ENOMEM;
+/* Worst case number of descs the skb takes on the ring */
+static unsigned int sunxi_gmac_tx_count_descs(struct sk_buff *skb)
+{
+	unsigned int count;
+	int i;
+
+	if (skb_is_gso(skb))
+		return tso_count_descs(skb);
+
+	count = DIV_ROUND_UP(skb_headlen(skb), SUNXI_GMAC_MAX_BUF_SZ);
+	for (i = 0; i < skb_shinfo(skb)->nr_frags; i++)
+		count += DIV_ROUND_UP(skb_frag_size(&skb_shinfo(skb)->frags[i]),
+				      SUNXI_GMAC_MAX_BUF_SZ);
+
+	return count;
+}
+
+/* Only every tx_coal_frames-th packet raises an irq */
+static void sunxi_gmac_tx_coalesce(struct sunxi_gmac *chip, unsigned int first,
+				   unsigned int last)
+{
+	for (; first != last; first = circ_inc(first, chip->dma_desc_tx))
+		chip->dma_tx[first].desc1.tx.interrupt = 0;
+
+	if (++chip->tx_coal_count < chip->tx_coal_frames) {
+		chip->dma_tx[last].desc1.tx.interrupt = 0;
+	} else {
+		chip->dma_tx[last].desc1.tx.interrupt = 1;
+		chip->tx_coal_count = 0;
+	}
+}
+
+static netdev_tx_t sunxi_gmac_xmit(struct sk_buff *skb, struct net_device *ndev)
+{
+	struct sunxi_gmac *chip = netdev_priv(ndev);
+	struct sunxi_gmac_dma_desc *first;
+	unsigned int entry, first_entry, last_entry;
+	int ret;
+
+	spin_lock_bh(&chip->tx_lock);
+	if (unlikely(circ_space(chip->tx_dirty, chip->tx_clean,
+		chip->dma_desc_tx) < sunxi_gmac_tx_count_descs(skb))) {
+		if (!netif_queue_stopped(ndev)) {
+			netdev_err(ndev, "Error: Tx Ring full when queue awake\n");
+			netif_stop_queue(ndev);
 		}
+		spin_unlock_bh(&chip->tx_lock);
 
-		trace_sunxi_gmac_tx_desc(chip->tx_clean, chip->tx_dirty, dma_addr,
-				chip->ndev->name);
+		return NETDEV_TX_BUSY;
+	}
 
-		sunxi_gmac_desc_buf_set(desc, dma_addr, len);
-		sunxi_gmac_desc_set_own(desc);
-		chip->tx_skb[entry] = NULL;
-		entry = circ_inc(entry, sunxi_gmac_dma_desc_tx);
+	first_entry = chip->tx_dirty;
+	first = chip->dma_tx + first_entry;
+	entry = first_entry;
+
+	trace_sunxi_gmac_skb_dump(skb, chip->ndev->name, 1);
+
+	if (skb_is_gso(skb))
+		ret = sunxi_gmac_tx_map_tso(chip, skb, &entry);
+	else
+		ret = sunxi_gmac_tx_map_skb(chip, skb, &entry);
+	if (unlikely(ret)) {
+		sunxi_gmac_tx_unwind(chip, first_entry, entry);
+		ndev->stats.tx_dropped++;
+		dev_kfree_skb_any(skb);
+		spin_unlock_bh(&chip->tx_lock);
+		return NETDEV_TX_OK;
 	}
 
+	/* the skb is freed once its last desc is done */
+	last_entry = (entry + chip->dma_desc_tx - 1) % chip->dma_desc_tx;
+	chip->tx_skb[last_entry] = skb;
+	if (chip->tx_coal_frames > 1)
+		sunxi_gmac_tx_coalesce(chip, first_entry, last_entry);
 	ndev->stats.tx_bytes += skb->len;
-	chip->tx_dirty = entry;
-	sunxi_gmac_desc_tx_close(first, desc, csum_insert);
+	netdev_sent_queue(ndev, skb->len);
 
 	/*
 	 * When the own bit, for the first frame, has to be set, all
 	 * descriptors for the same frame has to be set before, to
 	 * avoid race condition.
 	 */
+	for (entry = circ_inc(first_entry, chip->dma_desc_tx);
+	     entry != circ_inc(last_entry, chip->dma_desc_tx);
+	     entry = circ_inc(entry, chip->dma_desc_tx))
+		sunxi_gmac_desc_set_own(chip->dma_tx + entry);
+	chip->tx_dirty = circ_inc(last_entry, chip->dma_desc_tx);
+
 	dma_wmb();
 
 	sunxi_gmac_desc_set_own(first);
-	spin_unlock_bh(&chip->tx_lock);
 
-	if (circ_space(chip->tx_dirty, chip->tx_clean, sunxi_gmac_dma_desc_tx) <=
-			(MAX_SKB_FRAGS + 1)) {
+	if (circ_space(chip->tx_dirty, chip->tx_clean, chip->dma_desc_tx) <
+			SUNXI_GMAC_TX_MAX_DESCS)
 		netif_stop_queue(ndev);
-		if (circ_space(chip->tx_dirty, chip->tx_clean, sunxi_gmac_dma_desc_tx) >
-				SUNXI_GMAC_TX_THRESH)
-			netif_wake_queue(ndev);
-	}
+	spin_unlock_bh(&chip->tx_lock);
 
 	netdev_dbg(ndev, "TX descripotor DMA: 0x%08x, dirty: %d, clean: %d\n",
 			(unsigned int)chip->dma_tx_phy, chip->tx_dirty, chip->tx_clean);
-	sunxi_gmac_dump_dma_desc(chip->dma_tx, sunxi_gmac_dma_desc_tx);
+	sunxi_gmac_dump_dma_desc(chip->dma_tx, chip->dma_desc_tx);
 
+	/* completions are reaped from napi, the tx irq or timer schedules it */
 	sunxi_gmac_tx_poll(chip->base);
-	sunxi_gmac_tx_complete(chip);
+	sunxi_gmac_tx_coal_arm(chip);
 
 	return NETDEV_TX_OK;
 }
 
+/* Queue one xdp frame on the tx ring, called with tx_lock held */
+static int sunxi_gmac_xdp_xmit_frame(struct sunxi_gmac *chip,
+				     struct xdp_frame *xdpf, bool dma_map)
+{
+	unsigned int entry = chip->tx_dirty;
+	struct sunxi_gmac_dma_desc *desc;
+	dma_addr_t dma_addr;
+
+	if (xdpf->len > SUNXI_GMAC_MAX_BUF_SZ ||
+	    circ_space(chip->tx_dirty, chip->tx_clean, chip->dma_desc_tx) < 1)
+		return -EBUSY;
+
+	if (dma_map) {
+		dma_addr = dma_map_single(chip->dev, xdpf->data, xdpf->len, DMA_TO_DEVICE);
+		if (dma_mapping_error(chip->dev, dma_addr))
+			return -ENOMEM;
+	} else {
+		/* the frame sits in its rx page, behind the xdp_frame and headroom */
+		dma_addr = page_pool_get_dma_addr(virt_to_page(xdpf->data)) +
+			   sizeof(*xdpf) + xdpf->headroom;
+		dma_sync_single_for_device(chip->dev, dma_addr, xdpf->len,
+					   DMA_BIDIRECTIONAL);
+	}
+
+	trace_sunxi_gmac_tx_desc(chip->tx_clean, chip->tx_dirty, dma_addr,
+			chip->ndev->name);
+
+	desc = chip->dma_tx + entry;
+	sunxi_gmac_desc_buf_set(desc, dma_addr, xdpf->len);
+	sunxi_gmac_desc_tx_close(desc, desc, 0);
+	chip->tx_buf[entry].xdpf = xdpf;
+	chip->tx_buf[entry].map = dma_map ? SUNXI_GMAC_TX_MAP_SINGLE : SUNXI_GMAC_TX_MAP_NONE;
+	chip->tx_dirty = circ_inc(entry, chip->dma_desc_tx);
+
+	dma_wmb();
+	sunxi_gmac_desc_set_own(desc);
+
+	return 0;
+}
+
+static int sunxi_gmac_xdp_xmit(struct net_device *ndev, int n,
+			       struct xdp_frame **frames, u32 flags)
+{
+	struct sunxi_gmac *chip = netdev_priv(ndev);
+	int i, nxmit = 0;
+
+	if (unlikely(!netif_running(ndev) || !netif_carrier_ok(ndev)))
+		return -ENETDOWN;
+
+	if (unlikely(flags & ~XDP_XMIT_FLAGS_MASK))
+		return -EINVAL;
+
+	spin_lock_bh(&chip->tx_lock);
+	for (i = 0; i < n; i++) {
+		if (sunxi_gmac_xdp_xmit_frame(chip, frames[i], true)) {
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5, 13, 0)
+			/* the caller only frees the frames we did not take since 5.13 */
+			xdp_return_frame_rx_napi(frames[i]);
+			continue;
+#else
+			break;
+#endif
+		}
+		nxmit++;
+	}
+	spin_unlock_bh(&chip->tx_lock);
+
+	if (nxmit)
+		sunxi_gmac_tx_poll(chip->base);
+
+	return nxmit;
+}
+
+static int sunxi_gmac_xdp_tx_back(struct sunxi_gmac *chip, struct xdp_buff *xdp)
+{
+	struct xdp_frame *xdpf = xdp_convert_buff_to_frame(xdp);
+	int ret;
+
+	if (unlikely(!xdpf))
+		return -EOVERFLOW;
+
+	spin_lock(&chip->tx_lock);
+	ret = sunxi_gmac_xdp_xmit_frame(chip, xdpf, false);
+	spin_unlock(&chip->tx_lock);
+
+	return ret;
+}
+
+/*
+ * Run the xdp program on a frame of a single rx buffer, @offset and @len
+ * follow the head and tail the program moved.
+ */
+static int sunxi_gmac_rx_xdp(struct sunxi_gmac *chip, struct bpf_prog *prog,
+			     struct page *page, unsigned int *offset,
+			     unsigned int *len)
+{
+	struct xdp_buff xdp;
+	u32 act;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 12, 0)
+	xdp_init_buff(&xdp, PAGE_SIZE, &chip->xdp_rxq);
+	xdp_prepare_buff(&xdp, page_address(page), *offset, *len, false);
+#else
+	xdp.data_hard_start = page_address(page);
+	xdp.data = xdp.data_hard_start + *offset;
+	xdp.data_end = xdp.data + *len;
+	xdp_set_data_meta_invalid(&xdp);
+	xdp.frame_sz = PAGE_SIZE;
+	xdp.rxq = &chip->xdp_rxq;
+#endif
+
+	act = bpf_prog_run_xdp(prog, &xdp);
+	switch (act) {
+	case XDP_PASS:
+		*offset = xdp.data - xdp.data_hard_start;
+		*len = xdp.data_end - xdp.data;
+		chip->xstats.xdp_pass++;
+		return SUNXI_GMAC_XDP_PASS;
+	case XDP_TX:
+		if (unlikely(sunxi_gmac_xdp_tx_back(chip, &xdp)))
+			goto err;
+		chip->xstats.xdp_tx++;
+		return SUNXI_GMAC_XDP_TX;
+	case XDP_REDIRECT:
+		if (unlikely(xdp_do_redirect(chip->ndev, &xdp, prog)))
+			goto err;
+		chip->xstats.xdp_redirect++;
+		return SUNXI_GMAC_XDP_REDIRECT;
+	default:
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 17, 0)
+		bpf_warn_invalid_xdp_action(chip->ndev, prog, act);
+#else
+		bpf_warn_invalid_xdp_action(act);
+#endif
+		fallthrough;
+	case XDP_ABORTED:
+err:
+		trace_xdp_exception(chip->ndev, prog, act);
+		fallthrough;
+	case XDP_DROP:
+		chip->xstats.xdp_drop++;
+		return SUNXI_GMAC_XDP_CONSUMED;
+	}
+}
+
 static void sunxi_gmac_copy_loopback_data(struct sunxi_gmac *chip,
 					struct sk_buff *skb)
 {
@@ -2316,12 +2792,29 @@ static int sunxi_gmac_rx_metadata_cmp(struct sk_buff *skb)
 }
 #endif
 
+/*
+ * Hand the page over to the skb. Since 5.15 the stack gives marked pages
+ * back to the pool when the skb is freed, older kernels just unmap them.
+ */
+static void sunxi_gmac_rx_mark_page(struct sunxi_gmac *chip, struct sk_buff *skb,
+				    struct page *page)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 15, 0)
+	skb_mark_for_recycle(skb);
+#else
+	page_pool_release_page(chip->page_pool, page);
+#endif
+}
+
 static int sunxi_gmac_rx(struct sunxi_gmac *chip, int limit)
 {
-	unsigned int rxcount = 0, offset = 0;
-	unsigned int entry;
+	unsigned int rxcount = 0, offset = chip->rx_offset;
+	unsigned int entry, len, data_off;
 	struct sunxi_gmac_dma_desc *desc = NULL;
-	int status;
+	struct bpf_prog *prog = READ_ONCE(chip->xdp_prog);
+	struct page *page;
+	int status, xdp_res, xdp_status = 0;
+	bool strip_fcs;
 	u32 frame_len;
 
 	while (rxcount < limit) {
@@ -2332,7 +2825,7 @@ static int sunxi_gmac_rx(struct sunxi_gmac *chip, int limit)
 			break;
 
 		rxcount++;
-		chip->rx_dirty = circ_inc(chip->rx_dirty, sunxi_gmac_dma_desc_rx);
+		chip->rx_dirty = circ_inc(chip->rx_dirty, chip->dma_desc_rx);
 
 		/* Get length & status from hardware */
 		frame_len = sunxi_gmac_desc_rx_frame_len(desc);
@@ -2341,84 +2834,103 @@ static int sunxi_gmac_rx(struct sunxi_gmac *chip, int limit)
 		netdev_dbg(chip->ndev, "Rx frame size %d, status: %d\n",
 			   frame_len, status);
 
-		if (unlikely(!chip->rx_skb[entry])) {
-			netdev_err(chip->ndev, "Skb is null\n");
+		page = chip->rx_buf[entry].page;
+		if (unlikely(!page)) {
+			netdev_err(chip->ndev, "Page is null\n");
 			chip->ndev->stats.rx_dropped++;
 			break;
 		}
+		chip->rx_buf[entry].page = NULL;
 
 		if (status == discard_frame || frame_len > SUNXI_GMAC_MAX_MTU_SZ) {
 			netdev_err(chip->ndev, "Get error pkt\n");
 			chip->ndev->stats.rx_errors++;
-			if (chip->rx_skb[entry]) {
-				dev_kfree_skb_any(chip->rx_skb[entry]);
-				chip->rx_skb[entry] = NULL;
-			}
+			page_pool_recycle_direct(chip->page_pool, page);
 
 			if (chip->skb) {
 				dev_kfree_skb_any(chip->skb);
 				chip->skb = NULL;
 			}
+			offset = 0;
 			continue;
 		}
 
-		dma_unmap_single(chip->dev, (u32)sunxi_gmac_desc_buf_get_addr(desc),
-				 sunxi_gmac_desc_buf_get_len(desc), DMA_FROM_DEVICE);
+		/* only the part the dma wrote needs to be synced for the cpu */
+		len = frame_len - offset;
+		dma_sync_single_for_cpu(chip->dev,
+					page_pool_get_dma_addr(page) + SUNXI_GMAC_RX_HEADROOM,
+					len, page_pool_get_dma_dir(chip->page_pool));
+
+		data_off = SUNXI_GMAC_RX_HEADROOM;
+		strip_fcs = likely(status != llc_snap);
+		if (prog && !chip->skb && status != incomplete_frame) {
+			/* the program sees the frame without its fcs */
+			if (strip_fcs)
+				len -= ETH_FCS_LEN;
+			strip_fcs = false;
+			xdp_res = sunxi_gmac_rx_xdp(chip, prog, page, &data_off, &len);
+			if (xdp_res != SUNXI_GMAC_XDP_PASS) {
+				if (xdp_res & SUNXI_GMAC_XDP_CONSUMED)
+					page_pool_recycle_direct(chip->page_pool, page);
+				else
+					chip->ndev->stats.rx_bytes += len;
+				xdp_status |= xdp_res;
+				chip->ndev->stats.rx_packets++;
+				offset = 0;
+				continue;
+			}
+		}
 
-		/* jumbo frame */
-		if (status == incomplete_frame) {
-			if (!chip->skb)
-				chip->skb = netdev_alloc_skb_ip_align(chip->ndev, SUNXI_GMAC_MAX_MTU_SZ);
-
-			if (!chip->skb) {
-				netdev_err(chip->ndev, "Failed to alloc skb\n");
-				if (chip->rx_skb[entry]) {
-					dev_kfree_skb_any(chip->rx_skb[entry]);
-					chip->rx_skb[entry] = NULL;
-				}
+		if (!chip->skb) {
+			chip->skb = build_skb(page_address(page), PAGE_SIZE);
+			if (unlikely(!chip->skb)) {
+				netdev_err(chip->ndev, "Failed to build skb\n");
+				chip->ndev->stats.rx_dropped++;
+				page_pool_recycle_direct(chip->page_pool, page);
+				offset = 0;
 				continue;
 			}
+			sunxi_gmac_rx_mark_page(chip, chip->skb, page);
+			skb_reserve(chip->skb, data_off);
+			skb_put(chip->skb, len);
+		} else {
+			/* jumbo frame, the next buffers are added as frags, no copy */
+			sunxi_gmac_rx_mark_page(chip, chip->skb, page);
+			skb_add_rx_frag(chip->skb, skb_shinfo(chip->skb)->nr_frags, page,
+					SUNXI_GMAC_RX_HEADROOM, len, PAGE_SIZE);
+		}
 
-			skb_copy_to_linear_data_offset(chip->skb, offset, chip->rx_skb[entry]->data, frame_len - offset);
-			/* after copy, release tmp skb */
-			dev_kfree_skb_any(chip->rx_skb[entry]);
-			chip->rx_skb[entry] = NULL;
+		if (status == incomplete_frame) {
 			offset = frame_len;
 			continue;
-		} else {
-			if (!chip->skb) {
-				/*
-				 * no need to copy skb,
-				 * pass it to protocol stack,
-				 * and protocol stack will release skb
-				 */
-				chip->skb = chip->rx_skb[entry];
-				chip->rx_skb[entry] = NULL;
-			} else {
-				skb_copy_to_linear_data_offset(chip->skb, offset, chip->rx_skb[entry]->data, frame_len - offset);
-				/* after copy, release tmp skb */
-				dev_kfree_skb_any(chip->rx_skb[entry]);
-				chip->rx_skb[entry] = NULL;
-			}
-			offset = 0;
 		}
+		offset = 0;
 
-		if (likely(status != llc_snap))
-			frame_len -= ETH_FCS_LEN;
+		/* the program cannot see a frame of several buffers, so drop it */
+		if (unlikely(prog && skb_shinfo(chip->skb)->nr_frags)) {
+			chip->ndev->stats.rx_dropped++;
+			dev_kfree_skb_any(chip->skb);
+			chip->skb = NULL;
+			continue;
+		}
 
-		trace_sunxi_gmac_skb_dump(chip->skb, chip->ndev->name, 0);
+		/* the fcs may straddle the last two buffers */
+		if (strip_fcs)
+			pskb_trim(chip->skb, chip->skb->len - ETH_FCS_LEN);
+		frame_len = chip->skb->len;
 
-		skb_put(chip->skb, frame_len);
+		trace_sunxi_gmac_skb_dump(chip->skb, chip->ndev->name, 0);
 
 		if (unlikely(chip->is_loopback_test))
 			sunxi_gmac_copy_loopback_data(chip, chip->skb);
 
 #if IS_ENABLED(CONFIG_AW_GMAC_METADATA)
 		if (unlikely(sunxi_gmac_rx_metadata_cmp(chip->skb) == 0)) {
-			frame_len = min(frame_len, chip->metadata_len);
-			memcpy(chip->metadata_buff, chip->skb->data + (2 * ETH_ALEN + 6), frame_len);
+			frame_len = min(frame_len - (2 * ETH_ALEN + 6), chip->metadata_len);
+			skb_copy_bits(chip->skb, 2 * ETH_ALEN + 6, chip->metadata_buff, frame_len);
 			complete(&chip->metadata_done);
 			dev_kfree_skb_any(chip->skb);
+			chip->skb = NULL;
 			continue;
 		}
 #endif
@@ -2433,10 +2945,17 @@ static int sunxi_gmac_rx(struct sunxi_gmac *chip, int limit)
 		chip->skb = NULL;
 	}
 
+	chip->rx_offset = offset;
+
+	if (xdp_status & SUNXI_GMAC_XDP_REDIRECT)
+		xdp_do_flush();
+	if (xdp_status & SUNXI_GMAC_XDP_TX)
+		sunxi_gmac_tx_poll(chip->base);
+
 	if (rxcount > 0) {
 		netdev_dbg(chip->ndev, "RX descriptor DMA: 0x%08x, dirty: %d, clean: %d\n",
 				(unsigned int)chip->dma_rx_phy, chip->rx_dirty, chip->rx_clean);
-		sunxi_gmac_dump_dma_desc(chip->dma_rx, sunxi_gmac_dma_desc_rx);
+		sunxi_gmac_dump_dma_desc(chip->dma_rx, chip->dma_desc_rx);
 	}
 
 	sunxi_gmac_rx_refill(chip->ndev);
@@ -2449,19 +2968,117 @@ static int sunxi_gmac_poll(struct napi_struct *napi, int budget)
 	struct sunxi_gmac *chip = container_of(napi, struct sunxi_gmac, napi);
 	int work_done = 0;
 
-	sunxi_gmac_tx_complete(chip);
+	sunxi_gmac_tx_complete(chip, budget);
 	work_done = sunxi_gmac_rx(chip, budget);
 
-	if (work_done < budget) {
-		napi_complete(napi);
-		sunxi_gmac_irq_enable(chip->base);
+	if (chip->rx_dim_enabled) {
+		struct dim_sample sample = {};
+
+		dim_update_sample(++chip->rx_dim_events, chip->ndev->stats.rx_packets,
+				  chip->ndev->stats.rx_bytes, &sample);
+		net_dim(&chip->rx_dim, sample);
+	}
+
+	if (work_done < budget && napi_complete_done(napi, work_done)) {
+		/* hold the irq off for rx-usecs, what comes meanwhile stays latched */
+		if (chip->rx_coal_usecs)
+			hrtimer_start(&chip->rx_coal_timer,
+				      ns_to_ktime(chip->rx_coal_usecs * NSEC_PER_USEC),
+				      HRTIMER_MODE_REL);
+		else
+			sunxi_gmac_irq_enable(chip->base);
 	}
 
 	return work_done;
 }
 
+static enum hrtimer_restart sunxi_gmac_rx_coal_timer(struct hrtimer *t)
+{
+	struct sunxi_gmac *chip = container_of(t, struct sunxi_gmac, rx_coal_timer);
+
+	sunxi_gmac_irq_enable(chip->base);
+
+	return HRTIMER_NORESTART;
+}
+
+static enum hrtimer_restart sunxi_gmac_tx_coal_timer(struct hrtimer *t)
+{
+	struct sunxi_gmac *chip = container_of(t, struct sunxi_gmac, tx_coal_timer);
+
+	sunxi_gmac_schedule(chip);
+
+	return HRTIMER_NORESTART;
+}
+
+static void sunxi_gmac_rx_dim_work(struct work_struct *work)
+{
+	struct dim *dim = container_of(work, struct dim, work);
+	struct sunxi_gmac *chip = container_of(dim, struct sunxi_gmac, rx_dim);
+	struct dim_cq_moder moder;
+
+	moder = net_dim_get_rx_moderation(dim->mode, dim->profile_ix);
+	WRITE_ONCE(chip->rx_coal_usecs, min_t(u32, moder.usec, SUNXI_GMAC_COAL_USECS_MAX));
+	dim->state = DIM_START_MEASURE;
+}
+
+/* xdp only runs on frames that fit in one rx buffer */
+static bool sunxi_gmac_xdp_mtu_ok(struct sunxi_gmac *chip, int mtu)
+{
+	return mtu + ETH_HLEN + VLAN_HLEN + ETH_FCS_LEN <= chip->buf_sz;
+}
+
+static int sunxi_gmac_xdp_setup(struct net_device *ndev, struct bpf_prog *prog,
+				struct netlink_ext_ack *extack)
+{
+	struct sunxi_gmac *chip = netdev_priv(ndev);
+	bool running = netif_running(ndev);
+	bool reset = !chip->xdp_prog != !prog;
+	struct bpf_prog *old_prog;
+	int ret;
+
+	if (prog && !sunxi_gmac_xdp_mtu_ok(chip, ndev->mtu)) {
+		NL_SET_ERR_MSG_MOD(extack, "MTU too large for XDP");
+		return -EOPNOTSUPP;
+	}
+
+	/* the rx pages change their dma direction, restart the rings */
+	if (running && reset)
+		sunxi_gmac_stop(ndev);
+
+	old_prog = xchg(&chip->xdp_prog, prog);
+
+	if (running && reset) {
+		ret = sunxi_gmac_open(ndev);
+		if (ret) {
+			/* the caller drops prog on error, go back to the old one */
+			NL_SET_ERR_MSG_MOD(extack, "Restart with XDP failed");
+			xchg(&chip->xdp_prog, old_prog);
+			if (sunxi_gmac_open(ndev))
+				netdev_err(ndev, "Error: Restart failed, bring it down and up\n");
+			return ret;
+		}
+	}
+
+	if (old_prog)
+		bpf_prog_put(old_prog);
+
+	return 0;
+}
+
+static int sunxi_gmac_bpf(struct net_device *ndev, struct netdev_bpf *bpf)
+{
+	switch (bpf->command) {
+	case XDP_SETUP_PROG:
+		return sunxi_gmac_xdp_setup(ndev, bpf->prog, bpf->extack);
+	default:
+		return -EINVAL;
+	}
+}
+
 static int sunxi_gmac_change_mtu(struct net_device *ndev, int new_mtu)
 {
+	struct sunxi_gmac *chip = netdev_priv(ndev);
+
 	if (netif_running(ndev)) {
 		netdev_err(ndev, "Error: Nic must be stopped to change its MTU\n");
 		return -EBUSY;
@@ -2472,6 +3089,11 @@ static int sunxi_gmac_change_mtu(struct net_device *ndev, int new_mtu)
 		return -EINVAL;
 	}
 
+	if (chip->xdp_prog && !sunxi_gmac_xdp_mtu_ok(chip, new_mtu)) {
+		netdev_err(ndev, "Error: MTU too large for XDP\n");
+		return -EINVAL;
+	}
+
 	ndev->mtu = new_mtu;
 	netdev_update_features(ndev);
 
@@ -2481,6 +3103,16 @@ static int sunxi_gmac_change_mtu(struct net_device *ndev, int new_mtu)
 static netdev_features_t sunxi_gmac_fix_features(struct net_device *ndev,
 					   netdev_features_t features)
 {
+	struct sunxi_gmac *chip = netdev_priv(ndev);
+
+	/*
+	 * Software tso keeps a segment within one desc and needs room for
+	 * a whole skb of segments on the ring.
+	 */
+	if (ndev->mtu + ETH_HLEN + VLAN_HLEN > SUNXI_GMAC_MAX_BUF_SZ ||
+	    chip->dma_desc_tx < 2 * SUNXI_GMAC_TX_MAX_DESCS)
+		features &= ~(NETIF_F_TSO | NETIF_F_TSO6);
+
 	return features;
 }
 
@@ -2642,6 +3274,8 @@ static const struct net_device_ops sunxi_gmac_netdev_ops = {
 #endif
 	.ndo_set_mac_address = sunxi_gmac_set_mac_address,
 	.ndo_set_features = sunxi_gmac_set_features,
+	.ndo_bpf = sunxi_gmac_bpf,
+	.ndo_xdp_xmit = sunxi_gmac_xdp_xmit,
 };
 
 static int sunxi_gmac_check_if_running(struct net_device *ndev)
@@ -2774,6 +3408,8 @@ static int __sunxi_gmac_loopback_test(struct net_device *ndev)
 	struct sk_buff *skb_tmp = NULL, *skb = NULL;
 	u8 *test_data = NULL;
 	u8 *loopback_test_rx_buf = chip->loopback_test_rx_buf;
+	unsigned long timeout;
+	u64 start, elapsed = 0;
 	u32 i, j;
 
 	skb_tmp = alloc_skb(LOOPBACK_PKT_LEN, GFP_ATOMIC);
@@ -2798,6 +3434,7 @@ static int __sunxi_gmac_loopback_test(struct net_device *ndev)
 		chip->loopback_test_rx_idx = 0;
 		memset(loopback_test_rx_buf, 0, LOOPBACK_PKT_CNT * LOOPBACK_PKT_LEN);
 
+		start = ktime_get_ns();
 		for (j = 0; j < LOOPBACK_PKT_CNT; j++) {
 			skb = pskb_copy(skb_tmp, GFP_ATOMIC);
 			if (!skb) {
@@ -2819,7 +3456,11 @@ static int __sunxi_gmac_loopback_test(struct net_device *ndev)
 		}
 
 		/* wait till all pkts received to RX buffer */
-		msleep(200);
+		timeout = jiffies + msecs_to_jiffies(200);
+		while (READ_ONCE(chip->loopback_test_rx_idx) < LOOPBACK_PKT_CNT &&
+		       time_before(jiffies, timeout))
+			usleep_range(50, 100);
+		elapsed += ktime_get_ns() - start;
 
 		for (j = 0; j < LOOPBACK_PKT_CNT; j++) {
 			/* compare loopback data */
@@ -2839,6 +3480,13 @@ static int __sunxi_gmac_loopback_test(struct net_device *ndev)
 	}
 
 	dev_kfree_skb_any(skb_tmp);
+
+	/* rough rx path throughput, the ring refill cost is part of it */
+	netdev_info(ndev, "Loopback test: %u pkts of %u bytes in %llu us, %llu Mbps\n",
+		    LOOPBACK_DEFAULT_TIME * LOOPBACK_PKT_CNT, LOOPBACK_PKT_LEN,
+		    div_u64(elapsed, NSEC_PER_USEC),
+		    elapsed ? div64_u64((u64)LOOPBACK_DEFAULT_TIME * LOOPBACK_PKT_CNT *
+					LOOPBACK_PKT_LEN * 8 * 1000, elapsed) : 0);
 	return 0;
 }
 
@@ -2941,7 +3589,157 @@ static void sunxi_gmac_get_strings(struct net_device *netdev,
 	}
 }
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 17, 0)
+static void sunxi_gmac_get_ringparam(struct net_device *ndev,
+				     struct ethtool_ringparam *ring,
+				     struct kernel_ethtool_ringparam *kernel_ring,
+				     struct netlink_ext_ack *extack)
+#else
+static void sunxi_gmac_get_ringparam(struct net_device *ndev,
+				     struct ethtool_ringparam *ring)
+#endif
+{
+	struct sunxi_gmac *chip = netdev_priv(ndev);
+
+	ring->rx_max_pending = SUNXI_GMAC_DMA_DESC_MAX;
+	ring->tx_max_pending = SUNXI_GMAC_DMA_DESC_MAX;
+	ring->rx_pending = chip->dma_desc_rx;
+	ring->tx_pending = chip->dma_desc_tx;
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 17, 0)
+static int sunxi_gmac_set_ringparam(struct net_device *ndev,
+				    struct ethtool_ringparam *ring,
+				    struct kernel_ethtool_ringparam *kernel_ring,
+				    struct netlink_ext_ack *extack)
+#else
+static int sunxi_gmac_set_ringparam(struct net_device *ndev,
+				    struct ethtool_ringparam *ring)
+#endif
+{
+	struct sunxi_gmac *chip = netdev_priv(ndev);
+	int old_rx = chip->dma_desc_rx, old_tx = chip->dma_desc_tx;
+	bool running = netif_running(ndev);
+	int ret;
+
+	if (ring->rx_mini_pending || ring->rx_jumbo_pending)
+		return -EINVAL;
+
+	/* the ring index arithmetic needs a power of 2 */
+	if (ring->rx_pending < SUNXI_GMAC_DMA_DESC_MIN ||
+	    ring->rx_pending > SUNXI_GMAC_DMA_DESC_MAX ||
+	    ring->tx_pending < SUNXI_GMAC_DMA_DESC_MIN ||
+	    ring->tx_pending > SUNXI_GMAC_DMA_DESC_MAX ||
+	    !is_power_of_2(ring->rx_pending) || !is_power_of_2(ring->tx_pending)) {
+		netdev_err(ndev, "Error: Ring size must be a power of 2 in [%d, %d]\n",
+			   SUNXI_GMAC_DMA_DESC_MIN, SUNXI_GMAC_DMA_DESC_MAX);
+		return -EINVAL;
+	}
+
+	if (ring->rx_pending == old_rx && ring->tx_pending == old_tx)
+		return 0;
+
+	if (running)
+		sunxi_gmac_stop(ndev);
+
+	sunxi_gmac_dma_desc_deinit(chip);
+	chip->dma_desc_rx = ring->rx_pending;
+	chip->dma_desc_tx = ring->tx_pending;
+	ret = sunxi_gmac_dma_desc_init(ndev);
+	if (ret) {
+		netdev_err(ndev, "Error: Resize rings failed, keep %d/%d\n", old_rx, old_tx);
+		chip->dma_desc_rx = old_rx;
+		chip->dma_desc_tx = old_tx;
+		if (sunxi_gmac_dma_desc_init(ndev))
+			return ret;
+	}
+
+	/* tso depends on the tx ring size */
+	netdev_update_features(ndev);
+
+	if (running) {
+		int err = sunxi_gmac_open(ndev);
+
+		if (err)
+			return err;
+	}
+
+	return ret;
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 15, 0)
+static int sunxi_gmac_get_coalesce(struct net_device *ndev,
+				   struct ethtool_coalesce *ec,
+				   struct kernel_ethtool_coalesce *kernel_coal,
+				   struct netlink_ext_ack *extack)
+#else
+static int sunxi_gmac_get_coalesce(struct net_device *ndev,
+				   struct ethtool_coalesce *ec)
+#endif
+{
+	struct sunxi_gmac *chip = netdev_priv(ndev);
+
+	ec->rx_coalesce_usecs = READ_ONCE(chip->rx_coal_usecs);
+	ec->tx_coalesce_usecs = chip->tx_coal_usecs;
+	ec->tx_max_coalesced_frames = chip->tx_coal_frames;
+	ec->use_adaptive_rx_coalesce = chip->rx_dim_enabled;
+
+	return 0;
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 15, 0)
+static int sunxi_gmac_set_coalesce(struct net_device *ndev,
+				   struct ethtool_coalesce *ec,
+				   struct kernel_ethtool_coalesce *kernel_coal,
+				   struct netlink_ext_ack *extack)
+#else
+static int sunxi_gmac_set_coalesce(struct net_device *ndev,
+				   struct ethtool_coalesce *ec)
+#endif
+{
+	struct sunxi_gmac *chip = netdev_priv(ndev);
+	bool running;
+
+	if (ec->rx_coalesce_usecs > SUNXI_GMAC_COAL_USECS_MAX ||
+	    ec->tx_coalesce_usecs > SUNXI_GMAC_COAL_USECS_MAX ||
+	    ec->tx_max_coalesced_frames > SUNXI_GMAC_COAL_FRAMES_MAX)
+		return -EINVAL;
+
+	/* the tx timer is the only thing reaping packets without an irq */
+	if (ec->tx_max_coalesced_frames > 1 && !ec->tx_coalesce_usecs)
+		return -EINVAL;
+
+	/* a whole ring of packets must not wait for an irq */
+	if (ec->tx_max_coalesced_frames > chip->dma_desc_tx / 2)
+		return -EINVAL;
+
+	running = netif_running(ndev);
+	if (running)
+		napi_disable(&chip->napi);
+	if (chip->rx_dim_enabled && !ec->use_adaptive_rx_coalesce)
+		cancel_work_sync(&chip->rx_dim.work);
+	chip->rx_dim_enabled = ec->use_adaptive_rx_coalesce;
+	if (!chip->rx_dim_enabled)
+		WRITE_ONCE(chip->rx_coal_usecs, ec->rx_coalesce_usecs);
+	/* xmit counts packets against these under tx_lock */
+	spin_lock_bh(&chip->tx_lock);
+	chip->tx_coal_usecs = ec->tx_coalesce_usecs;
+	chip->tx_coal_frames = max_t(u32, ec->tx_max_coalesced_frames, 1);
+	chip->tx_coal_count = 0;
+	spin_unlock_bh(&chip->tx_lock);
+	if (running)
+		napi_enable(&chip->napi);
+
+	return 0;
+}
+
 static const struct ethtool_ops sunxi_gmac_ethtool_ops = {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 7, 0)
+	.supported_coalesce_params = ETHTOOL_COALESCE_RX_USECS |
+				     ETHTOOL_COALESCE_TX_USECS |
+				     ETHTOOL_COALESCE_TX_MAX_FRAMES |
+				     ETHTOOL_COALESCE_USE_ADAPTIVE_RX,
+#endif
 	.begin = sunxi_gmac_check_if_running,
 	.get_link = ethtool_op_get_link,
 	.get_pauseparam = sunxi_gmac_ethtool_get_pauseparam,
@@ -2955,6 +3753,10 @@ static const struct ethtool_ops sunxi_gmac_ethtool_ops = {
 	.get_sset_count = sunxi_gmac_get_sset_count,
 	.get_strings = sunxi_gmac_get_strings,
 	.self_test = sunxi_gmac_self_test,
+	.get_ringparam = sunxi_gmac_get_ringparam,
+	.set_ringparam = sunxi_gmac_set_ringparam,
+	.get_coalesce = sunxi_gmac_get_coalesce,
+	.set_coalesce = sunxi_gmac_set_coalesce,
 };
 
 #if IS_ENABLED(CONFIG_AW_EPHY)
@@ -3516,6 +4318,9 @@ static int sunxi_gmac_probe(struct platform_device *pdev)
 #endif /* CONFIG_AW_EPHY */
 	chip->ndev = ndev;
 	chip->dev = &pdev->dev;
+	/* per port from here on, ethtool -G resizes only this one */
+	chip->dma_desc_rx = sunxi_gmac_dma_desc_rx;
+	chip->dma_desc_tx = sunxi_gmac_dma_desc_tx;
 	ret = sunxi_gmac_resource_get(pdev);
 	if (ret) {
 		dev_err(&pdev->dev, "Error: Get gmac hardware resource failed\n");
@@ -3540,8 +4345,10 @@ static int sunxi_gmac_probe(struct platform_device *pdev)
 
 	/* fillup netdevice features and flags */
 	ndev->hw_features = NETIF_F_SG | NETIF_F_HIGHDMA | NETIF_F_IP_CSUM |
-				NETIF_F_IPV6_CSUM | NETIF_F_RXCSUM | NETIF_F_GRO;
+				NETIF_F_IPV6_CSUM | NETIF_F_RXCSUM | NETIF_F_GRO |
+				NETIF_F_TSO | NETIF_F_TSO6;
 	ndev->features |= ndev->hw_features;
+	ndev->gso_max_segs = SUNXI_GMAC_TSO_MAX_SEGS;
 	ndev->hw_features |= NETIF_F_LOOPBACK;
 	ndev->priv_flags |= IFF_UNICAST_FLT;
 	ndev->watchdog_timeo = msecs_to_jiffies(watchdog);
@@ -3549,11 +4356,20 @@ static int sunxi_gmac_probe(struct platform_device *pdev)
 
 	/* add napi poll method */
 #if LINUX_VERSION_CODE < KERNEL_VERSION(6, 1, 0)
-	netif_napi_add(ndev, &chip->napi, sunxi_gmac_poll, SUNXI_GMAC_BUDGET);
+	netif_napi_add(ndev, &chip->napi, sunxi_gmac_poll, SUNXI_GMAC_BUDGET(chip));
 #else
 	netif_napi_add(ndev, &chip->napi, sunxi_gmac_poll);
 #endif
 
+	hrtimer_init(&chip->rx_coal_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	chip->rx_coal_timer.function = sunxi_gmac_rx_coal_timer;
+	hrtimer_init(&chip->tx_coal_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	chip->tx_coal_timer.function = sunxi_gmac_tx_coal_timer;
+	INIT_WORK(&chip->rx_dim.work, sunxi_gmac_rx_dim_work);
+	chip->rx_dim.mode = DIM_CQ_PERIOD_MODE_START_FROM_EQE;
+	chip->tx_coal_frames = 1;
+	chip->tx_coal_usecs = SUNXI_GMAC_TX_COAL_USECS;
+
 	spin_lock_init(&chip->universal_lock);
 	spin_lock_init(&chip->tx_lock);
 
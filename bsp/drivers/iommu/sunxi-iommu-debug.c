@@ -21,6 +21,8 @@
 #include <linux/slab.h>
 #include <linux/uaccess.h>
 #include <linux/dma-mapping.h>
+#include <linux/scatterlist.h>
+#include <linux/ktime.h>
 #include <asm/cacheflush.h>
 #include <asm/barrier.h>
 #include <sunxi-iommu.h>
@@ -93,6 +95,8 @@ static const char * const _size_to_string(unsigned long size)
 		return "16M";
 	case SZ_1M * 32:
 		return "32M";
+	case SZ_1M * 64:
+		return "64M";
 	}
 	return "unknown size, please add to _size_to_string";
 }
@@ -191,6 +195,113 @@ static const struct file_operations iommu_debug_profiling_fast_dma_api_fops = {
 };
 
 
+#define SG_PROFILING_CHUNK	SZ_64K
+#define SG_PROFILING_ITERS	10
+
+static void __sg_profiling_free(struct sg_table *sgt)
+{
+	struct scatterlist *sg;
+	int i;
+
+	for_each_sg(sgt->sgl, sg, sgt->orig_nents, i) {
+		if (sg_page(sg))
+			__free_pages(sg_page(sg), get_order(sg->length));
+	}
+	sg_free_table(sgt);
+}
+
+/* build a sg table like a dma-buf made of 64K chunks */
+static int __sg_profiling_alloc(struct sg_table *sgt, size_t size)
+{
+	struct scatterlist *sg;
+	struct page *page;
+	int i;
+
+	if (sg_alloc_table(sgt, size / SG_PROFILING_CHUNK, GFP_KERNEL))
+		return -ENOMEM;
+
+	for_each_sg(sgt->sgl, sg, sgt->orig_nents, i) {
+		page = alloc_pages(GFP_KERNEL, get_order(SG_PROFILING_CHUNK));
+		if (!page) {
+			__sg_profiling_free(sgt);
+			return -ENOMEM;
+		}
+		sg_set_page(sg, page, SG_PROFILING_CHUNK, 0);
+	}
+
+	return 0;
+}
+
+static int iommu_debug_profiling_sg_map_show(struct seq_file *s,
+					     void *ignored)
+{
+	struct iommu_debug_device *ddev = s->private;
+	struct device *dev = ddev->dev;
+	const size_t sizes[] = { SZ_1M, SZ_4M, SZ_16M, SZ_64M };
+	struct sg_table sgt;
+	u64 start, map_ns, unmap_ns;
+	u32 mb, map_rem, unmap_rem;
+	int i, j;
+
+	for (i = 0; i < ARRAY_SIZE(sizes); ++i) {
+		if (__sg_profiling_alloc(&sgt, sizes[i])) {
+			seq_printf(s, "%4s: alloc sg table failed\n",
+				   _size_to_string(sizes[i]));
+			continue;
+		}
+
+		map_ns = 0;
+		unmap_ns = 0;
+		for (j = 0; j < SG_PROFILING_ITERS; ++j) {
+			start = ktime_get_ns();
+			if (!dma_map_sg_attrs(dev, sgt.sgl, sgt.orig_nents,
+					      DMA_BIDIRECTIONAL,
+					      DMA_ATTR_SKIP_CPU_SYNC)) {
+				seq_puts(s, "dma_map_sg failed\n");
+				break;
+			}
+			map_ns += ktime_get_ns() - start;
+
+			start = ktime_get_ns();
+			dma_unmap_sg_attrs(dev, sgt.sgl, sgt.orig_nents,
+					   DMA_BIDIRECTIONAL,
+					   DMA_ATTR_SKIP_CPU_SYNC);
+			unmap_ns += ktime_get_ns() - start;
+		}
+
+		if (j) {
+			mb = sizes[i] / SZ_1M;
+			map_ns = div_u64(map_ns, j * mb);
+			unmap_ns = div_u64(unmap_ns, j * mb);
+			map_ns = div_u64_rem(map_ns, NSEC_PER_USEC, &map_rem);
+			unmap_ns = div_u64_rem(unmap_ns, NSEC_PER_USEC,
+					       &unmap_rem);
+			seq_printf(s,
+				   "%4s x %d: map %llu.%03u us/MiB, unmap %llu.%03u us/MiB\n",
+				   _size_to_string(sizes[i]), j, map_ns,
+				   map_rem, unmap_ns, unmap_rem);
+		}
+		__sg_profiling_free(&sgt);
+	}
+
+	return 0;
+}
+
+static int iommu_debug_profiling_sg_map_open(struct inode *inode,
+					     struct file *file)
+{
+	return single_open(file, iommu_debug_profiling_sg_map_show,
+			   inode->i_private);
+}
+
+static const struct file_operations iommu_debug_profiling_sg_map_fops = {
+	.open	 = iommu_debug_profiling_sg_map_open,
+	.read	 = seq_read,
+	.llseek	 = seq_lseek,
+	.release = single_release,
+};
+
+
 /* Creates a fresh fast mapping and applies @fn to it */
 static int __apply_to_new_mapping(struct seq_file *s,
 				    int (*fn)(struct device *dev,
@@ -848,6 +959,13 @@ static int snarf_iommu_devices(struct device *dev, const char *name)
 		goto err_rmdir;
 	}
 
+	if (!debugfs_create_file("profiling_sg_map_unmap", 0400, dir, ddev,
+				 &iommu_debug_profiling_sg_map_fops)) {
+		pr_err("Couldn't create iommu/devices/%s/profiling_sg_map_unmap debugfs file\n",
+		       name);
+		goto err_rmdir;
+	}
+
 	if (!debugfs_create_file("iommu_basic_test", 0400, dir, ddev,
 				 &iommu_debug_basic_test_fops)) {
 		pr_err("Couldn't create iommu/devices/%s/iommu_basic_test debugfs file\n",
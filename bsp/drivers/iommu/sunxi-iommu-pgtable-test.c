@@ -0,0 +1,214 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright(c) 2020 - 2023 Allwinner Technology Co.,Ltd. All rights reserved. */
+/*
+ * KUnit tests for Allwinner's pgtable controler
+ *
+ * Only the page table in memory is exercised, no iommu hardware is needed,
+ * so the suite runs under QEMU.
+ */
+
+#include <kunit/test.h>
+#include <linux/device.h>
+#include <linux/kthread.h>
+#include <linux/atomic.h>
+#include <linux/slab.h>
+#include "sunxi-iommu.h"
+
+#define PGTABLE_TEST_IOVA	0x10000000UL
+#define PGTABLE_TEST_SIZE	(4 * SPD_SIZE)
+#define PGTABLE_TEST_PAGES	(PGTABLE_TEST_SIZE / SPAGE_SIZE)
+#define PGTABLE_TEST_PHYS_A	0x80000000UL
+#define PGTABLE_TEST_PHYS_B	0xa0000000UL
+#define PGTABLE_TEST_ROUNDS	200
+#define PGTABLE_TEST_READERS	2
+
+struct pgtable_test_ctx {
+	struct device *dev;
+	struct kmem_cache *cache;
+	unsigned int *pgtable;
+	atomic_t errors;
+	atomic_t hits;
+};
+
+/* same sequence as sunxi_iommu_map() */
+static int pgtable_test_map(unsigned int *pgtable, dma_addr_t iova,
+			    size_t size, phys_addr_t phys)
+{
+	int ret;
+
+	ret = sunxi_pgtable_prepare_l1_tables(pgtable, iova, iova + size,
+					      IOMMU_READ | IOMMU_WRITE);
+	if (ret)
+		return ret;
+
+	return sunxi_pgtable_prepare_l2_tables(pgtable, iova, iova + size,
+					       phys, IOMMU_READ | IOMMU_WRITE);
+}
+
+/* same sequence as sunxi_iommu_unmap(), l2 tables go through rcu */
+static void pgtable_test_unmap(unsigned int *pgtable, dma_addr_t iova,
+			       size_t size)
+{
+	dma_addr_t end = iova + size;
+	u32 tail;
+
+	while (iova < end) {
+		tail = sunxi_pgtable_delete_l2_tables(pgtable, iova, end, NULL);
+		iova += tail;
+	}
+}
+
+static void pgtable_test_map_unmap(struct kunit *test)
+{
+	struct pgtable_test_ctx *ctx = test->priv;
+	dma_addr_t iova = PGTABLE_TEST_IOVA + 3 * SPAGE_SIZE;
+	size_t size = PGTABLE_TEST_SIZE - 8 * SPAGE_SIZE;
+	size_t off;
+
+	KUNIT_ASSERT_EQ(test, pgtable_test_map(ctx->pgtable, iova, size,
+					       PGTABLE_TEST_PHYS_A), 0);
+
+	for (off = 0; off < size; off += SPAGE_SIZE)
+		KUNIT_EXPECT_EQ(test,
+			sunxi_pgtable_iova_to_phys(ctx->pgtable,
+						   iova + off + 0x123),
+			(phys_addr_t)(PGTABLE_TEST_PHYS_A + off + 0x123));
+	KUNIT_EXPECT_EQ(test, sunxi_pgtable_iova_to_phys(ctx->pgtable,
+						iova - SPAGE_SIZE), 0);
+	KUNIT_EXPECT_EQ(test, sunxi_pgtable_iova_to_phys(ctx->pgtable,
+						iova + size), 0);
+
+	pgtable_test_unmap(ctx->pgtable, iova, size);
+
+	for (off = 0; off < size; off += SPAGE_SIZE)
+		KUNIT_EXPECT_EQ(test,
+			sunxi_pgtable_iova_to_phys(ctx->pgtable, iova + off),
+			0);
+}
+
+/*
+ * lookups racing with map/unmap must only ever see an unmapped iova or one
+ * of the translations the writer installed, never a torn entry or a freed
+ * l2 table
+ */
+static int pgtable_test_reader(void *data)
+{
+	struct pgtable_test_ctx *ctx = data;
+	unsigned long idx = 0;
+	dma_addr_t iova;
+	phys_addr_t phys, base;
+
+	while (!kthread_should_stop()) {
+		idx = (idx * 7 + 1) % PGTABLE_TEST_PAGES;
+		iova = PGTABLE_TEST_IOVA + idx * SPAGE_SIZE;
+		phys = sunxi_pgtable_iova_to_phys(ctx->pgtable, iova);
+		if (phys) {
+			base = phys - idx * SPAGE_SIZE;
+			if (base != PGTABLE_TEST_PHYS_A &&
+			    base != PGTABLE_TEST_PHYS_B)
+				atomic_inc(&ctx->errors);
+			atomic_inc(&ctx->hits);
+		}
+		cond_resched();
+	}
+
+	return 0;
+}
+
+static void pgtable_test_concurrent_lookup(struct kunit *test)
+{
+	struct pgtable_test_ctx *ctx = test->priv;
+	struct task_struct *readers[PGTABLE_TEST_READERS];
+	unsigned long idx;
+	int i;
+
+	for (i = 0; i < PGTABLE_TEST_READERS; i++) {
+		readers[i] = kthread_run(pgtable_test_reader, ctx,
+					 "pgtable_test/%d", i);
+		KUNIT_ASSERT_FALSE(test, IS_ERR(readers[i]));
+	}
+
+	for (i = 0; i < PGTABLE_TEST_ROUNDS; i++) {
+		KUNIT_EXPECT_EQ(test,
+			pgtable_test_map(ctx->pgtable, PGTABLE_TEST_IOVA,
+					 PGTABLE_TEST_SIZE,
+					 i & 1 ? PGTABLE_TEST_PHYS_B :
+						 PGTABLE_TEST_PHYS_A), 0);
+		cond_resched();
+		pgtable_test_unmap(ctx->pgtable, PGTABLE_TEST_IOVA,
+				   PGTABLE_TEST_SIZE);
+		cond_resched();
+	}
+
+	for (i = 0; i < PGTABLE_TEST_READERS; i++)
+		kthread_stop(readers[i]);
+
+	KUNIT_EXPECT_EQ(test, atomic_read(&ctx->errors), 0);
+	for (idx = 0; idx < PGTABLE_TEST_PAGES; idx++)
+		KUNIT_EXPECT_EQ(test,
+			sunxi_pgtable_iova_to_phys(ctx->pgtable,
+				PGTABLE_TEST_IOVA + idx * SPAGE_SIZE), 0);
+	kunit_info(test, "%d lookups hit a mapping\n",
+		   atomic_read(&ctx->hits));
+}
+
+static int pgtable_test_init(struct kunit *test)
+{
+	struct pgtable_test_ctx *ctx;
+
+	/* the helpers work on the driver's cache and dma device, leave them be */
+	if (sunxi_pgtable_in_use())
+		kunit_skip(test, "iommu bound, its page table cache is in use");
+
+	ctx = kunit_kzalloc(test, sizeof(*ctx), GFP_KERNEL);
+	if (!ctx)
+		return -ENOMEM;
+
+	ctx->dev = root_device_register("sunxi_pgtable_test");
+	if (IS_ERR(ctx->dev))
+		return PTR_ERR(ctx->dev);
+	sunxi_pgtable_set_dma_dev(ctx->dev);
+
+	ctx->cache = sunxi_pgtable_alloc_pte_cache();
+	ctx->pgtable = sunxi_pgtable_alloc();
+	if (!ctx->cache || !ctx->pgtable) {
+		if (ctx->pgtable)
+			sunxi_pgtable_free(ctx->pgtable);
+		if (ctx->cache)
+			sunxi_pgtable_free_pte_cache(ctx->cache);
+		root_device_unregister(ctx->dev);
+		return -ENOMEM;
+	}
+
+	test->priv = ctx;
+	return 0;
+}
+
+static void pgtable_test_exit(struct kunit *test)
+{
+	struct pgtable_test_ctx *ctx = test->priv;
+
+	if (!ctx)
+		return;
+
+	sunxi_pgtable_clear(ctx->pgtable);
+	sunxi_pgtable_free(ctx->pgtable);
+	sunxi_pgtable_free_pte_cache(ctx->cache);
+	sunxi_pgtable_set_dma_dev(NULL);
+	root_device_unregister(ctx->dev);
+}
+
+static struct kunit_case sunxi_pgtable_test_cases[] = {
+	KUNIT_CASE(pgtable_test_map_unmap),
+	KUNIT_CASE(pgtable_test_concurrent_lookup),
+	{},
+};
+
+static struct kunit_suite sunxi_pgtable_test_suite = {
+	.name = "sunxi_iommu_pgtable",
+	.init = pgtable_test_init,
+	.exit = pgtable_test_exit,
+	.test_cases = sunxi_pgtable_test_cases,
+};
+
+kunit_test_suites(&sunxi_pgtable_test_suite);
@@ -19,6 +19,7 @@
 
 #include <linux/iommu.h>
 #include <linux/slab.h>
+#include <linux/rcupdate.h>
 #include "sunxi-iommu.h"
 #include <sunxi-iommu.h>
 
@@ -90,15 +91,18 @@ static inline u32 *iopde_offset(u32 *iopd, dma_addr_t iova)
 	return iopd + IOPDE_INDEX(iova);
 }
 
-/* pointer to l2 table entry */
-static inline u32 *iopte_offset(u32 *ent, dma_addr_t iova)
+/*
+ * pointer to l2 table entry, take the l1 entry by value so that lockless
+ * walkers decode the same entry they checked with IS_VALID()
+ */
+static inline u32 *iopte_offset(u32 ent, dma_addr_t iova)
 {
 	u64 iopte_base = 0;
 
-	iopte_base = IOPTE_BASE(*ent);
+	iopte_base = IOPTE_BASE(ent);
 #if defined(AW_IOMMU_PGTABLE_V2)
 	iopte_base |=
-		(u64)((*ent & DENT_ADDR_HIGH_MASK) >> DENT_ADDR_HIGH_SHIFT)
+		(u64)((ent & DENT_ADDR_HIGH_MASK) >> DENT_ADDR_HIGH_SHIFT)
 		<< 32;
 #endif
 	iopte_base = iommu_phy_to_cpu_phy(iopte_base);
@@ -110,6 +114,7 @@ static int sunxi_alloc_iopte(u32 *sent, int prot)
 {
 	u32 *pent;
 	u32 flags = 0;
+	u32 dent;
 
 	flags |= (prot & IOMMU_READ) ? DENT_READABLE : 0;
 	flags |= (prot & IOMMU_WRITE) ? DENT_WRITABLE : 0;
@@ -123,11 +128,14 @@ static int sunxi_alloc_iopte(u32 *sent, int prot)
 	dma_sync_single_for_cpu(sunxi_pgtable_params.dma_dev,
 				virt_to_phys(sent), sizeof(*sent),
 				DMA_TO_DEVICE);
-	*sent = cpu_phy_to_iommu_phy(__pa(pent)) | DENT_VALID;
+	dent = cpu_phy_to_iommu_phy(__pa(pent)) | DENT_VALID;
 #if defined(AW_IOMMU_PGTABLE_V2)
-	*sent |= ((__pa(pent) >> 32) << DENT_ADDR_HIGH_SHIFT) &
-		 DENT_ADDR_HIGH_MASK;
+	dent |= ((__pa(pent) >> 32) << DENT_ADDR_HIGH_SHIFT) &
+		DENT_ADDR_HIGH_MASK;
 #endif
+	/* zeroed l2 table must be visible before lockless walkers can see it */
+	smp_wmb();
+	WRITE_ONCE(*sent, dent);
 	dma_sync_single_for_device(sunxi_pgtable_params.dma_dev,
 				   virt_to_phys(sent), sizeof(*sent),
 				   DMA_TO_DEVICE);
@@ -140,6 +148,23 @@ static void sunxi_free_iopte(u32 *pent)
 	kmem_cache_free(sunxi_pgtable_params.iopte_cache, pent);
 }
 
+/* l2 tables unlinked from l1, freed after lockless walkers are done */
+struct sunxi_iopte_free_batch {
+	struct rcu_head rcu;
+	unsigned int cnt;
+	u32 *pents[];
+};
+
+static void sunxi_free_iopte_batch_rcu(struct rcu_head *head)
+{
+	struct sunxi_iopte_free_batch *batch =
+		container_of(head, struct sunxi_iopte_free_batch, rcu);
+
+	while (batch->cnt)
+		sunxi_free_iopte(batch->pents[--batch->cnt]);
+	kfree(batch);
+}
+
 static inline u32 sunxi_mk_pte(phys_addr_t page, int prot)
 {
 	u32 flags = 0;
@@ -190,17 +215,17 @@ int sunxi_pgtable_prepare_l2_tables(unsigned int *pgtable,
 		}
 
 		dent = iopde_offset(pgtable, iova_start);
-		pent = iopte_offset(dent, iova_start);
+		pent = iopte_offset(*dent, iova_start);
 		pent_val = sunxi_mk_pte(paddr_start, prot);
 		for (i = 0; i < iova_tail_count; i++) {
 			WARN_ON(*pent);
-			*pent = pent_val + SPAGE_SIZE * i;
+			WRITE_ONCE(*pent, pent_val + SPAGE_SIZE * i);
 			pent++;
 		}
 
 		dma_sync_single_for_device(
 			sunxi_pgtable_params.dma_dev,
-			virt_to_phys(iopte_offset(dent, iova_start)),
+			virt_to_phys(iopte_offset(*dent, iova_start)),
 			iova_tail_count << 2, DMA_TO_DEVICE);
 		iova_start += iova_tail_size;
 		paddr_start += iova_tail_size;
@@ -209,11 +234,19 @@ int sunxi_pgtable_prepare_l2_tables(unsigned int *pgtable,
 }
 
 
+/*
+ * clear ptes in [iova_start, iova_end) within one l2 table, the l2 table is
+ * released once it becomes empty. If @l2_table is not NULL the emptied table
+ * is returned through it instead, so caller can free it with
+ * sunxi_pgtable_free_l2_table() after hardware stops walking it.
+ */
 int sunxi_pgtable_delete_l2_tables(unsigned int *pgtable, dma_addr_t iova_start,
-				   dma_addr_t iova_end)
+				   dma_addr_t iova_end, u32 **l2_table)
 {
 	u32 *dent, *pent;
 	u32 iova_tail_count, iova_tail_size;
+	int i;
+
 	iova_tail_count = NUM_ENTRIES_PTE - IOPTE_INDEX(iova_start);
 	iova_tail_size = iova_tail_count * SPAGE_SIZE;
 	if (iova_start + iova_tail_size > iova_end) {
@@ -224,50 +257,86 @@ int sunxi_pgtable_delete_l2_tables(unsigned int *pgtable, dma_addr_t iova_start,
 	dent = iopde_offset(pgtable, iova_start);
 	if (!IS_VALID(*dent))
 		return -EINVAL;
-	pent = iopte_offset(dent, iova_start);
-	memset(pent, 0, iova_tail_count * sizeof(u32));
+	pent = iopte_offset(*dent, iova_start);
+	/* entry by entry, lockless walkers must not see torn ptes */
+	for (i = 0; i < iova_tail_count; i++)
+		WRITE_ONCE(pent[i], 0);
 	dma_sync_single_for_device(sunxi_pgtable_params.dma_dev,
-				   virt_to_phys(iopte_offset(dent, iova_start)),
+				   virt_to_phys(pent),
 				   iova_tail_count << 2, DMA_TO_DEVICE);
 
 	if (iova_tail_size == SPD_SIZE) {
-		*dent = 0;
+		WRITE_ONCE(*dent, 0);
 		dma_sync_single_for_device(sunxi_pgtable_params.dma_dev,
 					   virt_to_phys(dent), sizeof(*dent),
 					   DMA_TO_DEVICE);
-		sunxi_free_iopte(pent);
+		if (l2_table)
+			*l2_table = pent;
+		else
+			sunxi_pgtable_free_l2_tables(&pent, 1);
 	}
 	return iova_tail_size;
 }
 
+/*
+ * free l2 tables already unlinked from l1 table, memory is only released
+ * after a rcu grace period since lookups walk the page table without lock
+ */
+void sunxi_pgtable_free_l2_tables(u32 **l2_tables, unsigned int cnt)
+{
+	struct sunxi_iopte_free_batch *batch;
+
+	if (!cnt)
+		return;
+
+	/* callers hold dt_lock, a mutex, so this may sleep */
+	batch = kmalloc(struct_size(batch, pents, cnt), GFP_KERNEL);
+	if (!batch) {
+		synchronize_rcu();
+		while (cnt)
+			sunxi_free_iopte(l2_tables[--cnt]);
+		return;
+	}
+
+	memcpy(batch->pents, l2_tables, cnt * sizeof(*l2_tables));
+	batch->cnt = cnt;
+	call_rcu(&batch->rcu, sunxi_free_iopte_batch_rcu);
+}
+
 
 phys_addr_t sunxi_pgtable_iova_to_phys(unsigned int *pgtable, dma_addr_t iova)
 {
-	u32 *dent, *pent;
+	u32 dent, pent;
 	phys_addr_t ret = 0;
-	dent = iopde_offset(pgtable, iova);
-	if (IS_VALID(*dent)) {
-		pent = iopte_offset(dent, iova);
-		if (*pent) {
-			ret = IOPTE_TO_PFN(pent) + IOVA_PAGE_OFT(iova);
+
+	rcu_read_lock();
+	dent = READ_ONCE(*iopde_offset(pgtable, iova));
+	if (IS_VALID(dent)) {
+		pent = READ_ONCE(*iopte_offset(dent, iova));
+		if (pent) {
+			ret = IOPTE_TO_PFN(&pent) + IOVA_PAGE_OFT(iova);
 			ret = iommu_phy_to_cpu_phy(ret);
 		}
 	}
+	rcu_read_unlock();
 	return ret;
 }
 
 
 int sunxi_pgtable_invalid_helper(unsigned int *pgtable, dma_addr_t iova)
 {
-	u32 *pte_addr, *dte_addr;
+	u32 pte, dte;
 
-	dte_addr = iopde_offset(pgtable, iova);
-	if ((*dte_addr & 0x3) != 0x1) {
+	rcu_read_lock();
+	dte = READ_ONCE(*iopde_offset(pgtable, iova));
+	if ((dte & 0x3) != 0x1) {
+		rcu_read_unlock();
 		pr_err("0x%pad is not mapped!\n", &iova);
 		return 1;
 	}
-	pte_addr = iopte_offset(dte_addr, iova);
-	if ((*pte_addr & 0x2) == 0) {
+	pte = READ_ONCE(*iopte_offset(dte, iova));
+	rcu_read_unlock();
+	if ((pte & 0x2) == 0) {
 		pr_err("0x%pad is not mapped!\n", &iova);
 		return 1;
 	}
@@ -287,7 +356,7 @@ void sunxi_pgtable_clear(unsigned int *pgtable)
 		dent = pgtable + i;
 		iova = (unsigned long)i << IOMMU_PD_SHIFT;
 		if (IS_VALID(*dent)) {
-			pent = iopte_offset(dent, iova);
+			pent = iopte_offset(*dent, iova);
 			dma_sync_single_for_cpu(sunxi_pgtable_params.dma_dev,
 						virt_to_phys(pent), PT_SIZE,
 						DMA_TO_DEVICE);
@@ -298,12 +367,12 @@ void sunxi_pgtable_clear(unsigned int *pgtable)
 			dma_sync_single_for_cpu(sunxi_pgtable_params.dma_dev,
 						virt_to_phys(dent), PT_SIZE,
 						DMA_TO_DEVICE);
-			*dent = 0;
+			WRITE_ONCE(*dent, 0);
 			dma_sync_single_for_device(sunxi_pgtable_params.dma_dev,
 						   virt_to_phys(dent),
 						   sizeof(*dent),
 						   DMA_TO_DEVICE);
-			sunxi_free_iopte(pent);
+			sunxi_pgtable_free_l2_tables(&pent, 1);
 		}
 	}
 }
@@ -325,6 +394,8 @@ unsigned int *sunxi_pgtable_alloc(void)
 
 void sunxi_pgtable_free(unsigned int *pgtable)
 {
+	/* wait for lockless walkers still looking at the l1 table */
+	synchronize_rcu();
 	free_pages((unsigned long)pgtable, get_order(PD_SIZE));
 	sunxi_pgtable_params.pgtable = NULL;
 }
@@ -397,6 +468,7 @@ ssize_t sunxi_pgtable_dump(unsigned int *pgtable, ssize_t len, char *buf,
 	/* walk and dump */
 	int i, j;
 	u32 *dent, *pent;
+	u32 dent_val, pte;
 	struct dump_region active_region;
 
 	if (for_sysfs_show) {
@@ -411,7 +483,11 @@ ssize_t sunxi_pgtable_dump(unsigned int *pgtable, ssize_t len, char *buf,
 	active_region.access_mask = 0;
 	for (i = 0; i < NUM_ENTRIES_PDE; i++) {
 		j = 0;
-		if (!IS_VALID(dent[i])) {
+		/* the l2 table may be unlinked and freed once this is read */
+		rcu_read_lock();
+		dent_val = READ_ONCE(dent[i]);
+		if (!IS_VALID(dent_val)) {
+			rcu_read_unlock();
 			/* empty dentry measn ended of region, print it*/
 			if (active_region.size) {
 				len = __print_region(buf, buf_len, len,
@@ -424,15 +500,16 @@ ssize_t sunxi_pgtable_dump(unsigned int *pgtable, ssize_t len, char *buf,
 			continue;
 		}
 		/* iova here use for l1 idx, safe to pass 0 to get entry for 1st page(idx 0)*/
-		pent = iopte_offset(dent + i, 0);
+		pent = iopte_offset(dent_val, 0);
 		for (; j < NUM_ENTRIES_PTE; j++) {
+			pte = READ_ONCE(pent[j]);
 			if (active_region.size) {
 				/* looks like we are counting something, check if it need printing */
-				if (__region_ended(pent[j]) /* not contiguous */
+				if (__region_ended(pte) /* not contiguous */
 				    ||
 				    (active_region.access_mask &&
 				     __access_mask_changed(
-					     pent[j],
+					     pte,
 					     active_region
 						     .access_mask)) /* different access */
 				) {
@@ -446,7 +523,7 @@ ssize_t sunxi_pgtable_dump(unsigned int *pgtable, ssize_t len, char *buf,
 				}
 			}
 
-			if (pent[j] & SUNXI_PTE_PAGE_VALID) {
+			if (pte & SUNXI_PTE_PAGE_VALID) {
 				//dma_addr_t iova_tmp,phy_tmp;
 				//iova_tmp = ((dma_addr_t)i
 				//<< IOMMU_PD_SHIFT) +
@@ -464,15 +541,16 @@ ssize_t sunxi_pgtable_dump(unsigned int *pgtable, ssize_t len, char *buf,
 						 << IOMMU_PT_SHIFT);
 					active_region.phys =
 						iommu_phy_to_cpu_phy(
-							IOPTE_TO_PFN(&pent[j]));
+							IOPTE_TO_PFN(&pte));
 					active_region.access_mask =
-						(pent[j] &
+						(pte &
 						 (SUNXI_PTE_PAGE_READABLE |
 						  SUNXI_PTE_PAGE_WRITABLE));
 				}
 				active_region.size += 1 << IOMMU_PT_SHIFT;
 			}
 		}
+		rcu_read_unlock();
 	}
 	//dump last region (if any)
 	if (active_region.size) {
@@ -495,7 +573,17 @@ struct kmem_cache *sunxi_pgtable_alloc_pte_cache(void)
 
 void sunxi_pgtable_free_pte_cache(struct kmem_cache *iopte_cache)
 {
+	/* l2 tables may still be queued for freeing */
+	rcu_barrier();
 	kmem_cache_destroy(iopte_cache);
+	if (sunxi_pgtable_params.iopte_cache == iopte_cache)
+		sunxi_pgtable_params.iopte_cache = NULL;
+}
+
+/* the page table cache only exists while an iommu is bound */
+bool sunxi_pgtable_in_use(void)
+{
+	return sunxi_pgtable_params.iopte_cache != NULL;
 }
 
 
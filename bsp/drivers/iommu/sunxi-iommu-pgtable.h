@@ -135,7 +135,8 @@ int sunxi_pgtable_prepare_l2_tables(unsigned int *pgtable,
 				    dma_addr_t iova_start, dma_addr_t iova_end,
 				    phys_addr_t paddr, int prot);
 int sunxi_pgtable_delete_l2_tables(unsigned int *pgtable, dma_addr_t iova_start,
-				   dma_addr_t iova_end);
+				   dma_addr_t iova_end, u32 **l2_table);
+void sunxi_pgtable_free_l2_tables(u32 **l2_tables, unsigned int cnt);
 phys_addr_t sunxi_pgtable_iova_to_phys(unsigned int *pgtable, dma_addr_t iova);
 int sunxi_pgtable_invalid_helper(unsigned int *pgtable, dma_addr_t iova);
 void sunxi_pgtable_clear(unsigned int *pgtable);
@@ -146,5 +147,6 @@ ssize_t sunxi_pgtable_dump(unsigned int *pgtable, ssize_t len, char *buf,
 struct kmem_cache *sunxi_pgtable_alloc_pte_cache(void);
 void sunxi_pgtable_free_pte_cache(struct kmem_cache *iopte_cache);
 void sunxi_pgtable_set_dma_dev(struct device *dma_dev);
+bool sunxi_pgtable_in_use(void);
 
 #endif
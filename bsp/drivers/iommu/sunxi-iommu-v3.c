@@ -319,6 +319,8 @@ struct sunxi_iommu_dev {
 	struct sunxi_iommu_plat_data *plat_data;
 };
 
+#define SUNXI_L2_PENDING_MAX 32
+
 struct sunxi_iommu_domain {
 	unsigned int *pgtable;		/* first page directory, size is 16KB */
 	u32 *sg_buffer;
@@ -329,6 +331,9 @@ struct sunxi_iommu_domain {
 	/* list of master device, it represent a micro TLB */
 	struct list_head mdevs;
 	spinlock_t lock;
+	/* emptied l2 tables waiting for iotlb_sync, protected by dt_lock */
+	u32 *l2_pending[SUNXI_L2_PENDING_MAX];
+	unsigned int l2_pending_cnt;
 };
 
 /*
@@ -711,16 +716,67 @@ static int sunxi_iommu_map(struct iommu_domain *domain, unsigned long iova,
 	return 0;
 }
 
+#ifdef MAP_PAGES_API
+static int sunxi_iommu_map_pages(struct iommu_domain *domain,
+				 unsigned long iova, phys_addr_t paddr,
+				 size_t pgsize, size_t pgcount, int prot,
+				 gfp_t gfp, size_t *mapped)
+{
+	size_t size = pgsize * pgcount;
+	int ret;
+
+	ret = sunxi_iommu_map(domain, iova, paddr, size, prot, gfp);
+	if (!ret)
+		*mapped = size;
+
+	return ret;
+}
+#endif
+
+static void sunxi_iommu_free_l2_pending(struct sunxi_iommu_domain *sunxi_domain)
+{
+	sunxi_pgtable_free_l2_tables(sunxi_domain->l2_pending,
+				     sunxi_domain->l2_pending_cnt);
+	sunxi_domain->l2_pending_cnt = 0;
+}
+
+/*
+ * invalid TLB and PTW cache of [iova_start, iova_end) and release the l2
+ * tables emptied by unmap, caller should hold dt_lock
+ */
+static void sunxi_iommu_flush_range(struct sunxi_iommu_domain *sunxi_domain,
+				    unsigned long iova_start,
+				    unsigned long iova_end)
+{
+	const struct sunxi_iommu_plat_data *plat_data =
+		global_iommu_dev->plat_data;
+	unsigned long iova;
+
+	if (iova_start < iova_end) {
+		if (plat_data->version >= IOMMU_VERSION_V12)
+			sunxi_tlb_invalid(iova_start, iova_end);
+		if (plat_data->version >= IOMMU_VERSION_V14) {
+			sunxi_ptw_cache_invalid(iova_start, iova_end);
+		} else {
+			for (iova = iova_start & IOMMU_PD_MASK; iova < iova_end;
+			     iova += SPD_SIZE)
+				sunxi_ptw_cache_invalid(iova, 0);
+			sunxi_zap_tlb(iova_start, iova_end - iova_start);
+		}
+	}
+
+	sunxi_iommu_free_l2_pending(sunxi_domain);
+}
+
 static size_t sunxi_iommu_unmap(struct iommu_domain *domain, unsigned long iova,
 				size_t size, struct iommu_iotlb_gather *gather)
 {
 	struct sunxi_iommu_domain *sunxi_domain;
-	const struct sunxi_iommu_plat_data *plat_data;
 	size_t iova_start, iova_end;
 	u32 iova_tail_size;
+	u32 *l2_table;
 
 	sunxi_domain = container_of(domain, struct sunxi_iommu_domain, domain);
-	plat_data = global_iommu_dev->plat_data;
 	WARN_ON(sunxi_domain->pgtable == NULL);
 	iova_start = iova & IOMMU_PT_MASK;
 	iova_end = SPAGE_ALIGN(iova + size);
@@ -730,19 +786,24 @@ static size_t sunxi_iommu_unmap(struct iommu_domain *domain, unsigned long iova,
 	if (gather->end < iova_end)
 		gather->end = iova_end;
 
+	/*
+	 * only clear the page table here, TLB and PTW cache are invalidated
+	 * once for the whole gathered range in iotlb_sync, emptied l2 tables
+	 * are kept until then since PTW may still walk them.
+	 */
 	mutex_lock(&sunxi_domain->dt_lock);
-	/* Invalid TLB and PTW */
-	if (plat_data->version >= IOMMU_VERSION_V12)
-		sunxi_tlb_invalid(iova_start, iova_end);
-	if (plat_data->version >= IOMMU_VERSION_V14)
-		sunxi_ptw_cache_invalid(iova_start, iova_end);
-
-	for (; iova_start < iova_end; ) {
+	for (; iova_start < iova_end;) {
+		l2_table = NULL;
 		iova_tail_size = sunxi_pgtable_delete_l2_tables(
-			 sunxi_domain->pgtable, iova_start, iova_end);
-
-		if (plat_data->version < IOMMU_VERSION_V14)
-			sunxi_ptw_cache_invalid(iova_start, 0);
+			sunxi_domain->pgtable, iova_start, iova_end, &l2_table);
+		if (l2_table) {
+			if (sunxi_domain->l2_pending_cnt == SUNXI_L2_PENDING_MAX)
+				sunxi_iommu_flush_range(sunxi_domain,
+							gather->start,
+							gather->end);
+			sunxi_domain->l2_pending[sunxi_domain->l2_pending_cnt++] =
+				l2_table;
+		}
 		iova_start += iova_tail_size;
 	}
 	mutex_unlock(&sunxi_domain->dt_lock);
@@ -750,6 +811,16 @@ static size_t sunxi_iommu_unmap(struct iommu_domain *domain, unsigned long iova,
 	return size;
 }
 
+#ifdef MAP_PAGES_API
+static size_t sunxi_iommu_unmap_pages(struct iommu_domain *domain,
+				      unsigned long iova, size_t pgsize,
+				      size_t pgcount,
+				      struct iommu_iotlb_gather *gather)
+{
+	return sunxi_iommu_unmap(domain, iova, pgsize * pgcount, gather);
+}
+#endif
+
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 15, 0)
 static void sunxi_iommu_iotlb_sync_map(struct iommu_domain *domain,
 				unsigned long iova, size_t size)
@@ -770,14 +841,10 @@ static void sunxi_iommu_iotlb_sync(struct iommu_domain *domain,
 {
 	struct sunxi_iommu_domain *sunxi_domain =
 		container_of(domain, struct sunxi_iommu_domain, domain);
-	struct sunxi_iommu_dev *iommu = global_iommu_dev;
-	const struct sunxi_iommu_plat_data *plat_data = iommu->plat_data;
-
-	if (plat_data->version >= IOMMU_VERSION_V14)
-		return ;
 
 	mutex_lock(&sunxi_domain->dt_lock);
-	sunxi_zap_tlb(iotlb_gather->start, iotlb_gather->end -iotlb_gather->start);
+	sunxi_iommu_flush_range(sunxi_domain, iotlb_gather->start,
+				iotlb_gather->end);
 	mutex_unlock(&sunxi_domain->dt_lock);
 
 	return;
@@ -791,9 +858,8 @@ static phys_addr_t sunxi_iommu_iova_to_phys(struct iommu_domain *domain,
 	phys_addr_t ret = 0;
 
 	WARN_ON(sunxi_domain->pgtable == NULL);
-	mutex_lock(&sunxi_domain->dt_lock);
+	/* page table walk is rcu safe, no need to wait for map/unmap */
 	ret = sunxi_pgtable_iova_to_phys(sunxi_domain->pgtable, iova);
-	mutex_unlock(&sunxi_domain->dt_lock);
 
 	return ret;
 }
@@ -868,6 +934,7 @@ static void sunxi_iommu_domain_free(struct iommu_domain *domain)
 	mutex_lock(&sunxi_domain->dt_lock);
 	sunxi_pgtable_clear(sunxi_domain->pgtable);
 	sunxi_tlb_flush(global_iommu_dev);
+	sunxi_iommu_free_l2_pending(sunxi_domain);
 	mutex_unlock(&sunxi_domain->dt_lock);
 	sunxi_pgtable_free(sunxi_domain->pgtable);
 	sunxi_domain->pgtable = NULL;
@@ -1587,8 +1654,8 @@ static void sunxi_iommu_get_resv_regions(struct device *dev,
 static const struct iommu_domain_ops sunxi_iommu_domain_ops = {
 	.attach_dev	= sunxi_iommu_attach_dev,
 	.detach_dev	= sunxi_iommu_detach_dev,
-	.map		= sunxi_iommu_map,
-	.unmap		= sunxi_iommu_unmap,
+	.map_pages	= sunxi_iommu_map_pages,
+	.unmap_pages	= sunxi_iommu_unmap_pages,
 	.iotlb_sync_map = sunxi_iommu_iotlb_sync_map,
 	.iova_to_phys	= sunxi_iommu_iova_to_phys,
 	.iotlb_sync	= sunxi_iommu_iotlb_sync,
@@ -1610,8 +1677,13 @@ static const struct iommu_ops sunxi_iommu_ops = {
 #else
 static const struct iommu_ops sunxi_iommu_ops = {
 	.pgsize_bitmap = SZ_4K | SZ_16K | SZ_64K | SZ_256K | SZ_1M | SZ_4M | SZ_16M,
+#ifdef MAP_PAGES_API
+	.map_pages = sunxi_iommu_map_pages,
+	.unmap_pages = sunxi_iommu_unmap_pages,
+#else
 	.map  = sunxi_iommu_map,
 	.unmap = sunxi_iommu_unmap,
+#endif
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 15, 0)
 	.iotlb_sync_map = sunxi_iommu_iotlb_sync_map,
 #endif
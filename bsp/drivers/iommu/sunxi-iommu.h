@@ -31,6 +31,11 @@
 #define RESV_REGION_NEED_GFP_FLAG
 #endif
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 15, 0)
+//iommu core map/unmap runs of same size pages in one call
+#define MAP_PAGES_API
+#endif
+
 #ifdef DMA_IOMMU_IN_IOMMU
 #include <linux/iommu.h>
 /*
@@ -25,6 +25,7 @@
 #include <linux/hwmon.h>
 #include <linux/hwmon-sysfs.h>
 #include <asm/cacheflush.h>
+#include "sunxi_mbus_perf.h"
 
 #define DRIVER_NAME                 "MBUS"
 #define DRIVER_NAME_PMU             DRIVER_NAME"_PMU"
@@ -127,6 +128,7 @@ struct mbus_master_manager_t {
 	struct attribute_group
 		mbus_groups[2 + 1]; /* one for port(rw), one for master(r)*/
 	uint32_t *pmu_idxs; /* pmu bw reading */
+	int pmu_cnt;
 	int pmu_max;
 	uint32_t *port_idxs; /* by master configuration */
 	int port_max;
@@ -1063,6 +1065,7 @@ static int mbus_master_manager_init(struct device *dev)
 				      of_names, bw_read_idx_cnt);
 	of_property_read_variable_u32_array(dev->of_node, "master_pmu_idxs",
 					    active_idxs, 0, bw_read_idx_cnt);
+	mbus_master_manager.pmu_cnt = bw_read_idx_cnt;
 	mbus_master_manager.pmu_max = 0;
 	for (i = 0; i < bw_read_idx_cnt; i++) {
 		memcpy(&mbus_master_manager.dev_attr_buf[i],
@@ -1142,6 +1145,60 @@ mbus_master_manager_deinit(__maybe_unused struct device *dev)
 		devm_kfree(dev, mbus_master_manager.mbus_groups[0].attrs);
 }
 
+#if IS_ENABLED(CONFIG_AW_MBUS_PERF)
+static struct sunxi_mbus_perf *mbus_perf;
+
+static void mbus_perf_enable(void *priv)
+{
+	/* confirm the pmu is enabled */
+	if (!mbus_pmu_getstate())
+		mbus_pmu_enable();
+}
+
+static u32 mbus_perf_read(void *priv, unsigned int idx)
+{
+	return readl_relaxed(mbus_ctrl_base + MBUS_PMU_CNT_REG(idx));
+}
+
+static const struct sunxi_mbus_perf_ops mbus_perf_ops = {
+	.enable = mbus_perf_enable,
+	.read = mbus_perf_read,
+};
+
+/* the same masters as the hwmon pmu files, as sunxi_mbus/<name>/ */
+static void mbus_perf_init(struct device *dev)
+{
+	struct sunxi_mbus_perf_master *masters;
+	int i, cnt = mbus_master_manager.pmu_cnt;
+
+	masters = kcalloc(cnt, sizeof(*masters), GFP_KERNEL);
+	if (!masters)
+		return;
+
+	for (i = 0; i < cnt; i++) {
+		masters[i].name = mbus_master_manager.name_buf[i];
+		masters[i].idx = mbus_master_manager.pmu_idxs[i];
+	}
+
+	mbus_perf = sunxi_mbus_perf_register("sunxi_mbus", &mbus_perf_ops, NULL,
+					     masters, cnt);
+	if (IS_ERR(mbus_perf)) {
+		dev_warn(dev, "perf pmu not registered: %ld\n", PTR_ERR(mbus_perf));
+		mbus_perf = NULL;
+	}
+	kfree(masters);
+}
+
+static void mbus_perf_exit(void)
+{
+	sunxi_mbus_perf_unregister(mbus_perf);
+	mbus_perf = NULL;
+}
+#else
+static inline void mbus_perf_init(struct device *dev) {}
+static inline void mbus_perf_exit(void) {}
+#endif
+
 static int mbus_pmu_probe(struct platform_device *pdev)
 {
 	int ret;
@@ -1167,6 +1224,8 @@ static int mbus_pmu_probe(struct platform_device *pdev)
 	hw_mbus_pmu.valid = 0;
 	mutex_init(&hw_mbus_pmu.update_lock);
 
+	mbus_perf_init(&pdev->dev);
+
 	return 0;
 
 out_err:
@@ -1178,6 +1237,7 @@ out_err:
 
 static int mbus_pmu_remove(struct platform_device *pdev)
 {
+	mbus_perf_exit();
 	hwmon_device_unregister(hw_mbus_pmu.hwmon_dev);
 	mbus_master_manager_deinit(&pdev->dev);
 	sysfs_remove_group(&pdev->dev.kobj, mbus_master_manager.mbus_groups);
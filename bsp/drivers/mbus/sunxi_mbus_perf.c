@@ -0,0 +1,401 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/* Copyright(c) 2020 - 2023 Allwinner Technology Co.,Ltd. All rights reserved. */
+/*
+ * Allwinner SUNXI MBUS perf PMU
+ *
+ * One event per MBUS master bandwidth counter, named after the master
+ * in the device tree:
+ *
+ *   perf stat -a -e sunxi_mbus/gpu_rd/,sunxi_mbus/ve_rd/ -- sleep 1
+ *   perf record -a -c 1048576 -e sunxi_mbus/gpu_rd/ -- ./workload
+ *
+ * The counters are free running and shared, any number of events may
+ * count the same master. They raise no interrupt, so the events are
+ * updated by a timer every poll_ms while one is active, and sampling
+ * events overflow from that timer, with the registers it interrupted.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define pr_fmt(fmt) "sunxi_mbus_perf: " fmt
+
+#include <linux/cpuhotplug.h>
+#include <linux/cpumask.h>
+#include <linux/irq_regs.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include "sunxi_mbus_perf.h"
+
+static unsigned int poll_ms = 10;
+module_param(poll_ms, uint, 0644);
+MODULE_PARM_DESC(poll_ms, "counter poll and sampling period in msec (default: 10)");
+
+static enum cpuhp_state mbus_perf_hp_state;
+
+static void mbus_perf_event_update(struct perf_event *event)
+{
+	struct sunxi_mbus_perf *mp = to_sunxi_mbus_perf(event->pmu);
+	struct hw_perf_event *hwc = &event->hw;
+	u32 prev, now, delta;
+
+	now = mp->ops->read(mp->priv, hwc->idx);
+	prev = local64_xchg(&hwc->prev_count, now);
+	/* 32 bit counter, the poll period keeps it from wrapping twice */
+	delta = now - prev;
+
+	local64_add(delta, &event->count);
+	if (is_sampling_event(event))
+		local64_sub(delta, &hwc->period_left);
+}
+
+static enum hrtimer_restart mbus_perf_timer(struct hrtimer *timer)
+{
+	struct sunxi_mbus_perf *mp = container_of(timer, struct sunxi_mbus_perf, timer);
+	struct pt_regs *regs = get_irq_regs();
+	struct perf_sample_data data;
+	struct hw_perf_event *hwc;
+	struct perf_event *event;
+	s64 left;
+
+	list_for_each_entry(event, &mp->active, active_entry) {
+		hwc = &event->hw;
+		if (hwc->state & PERF_HES_STOPPED)
+			continue;
+
+		mbus_perf_event_update(event);
+		if (!is_sampling_event(event))
+			continue;
+
+		left = local64_read(&hwc->period_left);
+		if (left > 0)
+			continue;
+		left += hwc->sample_period;
+		if (left <= 0)
+			left = hwc->sample_period;
+		local64_set(&hwc->period_left, left);
+		hwc->last_period = hwc->sample_period;
+
+		if (!regs)
+			continue;
+		perf_sample_data_init(&data, 0, hwc->last_period);
+		if (perf_event_overflow(event, &data, regs))
+			event->pmu->stop(event, 0);
+	}
+
+	hrtimer_forward_now(timer, ms_to_ktime(max(poll_ms, 1U)));
+	return HRTIMER_RESTART;
+}
+
+static bool mbus_perf_valid_idx(struct sunxi_mbus_perf *mp, u64 config)
+{
+	int i;
+
+	for (i = 0; i < mp->num; i++)
+		if (mp->idxs[i] == config)
+			return true;
+
+	return false;
+}
+
+static int mbus_perf_event_init(struct perf_event *event)
+{
+	struct sunxi_mbus_perf *mp = to_sunxi_mbus_perf(event->pmu);
+	struct hw_perf_event *hwc = &event->hw;
+
+	if (event->attr.type != event->pmu->type)
+		return -ENOENT;
+
+	/* uncore, there is no per task counting */
+	if (event->cpu < 0 || event->attach_state & PERF_ATTACH_TASK)
+		return -EINVAL;
+
+	if (has_branch_stack(event))
+		return -EOPNOTSUPP;
+
+	if (!mbus_perf_valid_idx(mp, event->attr.config))
+		return -EINVAL;
+
+	/* all events of the pmu live on one cpu */
+	event->cpu = mp->cpu;
+	hwc->idx = event->attr.config;
+	hwc->config = event->attr.config;
+
+	if (mp->ops->enable)
+		mp->ops->enable(mp->priv);
+
+	return 0;
+}
+
+static void mbus_perf_event_start(struct perf_event *event, int flags)
+{
+	struct sunxi_mbus_perf *mp = to_sunxi_mbus_perf(event->pmu);
+	struct hw_perf_event *hwc = &event->hw;
+
+	if (flags & PERF_EF_RELOAD && is_sampling_event(event))
+		local64_set(&hwc->period_left, hwc->sample_period);
+
+	hwc->state = 0;
+	local64_set(&hwc->prev_count, mp->ops->read(mp->priv, hwc->idx));
+}
+
+static void mbus_perf_event_stop(struct perf_event *event, int flags)
+{
+	struct hw_perf_event *hwc = &event->hw;
+
+	if (hwc->state & PERF_HES_STOPPED)
+		return;
+
+	mbus_perf_event_update(event);
+	hwc->state |= PERF_HES_STOPPED | PERF_HES_UPTODATE;
+}
+
+static int mbus_perf_event_add(struct perf_event *event, int flags)
+{
+	struct sunxi_mbus_perf *mp = to_sunxi_mbus_perf(event->pmu);
+	struct hw_perf_event *hwc = &event->hw;
+
+	hwc->state = PERF_HES_STOPPED | PERF_HES_UPTODATE;
+	if (list_empty(&mp->active))
+		hrtimer_start(&mp->timer, ms_to_ktime(max(poll_ms, 1U)),
+			      HRTIMER_MODE_REL_PINNED_HARD);
+	list_add_tail(&event->active_entry, &mp->active);
+
+	if (flags & PERF_EF_START)
+		mbus_perf_event_start(event, PERF_EF_RELOAD);
+
+	perf_event_update_userpage(event);
+	return 0;
+}
+
+static void mbus_perf_event_del(struct perf_event *event, int flags)
+{
+	struct sunxi_mbus_perf *mp = to_sunxi_mbus_perf(event->pmu);
+
+	mbus_perf_event_stop(event, PERF_EF_UPDATE);
+	list_del(&event->active_entry);
+	/* irqs are off and the timer is pinned here, it is not running */
+	if (list_empty(&mp->active))
+		hrtimer_try_to_cancel(&mp->timer);
+
+	perf_event_update_userpage(event);
+}
+
+static void mbus_perf_event_read(struct perf_event *event)
+{
+	if (!(event->hw.state & PERF_HES_STOPPED))
+		mbus_perf_event_update(event);
+}
+
+static ssize_t cpumask_show(struct device *dev, struct device_attribute *attr,
+			    char *buf)
+{
+	struct sunxi_mbus_perf *mp = to_sunxi_mbus_perf(dev_get_drvdata(dev));
+
+	return cpumap_print_to_pagebuf(true, buf, cpumask_of(mp->cpu));
+}
+static DEVICE_ATTR_RO(cpumask);
+
+static struct attribute *mbus_perf_cpumask_attrs[] = {
+	&dev_attr_cpumask.attr,
+	NULL,
+};
+
+static const struct attribute_group mbus_perf_cpumask_group = {
+	.attrs = mbus_perf_cpumask_attrs,
+};
+
+PMU_FORMAT_ATTR(event, "config:0-7");
+
+static struct attribute *mbus_perf_format_attrs[] = {
+	&format_attr_event.attr,
+	NULL,
+};
+
+static const struct attribute_group mbus_perf_format_group = {
+	.name = "format",
+	.attrs = mbus_perf_format_attrs,
+};
+
+static int mbus_perf_offline_cpu(unsigned int cpu, struct hlist_node *node)
+{
+	struct sunxi_mbus_perf *mp = hlist_entry_safe(node, struct sunxi_mbus_perf, node);
+	unsigned int target;
+
+	if (cpu != mp->cpu)
+		return 0;
+
+	target = cpumask_any_but(cpu_online_mask, cpu);
+	if (target >= nr_cpu_ids)
+		return 0;
+
+	perf_pmu_migrate_context(&mp->pmu, cpu, target);
+	mp->cpu = target;
+
+	return 0;
+}
+
+static void mbus_perf_free_events(struct sunxi_mbus_perf *mp)
+{
+	int i;
+
+	if (mp->event_attrs)
+		for (i = 0; i < mp->num; i++) {
+			kfree(mp->event_attrs[i].attr.attr.name);
+			kfree(mp->event_attrs[i].event_str);
+		}
+	kfree(mp->event_attrs);
+	kfree(mp->attrs);
+	kfree(mp->idxs);
+}
+
+static int mbus_perf_alloc_events(struct sunxi_mbus_perf *mp,
+				  const struct sunxi_mbus_perf_master *masters)
+{
+	struct perf_pmu_events_attr *pa;
+	int i;
+
+	mp->idxs = kcalloc(mp->num, sizeof(*mp->idxs), GFP_KERNEL);
+	mp->event_attrs = kcalloc(mp->num, sizeof(*mp->event_attrs), GFP_KERNEL);
+	mp->attrs = kcalloc(mp->num + 1, sizeof(*mp->attrs), GFP_KERNEL);
+	if (!mp->idxs || !mp->event_attrs || !mp->attrs)
+		return -ENOMEM;
+
+	for (i = 0; i < mp->num; i++) {
+		pa = &mp->event_attrs[i];
+		sysfs_attr_init(&pa->attr.attr);
+		pa->attr.attr.name = kstrdup(masters[i].name, GFP_KERNEL);
+		pa->event_str = kasprintf(GFP_KERNEL, "event=0x%02x", masters[i].idx);
+		if (!pa->attr.attr.name || !pa->event_str)
+			return -ENOMEM;
+		pa->attr.attr.mode = 0444;
+		pa->attr.show = perf_event_sysfs_show;
+		pa->id = masters[i].idx;
+
+		mp->idxs[i] = masters[i].idx;
+		mp->attrs[i] = &pa->attr.attr;
+	}
+
+	mp->events_group.name = "events";
+	mp->events_group.attrs = mp->attrs;
+
+	return 0;
+}
+
+/**
+ * sunxi_mbus_perf_register() - register a perf PMU for MBUS counters
+ *
+ * @name: PMU name, e.g. sunxi_mbus
+ * @ops: counter access
+ * @priv: passed to @ops
+ * @masters: one event per entry
+ * @num: number of @masters
+ *
+ * Return: the PMU or an ERR_PTR().
+ */
+struct sunxi_mbus_perf *sunxi_mbus_perf_register(const char *name,
+						 const struct sunxi_mbus_perf_ops *ops,
+						 void *priv,
+						 const struct sunxi_mbus_perf_master *masters,
+						 int num)
+{
+	struct sunxi_mbus_perf *mp;
+	int i, ret;
+
+	if (!ops || !ops->read || !masters || num <= 0)
+		return ERR_PTR(-EINVAL);
+	for (i = 0; i < num; i++)
+		if (masters[i].idx > 0xff)
+			return ERR_PTR(-EINVAL);
+	if (!mbus_perf_hp_state)
+		return ERR_PTR(-ENODEV);
+
+	mp = kzalloc(sizeof(*mp), GFP_KERNEL);
+	if (!mp)
+		return ERR_PTR(-ENOMEM);
+
+	mp->ops = ops;
+	mp->priv = priv;
+	mp->num = num;
+	INIT_LIST_HEAD(&mp->active);
+	hrtimer_init(&mp->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL_HARD);
+	mp->timer.function = mbus_perf_timer;
+
+	ret = mbus_perf_alloc_events(mp, masters);
+	if (ret)
+		goto err_free;
+
+	mp->attr_groups[0] = &mp->events_group;
+	mp->attr_groups[1] = &mbus_perf_format_group;
+	mp->attr_groups[2] = &mbus_perf_cpumask_group;
+
+	mp->pmu = (struct pmu) {
+		.module		= THIS_MODULE,
+		.task_ctx_nr	= perf_invalid_context,
+		.capabilities	= PERF_PMU_CAP_NO_EXCLUDE,
+		.attr_groups	= mp->attr_groups,
+		.event_init	= mbus_perf_event_init,
+		.add		= mbus_perf_event_add,
+		.del		= mbus_perf_event_del,
+		.start		= mbus_perf_event_start,
+		.stop		= mbus_perf_event_stop,
+		.read		= mbus_perf_event_read,
+	};
+
+	cpus_read_lock();
+	mp->cpu = cpumask_first(cpu_online_mask);
+	ret = cpuhp_state_add_instance_nocalls_cpuslocked(mbus_perf_hp_state, &mp->node);
+	cpus_read_unlock();
+	if (ret)
+		goto err_free;
+
+	ret = perf_pmu_register(&mp->pmu, name, -1);
+	if (ret) {
+		pr_err("register pmu %s failed: %d\n", name, ret);
+		goto err_hp;
+	}
+
+	pr_info("%s: %d masters\n", name, num);
+	return mp;
+
+err_hp:
+	cpuhp_state_remove_instance_nocalls(mbus_perf_hp_state, &mp->node);
+err_free:
+	mbus_perf_free_events(mp);
+	kfree(mp);
+	return ERR_PTR(ret);
+}
+EXPORT_SYMBOL_GPL(sunxi_mbus_perf_register);
+
+void sunxi_mbus_perf_unregister(struct sunxi_mbus_perf *mp)
+{
+	if (IS_ERR_OR_NULL(mp))
+		return;
+
+	perf_pmu_unregister(&mp->pmu);
+	cpuhp_state_remove_instance_nocalls(mbus_perf_hp_state, &mp->node);
+	mbus_perf_free_events(mp);
+	kfree(mp);
+}
+EXPORT_SYMBOL_GPL(sunxi_mbus_perf_unregister);
+
+static int __init sunxi_mbus_perf_init(void)
+{
+	int ret;
+
+	ret = cpuhp_setup_state_multi(CPUHP_AP_ONLINE_DYN, "perf/sunxi/mbus:online",
+				      NULL, mbus_perf_offline_cpu);
+	if (ret < 0) {
+		pr_err("setup cpu hotplug state failed: %d\n", ret);
+		return ret;
+	}
+	mbus_perf_hp_state = ret;
+
+	return 0;
+}
+subsys_initcall(sunxi_mbus_perf_init);
+
+MODULE_LICENSE("GPL v2");
+MODULE_DESCRIPTION("SUNXI MBUS perf PMU");
@@ -0,0 +1,72 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright(c) 2020 - 2023 Allwinner Technology Co.,Ltd. All rights reserved. */
+/*
+ * Allwinner SUNXI MBUS perf PMU
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef __SUNXI_MBUS_PERF_H__
+#define __SUNXI_MBUS_PERF_H__
+
+#include <linux/hrtimer.h>
+#include <linux/list.h>
+#include <linux/perf_event.h>
+
+/**
+ * struct sunxi_mbus_perf_ops - access to the master bandwidth counters
+ *
+ * @enable: start the counters, may be called more than once
+ * @read: read the free running 32 bit counter @idx, from any context
+ */
+struct sunxi_mbus_perf_ops {
+	void (*enable)(void *priv);
+	u32 (*read)(void *priv, unsigned int idx);
+};
+
+/**
+ * struct sunxi_mbus_perf_master - one event of the PMU
+ *
+ * @name: event name, e.g. gpu_rd for sunxi_mbus/gpu_rd/
+ * @idx: counter index passed to ops->read(), the event config
+ */
+struct sunxi_mbus_perf_master {
+	const char *name;
+	u32 idx;
+};
+
+/**
+ * struct sunxi_mbus_perf - MBUS perf PMU
+ *
+ * The counters raise no interrupt, events are updated by @timer every
+ * poll_ms, often enough not to miss a 32 bit wrap, and sampling events
+ * overflow from there too.
+ */
+struct sunxi_mbus_perf {
+	struct pmu pmu;
+	const struct sunxi_mbus_perf_ops *ops;
+	void *priv;
+	unsigned int cpu;
+	struct hlist_node node;
+	struct hrtimer timer;
+	struct list_head active;
+	u32 *idxs;
+	int num;
+	struct perf_pmu_events_attr *event_attrs;
+	struct attribute **attrs;
+	struct attribute_group events_group;
+	const struct attribute_group *attr_groups[4];
+};
+
+#define to_sunxi_mbus_perf(p) container_of(p, struct sunxi_mbus_perf, pmu)
+
+struct sunxi_mbus_perf *sunxi_mbus_perf_register(const char *name,
+						 const struct sunxi_mbus_perf_ops *ops,
+						 void *priv,
+						 const struct sunxi_mbus_perf_master *masters,
+						 int num);
+void sunxi_mbus_perf_unregister(struct sunxi_mbus_perf *mp);
+
+#endif /* __SUNXI_MBUS_PERF_H__ */
@@ -0,0 +1,249 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright(c) 2020 - 2023 Allwinner Technology Co.,Ltd. All rights reserved. */
+/*
+ * KUnit tests for the MBUS perf PMU
+ *
+ * The PMU is registered on a mocked counter block, an array of u32 the
+ * tests bump by hand, so no MBUS is needed and the suite runs under QEMU.
+ * Events are opened as kernel counters on the cpu of the PMU.
+ */
+
+#include <kunit/test.h>
+#include <linux/delay.h>
+#include <linux/perf_event.h>
+#include "sunxi_mbus_perf.h"
+
+#define MOCK_COUNTERS		8
+#define MOCK_CPU_IDX		0
+#define MOCK_GPU_IDX		2
+#define MOCK_VE_IDX		5
+/* not a master of the mocked block */
+#define MOCK_BAD_IDX		1
+
+struct mbus_perf_test_ctx {
+	u32 cnt[MOCK_COUNTERS];
+	int enabled;
+	atomic_t overflows;
+	struct sunxi_mbus_perf *mp;
+};
+
+static const struct sunxi_mbus_perf_master mock_masters[] = {
+	{ .name = "cpu", .idx = MOCK_CPU_IDX },
+	{ .name = "gpu_rd", .idx = MOCK_GPU_IDX },
+	{ .name = "ve_rd", .idx = MOCK_VE_IDX },
+};
+
+static void mock_enable(void *priv)
+{
+	struct mbus_perf_test_ctx *ctx = priv;
+
+	ctx->enabled++;
+}
+
+static u32 mock_read(void *priv, unsigned int idx)
+{
+	struct mbus_perf_test_ctx *ctx = priv;
+
+	return READ_ONCE(ctx->cnt[idx]);
+}
+
+static const struct sunxi_mbus_perf_ops mock_ops = {
+	.enable = mock_enable,
+	.read = mock_read,
+};
+
+static void mock_bump(struct mbus_perf_test_ctx *ctx, unsigned int idx, u32 n)
+{
+	WRITE_ONCE(ctx->cnt[idx], ctx->cnt[idx] + n);
+}
+
+static void mock_overflow(struct perf_event *event, struct perf_sample_data *data,
+			  struct pt_regs *regs)
+{
+	struct mbus_perf_test_ctx *ctx = event->overflow_handler_context;
+
+	atomic_inc(&ctx->overflows);
+}
+
+static struct perf_event *mbus_perf_test_open(struct mbus_perf_test_ctx *ctx,
+					      u64 config, u64 sample_period,
+					      int cpu, struct task_struct *task)
+{
+	struct perf_event_attr attr = {
+		.type = ctx->mp->pmu.type,
+		.size = sizeof(attr),
+		.config = config,
+		.sample_period = sample_period,
+	};
+
+	return perf_event_create_kernel_counter(&attr, cpu, task,
+						sample_period ? mock_overflow : NULL,
+						ctx);
+}
+
+static u64 mbus_perf_test_value(struct perf_event *event)
+{
+	u64 enabled, running;
+
+	return perf_event_read_value(event, &enabled, &running);
+}
+
+static void mbus_perf_test_count(struct kunit *test)
+{
+	struct mbus_perf_test_ctx *ctx = test->priv;
+	struct perf_event *event;
+
+	mock_bump(ctx, MOCK_GPU_IDX, 12345);
+	event = mbus_perf_test_open(ctx, MOCK_GPU_IDX, 0, ctx->mp->cpu, NULL);
+	KUNIT_ASSERT_FALSE(test, IS_ERR(event));
+	KUNIT_EXPECT_GT(test, ctx->enabled, 0);
+	KUNIT_EXPECT_TRUE(test, hrtimer_active(&ctx->mp->timer));
+
+	/* counts from when it is opened */
+	KUNIT_EXPECT_EQ(test, mbus_perf_test_value(event), 0ULL);
+	mock_bump(ctx, MOCK_GPU_IDX, 1000);
+	KUNIT_EXPECT_EQ(test, mbus_perf_test_value(event), 1000ULL);
+	/* other masters do not count */
+	mock_bump(ctx, MOCK_VE_IDX, 500);
+	mock_bump(ctx, MOCK_GPU_IDX, 234);
+	KUNIT_EXPECT_EQ(test, mbus_perf_test_value(event), 1234ULL);
+
+	/* and the poll timer keeps it up to date meanwhile */
+	mock_bump(ctx, MOCK_GPU_IDX, 766);
+	msleep(50);
+	KUNIT_EXPECT_EQ(test, mbus_perf_test_value(event), 2000ULL);
+
+	perf_event_release_kernel(event);
+	KUNIT_EXPECT_FALSE(test, hrtimer_active(&ctx->mp->timer));
+}
+
+static void mbus_perf_test_wrap(struct kunit *test)
+{
+	struct mbus_perf_test_ctx *ctx = test->priv;
+	struct perf_event *event;
+
+	ctx->cnt[MOCK_VE_IDX] = 0xffffff00;
+	event = mbus_perf_test_open(ctx, MOCK_VE_IDX, 0, ctx->mp->cpu, NULL);
+	KUNIT_ASSERT_FALSE(test, IS_ERR(event));
+
+	mock_bump(ctx, MOCK_VE_IDX, 0x200);
+	KUNIT_EXPECT_EQ(test, ctx->cnt[MOCK_VE_IDX], 0x100U);
+	KUNIT_EXPECT_EQ(test, mbus_perf_test_value(event), 0x200ULL);
+
+	/* past 32 bits in total, over several polls */
+	mock_bump(ctx, MOCK_VE_IDX, 0xc0000000);
+	msleep(50);
+	mock_bump(ctx, MOCK_VE_IDX, 0xc0000000);
+	KUNIT_EXPECT_EQ(test, mbus_perf_test_value(event), 0x180000200ULL);
+
+	perf_event_release_kernel(event);
+}
+
+static void mbus_perf_test_shared(struct kunit *test)
+{
+	struct mbus_perf_test_ctx *ctx = test->priv;
+	struct perf_event *a, *b;
+
+	a = mbus_perf_test_open(ctx, MOCK_GPU_IDX, 0, ctx->mp->cpu, NULL);
+	KUNIT_ASSERT_FALSE(test, IS_ERR(a));
+	mock_bump(ctx, MOCK_GPU_IDX, 100);
+
+	b = mbus_perf_test_open(ctx, MOCK_GPU_IDX, 0, ctx->mp->cpu, NULL);
+	KUNIT_ASSERT_FALSE(test, IS_ERR(b));
+	mock_bump(ctx, MOCK_GPU_IDX, 50);
+
+	KUNIT_EXPECT_EQ(test, mbus_perf_test_value(a), 150ULL);
+	KUNIT_EXPECT_EQ(test, mbus_perf_test_value(b), 50ULL);
+
+	/* the timer goes on for the one left */
+	perf_event_release_kernel(a);
+	KUNIT_EXPECT_TRUE(test, hrtimer_active(&ctx->mp->timer));
+	mock_bump(ctx, MOCK_GPU_IDX, 25);
+	KUNIT_EXPECT_EQ(test, mbus_perf_test_value(b), 75ULL);
+
+	perf_event_release_kernel(b);
+	KUNIT_EXPECT_FALSE(test, hrtimer_active(&ctx->mp->timer));
+}
+
+static void mbus_perf_test_invalid(struct kunit *test)
+{
+	struct mbus_perf_test_ctx *ctx = test->priv;
+	struct perf_event *event;
+
+	event = mbus_perf_test_open(ctx, MOCK_BAD_IDX, 0, ctx->mp->cpu, NULL);
+	KUNIT_EXPECT_TRUE(test, IS_ERR(event));
+	if (!IS_ERR(event))
+		perf_event_release_kernel(event);
+
+	/* no per task counting */
+	event = mbus_perf_test_open(ctx, MOCK_GPU_IDX, 0, -1, current);
+	KUNIT_EXPECT_TRUE(test, IS_ERR(event));
+	if (!IS_ERR(event))
+		perf_event_release_kernel(event);
+}
+
+static void mbus_perf_test_sampling(struct kunit *test)
+{
+	struct mbus_perf_test_ctx *ctx = test->priv;
+	struct perf_event *event;
+	int i;
+
+	atomic_set(&ctx->overflows, 0);
+	event = mbus_perf_test_open(ctx, MOCK_CPU_IDX, 1000, ctx->mp->cpu, NULL);
+	KUNIT_ASSERT_FALSE(test, IS_ERR(event));
+
+	/* below the period, nothing */
+	mock_bump(ctx, MOCK_CPU_IDX, 999);
+	msleep(50);
+	KUNIT_EXPECT_EQ(test, atomic_read(&ctx->overflows), 0);
+
+	/* one overflow per period crossed, seen by the next poll */
+	for (i = 0; i < 10; i++) {
+		mock_bump(ctx, MOCK_CPU_IDX, 1000);
+		msleep(50);
+	}
+	KUNIT_EXPECT_EQ(test, atomic_read(&ctx->overflows), 10);
+	KUNIT_EXPECT_EQ(test, mbus_perf_test_value(event), 10999ULL);
+
+	perf_event_release_kernel(event);
+}
+
+static int mbus_perf_test_init(struct kunit *test)
+{
+	struct mbus_perf_test_ctx *ctx;
+
+	ctx = kunit_kzalloc(test, sizeof(*ctx), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, ctx);
+
+	ctx->mp = sunxi_mbus_perf_register("sunxi_mbus_test", &mock_ops, ctx,
+					   mock_masters, ARRAY_SIZE(mock_masters));
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, ctx->mp);
+	test->priv = ctx;
+
+	return 0;
+}
+
+static void mbus_perf_test_exit(struct kunit *test)
+{
+	struct mbus_perf_test_ctx *ctx = test->priv;
+
+	sunxi_mbus_perf_unregister(ctx->mp);
+}
+
+static struct kunit_case mbus_perf_test_cases[] = {
+	KUNIT_CASE(mbus_perf_test_count),
+	KUNIT_CASE(mbus_perf_test_wrap),
+	KUNIT_CASE(mbus_perf_test_shared),
+	KUNIT_CASE(mbus_perf_test_invalid),
+	KUNIT_CASE(mbus_perf_test_sampling),
+	{},
+};
+
+static struct kunit_suite mbus_perf_test_suite = {
+	.name = "sunxi_mbus_perf",
+	.init = mbus_perf_test_init,
+	.exit = mbus_perf_test_exit,
+	.test_cases = mbus_perf_test_cases,
+};
+
+kunit_test_suite(mbus_perf_test_suite);
@@ -28,6 +28,7 @@
 struct cqhci_slot {
 	struct mmc_request *mrq;
 	unsigned int flags;
+	ktime_t issue;
 #define CQHCI_EXTERNAL_TIMEOUT	BIT(0)
 #define CQHCI_COMPLETED		BIT(1)
 #define CQHCI_HOST_CRC		BIT(2)
@@ -372,6 +373,7 @@ static u32 cqhci_read_ctl(struct cqhci_host *cq_host)
 static void cqhci_off(struct mmc_host *mmc)
 {
 	struct cqhci_host *cq_host = mmc->cqe_private;
+	unsigned long flags;
 	u32 reg;
 	int err;
 
@@ -394,6 +396,10 @@ static void cqhci_off(struct mmc_host *mmc)
 		cq_host->ops->post_disable(mmc);
 
 	mmc->cqe_on = false;
+
+	spin_lock_irqsave(&cq_host->lock, flags);
+	cq_host->stats.off++;
+	spin_unlock_irqrestore(&cq_host->lock, flags);
 }
 
 static void cqhci_disable(struct mmc_host *mmc)
@@ -719,12 +725,41 @@ static void cqhci_post_req(struct mmc_host *host, struct mmc_request *mrq)
 }
 #endif
 
+static void cqhci_stats_queued(struct cqhci_host *cq_host, int tag,
+			       bool turned_on, u64 map_ns)
+{
+	struct cqhci_stats *st = &cq_host->stats;
+	int bucket = min(fls(cq_host->qcnt - 1), CQHCI_QDEPTH_BUCKETS - 1);
+
+	st->qdepth[bucket]++;
+	st->qdepth_max = max_t(u32, st->qdepth_max, cq_host->qcnt);
+	if (turned_on)
+		st->on++;
+	if (cq_host->slot[tag].mrq->data) {
+		st->map_cnt++;
+		st->map_ns += map_ns;
+		st->map_max_ns = max(st->map_max_ns, map_ns);
+	}
+}
+
+static void cqhci_stats_done(struct cqhci_host *cq_host, struct cqhci_slot *slot)
+{
+	struct cqhci_stats *st = &cq_host->stats;
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), slot->issue));
+
+	st->cmpl_cnt++;
+	st->cmpl_ns += ns;
+	st->cmpl_max_ns = max(st->cmpl_max_ns, ns);
+}
+
 static int cqhci_request(struct mmc_host *mmc, struct mmc_request *mrq)
 {
 	int err = 0;
 	int tag = cqhci_tag(mrq);
 	struct cqhci_host *cq_host = mmc->cqe_private;
 	unsigned long flags;
+	bool turned_on = false;
+	ktime_t start, issue;
 
 	if (!cq_host->enabled) {
 		pr_err("%s: cqhci: not enabled\n", mmc_hostname(mmc));
@@ -748,8 +783,10 @@ static int cqhci_request(struct mmc_host *mmc, struct mmc_request *mrq)
 		}
 		if (cq_host->ops->enable)
 			cq_host->ops->enable(mmc);
+		turned_on = true;
 	}
 
+	start = ktime_get();
 	if (mrq->data) {
 		cqhci_prep_task_desc(mrq, cq_host, tag);
 
@@ -762,6 +799,7 @@ static int cqhci_request(struct mmc_host *mmc, struct mmc_request *mrq)
 	} else {
 		cqhci_prep_dcmd_desc(mmc, mrq);
 	}
+	issue = ktime_get();
 
 	spin_lock_irqsave(&cq_host->lock, flags);
 
@@ -772,8 +810,11 @@ static int cqhci_request(struct mmc_host *mmc, struct mmc_request *mrq)
 
 	cq_host->slot[tag].mrq = mrq;
 	cq_host->slot[tag].flags = 0;
+	cq_host->slot[tag].issue = issue;
 
 	cq_host->qcnt += 1;
+	cqhci_stats_queued(cq_host, tag, turned_on,
+			   ktime_to_ns(ktime_sub(issue, start)));
 	/* Make sure descriptors are ready before ringing the doorbell */
 	wmb();
 	cqhci_writel(cq_host, 1 << tag, CQHCI_TDBR);
@@ -927,6 +968,7 @@ static void cqhci_finish_mrq(struct mmc_host *mmc, unsigned int tag)
 	slot->mrq = NULL;
 
 	cq_host->qcnt -= 1;
+	cqhci_stats_done(cq_host, slot);
 
 	data = mrq->data;
 	if (data) {
@@ -1090,6 +1132,7 @@ static bool cqhci_halted(struct cqhci_host *cq_host)
 static bool cqhci_halt(struct mmc_host *mmc, unsigned int timeout)
 {
 	struct cqhci_host *cq_host = mmc->cqe_private;
+	unsigned long flags;
 	bool ret;
 	u32 ctl;
 
@@ -1109,6 +1152,11 @@ static bool cqhci_halt(struct mmc_host *mmc, unsigned int timeout)
 
 	ret = cqhci_halted(cq_host);
 
+	spin_lock_irqsave(&cq_host->lock, flags);
+	cq_host->stats.halt++;
+	if (!ret)
+		cq_host->stats.halt_fail++;
+	spin_unlock_irqrestore(&cq_host->lock, flags);
 	if (!ret)
 		pr_debug("%s: cqhci: Failed to halt\n", mmc_hostname(mmc));
 
@@ -226,6 +226,27 @@ struct cqhci_sg {
 };
 #endif
 
+#define CQHCI_QDEPTH_BUCKETS	6
+
+/* read by the host driver, updated under cq_host->lock */
+struct cqhci_stats {
+	/* queue depth once a task is queued: 1, 2, 3-4, 5-8, 9-16, 17-32 */
+	u64 qdepth[CQHCI_QDEPTH_BUCKETS];
+	u32 qdepth_max;
+	/* CQE turned back on by a request, and off for a non-CQ command */
+	u64 on;
+	u64 off;
+	u64 halt;
+	u64 halt_fail;
+	/* transfer descriptor setup (dma map) and doorbell to completion */
+	u64 map_cnt;
+	u64 map_ns;
+	u64 map_max_ns;
+	u64 cmpl_cnt;
+	u64 cmpl_ns;
+	u64 cmpl_max_ns;
+};
+
 struct cqhci_host {
 	const struct cqhci_host_ops *ops;
 	void __iomem *mmio;
@@ -279,6 +300,7 @@ struct cqhci_host {
 	struct completion halt_comp;
 	wait_queue_head_t wait_queue;
 	struct cqhci_slot *slot;
+	struct cqhci_stats stats;
 #if defined(CONFIG_ARCH_SUN55IW3)
 	struct cqhci_pages pages_slot[32];
 	struct cqhci_sg sg_slot[32];
@@ -40,6 +40,9 @@
 #include "sunxi-mmc-export.h"
 #include "sunxi-mmc-sun50iw1p1-2.h"
 #include "sunxi-mmc-panic.h"
+#if IS_ENABLED(CONFIG_AW_MMC_CQHCI)
+#include "cqhci.h"
+#endif
 #include <linux/mmc/card.h>
 #include <linux/delay.h>
 #include <card.h>
@@ -770,6 +773,110 @@ sunxi_mmc_set_perf(struct device *dev, struct device_attribute *attr,
 	return count;
 }
 
+static u64 sunxi_mmc_avg(u64 total, u64 cnt)
+{
+	return cnt ? div64_u64(total, cnt) : 0;
+}
+
+static ssize_t
+sunxi_mmc_show_cqe_stats(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct platform_device *pdev = to_platform_device(dev);
+	struct mmc_host	*mmc = platform_get_drvdata(pdev);
+	struct sunxi_mmc_host *host = mmc_priv(mmc);
+	struct sunxi_mmc_cqe_stats *st = &host->cqe_stats;
+	int len = 0;
+#if IS_ENABLED(CONFIG_AW_MMC_CQHCI)
+	struct cqhci_host *cq_host = mmc->cqe_private;
+	struct cqhci_stats *cst;
+	int i;
+#endif
+
+	len += sprintf(buf + len, "cqe batch: %d\n", host->cqe_batch);
+	len += sprintf(buf + len, "enable: %llu (kept setup %llu), disable: %llu, recovery: %llu\n",
+			st->enable, st->enable_fast, st->disable, st->recovery);
+	len += sprintf(buf + len, "cmd with data in halt: disable %llu, restore %llu\n",
+			st->nrml_dis, st->nrml_rstr);
+	len += sprintf(buf + len, "pre_req map: %llu, avg %llu ns, max %llu ns\n",
+			st->map_cnt, sunxi_mmc_avg(st->map_ns, st->map_cnt), st->map_max_ns);
+	len += sprintf(buf + len, "non-CQ request: %llu, avg %llu ns, max %llu ns\n",
+			st->req_cnt, sunxi_mmc_avg(st->req_ns, st->req_cnt), st->req_max_ns);
+
+#if IS_ENABLED(CONFIG_AW_MMC_CQHCI)
+	if (!cq_host)
+		return len;
+
+	cst = &cq_host->stats;
+	len += sprintf(buf + len, "cqe on: %llu, off: %llu, halt: %llu (failed %llu)\n",
+			cst->on, cst->off, cst->halt, cst->halt_fail);
+	len += sprintf(buf + len, "queue depth (1 2 3-4 5-8 9-16 17-32):");
+	for (i = 0; i < CQHCI_QDEPTH_BUCKETS; i++)
+		len += sprintf(buf + len, " %llu", cst->qdepth[i]);
+	len += sprintf(buf + len, ", max %u\n", cst->qdepth_max);
+	len += sprintf(buf + len, "task desc map: %llu, avg %llu ns, max %llu ns\n",
+			cst->map_cnt, sunxi_mmc_avg(cst->map_ns, cst->map_cnt), cst->map_max_ns);
+	len += sprintf(buf + len, "task done: %llu, avg %llu ns, max %llu ns\n",
+			cst->cmpl_cnt, sunxi_mmc_avg(cst->cmpl_ns, cst->cmpl_cnt), cst->cmpl_max_ns);
+#endif
+
+	return len;
+}
+
+static ssize_t
+sunxi_mmc_clear_cqe_stats(struct device *dev, struct device_attribute *attr,
+		const char *buf, size_t count)
+{
+	struct platform_device *pdev = to_platform_device(dev);
+	struct mmc_host	*mmc = platform_get_drvdata(pdev);
+	struct sunxi_mmc_host *host = mmc_priv(mmc);
+#if IS_ENABLED(CONFIG_AW_MMC_CQHCI)
+	struct cqhci_host *cq_host = mmc->cqe_private;
+#endif
+	unsigned long iflags;
+
+	spin_lock_irqsave(&host->lock, iflags);
+	memset(&host->cqe_stats, 0, sizeof(host->cqe_stats));
+	spin_unlock_irqrestore(&host->lock, iflags);
+#if IS_ENABLED(CONFIG_AW_MMC_CQHCI)
+	if (cq_host) {
+		spin_lock_irqsave(&cq_host->lock, iflags);
+		memset(&cq_host->stats, 0, sizeof(cq_host->stats));
+		spin_unlock_irqrestore(&cq_host->lock, iflags);
+	}
+#endif
+
+	return count;
+}
+
+static ssize_t
+sunxi_mmc_show_cqe_batch(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct platform_device *pdev = to_platform_device(dev);
+	struct mmc_host	*mmc = platform_get_drvdata(pdev);
+	struct sunxi_mmc_host *host = mmc_priv(mmc);
+
+	return sprintf(buf, "%d\n", host->cqe_batch);
+}
+
+static ssize_t
+sunxi_mmc_set_cqe_batch(struct device *dev, struct device_attribute *attr,
+		const char *buf, size_t count)
+{
+	struct platform_device *pdev = to_platform_device(dev);
+	struct mmc_host	*mmc = platform_get_drvdata(pdev);
+	struct sunxi_mmc_host *host = mmc_priv(mmc);
+	bool value;
+
+	if (kstrtobool(buf, &value))
+		return -EINVAL;
+
+	mmc_claim_host(mmc);
+	host->cqe_batch = value;
+	mmc_release_host(mmc);
+
+	return count;
+}
+
 extern void sunxi_mmc_set_ds_dl_raw(struct sunxi_mmc_host *host, int sunxi_ds_dl);
 extern void sunxi_mmc_set_samp_dl_raw(struct sunxi_mmc_host *host, int sunxi_samp_dl);
 extern ssize_t sunxi_mmc_panic_rtest(struct device *dev, struct device_attribute *attr, char *buf);
@@ -990,6 +1097,24 @@ int mmc_create_sys_fs(struct sunxi_mmc_host *host, struct platform_device *pdev)
 	if (ret)
 		return ret;
 
+	host->host_cqe_stats.show = sunxi_mmc_show_cqe_stats;
+	host->host_cqe_stats.store = sunxi_mmc_clear_cqe_stats;
+	sysfs_attr_init(&(host->host_cqe_stats.attr));
+	host->host_cqe_stats.attr.mode = S_IRUGO | S_IWUSR;
+	host->host_cqe_stats.attr.name = "sunxi_cqe_stats";
+	ret = device_create_file(&pdev->dev, &host->host_cqe_stats);
+	if (ret)
+		return ret;
+
+	host->host_cqe_batch.show = sunxi_mmc_show_cqe_batch;
+	host->host_cqe_batch.store = sunxi_mmc_set_cqe_batch;
+	sysfs_attr_init(&(host->host_cqe_batch.attr));
+	host->host_cqe_batch.attr.mode = S_IRUGO | S_IWUSR;
+	host->host_cqe_batch.attr.name = "sunxi_cqe_batch";
+	ret = device_create_file(&pdev->dev, &host->host_cqe_batch);
+	if (ret)
+		return ret;
+
 	host->filter_sector_perf.show = sunxi_mmc_show_filter_sector;
 	host->filter_sector_perf.store = sunxi_mmc_set_filter_sector;
 	sysfs_attr_init(&(host->filter_sector_perf.attr));
@@ -1130,6 +1255,8 @@ void mmc_remove_sys_fs(struct sunxi_mmc_host *host,
 {
 	device_remove_file(&pdev->dev, &host->host_mwr);
 	device_remove_file(&pdev->dev, &host->host_perf);
+	device_remove_file(&pdev->dev, &host->host_cqe_stats);
+	device_remove_file(&pdev->dev, &host->host_cqe_batch);
 	device_remove_file(&pdev->dev, &host->maual_insert);
 	device_remove_file(&pdev->dev, &host->dump_register[0]);
 	device_remove_file(&pdev->dev, &host->dump_register[1]);
@@ -147,6 +147,8 @@ static int sunxi_is_recovery_halt(struct mmc_host *mmc);
 static u32 sunxi_mmc_cqhci_irq(struct sunxi_mmc_host *host, u32 intmask);
 static bool sunxi_mmc_is_cqhci_halt(struct sunxi_mmc_host *host);
 static void cqhci_set_irqs(struct cqhci_host *cq_host, u32 set);
+static void sunxi_mmc_cqe_restore_nrml(struct sunxi_mmc_host *host,
+				       struct cqhci_host *cq_host);
 #else
 static int sunxi_is_recovery_halt(struct mmc_host *mmc)
 {
@@ -278,7 +280,10 @@ static void sunxi_timerout_handle(struct work_struct *work)
 				host->int_sum = 0;
 				host->wait_dma = false;
 				SM_ERR(mmc_dev(host->mmc), "too busy:done\n");
+				/* request_done takes host->lock for the stats */
+				spin_unlock_irqrestore(&host->lock, flags);
 				sunxi_mmc_request_done(host->mmc, mrq);
+				return;
 			}
 			goto timeout_out;
 		}
@@ -307,6 +312,20 @@ static void sunxi_mmc_request_done(struct mmc_host *mmc, struct mmc_request *mrq
 	unsigned long iflags;
 	enum mrq_slot slot, mrq_type;
 	struct redeposit_info *info = get_redeposit_info(host);
+	struct sunxi_mmc_cqe_stats *st = &host->cqe_stats;
+	u64 ns;
+
+	/* requests that fail before they are issued have no start time */
+	spin_lock_irqsave(&host->lock, iflags);
+	if (ktime_to_ns(host->req_start)) {
+		ns = ktime_to_ns(ktime_sub(ktime_get(), host->req_start));
+		host->req_start = 0;
+		st->req_cnt++;
+		st->req_ns += ns;
+		st->req_max_ns = max(st->req_max_ns, ns);
+	}
+	spin_unlock_irqrestore(&host->lock, iflags);
+
 	if ((host->ctl_spec_cap & SUNXI_SC_EN_TIMEOUT_DETECT)
 	    || unlikely(cmd->opcode == SD_SWITCH_VOLTAGE && (host->ctl_spec_cap & SUNXI_CMD11_TIMEOUT_DETECT))) {
 		cancel_delayed_work(&host->sunxi_timerout_work);
@@ -925,7 +944,6 @@ static int sunxi_mmc_finalize_request(struct sunxi_mmc_host *host)
 #if IS_ENABLED(CONFIG_AW_MMC_CQHCI)
 	struct mmc_card *card = host->mmc ? host->mmc->card : NULL;
 	struct cqhci_host *cq_host = host->mmc->cqe_private;
-	u32 tmp_irq;
 #endif
 	u32 imask = 0;
 	u32 cmd_val = 0;
@@ -1069,21 +1087,9 @@ out:
 						| EXT_CSD_CARD_TYPE_HS400ES | EXT_CSD_CARD_TYPE_DDR_52);
 	}
 
-	if (host->rstr_nrml) {
-		rval = cqhci_readl(cq_host, CQHCI_CFG);
-		rval |= CQHCI_ENABLE;
-		cqhci_writel(cq_host, rval, CQHCI_CFG);
-		tmp_irq = cqhci_readl(cq_host, CQHCI_ISTE);
-		cqhci_set_irqs(cq_host, 0);
-		rval = cqhci_readl(cq_host, CQHCI_CTL);
-		rval |= CQHCI_HALT;
-		cqhci_writel(cq_host, rval, CQHCI_CTL);
-		cqhci_set_irqs(cq_host, tmp_irq);
-		host->rstr_nrml = false;
-		SM_INFO(mmc_dev(host->mmc), "cmd with data done, restore cqe enable and halt:%x,%x,%x,%x\n",
-			cqhci_readl(cq_host, CQHCI_CFG), cqhci_readl(cq_host, CQHCI_CTL),
-			cqhci_readl(cq_host, CQHCI_ISTE), tmp_irq);
-	}
+	/* with cqe_batch the restore waits for the next CQ request, see .pre_enable */
+	if (host->rstr_nrml && !host->cqe_batch)
+		sunxi_mmc_cqe_restore_nrml(host, cq_host);
 #endif
 	mmc_writel(host, REG_IMASK, host->sdio_imask | host->dat3_imask);
 	mmc_writel(host, REG_RINTR, 0xffff);
@@ -2207,7 +2213,8 @@ static void sunxi_mmc_parse_cmd(struct mmc_host *mmc, struct mmc_command *cmd,
 		rval &= (~CQHCI_ENABLE);
 		cqhci_writel(cq_host, rval, CQHCI_CFG);
 		host->rstr_nrml = true;
-		SM_INFO(mmc_dev(mmc), "have to disable cqe when send cmd with data!!!, CQHCI_CFG:%x\n", cqhci_readl(cq_host, CQHCI_CFG));
+		host->cqe_stats.nrml_dis++;
+		SM_DBG(mmc_dev(mmc), "have to disable cqe when send cmd with data!!!, CQHCI_CFG:%x\n", cqhci_readl(cq_host, CQHCI_CFG));
 	}
 #endif
 }
@@ -2270,13 +2277,24 @@ static void sunxi_mmc_post_req(struct mmc_host *mmc, struct mmc_request *mrq,
 static void sunxi_mmc_pre_req(struct mmc_host *mmc, struct mmc_request *mrq)
 {
 	struct sunxi_mmc_host *host = mmc_priv(mmc);
+	struct sunxi_mmc_cqe_stats *st = &host->cqe_stats;
 	struct mmc_data *data = mrq->data;
+	ktime_t start = ktime_get();
+	unsigned long iflags;
+	u64 ns;
 
 	data->host_cookie = COOKIE_UNMAPPED;
 
 	sunxi_mmc_map_dma(host, data, COOKIE_PRE_MAPPED);
 	SM_DBG(mmc_dev(mmc), "prepare request %p\n", data);
 
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	spin_lock_irqsave(&host->lock, iflags);
+	st->map_cnt++;
+	st->map_ns += ns;
+	st->map_max_ns = max(st->map_max_ns, ns);
+	spin_unlock_irqrestore(&host->lock, iflags);
+
 }
 
 static void *sunxi_mmc_build_request(void *flash, void *buf, u32 sg_len, u32 addr, u32 nr_byte)
@@ -2490,6 +2508,7 @@ static int sunxi_mmc_request_parallel(void *flash, void *request, struct request
 		spin_lock_irqsave(&host->lock, iflags);
 	}
 
+	host->req_start = ktime_get();
 	host->mrq = mrq;
 	host->wait_dma = wait_dma;
 
@@ -2843,9 +2862,19 @@ static void sunxi_mmc_cqe_disable(struct mmc_host *mmc, bool recovery)
 		if (!(cqhci_readl(cq_host, CQHCI_CTL) & CQHCI_HALT)) {
 			SM_ERR(mmc_dev(host->mmc), "cqhci halt timeout when recovery doing!\n");
 		}
+		host->rstr_nrml = false;
 	}
+	spin_lock_irqsave(&host->lock, iflags);
+	if (recovery)
+		host->cqe_stats.recovery++;
+	host->cqe_stats.disable++;
+	spin_unlock_irqrestore(&host->lock, iflags);
 	host->cqe_on = false;
-	host->has_recovery = true;
+	/* a plain cqhci_off only halts, so the setup can be reused by .enable */
+	if (host->cqe_batch && !recovery)
+		host->cqe_parked = true;
+	else
+		host->has_recovery = true;
 }
 
 static void cqhci_set_irqs(struct cqhci_host *cq_host, u32 set)
@@ -2854,6 +2883,59 @@ static void cqhci_set_irqs(struct cqhci_host *cq_host, u32 set)
 	cqhci_writel(cq_host, set, CQHCI_ISGE);
 }
 
+/* caller holds host->lock */
+static void sunxi_mmc_cqe_restore_nrml(struct sunxi_mmc_host *host,
+				       struct cqhci_host *cq_host)
+{
+	u32 rval, tmp_irq;
+
+	rval = cqhci_readl(cq_host, CQHCI_CFG);
+	rval |= CQHCI_ENABLE;
+	cqhci_writel(cq_host, rval, CQHCI_CFG);
+	tmp_irq = cqhci_readl(cq_host, CQHCI_ISTE);
+	cqhci_set_irqs(cq_host, 0);
+	rval = cqhci_readl(cq_host, CQHCI_CTL);
+	rval |= CQHCI_HALT;
+	cqhci_writel(cq_host, rval, CQHCI_CTL);
+	cqhci_set_irqs(cq_host, tmp_irq);
+	host->rstr_nrml = false;
+	host->cqe_stats.nrml_rstr++;
+	SM_DBG(mmc_dev(host->mmc), "cmd with data done, restore cqe enable and halt:%x,%x,%x,%x\n",
+		cqhci_readl(cq_host, CQHCI_CFG), cqhci_readl(cq_host, CQHCI_CTL),
+		cqhci_readl(cq_host, CQHCI_ISTE), tmp_irq);
+}
+
+/*
+ * With cqe_batch the cqe stays disabled across a run of non-CQ commands
+ * with data and is enabled again right before cqhci_request leaves halt.
+ */
+static void sunxi_mmc_cqe_pre_enable(struct mmc_host *mmc)
+{
+	struct cqhci_host *cq_host = mmc->cqe_private;
+	struct sunxi_mmc_host *host = mmc_priv(mmc);
+	unsigned long flags;
+
+	spin_lock_irqsave(&host->lock, flags);
+	if (host->rstr_nrml)
+		sunxi_mmc_cqe_restore_nrml(host, cq_host);
+	spin_unlock_irqrestore(&host->lock, flags);
+}
+
+/*
+ * Non-CQ commands in between only touch the legacy registers, unless the
+ * host was reset or its clock gated, which loses the cqe setup as well.
+ */
+static bool sunxi_mmc_cqe_intact(struct sunxi_mmc_host *host,
+				 struct cqhci_host *cq_host)
+{
+	struct sunxi_mmc_ctrl_regs *bak_regs = &host->bak_regs;
+
+	return (cqhci_readl(cq_host, CQHCI_CFG) & CQHCI_ENABLE) &&
+		cqhci_readl(cq_host, CQHCI_TDLBA) == bak_regs->cqtdlba &&
+		cqhci_readl(cq_host, CQHCI_TDLBAU) == bak_regs->cqtdlbau &&
+		cqhci_readl(cq_host, CQHCI_SSC1) == bak_regs->cqssc1;
+}
+
 #if defined(CONFIG_ARCH_SUN55IW3)
 static u32 sunxi_mmc_read_l(struct cqhci_host *cq_host, int reg)
 {
@@ -2890,9 +2972,20 @@ static void sunxi_mmc_cqe_enable(struct mmc_host *mmc)
 	unsigned long flags;
 	u32 rval;
 	u32 imask = SDXC_INTERRUPT_ERROR_BIT;
+	bool fast = false;
 
 	spin_lock_irqsave(&host->lock, flags);
 
+	host->cqe_stats.enable++;
+	if (host->cqe_parked) {
+		host->cqe_parked = false;
+		fast = sunxi_mmc_cqe_intact(host, cq_host);
+		if (fast)
+			host->cqe_stats.enable_fast++;
+		else
+			host->has_recovery = true;
+	}
+
 	/* if cqe activate, it have to enable cqe by .enable;
 	 * which .cqe_enable may be not to enable cqe.
 	 * such as cqhci_request use .enable after recovery reset and reinit host cause clk on to off */
@@ -2934,6 +3027,12 @@ static void sunxi_mmc_cqe_enable(struct mmc_host *mmc)
 	mmc_writel(host, REG_DMAC, SDXC_IDMAC_FIX_BURST | SDXC_IDMAC_IDMA_ON);
 	mmc_writel(host, REG_IMASK, imask);
 
+	if (fast) {
+		host->cqe_on = true;
+		spin_unlock_irqrestore(&host->lock, flags);
+		return;
+	}
+
 	cqhci_writel(cq_host, 0x1000, CQHCI_SSC1);
 
 	/* Select cmdq mode */
@@ -2972,6 +3071,7 @@ static const struct cqhci_host_ops sunxi_mmc_cqhci_ops = {
 	.read_l = sunxi_mmc_read_l,
 	.enable	= sunxi_mmc_cqe_enable,
 	.disable = sunxi_mmc_cqe_disable,
+	.pre_enable = sunxi_mmc_cqe_pre_enable,
 	.dumpregs = sunxi_mmc_dump_regs,
 };
 #endif //#if IS_ENABLED(CONFIG_AW_MMC_CQHCI)
@@ -3550,6 +3650,8 @@ static int sunxi_mmc_extra_of_parse(struct mmc_host *mmc)
 		host->sunxi_caps3 |= MMC_SUNXI_CQE_ON;
 		if (of_property_read_bool(np, "int-clsc-on"))
 			host->sunxi_caps3 |= MMC_SUNXI_INT_CLSC_ON;
+		if (of_property_read_bool(np, "cqe-batch"))
+			host->cqe_batch = true;
 
 		ret = of_property_read_u32(np, "ctl-cmdq-md", &caps_val);
 		if (!ret) {
@@ -3749,6 +3851,7 @@ static int sunxi_mmc_probe(struct platform_device *pdev)
 #if IS_ENABLED(CONFIG_AW_MMC_CQHCI)
 	if (host->sunxi_caps3 & MMC_SUNXI_CQE_ON) {
 		host->has_recovery = false;
+		host->cqe_parked = false;
 		host->mmc->caps2 |= MMC_CAP2_CQE | MMC_CAP2_CQE_DCMD;
 
 		cq_host = devm_kzalloc(&pdev->dev, sizeof(*cq_host), GFP_KERNEL);
@@ -340,6 +340,25 @@ struct sunxi_mmc_host_perf{
 	ktime_t wtimetran;
 };
 
+/* command queue and legacy path counters, see sunxi_cqe_stats in sysfs */
+struct sunxi_mmc_cqe_stats {
+	/* .enable/.disable from cqhci, enable_fast kept the cqe setup */
+	u64 enable;
+	u64 enable_fast;
+	u64 disable;
+	u64 recovery;
+	/* cqe disabled for a cmd with data while halted, and restored */
+	u64 nrml_dis;
+	u64 nrml_rstr;
+	/* pre_req dma map, and legacy request to done */
+	u64 map_cnt;
+	u64 map_ns;
+	u64 map_max_ns;
+	u64 req_cnt;
+	u64 req_ns;
+	u64 req_max_ns;
+};
+
 struct sunxi_mmc_supply {
 	struct regulator *vmmc;		/* Card power supply */
 	struct regulator *vqmmc;	/* Optional Vccq supply */
@@ -519,6 +538,13 @@ struct sunxi_mmc_host {
 	bool perf_enable;
 	bool cqe_on;
 	bool has_recovery;
+	/* keep the cqe setup across non-CQ commands instead of rebuilding it */
+	bool cqe_batch;
+	bool cqe_parked;
+	struct sunxi_mmc_cqe_stats cqe_stats;
+	ktime_t req_start;
+	struct device_attribute host_cqe_stats;
+	struct device_attribute host_cqe_batch;
 	struct device_attribute host_perf;
 	struct sunxi_mmc_host_perf perf;
 	struct device_attribute filter_sector_perf;
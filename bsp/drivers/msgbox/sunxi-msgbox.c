@@ -24,7 +24,11 @@
 #include <linux/reset.h>
 #include <linux/spinlock.h>
 #include <linux/bitops.h>
+#include <linux/hrtimer.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <linux/mailbox_controller.h>
+#include <linux/sunxi-msgbox.h>
 
 #define SUNXI_MSGBOX_OFFSET(n)			(0x100 * (n))
 #define SUNXI_MSGBOX_READ_IRQ_ENABLE(n)		(0x20 + SUNXI_MSGBOX_OFFSET(n))
@@ -61,6 +65,21 @@
 #define WR_IRQ_THR_MASK			0x3
 #define WR_IRQ_THR_SHIFT		0
 
+/*
+ * RX coalescing. The read IRQ is raised as soon as one message is in the
+ * FIFO, there is no read threshold. With rx_coalesce_usecs set, an IRQ
+ * seeing less than rx_coalesce_frames messages masks the read IRQ of the
+ * channel and the FIFO is drained by a timer rx_coalesce_usecs later, so
+ * a burst costs one IRQ and the latency added is capped.
+ */
+static unsigned int rx_coalesce_usecs;
+module_param(rx_coalesce_usecs, uint, 0644);
+MODULE_PARM_DESC(rx_coalesce_usecs, "max usecs a message waits for others, 0 to disable (default: 0)");
+
+static unsigned int rx_coalesce_frames = 4;
+module_param(rx_coalesce_frames, uint, 0644);
+MODULE_PARM_DESC(rx_coalesce_frames, "messages in FIFO that are delivered at once (default: 4)");
+
 /*
  * AW msgbox hardware data information
  * Each msgox can be used for RX by current processor, it can trigger
@@ -95,6 +114,34 @@ static u32 sunxi_msgbox_regs_offset[] = {
 };
 #endif /* CONFIG_PM  */
 
+/*
+ * Per channel state
+ *
+ * @rx_lock:		Serializes draining the read FIFO between IRQs and the timer
+ * @rx_timer:		Drains the read FIFO once the coalescing delay is over
+ * @rx_stopped:		Channel shut down, the IRQ and the timer leave the read IRQ masked
+ * @rx_irqs:		Read IRQs taken
+ * @rx_timer_deliveries: FIFO drains by timer
+ * @rx_msgs:		Messages received
+ * @rx_max:		Most messages received by one drain
+ * @tx_msgs:		Messages sent, one by one or batched
+ * @tx_batches:		Calls to sunxi_msgbox_send_batch() that sent something
+ * @tx_full:		Sends that found the FIFO full
+ */
+struct sunxi_msgbox_chan {
+	struct mbox_chan *chan;
+	spinlock_t rx_lock;
+	struct hrtimer rx_timer;
+	bool rx_stopped;
+	u64 rx_irqs;
+	u64 rx_timer_deliveries;
+	u64 rx_msgs;
+	u32 rx_max;
+	u64 tx_msgs;
+	u64 tx_batches;
+	u64 tx_full;
+};
+
 /**
  * AW msgbox controller data
  *
@@ -112,6 +159,9 @@ static u32 sunxi_msgbox_regs_offset[] = {
  * @irq_cnt:	The msgbox irq num, irq_cnt should equal to hwdata->processors_max
  * @local_id:	Curren process id num for all msgbox controller
  * @regs_backup Save msgbox status register values during sleep
+ * @mchans:	Per channel state, indexed like controller.chans
+ * @irq_en_lock: Serializes the read-modify-write of the read IRQ enable
+ * @debugfs:	Debugfs directory of the statistics
  * @base_addr:	Base address of the register mapping region
  */
 struct sunxi_msgbox {
@@ -128,6 +178,9 @@ struct sunxi_msgbox {
 #if IS_ENABLED(CONFIG_PM)
 	u32 regs_backup[ARRAY_SIZE(sunxi_msgbox_regs_offset)];
 #endif /* CONFIG_PM  */
+	struct sunxi_msgbox_chan *mchans;
+	spinlock_t irq_en_lock;
+	struct dentry *debugfs;
 	void __iomem *base_addr[0];
 };
 
@@ -198,6 +251,11 @@ static inline struct sunxi_msgbox *to_sunxi_msgbox(struct mbox_chan *chan)
 	return chan->con_priv;
 }
 
+static inline struct sunxi_msgbox_chan *to_sunxi_msgbox_chan(struct mbox_chan *chan)
+{
+	return &to_sunxi_msgbox(chan)->mchans[chan - chan->mbox->chans];
+}
+
 /* set the msgbox's fifo trigger level */
 static void sunxi_msgbox_set_write_irq_threshold(struct sunxi_msgbox *chip,
 							void __iomem *base, int n, int p,
@@ -228,27 +286,98 @@ static void sunxi_msgbox_set_write_irq_threshold(struct sunxi_msgbox *chip,
 	reg_val_update(reg, WR_IRQ_THR_MASK, WR_IRQ_THR_SHIFT, thr_val);
 }
 
-static void sunxi_msgbox_read_handler(struct sunxi_msgbox *chip, struct mbox_chan *chan,
-				  void __iomem *base, int local_n, int p)
+static void sunxi_msgbox_read_irq_enable(struct sunxi_msgbox *chip, void __iomem *base,
+					 int local_n, int p, bool enable)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&chip->irq_en_lock, flags);
+	if (enable)
+		set_bits(base + SUNXI_MSGBOX_READ_IRQ_ENABLE(local_n), RD_IRQ_EN_MASK << RD_IRQ_EN_SHIFT(p));
+	else
+		clear_field(base + SUNXI_MSGBOX_READ_IRQ_ENABLE(local_n), RD_IRQ_EN_MASK << RD_IRQ_EN_SHIFT(p));
+	spin_unlock_irqrestore(&chip->irq_en_lock, flags);
+}
+
+/* called with mchan->rx_lock held */
+static void sunxi_msgbox_read_fifo(struct sunxi_msgbox *chip, struct mbox_chan *chan,
+				   void __iomem *base, int local_n, int p)
 {
+	struct sunxi_msgbox_chan *mchan = to_sunxi_msgbox_chan(chan);
 	unsigned long timeout = jiffies + msecs_to_jiffies(10);
-	u32 msg;
-	int ret = -1;
+	u32 msg, cnt = 0;
 
 	while (sunxi_msgbox_peek_data(chan) && time_before(jiffies, timeout)) {
 		msg = readl(base + SUNXI_MSGBOX_MSG_FIFO(local_n, p));
 		dev_dbg(chip->dev, "process-%d read data [0x%x] by channel %d from processor-%d success\n",
 				chip->local_id, msg, p, sunxi_msgbox_remote_id(chip, chip->local_id, local_n));
 		mbox_chan_received_data(chan, &msg);
-		ret = 0;
+		cnt++;
 	}
-	if (ret)
+	if (!cnt)
 		dev_err(chip->dev, "read data timeout\n");
 
+	mchan->rx_msgs += cnt;
+	mchan->rx_max = max(mchan->rx_max, cnt);
+
 	/* The IRQ pending can be cleared only once the FIFO is empty. */
 	set_bits(base + SUNXI_MSGBOX_READ_IRQ_STATUS(local_n), RD_IRQ_PEND_MASK << RD_IRQ_PEND_SHIFT(p));
 }
 
+static void sunxi_msgbox_read_handler(struct sunxi_msgbox *chip, struct mbox_chan *chan,
+				  void __iomem *base, int local_n, int p)
+{
+	struct sunxi_msgbox_chan *mchan = to_sunxi_msgbox_chan(chan);
+	unsigned int usecs = READ_ONCE(rx_coalesce_usecs);
+	unsigned int frames = min_t(unsigned int, READ_ONCE(rx_coalesce_frames),
+				    chip->hwdata->fifo_msg_max);
+	u32 msg_num;
+
+	spin_lock(&mchan->rx_lock);
+	if (mchan->rx_stopped) {
+		spin_unlock(&mchan->rx_lock);
+		return;
+	}
+	mchan->rx_irqs++;
+
+	if (usecs) {
+		msg_num = get_field(base + SUNXI_MSGBOX_MSG_STATUS(local_n, p), MSG_NUM_MASK);
+		if (msg_num < frames) {
+			/* Let the burst pile up, the timer drains and unmasks */
+			sunxi_msgbox_read_irq_enable(chip, base, local_n, p, false);
+			hrtimer_start(&mchan->rx_timer, us_to_ktime(usecs), HRTIMER_MODE_REL);
+			spin_unlock(&mchan->rx_lock);
+			return;
+		}
+	}
+
+	sunxi_msgbox_read_fifo(chip, chan, base, local_n, p);
+	spin_unlock(&mchan->rx_lock);
+}
+
+static enum hrtimer_restart sunxi_msgbox_rx_timer(struct hrtimer *timer)
+{
+	struct sunxi_msgbox_chan *mchan = container_of(timer, struct sunxi_msgbox_chan, rx_timer);
+	struct mbox_chan *chan = mchan->chan;
+	struct sunxi_msgbox *chip = to_sunxi_msgbox(chan);
+	void __iomem *read_reg_base;
+	unsigned long flags;
+	int local_n, p;
+
+	mbox_chan_to_coef_n_p(chip, chan, &local_n, &p);
+	read_reg_base = sunxi_msgbox_reg_base(chip, chip->local_id);
+
+	spin_lock_irqsave(&mchan->rx_lock, flags);
+	if (!mchan->rx_stopped) {
+		mchan->rx_timer_deliveries++;
+		sunxi_msgbox_read_fifo(chip, chan, read_reg_base, local_n, p);
+		sunxi_msgbox_read_irq_enable(chip, read_reg_base, local_n, p, true);
+	}
+	spin_unlock_irqrestore(&mchan->rx_lock, flags);
+
+	return HRTIMER_NORESTART;
+}
+
 #if IS_ENABLED(CONFIG_AW_MAILBOX_SUPPORT_TXDONE_IRQ)
 static void sunxi_msgbox_write_handler(struct sunxi_msgbox *chip, struct mbox_chan *chan,
 					void __iomem *base, int remote_n, int p)
@@ -343,7 +472,8 @@ static int sunxi_msgbox_startup(struct mbox_chan *chan)
 	set_bits(read_reg_base + SUNXI_MSGBOX_READ_IRQ_STATUS(local_n), RD_IRQ_PEND_MASK << RD_IRQ_PEND_SHIFT(p));
 
 	/* Enable read IRQ */
-	set_bits(read_reg_base + SUNXI_MSGBOX_READ_IRQ_ENABLE(local_n), RD_IRQ_EN_MASK << RD_IRQ_EN_SHIFT(p));
+	WRITE_ONCE(to_sunxi_msgbox_chan(chan)->rx_stopped, false);
+	sunxi_msgbox_read_irq_enable(chip, read_reg_base, local_n, p, true);
 
 	/* Clear remote process's write IRQ pending */
 	set_bits(write_reg_base + SUNXI_MSGBOX_WRITE_IRQ_STATUS(remote_n), WR_IRQ_PEND_MASK << WR_IRQ_PEND_SHIFT(p));
@@ -400,20 +530,77 @@ static int sunxi_msgbox_send_data(struct mbox_chan *chan, void *data)
 	remaining_space_in_fifo = chip->hwdata->fifo_msg_max - get_field(write_reg_base + SUNXI_MSGBOX_MSG_STATUS(remote_n, p), MSG_NUM_MASK);
 	if (remaining_space_in_fifo <= 0) {
 		dev_err(chip->dev, "Channel %d to processor %d: FIFO is full\n", p, remote_id);
+		to_sunxi_msgbox_chan(chan)->tx_full++;
 		return -EBUSY;
 	}
 
 	/* Write message to remote process's msgbox controller's FIFO */
 	writel(msg, write_reg_base + SUNXI_MSGBOX_MSG_FIFO(remote_n, p));
+	to_sunxi_msgbox_chan(chan)->tx_msgs++;
 
 	dev_dbg(chip->dev, "processor-%d use channel %d send data [0x%x] to processor-%d success\n",
 			local_id, p, msg, remote_id);
 	return 0;
 }
 
+int sunxi_msgbox_send_batch(struct mbox_chan *chan, const u32 *msgs, int count)
+{
+	struct sunxi_msgbox *chip;
+	struct sunxi_msgbox_chan *mchan;
+	int local_n, remote_id, remote_n, p;
+	void __iomem *write_reg_base;
+	unsigned long flags;
+	u32 msg_num;
+	int i, ret;
+
+	if (IS_ERR_OR_NULL(chan) || !msgs || count <= 0)
+		return -EINVAL;
+
+	chip = to_sunxi_msgbox(chan);
+	mchan = to_sunxi_msgbox_chan(chan);
+	mbox_chan_to_coef_n_p(chip, chan, &local_n, &p);
+	remote_id = sunxi_msgbox_remote_id(chip, chip->local_id, local_n);
+	remote_n = sunxi_msgbox_coef_n(chip, remote_id, chip->local_id);
+	write_reg_base = sunxi_msgbox_reg_base(chip, remote_id);
+
+	/* chan->lock is what the mailbox core holds around send_data() */
+	spin_lock_irqsave(&chan->lock, flags);
+	if (!chan->cl) {
+		ret = -EINVAL;
+		goto out;
+	}
+	/* Keep the order with messages queued by mbox_send_message() */
+	if (chan->active_req || chan->msg_count) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	msg_num = get_field(write_reg_base + SUNXI_MSGBOX_MSG_STATUS(remote_n, p), MSG_NUM_MASK);
+	ret = min_t(int, count, chip->hwdata->fifo_msg_max - (int)msg_num);
+	if (ret <= 0) {
+		mchan->tx_full++;
+		ret = 0;
+		goto out;
+	}
+
+	for (i = 0; i < ret; i++)
+		writel(msgs[i], write_reg_base + SUNXI_MSGBOX_MSG_FIFO(remote_n, p));
+	mchan->tx_msgs += ret;
+	mchan->tx_batches++;
+
+	dev_dbg(chip->dev, "processor-%d use channel %d send %d of %d messages to processor-%d\n",
+			chip->local_id, p, ret, count, remote_id);
+out:
+	spin_unlock_irqrestore(&chan->lock, flags);
+	return ret;
+}
+EXPORT_SYMBOL(sunxi_msgbox_send_batch);
+
 static void sunxi_msgbox_shutdown(struct mbox_chan *chan)
 {
 	struct sunxi_msgbox *chip = to_sunxi_msgbox(chan);
+	struct sunxi_msgbox_chan *mchan = to_sunxi_msgbox_chan(chan);
+	unsigned long flags;
 	int local_id, remote_id;
 	int local_n, remote_n, p;
 	void __iomem *read_reg_base;
@@ -427,6 +614,17 @@ static void sunxi_msgbox_shutdown(struct mbox_chan *chan)
 	read_reg_base = sunxi_msgbox_reg_base(chip, local_id);
 	write_reg_base = sunxi_msgbox_reg_base(chip, remote_id);
 
+	/*
+	 * Mask the read IRQ before cancelling the coalescing timer. An IRQ in
+	 * between would arm it again, and it unmasks the IRQ and delivers to
+	 * a channel without a client.
+	 */
+	spin_lock_irqsave(&mchan->rx_lock, flags);
+	mchan->rx_stopped = true;
+	sunxi_msgbox_read_irq_enable(chip, read_reg_base, local_n, p, false);
+	spin_unlock_irqrestore(&mchan->rx_lock, flags);
+	hrtimer_cancel(&mchan->rx_timer);
+
 	/* Disable the write IRQ */
 	clear_field(write_reg_base + SUNXI_MSGBOX_WRITE_IRQ_ENABLE(remote_n), WR_IRQ_EN_MASK << WR_IRQ_EN_SHIFT(p));
 	/* Clear write IRQ pending */
@@ -437,8 +635,7 @@ static void sunxi_msgbox_shutdown(struct mbox_chan *chan)
 		while (sunxi_msgbox_peek_data(chan) && time_before(jiffies, timeout))
 			readl(read_reg_base + SUNXI_MSGBOX_MSG_FIFO(local_n, p));
 		/* Disable the read IRQ */
-		clear_field(read_reg_base + SUNXI_MSGBOX_READ_IRQ_ENABLE(local_n),
-				RD_IRQ_EN_MASK << RD_IRQ_EN_SHIFT(p));
+		sunxi_msgbox_read_irq_enable(chip, read_reg_base, local_n, p, false);
 		/* Clear the read IRQ pending */
 		set_bits(read_reg_base + SUNXI_MSGBOX_READ_IRQ_STATUS(local_n),
 				RD_IRQ_PEND_MASK << RD_IRQ_PEND_SHIFT(p));
@@ -849,6 +1046,93 @@ static void sunxi_msgbox_hw_deinit(struct sunxi_msgbox *chip)
 	clk_disable_unprepare(chip->clk);
 }
 
+static int sunxi_msgbox_stats_show(struct seq_file *m, void *v)
+{
+	struct sunxi_msgbox *chip = m->private;
+	struct sunxi_msgbox_chan *mchan, snap;
+	unsigned long flags;
+	int i, local_n, p;
+
+	seq_printf(m, "rx_coalesce_usecs %u rx_coalesce_frames %u\n",
+		   rx_coalesce_usecs, rx_coalesce_frames);
+	seq_puts(m, "chan remote p   rx_irqs   rx_msgs msgs/irq rx_max timer_drains   tx_msgs tx_batches tx_full\n");
+
+	for (i = 0; i < chip->hwdata->mbox_num_chans; i++) {
+		mchan = &chip->mchans[i];
+
+		spin_lock_irqsave(&mchan->rx_lock, flags);
+		snap.rx_irqs = mchan->rx_irqs;
+		snap.rx_msgs = mchan->rx_msgs;
+		snap.rx_max = mchan->rx_max;
+		snap.rx_timer_deliveries = mchan->rx_timer_deliveries;
+		spin_unlock_irqrestore(&mchan->rx_lock, flags);
+
+		spin_lock_irqsave(&mchan->chan->lock, flags);
+		snap.tx_msgs = mchan->tx_msgs;
+		snap.tx_batches = mchan->tx_batches;
+		snap.tx_full = mchan->tx_full;
+		spin_unlock_irqrestore(&mchan->chan->lock, flags);
+
+		if (!mchan->chan->cl && !snap.rx_msgs && !snap.tx_msgs)
+			continue;
+
+		mbox_chan_id_to_coef_n_p(chip, i, &local_n, &p);
+		/* messages per IRQ with two decimals */
+		seq_printf(m, "%4d %6d %d %9llu %9llu %5llu.%02llu %6u %12llu %9llu %10llu %7llu\n",
+			   i, sunxi_msgbox_remote_id(chip, chip->local_id, local_n), p,
+			   snap.rx_irqs, snap.rx_msgs,
+			   snap.rx_irqs ? div64_u64(snap.rx_msgs, snap.rx_irqs) : 0,
+			   snap.rx_irqs ? div64_u64(snap.rx_msgs * 100, snap.rx_irqs) % 100 : 0,
+			   snap.rx_max, snap.rx_timer_deliveries,
+			   snap.tx_msgs, snap.tx_batches, snap.tx_full);
+	}
+
+	return 0;
+}
+
+static int sunxi_msgbox_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, sunxi_msgbox_stats_show, inode->i_private);
+}
+
+/* write anything to clear */
+static ssize_t sunxi_msgbox_stats_write(struct file *file, const char __user *buf,
+					size_t count, loff_t *ppos)
+{
+	struct sunxi_msgbox *chip = ((struct seq_file *)file->private_data)->private;
+	struct sunxi_msgbox_chan *mchan;
+	unsigned long flags;
+	int i;
+
+	for (i = 0; i < chip->hwdata->mbox_num_chans; i++) {
+		mchan = &chip->mchans[i];
+
+		spin_lock_irqsave(&mchan->rx_lock, flags);
+		mchan->rx_irqs = 0;
+		mchan->rx_timer_deliveries = 0;
+		mchan->rx_msgs = 0;
+		mchan->rx_max = 0;
+		spin_unlock_irqrestore(&mchan->rx_lock, flags);
+
+		spin_lock_irqsave(&mchan->chan->lock, flags);
+		mchan->tx_msgs = 0;
+		mchan->tx_batches = 0;
+		mchan->tx_full = 0;
+		spin_unlock_irqrestore(&mchan->chan->lock, flags);
+	}
+
+	return count;
+}
+
+static const struct file_operations sunxi_msgbox_stats_fops = {
+	.owner		= THIS_MODULE,
+	.open		= sunxi_msgbox_stats_open,
+	.read		= seq_read,
+	.write		= sunxi_msgbox_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int sunxi_msgbox_probe(struct platform_device *pdev)
 {
 	struct mbox_chan *chans;
@@ -872,8 +1156,19 @@ static int sunxi_msgbox_probe(struct platform_device *pdev)
 		ret = -ENOMEM;
 		return ret;
 	}
-	for (i = 0; i < chip->hwdata->mbox_num_chans; i++)
+	chip->mchans = devm_kcalloc(chip->dev, chip->hwdata->mbox_num_chans,
+				    sizeof(*chip->mchans), GFP_KERNEL);
+	if (!chip->mchans)
+		return -ENOMEM;
+	spin_lock_init(&chip->irq_en_lock);
+
+	for (i = 0; i < chip->hwdata->mbox_num_chans; i++) {
 		chans[i].con_priv = chip;
+		chip->mchans[i].chan = &chans[i];
+		spin_lock_init(&chip->mchans[i].rx_lock);
+		hrtimer_init(&chip->mchans[i].rx_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+		chip->mchans[i].rx_timer.function = sunxi_msgbox_rx_timer;
+	}
 
 	ret = sunxi_msgbox_resource_get(chip);
 	if (ret) {
@@ -907,6 +1202,9 @@ static int sunxi_msgbox_probe(struct platform_device *pdev)
 		goto err1;
 	}
 
+	chip->debugfs = debugfs_create_dir(dev_name(chip->dev), NULL);
+	debugfs_create_file("stats", 0644, chip->debugfs, chip, &sunxi_msgbox_stats_fops);
+
 	dev_info(chip->dev, "%s(): sunxi msgbox probe success\n", __func__);
 	return 0;
 
@@ -922,6 +1220,7 @@ static int sunxi_msgbox_remove(struct platform_device *pdev)
 {
 	struct sunxi_msgbox *chip = platform_get_drvdata(pdev);
 
+	debugfs_remove_recursive(chip->debugfs);
 	sunxi_msgbox_hw_deinit(chip);
 	sunxi_msgbox_resource_put(chip);
 
@@ -1022,4 +1321,4 @@ MODULE_AUTHOR("wujiayi <wujiayi@allwinnertech.com>");
 MODULE_AUTHOR("xuminghui <xuminghui@allwinnertech.com>");
 MODULE_AUTHOR("zhaiyaya <zhaiyaya@allwinnertech.com>");
 MODULE_LICENSE("GPL v2");
-MODULE_VERSION("1.1.5");
+MODULE_VERSION("1.2.0");
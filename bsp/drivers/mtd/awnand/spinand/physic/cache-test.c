@@ -0,0 +1,419 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright(c) 2020 - 2023 Allwinner Technology Co.,Ltd. All rights reserved. */
+/*
+ * KUnit tests for the read cache and read-ahead of the spinand physical layer
+ *
+ * The physical layer talks to a simulated MT29F1G01ABAGDWB behind a software
+ * spi controller, so no spinand is needed and the suite runs under QEMU. The
+ * simulation keeps the data and cache registers of the chip apart, so PAGE
+ * READ CACHE SEQUENTIAL/LAST behave like on the real chip.
+ */
+
+#include <kunit/test.h>
+#include <linux/device.h>
+#include <linux/slab.h>
+#include <linux/xarray.h>
+#include <linux/mtd/aw-spinand.h>
+#include "physic.h"
+
+#define SIM_PAGE_SIZE		2048
+#define SIM_PAGE_LEN		(SIM_PAGE_SIZE + 64)
+#define SIM_PAGES_PER_BLK	64
+
+static const u8 sim_id[MAX_ID_LEN] = {0x2c, 0x14, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff};
+
+struct spinand_sim {
+	/* programmed pages by page address, a missing one is erased */
+	struct xarray pages;
+	u8 regs[256];
+	u8 cache[SIM_PAGE_LEN];
+	/* page address loaded to the data register */
+	unsigned int data_page;
+	unsigned int nr_load;
+	unsigned int nr_seq;
+	unsigned int nr_last;
+};
+
+struct cache_test_ctx {
+	struct device *dev;
+	struct spi_controller *ctlr;
+	struct spi_device *spi;
+	struct spinand_sim *sim;
+	struct aw_spinand_chip *chip;
+	u8 *buf;
+	u8 *want;
+};
+
+static u8 *sim_page(struct spinand_sim *sim, unsigned int paddr, bool alloc)
+{
+	u8 *page = xa_load(&sim->pages, paddr);
+
+	if (page || !alloc)
+		return page;
+
+	page = kmalloc(SIM_PAGE_LEN, GFP_KERNEL);
+	if (!page)
+		return NULL;
+	memset(page, 0xff, SIM_PAGE_LEN);
+	if (xa_err(xa_store(&sim->pages, paddr, page, GFP_KERNEL))) {
+		kfree(page);
+		return NULL;
+	}
+	return page;
+}
+
+/* move the page in the data register to the cache register */
+static void sim_load_cache(struct spinand_sim *sim, unsigned int paddr)
+{
+	u8 *page = sim_page(sim, paddr, false);
+
+	if (page)
+		memcpy(sim->cache, page, SIM_PAGE_LEN);
+	else
+		memset(sim->cache, 0xff, SIM_PAGE_LEN);
+}
+
+static void sim_erase(struct spinand_sim *sim, unsigned int paddr)
+{
+	unsigned int first = round_down(paddr, SIM_PAGES_PER_BLK);
+	unsigned int i;
+
+	for (i = first; i < first + SIM_PAGES_PER_BLK; i++)
+		kfree(xa_erase(&sim->pages, i));
+}
+
+static void sim_free(struct spinand_sim *sim)
+{
+	unsigned long index;
+	u8 *page;
+
+	xa_for_each(&sim->pages, index, page)
+		kfree(page);
+	xa_destroy(&sim->pages);
+}
+
+/*
+ * The first transfer holds the command, the address and the dummy bytes,
+ * the second one if any the data, as the physical layer sends them.
+ */
+static int sim_transfer_one_message(struct spi_controller *ctlr,
+		struct spi_message *msg)
+{
+	struct spinand_sim *sim = spi_controller_get_devdata(ctlr);
+	struct spi_transfer *cmd, *data = NULL, *t;
+	unsigned int paddr, column, len, i;
+	const u8 *tx;
+	u8 *page;
+	int ret = 0;
+
+	cmd = list_first_entry(&msg->transfers, struct spi_transfer,
+			transfer_list);
+	if (!list_is_last(&cmd->transfer_list, &msg->transfers))
+		data = list_next_entry(cmd, transfer_list);
+	tx = cmd->tx_buf;
+	paddr = cmd->len >= 4 ? tx[1] << 16 | tx[2] << 8 | tx[3] : 0;
+	column = cmd->len >= 3 ? (tx[1] & 0x0f) << 8 | tx[2] : 0;
+
+	switch (tx[0]) {
+	case SPI_NAND_RDID:
+		if (data && data->rx_buf)
+			memcpy(data->rx_buf, sim_id, min_t(unsigned int,
+						data->len, MAX_ID_LEN));
+		break;
+	case SPI_NAND_GETSR:
+		/* always ready, no ecc error */
+		if (data && data->rx_buf)
+			*(u8 *)data->rx_buf = tx[1] == REG_STATUS ? 0 :
+				sim->regs[tx[1]];
+		break;
+	case SPI_NAND_SETSR:
+		sim->regs[tx[1]] = tx[2];
+		break;
+	case SPI_NAND_PAGE_READ:
+		sim->nr_load++;
+		sim->data_page = paddr;
+		sim_load_cache(sim, paddr);
+		break;
+	case SPI_NAND_READ_CACHE_SEQ:
+		sim->nr_seq++;
+		sim_load_cache(sim, sim->data_page++);
+		break;
+	case SPI_NAND_READ_CACHE_LAST:
+		sim->nr_last++;
+		sim_load_cache(sim, sim->data_page);
+		break;
+	case SPI_NAND_READ_X1:
+	case SPI_NAND_FAST_READ_X1:
+	case SPI_NAND_READ_X2:
+	case SPI_NAND_READ_X4:
+		if (!data || !data->rx_buf)
+			break;
+		len = column < SIM_PAGE_LEN ?
+			min(data->len, SIM_PAGE_LEN - column) : 0;
+		memcpy(data->rx_buf, sim->cache + column, len);
+		memset(data->rx_buf + len, 0xff, data->len - len);
+		break;
+	case SPI_NAND_PP:
+	case SPI_NAND_PP_X4:
+		memset(sim->cache, 0xff, SIM_PAGE_LEN);
+		fallthrough;
+	case SPI_NAND_RANDOM_PP:
+	case SPI_NAND_RANDOM_PP_X4:
+		if (!data || !data->tx_buf || column >= SIM_PAGE_LEN)
+			break;
+		len = min(data->len, SIM_PAGE_LEN - column);
+		memcpy(sim->cache + column, data->tx_buf, len);
+		break;
+	case SPI_NAND_PE:
+		page = sim_page(sim, paddr, true);
+		if (!page) {
+			ret = -ENOMEM;
+			break;
+		}
+		/* programming only clears bits */
+		for (i = 0; i < SIM_PAGE_LEN; i++)
+			page[i] &= sim->cache[i];
+		break;
+	case SPI_NAND_BE:
+		sim_erase(sim, paddr);
+		break;
+	default:
+		/* reset, write enable/disable */
+		break;
+	}
+
+	list_for_each_entry(t, &msg->transfers, transfer_list)
+		msg->actual_length += t->len;
+	msg->status = ret;
+	spi_finalize_current_message(ctlr);
+	return 0;
+}
+
+static void cache_test_pattern(u8 *buf, unsigned int block, unsigned int page,
+		u8 salt)
+{
+	unsigned int i;
+
+	for (i = 0; i < SIM_PAGE_SIZE; i++)
+		buf[i] = (u8)(i + block * 31 + page * 7) ^ salt;
+}
+
+/* program the page behind the back of the physical layer */
+static void cache_test_fill(struct kunit *test, unsigned int block,
+		unsigned int page)
+{
+	struct cache_test_ctx *ctx = test->priv;
+	u8 *p = sim_page(ctx->sim, block * SIM_PAGES_PER_BLK + page, true);
+
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, p);
+	cache_test_pattern(p, block, page, 0);
+}
+
+static int cache_test_read(struct cache_test_ctx *ctx, unsigned int block,
+		unsigned int page)
+{
+	struct aw_spinand_chip_request req = {0};
+
+	req.block = block;
+	req.page = page;
+	req.datalen = SIM_PAGE_SIZE;
+	req.databuf = ctx->buf;
+	memset(ctx->buf, 0, SIM_PAGE_SIZE);
+	return ctx->chip->ops->phy_read_page(ctx->chip, &req);
+}
+
+static bool cache_test_in_slot(struct aw_spinand_cache *cache,
+		unsigned int block, unsigned int page)
+{
+	unsigned int i;
+
+	for (i = 0; i < cache->nr_slots; i++)
+		if (cache->slots[i].block == block &&
+				cache->slots[i].page == page)
+			return true;
+	return false;
+}
+
+/* read-ahead is only tried with at least 2 pages on each block parity */
+static bool cache_test_readahead_on(struct kunit *test)
+{
+	struct cache_test_ctx *ctx = test->priv;
+
+	if (ctx->chip->cache->nr_slots >= 4)
+		return true;
+	kunit_info(test, "AW_SPINAND_CACHE_PAGES < 4, no read-ahead to test\n");
+	return false;
+}
+
+static void cache_test_sequential(struct kunit *test)
+{
+	struct cache_test_ctx *ctx = test->priv;
+	struct aw_spinand_cache *cache = ctx->chip->cache;
+	unsigned int page, pages = 8;
+
+	if (!cache_test_readahead_on(test))
+		return;
+
+	for (page = 0; page < pages; page++)
+		cache_test_fill(test, 2, page);
+
+	ctx->sim->nr_load = 0;
+	for (page = 0; page < pages; page++) {
+		KUNIT_ASSERT_EQ(test, cache_test_read(ctx, 2, page), 0);
+		cache_test_pattern(ctx->want, 2, page, 0);
+		KUNIT_EXPECT_EQ_MSG(test, memcmp(ctx->buf, ctx->want,
+					SIM_PAGE_SIZE), 0, "page %u", page);
+	}
+
+	KUNIT_EXPECT_GT(test, ctx->sim->nr_seq, 0U);
+	KUNIT_EXPECT_GT(test, ctx->sim->nr_last, 0U);
+	KUNIT_EXPECT_LT(test, ctx->sim->nr_load, pages);
+	KUNIT_EXPECT_GT(test, cache->slot_hit, 0UL);
+}
+
+static void cache_test_write_after_readahead(struct kunit *test)
+{
+	struct cache_test_ctx *ctx = test->priv;
+	struct aw_spinand_chip_request req = {0};
+
+	if (!cache_test_readahead_on(test))
+		return;
+
+	/* page 3 is left erased and read ahead as all 0xff */
+	cache_test_fill(test, 3, 0);
+	cache_test_fill(test, 3, 1);
+	cache_test_fill(test, 3, 2);
+	KUNIT_ASSERT_EQ(test, cache_test_read(ctx, 3, 0), 0);
+	KUNIT_ASSERT_EQ(test, cache_test_read(ctx, 3, 1), 0);
+	KUNIT_ASSERT_TRUE(test, cache_test_in_slot(ctx->chip->cache, 3, 3));
+
+	cache_test_pattern(ctx->want, 3, 3, 0x5a);
+	req.block = 3;
+	req.page = 3;
+	req.datalen = SIM_PAGE_SIZE;
+	req.databuf = ctx->want;
+	KUNIT_ASSERT_EQ(test, ctx->chip->ops->phy_write_page(ctx->chip, &req),
+			0);
+	KUNIT_EXPECT_FALSE(test, cache_test_in_slot(ctx->chip->cache, 3, 3));
+
+	/* page 2 comes from a slot and page 3 must come from the chip */
+	KUNIT_ASSERT_EQ(test, cache_test_read(ctx, 3, 2), 0);
+	KUNIT_ASSERT_EQ(test, cache_test_read(ctx, 3, 3), 0);
+	KUNIT_EXPECT_EQ(test, memcmp(ctx->buf, ctx->want, SIM_PAGE_SIZE), 0);
+}
+
+static void cache_test_erase_after_read(struct kunit *test)
+{
+	struct cache_test_ctx *ctx = test->priv;
+	struct aw_spinand_chip_request req = {0};
+	unsigned int page;
+
+	for (page = 0; page < 6; page++)
+		cache_test_fill(test, 4, page);
+	for (page = 0; page < 3; page++)
+		KUNIT_ASSERT_EQ(test, cache_test_read(ctx, 4, page), 0);
+
+	req.block = 4;
+	KUNIT_ASSERT_EQ(test, ctx->chip->ops->phy_erase_block(ctx->chip, &req),
+			0);
+
+	/* neither the last page read nor a read-ahead one may survive */
+	for (page = 0; page < 6; page++) {
+		KUNIT_ASSERT_EQ(test, cache_test_read(ctx, 4, page), 0);
+		KUNIT_EXPECT_PTR_EQ_MSG(test, memchr_inv(ctx->buf, 0xff,
+					SIM_PAGE_SIZE), NULL, "page %u", page);
+	}
+}
+
+static int cache_test_init(struct kunit *test)
+{
+	struct spi_board_info info = {
+		.modalias = "aw-spinand-sim",
+		.max_speed_hz = 100000000,
+		.mode = SPI_RX_QUAD | SPI_TX_QUAD,
+	};
+	struct cache_test_ctx *ctx;
+	int ret;
+
+	ctx = kunit_kzalloc(test, sizeof(*ctx), GFP_KERNEL);
+	if (!ctx)
+		return -ENOMEM;
+	ctx->chip = kunit_kzalloc(test, sizeof(*ctx->chip), GFP_KERNEL);
+	ctx->buf = kunit_kzalloc(test, SIM_PAGE_SIZE, GFP_KERNEL);
+	ctx->want = kunit_kzalloc(test, SIM_PAGE_SIZE, GFP_KERNEL);
+	if (!ctx->chip || !ctx->buf || !ctx->want)
+		return -ENOMEM;
+
+	ctx->dev = root_device_register("aw_spinand_cache_test");
+	if (IS_ERR(ctx->dev))
+		return PTR_ERR(ctx->dev);
+
+	ctx->ctlr = spi_alloc_master(ctx->dev, sizeof(*ctx->sim));
+	if (!ctx->ctlr) {
+		ret = -ENOMEM;
+		goto err_dev;
+	}
+	ctx->ctlr->bus_num = -1;
+	ctx->ctlr->num_chipselect = 1;
+	ctx->ctlr->mode_bits = SPI_RX_DUAL | SPI_RX_QUAD | SPI_TX_DUAL |
+		SPI_TX_QUAD;
+	ctx->ctlr->transfer_one_message = sim_transfer_one_message;
+	ctx->sim = spi_controller_get_devdata(ctx->ctlr);
+	xa_init(&ctx->sim->pages);
+
+	ret = spi_register_controller(ctx->ctlr);
+	if (ret) {
+		spi_controller_put(ctx->ctlr);
+		goto err_dev;
+	}
+
+	ctx->spi = spi_new_device(ctx->ctlr, &info);
+	if (!ctx->spi) {
+		ret = -ENODEV;
+		goto err_ctlr;
+	}
+
+	ret = aw_spinand_chip_init(ctx->spi, ctx->chip);
+	if (ret)
+		goto err_spi;
+
+	test->priv = ctx;
+	return 0;
+
+err_spi:
+	spi_unregister_device(ctx->spi);
+err_ctlr:
+	sim_free(ctx->sim);
+	spi_unregister_controller(ctx->ctlr);
+err_dev:
+	root_device_unregister(ctx->dev);
+	return ret;
+}
+
+static void cache_test_exit(struct kunit *test)
+{
+	struct cache_test_ctx *ctx = test->priv;
+
+	aw_spinand_chip_exit(ctx->chip);
+	spi_unregister_device(ctx->spi);
+	sim_free(ctx->sim);
+	spi_unregister_controller(ctx->ctlr);
+	root_device_unregister(ctx->dev);
+}
+
+static struct kunit_case aw_spinand_cache_test_cases[] = {
+	KUNIT_CASE(cache_test_sequential),
+	KUNIT_CASE(cache_test_write_after_readahead),
+	KUNIT_CASE(cache_test_erase_after_read),
+	{},
+};
+
+static struct kunit_suite aw_spinand_cache_test_suite = {
+	.name = "aw_spinand_cache",
+	.init = cache_test_init,
+	.exit = cache_test_exit,
+	.test_cases = aw_spinand_cache_test_cases,
+};
+
+kunit_test_suites(&aw_spinand_cache_test_suite);
@@ -13,7 +13,6 @@
 
 #include "physic.h"
 
-#define INVALID_CACHE ((unsigned int)(-1))
 static void update_cache_info(struct aw_spinand_cache *cache,
 		struct aw_spinand_chip_request *req)
 {
@@ -378,49 +377,15 @@ err:
 	return ret;
 }
 
-/*
- * 3 step:
- *  a) copy data from req to cache->databuf/oobbuf
- *  b) update cache->block/page
- *  c) send write cache command to spinand
- */
-static int aw_spinand_cache_read_from_cache(struct aw_spinand_chip *chip,
+static int aw_spinand_cache_read_from_cache_do(struct aw_spinand_chip *chip,
+		void *buf, unsigned int len, unsigned int column,
 		struct aw_spinand_chip_request *req)
 {
-	unsigned int rbytes = 0;
-	void *rbuf = NULL;
-	int column = 0, ret;
-	unsigned char txbuf[5];
 	struct aw_spinand_info *info = chip->info;
 	struct aw_spinand_phy_info *pinfo = info->phy_info;
-	struct aw_spinand_cache *cache = chip->cache;
+	unsigned char txbuf[5];
 	struct spi_message msg;
 	struct spi_transfer t[2] = {};
-#if IS_ENABLED(CONFIG_AW_SPINAND_ENABLE_PHY_CRC16)
-	unsigned char oob[AW_OOB_SIZE_PER_PHY_PAGE] = {0xFF};
-#endif
-
-#if IS_ENABLED(CONFIG_AW_SPINAND_ENABLE_PHY_CRC16)
-	if (req->databuf && !req->oobbuf) {
-		req->oobbuf = oob;
-		req->ooblen = AW_OOB_SIZE_PER_PHY_PAGE;
-	}
-#endif
-
-	if (req->datalen) {
-		rbuf = cache->databuf;
-		rbytes = cache->data_maxlen;
-		column = 0;
-	}
-
-	if (req->ooblen) {
-		rbytes += cache->oob_maxlen;
-		/* just oob without data */
-		if (!rbuf) {
-			rbuf = cache->oobbuf;
-			column = info->phy_page_size(chip);
-		}
-	}
 
 	spi_message_init(&msg);
 
@@ -453,15 +418,58 @@ static int aw_spinand_cache_read_from_cache(struct aw_spinand_chip *chip,
 
 	/* to select the signal line count */
 	t[1].rx_nbits = chip->rx_bit;
-	t[1].rx_buf = rbuf;
-	t[1].len = rbytes;
+	t[1].rx_buf = buf;
+	t[1].len = len;
 	spi_message_add_tail(&t[1], &msg);
 
 	if (likely(req->type != AW_SPINAND_MTD_REQ_PANIC))
-		ret = spi_sync(chip->spi, &msg);
+		return spi_sync(chip->spi, &msg);
 	else
-		ret = aw_spi_sync_atomic(chip->spi, &msg);
+		return aw_spi_sync_atomic(chip->spi, &msg);
+}
+
+/*
+ * 3 step:
+ *  a) copy data from req to cache->databuf/oobbuf
+ *  b) update cache->block/page
+ *  c) send write cache command to spinand
+ */
+static int aw_spinand_cache_read_from_cache(struct aw_spinand_chip *chip,
+		struct aw_spinand_chip_request *req)
+{
+	unsigned int rbytes = 0;
+	void *rbuf = NULL;
+	int column = 0, ret;
+	struct aw_spinand_info *info = chip->info;
+	struct aw_spinand_cache *cache = chip->cache;
+#if IS_ENABLED(CONFIG_AW_SPINAND_ENABLE_PHY_CRC16)
+	unsigned char oob[AW_OOB_SIZE_PER_PHY_PAGE] = {0xFF};
+#endif
+
+#if IS_ENABLED(CONFIG_AW_SPINAND_ENABLE_PHY_CRC16)
+	if (req->databuf && !req->oobbuf) {
+		req->oobbuf = oob;
+		req->ooblen = AW_OOB_SIZE_PER_PHY_PAGE;
+	}
+#endif
+
+	if (req->datalen) {
+		rbuf = cache->databuf;
+		rbytes = cache->data_maxlen;
+		column = 0;
+	}
 
+	if (req->ooblen) {
+		rbytes += cache->oob_maxlen;
+		/* just oob without data */
+		if (!rbuf) {
+			rbuf = cache->oobbuf;
+			column = info->phy_page_size(chip);
+		}
+	}
+
+	ret = aw_spinand_cache_read_from_cache_do(chip, rbuf, rbytes, column,
+			req);
 	if (ret) {
 		/*
 		 * the cache buffer is invalid now as we do not know
@@ -490,6 +498,138 @@ static int aw_spinand_cache_read_from_cache(struct aw_spinand_chip *chip,
 	return 0;
 }
 
+static struct aw_spinand_cache_slot *aw_spinand_cache_find_slot(
+		struct aw_spinand_cache *cache, unsigned int block,
+		unsigned int page)
+{
+	int i;
+
+	for (i = 0; i < cache->nr_slots; i++) {
+		if (cache->slots[i].block == block &&
+				cache->slots[i].page == page)
+			return &cache->slots[i];
+	}
+	return NULL;
+}
+
+static int aw_spinand_cache_read_to_slot(struct aw_spinand_chip *chip,
+		struct aw_spinand_chip_request *req, int ecc)
+{
+	struct aw_spinand_cache *cache = chip->cache;
+	struct aw_spinand_cache_slot *slot;
+	int i, ret;
+
+	slot = aw_spinand_cache_find_slot(cache, req->block, req->page);
+	if (!slot) {
+		if (!cache->nr_slots)
+			return -ENOSPC;
+		/* a free slot, else the least recently read page */
+		slot = &cache->slots[0];
+		for (i = 0; i < cache->nr_slots; i++) {
+			if (cache->slots[i].block == INVALID_CACHE) {
+				slot = &cache->slots[i];
+				break;
+			}
+			if (time_before(cache->slots[i].stamp, slot->stamp))
+				slot = &cache->slots[i];
+		}
+	}
+
+	slot->block = slot->page = INVALID_CACHE;
+	ret = aw_spinand_cache_read_from_cache_do(chip, slot->buf,
+			cache->data_maxlen + cache->oob_maxlen, 0, req);
+	if (ret)
+		return ret;
+
+	slot->block = req->block;
+	slot->page = req->page;
+	slot->ecc = ecc;
+	slot->stamp = ++cache->stamp;
+	cache->readahead++;
+	return 0;
+}
+
+#if IS_ENABLED(CONFIG_AW_SPINAND_ENABLE_PHY_CRC16)
+/*
+ * The page of a slot is read by read-ahead and skips the check done in
+ * aw_spinand_cache_read_from_cache(), so do it when the slot is taken.
+ * The crc sits in the user oob, get it the same way copy_from_cache does.
+ */
+static void aw_spinand_cache_verify_slot_crc(struct aw_spinand_chip *chip,
+		struct aw_spinand_chip_request *req)
+{
+	unsigned char oob[AW_OOB_SIZE_PER_PHY_PAGE] = {0xFF};
+	struct aw_spinand_chip_request crc_req = *req;
+
+	if (!req->databuf)
+		return;
+
+	crc_req.databuf = NULL;
+	crc_req.datalen = 0;
+	crc_req.oobbuf = oob;
+	crc_req.ooblen = AW_OOB_SIZE_PER_PHY_PAGE;
+	if (chip->cache->copy_from_cache(chip, &crc_req))
+		return;
+
+	crc_req.databuf = req->databuf;
+	aw_spinand_chip_verify_crc(chip, &crc_req);
+}
+#endif
+
+static int aw_spinand_cache_take_slot(struct aw_spinand_chip *chip,
+		struct aw_spinand_chip_request *req)
+{
+	struct aw_spinand_cache *cache = chip->cache;
+	struct aw_spinand_cache_slot *slot;
+	unsigned char *buf;
+
+	slot = aw_spinand_cache_find_slot(cache, req->block, req->page);
+	if (!slot)
+		return -ENOENT;
+
+	/*
+	 * The old page above may only hold part of a page, do not keep it,
+	 * its buffer just becomes the free slot.
+	 */
+	buf = cache->databuf;
+	cache->databuf = slot->buf;
+	cache->oobbuf = cache->databuf + cache->data_maxlen;
+	cache->block = slot->block;
+	cache->page = slot->page;
+	cache->area = VALID_CACHE_DATA | VALID_CACHE_OOB;
+
+	slot->buf = buf;
+	slot->block = slot->page = INVALID_CACHE;
+	cache->slot_hit++;
+	sunxi_debug(NULL, "cache slot hit: phy blk %u page %u\n", req->block,
+			req->page);
+#if IS_ENABLED(CONFIG_AW_SPINAND_ENABLE_PHY_CRC16)
+	aw_spinand_cache_verify_slot_crc(chip, req);
+#endif
+	return slot->ecc;
+}
+
+static void aw_spinand_cache_invalidate(struct aw_spinand_chip *chip,
+		unsigned int block, unsigned int page)
+{
+	struct aw_spinand_cache *cache = chip->cache;
+	int i;
+
+	if (cache->block == block &&
+			(page == INVALID_CACHE || cache->page == page)) {
+		cache->block = cache->page = INVALID_CACHE;
+		cache->area = INVALID_CACHE_ALL_AREA;
+	}
+
+	for (i = 0; i < cache->nr_slots; i++) {
+		if (cache->slots[i].block == block &&
+				(page == INVALID_CACHE ||
+				 cache->slots[i].page == page))
+			cache->slots[i].block = cache->slots[i].page =
+				INVALID_CACHE;
+	}
+}
+
 /* see what these funcions do on somewhere defined struct aw_spinand_cache */
 struct aw_spinand_cache aw_spinand_cache = {
 	.match_cache = aw_spinand_cache_match_cache,
@@ -497,8 +637,52 @@ struct aw_spinand_cache aw_spinand_cache = {
 	.copy_from_cache = aw_spinand_cache_copy_from_cache,
 	.read_from_cache = aw_spinand_cache_read_from_cache,
 	.write_to_cache = aw_spinand_cache_write_to_cache,
+	.read_to_slot = aw_spinand_cache_read_to_slot,
+	.take_slot = aw_spinand_cache_take_slot,
+	.invalidate = aw_spinand_cache_invalidate,
 };
 
+static void aw_spinand_cache_free_slots(struct aw_spinand_cache *cache)
+{
+	int i;
+
+	if (!cache->slots)
+		return;
+
+	for (i = 0; i < cache->nr_slots; i++)
+		kfree(cache->slots[i].buf);
+	kfree(cache->slots);
+	cache->slots = NULL;
+	cache->nr_slots = 0;
+}
+
+static int aw_spinand_cache_alloc_slots(struct aw_spinand_cache *cache,
+		unsigned int nr)
+{
+	int i;
+
+	cache->nr_slots = 0;
+	if (!nr)
+		return 0;
+
+	cache->slots = kcalloc(nr, sizeof(*cache->slots), GFP_KERNEL);
+	if (!cache->slots)
+		return -ENOMEM;
+
+	for (i = 0; i < nr; i++) {
+		cache->slots[i].block = cache->slots[i].page = INVALID_CACHE;
+		cache->slots[i].buf = kmalloc(cache->data_maxlen +
+				cache->oob_maxlen, GFP_KERNEL);
+		if (!cache->slots[i].buf) {
+			cache->nr_slots = i;
+			aw_spinand_cache_free_slots(cache);
+			return -ENOMEM;
+		}
+	}
+	cache->nr_slots = nr;
+	return 0;
+}
+
 int aw_spinand_chip_cache_init(struct aw_spinand_chip *chip)
 {
 	struct aw_spinand_info *info = chip->info;
@@ -518,6 +702,16 @@ int aw_spinand_chip_cache_init(struct aw_spinand_chip *chip)
 		goto err;
 
 	cache->oobbuf = cache->databuf + cache->data_maxlen;
+	cache->block = cache->page = INVALID_CACHE;
+	cache->area = INVALID_CACHE_ALL_AREA;
+	cache->seq_block[0] = cache->seq_block[1] = INVALID_CACHE;
+	cache->slot_hit = cache->readahead = 0;
+
+	/* read-ahead is only an optimization, go on with the single page */
+	if (aw_spinand_cache_alloc_slots(cache, CONFIG_AW_SPINAND_CACHE_PAGES))
+		sunxi_warn(NULL, "no memory for %d read-ahead pages\n",
+				CONFIG_AW_SPINAND_CACHE_PAGES);
+
 	chip->cache = cache;
 	return 0;
 err:
@@ -529,6 +723,7 @@ void aw_spinand_chip_cache_exit(struct aw_spinand_chip *chip)
 {
 	struct aw_spinand_cache *cache = chip->cache;
 
+	aw_spinand_cache_free_slots(cache);
 	kfree(cache->databuf);
 	cache->databuf = cache->oobbuf = NULL;
 	chip->cache = NULL;
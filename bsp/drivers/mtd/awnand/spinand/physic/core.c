@@ -288,6 +288,19 @@ static ssize_t spinand_status_read(struct file *file, char __user *buf,
 			strcpy(spinanddbg_priv.status, "NONE");
 		}
 
+	} else if (!strncmp(spinanddbg_priv.param, "cache", 5)) {
+		struct aw_spinand_cache *cache = chip->cache;
+
+		sprintf(tmpstatus,
+			"read-ahead pages: %u%s\n"
+			"read-ahead reads: %lu\n"
+			"read-ahead hits:  %lu",
+			cache->nr_slots,
+			pinfo->OperationOpt & SPINAND_CACHE_READ_SEQ ?
+			"" : " (no cache read on this chip)",
+			cache->readahead, cache->slot_hit);
+		strcpy(spinanddbg_priv.status, tmpstatus);
+
 	} else if (!strncmp(spinanddbg_priv.param, "info", 4)) {
 		sprintf(tmpstatus,
 			"========== arch info ==========\n"
@@ -315,6 +328,7 @@ static ssize_t spinand_status_read(struct file *file, char __user *buf,
 		strcpy(spinanddbg_priv.status, "please set param before cat status\n \
 			freq    ----return spi frequency\n \
 			mode    ----return QUAD/DUAL/SINGLE\n \
+			cache   ----return read-ahead cache stats\n \
 			info    ----return chip info\n");
 	}
 
@@ -290,6 +290,8 @@ static int aw_spinand_chip_erase_single_block(struct aw_spinand_chip *chip,
 	if (paddr >= pmax)
 		return -EOVERFLOW;
 
+	chip->cache->invalidate(chip, req->block, INVALID_CACHE);
+
 	txbuf[0] = SPI_NAND_BE;
 	txbuf[1] = (paddr >> 16) & 0xFF;
 	txbuf[2] = (paddr >> 8) & 0xFF;
@@ -371,13 +373,16 @@ static int aw_spinand_chip_write_single_page(struct aw_spinand_chip *chip,
 	if (ret)
 		return ret;
 
+	/* a read-ahead copy of the page goes stale once it is programmed */
+	chip->cache->invalidate(chip, req->block, req->page);
+
 	ret = aw_spinand_chip_write_to_cache(chip, req);
 	if (ret)
 		return ret;
 
 	ret = aw_spinand_chip_program(chip, req);
 	if (ret)
-		return ret;
+		goto err;
 
 	if (likely(req->type != AW_SPINAND_MTD_REQ_PANIC))
 		ret = aw_spinand_chip_wait(chip, &status);
@@ -386,7 +391,13 @@ static int aw_spinand_chip_write_single_page(struct aw_spinand_chip *chip,
 
 	if (!ret && (status & STATUS_PROG_FAILED))
 		ret = -EIO;
+	if (ret)
+		goto err;
 
+	return 0;
+err:
+	/* we do not know what is on the page now */
+	chip->cache->invalidate(chip, req->block, req->page);
 	return ret;
 }
 
@@ -456,11 +467,117 @@ static int aw_spinand_chip_check_ecc(struct aw_spinand_chip *chip, u8 status)
 	return ecc->check_ecc(pinfo->EccType, status);
 }
 
+/*
+ * Read @count pages from req->page on into the cache slots by PAGE READ CACHE
+ * SEQUENTIAL, the chip loads the next page from the array while the current
+ * one is transferred. The last page is fetched with PAGE READ CACHE LAST.
+ */
+static int aw_spinand_chip_readahead(struct aw_spinand_chip *chip,
+		struct aw_spinand_chip_request *req, unsigned int count)
+{
+	struct aw_spinand_cache *cache = chip->cache;
+	struct aw_spinand_chip_request ra = {0};
+	unsigned char txbuf[1];
+	unsigned int i;
+	u8 status = 0;
+	int ret, ecc;
+
+	ra.block = req->block;
+	ra.page = req->page;
+	ra.datalen = cache->data_maxlen;
+	ra.ooblen = cache->oob_maxlen;
+
+	ret = aw_spinand_chip_load_page(chip, &ra);
+	if (ret)
+		return ret;
+
+	ret = aw_spinand_chip_wait(chip, NULL);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < count; i++, ra.page++) {
+		txbuf[0] = i < count - 1 ? SPI_NAND_READ_CACHE_SEQ :
+			SPI_NAND_READ_CACHE_LAST;
+		ret = spi_write(chip->spi, txbuf, 1);
+		if (ret)
+			break;
+
+		ret = aw_spinand_chip_wait(chip, &status);
+		if (ret)
+			break;
+
+		ecc = aw_spinand_chip_check_ecc(chip, status);
+		if (ecc < 0) {
+			ret = ecc;
+			break;
+		}
+		/* leave an uncorrectable page to the plain read to report */
+		if (ecc == ECC_ERR)
+			continue;
+
+		ret = chip->cache->read_to_slot(chip, &ra, ecc);
+		if (ret)
+			break;
+	}
+
+	if (ret && i < count - 1) {
+		/* get the chip out of the sequential cache read */
+		txbuf[0] = SPI_NAND_READ_CACHE_LAST;
+		if (!spi_write(chip->spi, txbuf, 1))
+			aw_spinand_chip_wait(chip, NULL);
+	}
+
+	sunxi_debug(NULL, "read-ahead phy blk %u page %u count %u: %d\n",
+			req->block, req->page, count, ret);
+	return ret;
+}
+
+/* note the page read on even/odd blocks, return whether req follows it */
+static bool aw_spinand_chip_seq_read(struct aw_spinand_chip *chip,
+		struct aw_spinand_chip_request *req)
+{
+	struct aw_spinand_cache *cache = chip->cache;
+	int i = req->block & 1;
+	bool seq;
+
+	seq = cache->seq_block[i] == req->block &&
+		cache->seq_page[i] + 1 == req->page;
+	cache->seq_block[i] = req->block;
+	cache->seq_page[i] = req->page;
+	return seq;
+}
+
+/* Return -ENOENT if neither a slot nor read-ahead has the page */
+static int aw_spinand_chip_read_slot(struct aw_spinand_chip *chip,
+		struct aw_spinand_chip_request *req, bool seq)
+{
+	struct aw_spinand_cache *cache = chip->cache;
+	struct aw_spinand_phy_info *pinfo = chip->info->phy_info;
+	unsigned int count;
+	int ecc, ret;
+
+	ecc = cache->take_slot(chip, req);
+	if (ecc == -ENOENT && seq && req->datalen &&
+			(pinfo->OperationOpt & SPINAND_CACHE_READ_SEQ)) {
+		/* half the slots, super pages read ahead on two blocks */
+		count = min(cache->nr_slots / 2,
+				pinfo->PageCntPerBlk - req->page);
+		if (count >= 2 && !aw_spinand_chip_readahead(chip, req, count))
+			ecc = cache->take_slot(chip, req);
+	}
+	if (ecc < 0)
+		return ecc;
+
+	ret = cache->copy_from_cache(chip, req);
+	return ret ? ret : ecc;
+}
+
 static int aw_spinand_chip_read_single_page(struct aw_spinand_chip *chip,
 		struct aw_spinand_chip_request *req)
 {
 	int ret;
 	u8 status = 0;
+	bool seq = false;
 	struct aw_spinand_cache *cache = chip->cache;
 	struct aw_spinand_phy_info *pinfo = chip->info->phy_info;
 
@@ -479,6 +596,9 @@ static int aw_spinand_chip_read_single_page(struct aw_spinand_chip *chip,
 		return -EOVERFLOW;
 	}
 
+	if (likely(req->type != AW_SPINAND_MTD_REQ_PANIC))
+		seq = aw_spinand_chip_seq_read(chip, req);
+
 	/* If the cache already has the data before, just copy them to req */
 	if (cache->match_cache(chip, req)) {
 		sunxi_debug(NULL, "cache match request blk %u page %u, no need to send to spinand\n",
@@ -486,6 +606,12 @@ static int aw_spinand_chip_read_single_page(struct aw_spinand_chip *chip,
 		return cache->copy_from_cache(chip, req);
 	}
 
+	if (likely(req->type != AW_SPINAND_MTD_REQ_PANIC)) {
+		ret = aw_spinand_chip_read_slot(chip, req, seq);
+		if (ret != -ENOENT)
+			return ret;
+	}
+
 	ret = aw_spinand_chip_load_page(chip, req);
 	if (ret)
 		return ret;
@@ -20,6 +20,8 @@
 #define SPI_NAND_GETSR		0x0f
 #define SPI_NAND_SETSR		0x1f
 #define SPI_NAND_PAGE_READ	0x13
+#define SPI_NAND_READ_CACHE_SEQ		0x31
+#define SPI_NAND_READ_CACHE_LAST	0x3f
 #define SPI_NAND_FAST_READ_X1	0x0b
 #define SPI_NAND_READ_X1	0x03
 #define SPI_NAND_READ_X2	0x3b
@@ -125,6 +127,7 @@ struct aw_spinand_phy_info {
 #define SPINAND_QUAD_NO_NEED_ENABLE		BIT(3)
 #define SPINAND_TWO_PLANE_SELECT		BIT(7)
 #define SPINAND_ONEDUMMY_AFTER_RANDOMREAD	BIT(8)
+#define SPINAND_CACHE_READ_SEQ			BIT(9)
 	int OperationOpt;
 	int MaxEraseTimes;
 #define HAS_EXT_ECC_SE01			BIT(0)
@@ -148,6 +151,15 @@ struct aw_spinand_bbt {
 	int (*is_badblock)(struct aw_spinand_chip *chip, unsigned int blknum);
 };
 
+/* a page kept by read-ahead, data and oob as read from the chip */
+struct aw_spinand_cache_slot {
+	unsigned int block;
+	unsigned int page;
+	int ecc;
+	unsigned long stamp;
+	unsigned char *buf;
+};
+
 struct aw_spinand_cache {
 	unsigned char *databuf;
 	unsigned char *oobbuf;
@@ -160,6 +172,20 @@ struct aw_spinand_cache {
 #define VALID_CACHE_DATA	BIT(2)
 	unsigned int area;
 
+	/*
+	 * Read-ahead pages besides the page above. A hit swaps the slot
+	 * buffer with databuf, so the page above is always the last one
+	 * handed out.
+	 */
+	struct aw_spinand_cache_slot *slots;
+	unsigned int nr_slots;
+	unsigned long stamp;
+	/* last page read on even and odd blocks, super pages interleave them */
+	unsigned int seq_block[2];
+	unsigned int seq_page[2];
+	unsigned long slot_hit;
+	unsigned long readahead;
+
 	/*
 	 * If the structure cache already has the data before, just copy
 	 * these data to req.
@@ -190,8 +216,24 @@ struct aw_spinand_cache {
 	 */
 	int (*read_from_cache)(struct aw_spinand_chip *chip,
 			struct aw_spinand_chip_request *req);
+	/*
+	 * @read_to_slot reads the whole page the chip holds in its cache
+	 *   register into the least recently used slot.
+	 * @take_slot moves a slot matching req to the page above and returns
+	 *   the ecc status it was read with, -ENOENT if no slot matches.
+	 * @invalidate drops the page, or every page of the block with page
+	 *   INVALID_CACHE, on write and erase.
+	 */
+	int (*read_to_slot)(struct aw_spinand_chip *chip,
+			struct aw_spinand_chip_request *req, int ecc);
+	int (*take_slot)(struct aw_spinand_chip *chip,
+			struct aw_spinand_chip_request *req);
+	void (*invalidate)(struct aw_spinand_chip *chip, unsigned int block,
+			unsigned int page);
 };
 
+#define INVALID_CACHE ((unsigned int)(-1))
+
 extern int aw_spinand_chip_ecc_init(struct aw_spinand_chip *chip);
 extern int aw_spinand_chip_ops_init(struct aw_spinand_chip *chip);
 extern int aw_spinand_chip_detect(struct aw_spinand_chip *chip);
@@ -30,6 +30,7 @@ struct aw_spinand {
 	int sector_shift;
 	int page_shift;
 	int block_shift;
+	int die_shift;
 	int phy_page_shift;
 	int phy_block_shift;
 #if IS_ENABLED(CONFIG_AW_SPINAND_SECURE_STORAGE)
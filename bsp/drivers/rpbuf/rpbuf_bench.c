@@ -0,0 +1,406 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/* Copyright(c) 2020 - 2023 Allwinner Technology Co.,Ltd. All rights reserved. */
+/*
+ * rpbuf benchmark on the loopback controller, no remote processor needed
+ *
+ * For every buffer size and transmit mode (async/sync) it reports the
+ * p50/p90/p99/max of:
+ *   alloc  rpbuf_alloc_buffer() until the buffer is available
+ *   tx     rpbuf_transmit_buffer(), in sync mode this is the ACK round trip
+ *   rtt    transmit until the peer's echo is received
+ *   rx     peer transmit until local rx_cb
+ * then the bulk throughput of back to back transmits, and of the ring mode
+ * with the given batch of frames per kick.
+ *
+ *   echo 64,4096,65536 > /sys/module/rpbuf_bench/parameters/sizes
+ *   echo 1 > /sys/module/rpbuf_bench/parameters/run
+ *
+ * Load rpbuf_controller_loopback with peer_cpu set to keep the peer off
+ * the cpu running the benchmark.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/delay.h>
+#include <linux/ktime.h>
+#include <linux/wait.h>
+#include <linux/atomic.h>
+#include <linux/completion.h>
+
+#include "rpbuf_internal.h"
+#include "rpbuf_loopback.h"
+
+#define BENCH_MAX_SIZES		8
+#define BENCH_RING_SLOTS	16
+
+static unsigned int iterations = 1000;
+module_param(iterations, uint, 0644);
+MODULE_PARM_DESC(iterations, "samples per size and mode (default: 1000)");
+
+static unsigned int sizes[BENCH_MAX_SIZES] = { 64, 4096, 65536 };
+static int nr_sizes = 3;
+module_param_array(sizes, uint, &nr_sizes, 0644);
+MODULE_PARM_DESC(sizes, "buffer sizes in bytes (default: 64,4096,65536)");
+
+static unsigned int modes = 3;
+module_param(modes, uint, 0644);
+MODULE_PARM_DESC(modes, "bit 0 async, bit 1 sync transmit (default: 3)");
+
+static unsigned int ring_batch = 16;
+module_param(ring_batch, uint, 0644);
+MODULE_PARM_DESC(ring_batch, "ring frames per kick, 0 to skip the ring (default: 16)");
+
+static unsigned int timeout_ms = 3000;
+module_param(timeout_ms, uint, 0644);
+MODULE_PARM_DESC(timeout_ms, "wait timeout in msec (default: 3000)");
+
+struct bench_ctx {
+	struct rpbuf_controller *controller;
+	struct completion available;
+	wait_queue_head_t wq;
+	atomic_t echoes;
+	/* the params are writable, a run only uses these copies */
+	unsigned int iterations;
+	unsigned int ring_batch;
+	u64 *rx;	/* per echo, peer transmit to local rx_cb */
+	u64 *rtt;	/* per echo, arrival time until bench_rtt() */
+};
+
+static DEFINE_MUTEX(bench_lock);
+
+static void bench_available_cb(struct rpbuf_buffer *buffer, void *priv)
+{
+	struct bench_ctx *ctx = priv;
+
+	complete(&ctx->available);
+}
+
+static int bench_rx_cb(struct rpbuf_buffer *buffer, void *data, int data_len,
+		       void *priv)
+{
+	struct bench_ctx *ctx = priv;
+	u64 now = ktime_get_ns();
+	u64 stamp;
+	int idx;
+
+	/* ring kick from the consumer, room again */
+	if (!data) {
+		wake_up(&ctx->wq);
+		return 0;
+	}
+
+	idx = atomic_read(&ctx->echoes);
+	if (idx < ctx->iterations) {
+		memcpy(&stamp, data, sizeof(stamp));
+		ctx->rx[idx] = now - stamp;
+		ctx->rtt[idx] = now;
+	}
+	atomic_inc(&ctx->echoes);
+	wake_up(&ctx->wq);
+
+	return 0;
+}
+
+static const struct rpbuf_buffer_cbs bench_cbs = {
+	.available_cb = bench_available_cb,
+	.rx_cb = bench_rx_cb,
+};
+
+static int bench_cmp(const void *a, const void *b)
+{
+	u64 x = *(const u64 *)a, y = *(const u64 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void bench_report(const char *what, unsigned int size, const char *mode,
+			 u64 *samples, unsigned int n)
+{
+	if (!n)
+		return;
+
+	sort(samples, n, sizeof(*samples), bench_cmp, NULL);
+	pr_info("%-5s %6u bytes %-5s p50/p90/p99/max %llu/%llu/%llu/%llu ns\n",
+		what, size, mode, samples[n / 2], samples[n * 9 / 10],
+		samples[n * 99 / 100], samples[n - 1]);
+}
+
+static struct rpbuf_buffer *bench_alloc(struct bench_ctx *ctx, const char *name,
+					unsigned int len)
+{
+	struct rpbuf_buffer *buffer;
+
+	reinit_completion(&ctx->available);
+	buffer = rpbuf_alloc_buffer(ctx->controller, name, len, NULL,
+				    &bench_cbs, ctx);
+	if (!buffer)
+		return NULL;
+
+	if (!wait_for_completion_timeout(&ctx->available,
+					 msecs_to_jiffies(timeout_ms))) {
+		pr_err("buffer %s not available\n", name);
+		rpbuf_free_buffer(buffer);
+		return NULL;
+	}
+
+	return buffer;
+}
+
+static int bench_alloc_latency(struct bench_ctx *ctx, unsigned int size,
+			       u64 *samples)
+{
+	struct rpbuf_buffer *buffer;
+	char name[RPBUF_NAME_SIZE];
+	u64 start;
+	unsigned int i;
+
+	snprintf(name, sizeof(name), "bench-alloc-%u", size);
+	for (i = 0; i < ctx->iterations; i++) {
+		start = ktime_get_ns();
+		buffer = bench_alloc(ctx, name, size);
+		if (!buffer)
+			return -ETIMEDOUT;
+		samples[i] = ktime_get_ns() - start;
+		rpbuf_free_buffer(buffer);
+	}
+
+	bench_report("alloc", size, "", samples, ctx->iterations);
+	return 0;
+}
+
+/* one transmit at a time, each waits for its echo */
+static int bench_rtt(struct bench_ctx *ctx, struct rpbuf_buffer *buffer,
+		     unsigned int size, const char *mode, u64 *tx)
+{
+	u64 start;
+	unsigned int i;
+	int ret;
+
+	atomic_set(&ctx->echoes, 0);
+	for (i = 0; i < ctx->iterations; i++) {
+		start = ktime_get_ns();
+		ret = rpbuf_transmit_buffer(buffer, 0, size);
+		if (ret < 0)
+			return ret;
+		tx[i] = ktime_get_ns() - start;
+
+		if (!wait_event_timeout(ctx->wq, atomic_read(&ctx->echoes) > i,
+					msecs_to_jiffies(timeout_ms)))
+			return -ETIMEDOUT;
+		ctx->rtt[i] -= start;
+	}
+
+	bench_report("tx", size, mode, tx, ctx->iterations);
+	bench_report("rtt", size, mode, ctx->rtt, ctx->iterations);
+	bench_report("rx", size, mode, ctx->rx, ctx->iterations);
+	return 0;
+}
+
+/* back to back transmits, done when the last echo is back */
+static int bench_bulk(struct bench_ctx *ctx, struct rpbuf_buffer *buffer,
+		      unsigned int size, const char *mode)
+{
+	u64 start, elapsed;
+	unsigned int i;
+	int ret;
+
+	atomic_set(&ctx->echoes, 0);
+	start = ktime_get_ns();
+	for (i = 0; i < ctx->iterations; i++) {
+		ret = rpbuf_transmit_buffer(buffer, 0, size);
+		if (ret < 0)
+			return ret;
+	}
+	if (!wait_event_timeout(ctx->wq,
+				atomic_read(&ctx->echoes) >= ctx->iterations,
+				msecs_to_jiffies(timeout_ms)))
+		return -ETIMEDOUT;
+	elapsed = ktime_get_ns() - start;
+
+	pr_info("bulk  %6u bytes %-5s %u transmits, %llu MB/s\n", size, mode,
+		ctx->iterations,
+		div64_u64((u64)size * ctx->iterations * 1000, elapsed));
+	return 0;
+}
+
+static int bench_transmit(struct bench_ctx *ctx, unsigned int size, u64 *tx)
+{
+	struct rpbuf_buffer *buffer;
+	char name[RPBUF_NAME_SIZE];
+	const char *mode;
+	int sync, ret = 0;
+
+	snprintf(name, sizeof(name), "bench-xfer-%u", size);
+	buffer = bench_alloc(ctx, name, size);
+	if (!buffer)
+		return -ETIMEDOUT;
+
+	for (sync = 0; sync < 2 && !ret; sync++) {
+		if (!(modes & BIT(sync)))
+			continue;
+		mode = sync ? "sync" : "async";
+		rpbuf_buffer_set_sync(buffer, sync);
+
+		ret = bench_rtt(ctx, buffer, size, mode, tx);
+		if (!ret)
+			ret = bench_bulk(ctx, buffer, size, mode);
+		if (ret)
+			pr_err("%u bytes %s transmit failed: %d\n", size, mode, ret);
+	}
+
+	rpbuf_free_buffer(buffer);
+	return ret;
+}
+
+static int bench_ring(struct bench_ctx *ctx, unsigned int size)
+{
+	struct rpbuf_buffer *buffer;
+	struct rpbuf_ring_hdr *hdr;
+	char name[RPBUF_NAME_SIZE];
+	unsigned int len, i;
+	u64 start, elapsed;
+	void *frame;
+	int ret;
+
+	frame = kzalloc(size, GFP_KERNEL);
+	if (!frame)
+		return -ENOMEM;
+
+	len = ALIGN(sizeof(*hdr), RPBUF_RING_ALIGN) +
+	      BENCH_RING_SLOTS * ALIGN(sizeof(struct rpbuf_ring_slot) + size, 8);
+	snprintf(name, sizeof(name), "bench-ring-%u", size);
+	buffer = bench_alloc(ctx, name, len);
+	if (!buffer) {
+		ret = -ETIMEDOUT;
+		goto out_free_frame;
+	}
+
+	ret = rpbuf_ring_setup(buffer, size, true);
+	if (ret < 0)
+		goto out_free_buffer;
+	hdr = rpbuf_buffer_va(buffer);
+
+	start = ktime_get_ns();
+	for (i = 0; i < ctx->iterations; i++) {
+		/* the peer takes its latency from the stamp */
+		*(u64 *)frame = ktime_get_ns();
+		ret = rpbuf_ring_write(buffer, frame, size,
+				       (i + 1) % ctx->ring_batch &&
+				       i + 1 < ctx->iterations);
+		if (ret == -ENOSPC) {
+			/* push out what is batched, then wait for room */
+			rpbuf_ring_kick(buffer);
+			if (!wait_event_timeout(ctx->wq, rpbuf_ring_arm(buffer),
+						msecs_to_jiffies(timeout_ms))) {
+				ret = -ETIMEDOUT;
+				goto out_free_buffer;
+			}
+			i--;
+			continue;
+		}
+		if (ret < 0)
+			goto out_free_buffer;
+	}
+	while (READ_ONCE(hdr->tail) != READ_ONCE(hdr->head)) {
+		if (ktime_get_ns() - start > (u64)timeout_ms * NSEC_PER_MSEC) {
+			ret = -ETIMEDOUT;
+			goto out_free_buffer;
+		}
+		usleep_range(10, 20);
+	}
+	elapsed = ktime_get_ns() - start;
+
+	pr_info("ring  %6u bytes       %u frames, %llu kicks, %llu MB/s\n", size,
+		ctx->iterations, buffer->ring.kicks_sent,
+		div64_u64((u64)size * ctx->iterations * 1000, elapsed));
+
+out_free_buffer:
+	if (ret < 0)
+		pr_err("%u bytes ring failed: %d\n", size, ret);
+	rpbuf_free_buffer(buffer);
+out_free_frame:
+	kfree(frame);
+	return ret;
+}
+
+static int bench_run(void)
+{
+	struct bench_ctx *ctx;
+	u64 *samples;
+	int i, ret = 0;
+
+	if (!nr_sizes)
+		return -EINVAL;
+	for (i = 0; i < nr_sizes; i++)
+		if (sizes[i] < sizeof(u64))
+			return -EINVAL;
+
+	ctx = kzalloc(sizeof(*ctx), GFP_KERNEL);
+	if (!ctx)
+		return -ENOMEM;
+	ctx->controller = rpbuf_loopback_get_controller();
+	ctx->iterations = iterations;
+	ctx->ring_batch = ring_batch;
+	init_completion(&ctx->available);
+	init_waitqueue_head(&ctx->wq);
+	if (!ctx->iterations) {
+		kfree(ctx);
+		return -EINVAL;
+	}
+
+	samples = kvcalloc(ctx->iterations, sizeof(u64), GFP_KERNEL);
+	ctx->rx = kvcalloc(ctx->iterations, sizeof(u64), GFP_KERNEL);
+	ctx->rtt = kvcalloc(ctx->iterations, sizeof(u64), GFP_KERNEL);
+	if (!samples || !ctx->rx || !ctx->rtt) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	rpbuf_loopback_set_echo(true);
+	for (i = 0; i < nr_sizes && !ret; i++) {
+		ret = bench_alloc_latency(ctx, sizes[i], samples);
+		if (!ret && modes)
+			ret = bench_transmit(ctx, sizes[i], samples);
+	}
+	rpbuf_loopback_set_echo(false);
+
+	for (i = 0; i < nr_sizes && !ret && ctx->ring_batch; i++)
+		ret = bench_ring(ctx, sizes[i]);
+
+out:
+	kvfree(ctx->rtt);
+	kvfree(ctx->rx);
+	kvfree(samples);
+	kfree(ctx);
+	return ret;
+}
+
+static int bench_run_set(const char *val, const struct kernel_param *kp)
+{
+	bool start;
+	int ret;
+
+	ret = kstrtobool(val, &start);
+	if (ret || !start)
+		return ret;
+
+	mutex_lock(&bench_lock);
+	ret = bench_run();
+	mutex_unlock(&bench_lock);
+
+	return ret;
+}
+
+static const struct kernel_param_ops bench_run_ops = {
+	.set = bench_run_set,
+	.get = param_get_bool,
+};
+
+static bool run;
+module_param_cb(run, &bench_run_ops, &run, 0200);
+MODULE_PARM_DESC(run, "write 1 to run the benchmark");
+
+MODULE_DESCRIPTION("RPBuf benchmark on the loopback controller");
+MODULE_LICENSE("GPL");
@@ -0,0 +1,542 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright(c) 2020 - 2023 Allwinner Technology Co.,Ltd. All rights reserved. */
+/*
+ *
+ * (C) Copyright 2020-2025
+ * Allwinner Technology Co., Ltd. <www.allwinnertech.com>
+ *
+ * RPBuf loopback controller.
+ *
+ * A pair of linked controllers that needs no remote processor. The local
+ * end is a MASTER exported as /dev/rpbuf_ctrl<ctrl_id>. The peer end is a
+ * SLAVE standing in for the remote core: it creates the counterpart of
+ * every buffer local creates, acks synchronous transmits and drains the
+ * ring of a buffer on every kick. Each end has a kthread worker delivering
+ * the service messages sent to it, the peer's is bound to peer_cpu if set.
+ *
+ * Frames of at least 8 bytes starting with a CLOCK_MONOTONIC timestamp in
+ * ns give the latency from the producer to the peer, see
+ * /sys/devices/rpbuf_loopback_peer/stats (write anything to clear).
+ *
+ * With echo set, the peer transmits every received payload back, after
+ * stamping its first 8 bytes with its own CLOCK_MONOTONIC time, so local
+ * can time the receive path too (see rpbuf_bench.c).
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ */
+
+#define pr_fmt(fmt)	"[RPBUF LOOPBACK](%s:%d) " fmt, __func__, __LINE__
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/mm.h>
+#include <linux/cpumask.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+
+#include "rpbuf_internal.h"
+#include "rpbuf_loopback.h"
+
+#define SUNXI_RPBUF_LOOPBACK_VERSION "1.1.0"
+
+/* ring frames the peer reads before letting other messages in */
+#define RPBUF_LOOPBACK_DRAIN_BUDGET	256
+
+static int ctrl_id = 15;
+module_param(ctrl_id, int, 0444);
+MODULE_PARM_DESC(ctrl_id, "id of /dev/rpbuf_ctrl<id> for the local end (default: 15)");
+
+static int peer_cpu = -1;
+module_param(peer_cpu, int, 0444);
+MODULE_PARM_DESC(peer_cpu, "cpu the peer end runs on, -1 for any (default: -1)");
+
+static bool echo;
+module_param(echo, bool, 0644);
+MODULE_PARM_DESC(echo, "peer transmits received payloads back (default: N)");
+
+struct rpbuf_loopback_end {
+	struct device *dev;
+	struct rpbuf_service *service;
+	struct rpbuf_controller *controller;
+	/* delivers the messages sent to this end */
+	struct kthread_worker *worker;
+	struct rpbuf_loopback_end *peer;
+};
+
+struct rpbuf_loopback_msg {
+	struct kthread_work work;
+	struct rpbuf_loopback_end *to;
+	int len;
+	u8 data[RPBUF_SERVICE_MESSAGE_LENGTH_MAX];
+};
+
+/*
+ * Counterpart of a local buffer on the peer end. Like a remote firmware
+ * the peer keeps it when local frees its side, so local can create the
+ * buffer again. Only the peer worker touches it.
+ */
+struct rpbuf_loopback_buf {
+	struct rpbuf_buffer *buffer;
+	struct kthread_work drain;
+	void *frame;
+	bool ring_setup;
+	struct list_head list;
+};
+
+struct rpbuf_loopback_stats {
+	u64 transmits;
+	u64 kicks;
+	u64 frames;
+	u64 bytes;
+	u64 lat_cnt;
+	u64 lat_total;
+	u64 lat_min;
+	u64 lat_max;
+};
+
+static struct rpbuf_loopback_end lb_local;
+static struct rpbuf_loopback_end lb_peer;
+static LIST_HEAD(lb_bufs);
+
+static struct rpbuf_loopback_stats lb_stats = { .lat_min = U64_MAX };
+static DEFINE_SPINLOCK(lb_stats_lock);
+
+static void rpbuf_loopback_account(const void *data, int len)
+{
+	u64 now = ktime_get_ns();
+	u64 stamp = 0;
+
+	if (len >= sizeof(stamp))
+		memcpy(&stamp, data, sizeof(stamp));
+
+	spin_lock(&lb_stats_lock);
+	lb_stats.frames++;
+	lb_stats.bytes += len;
+	if (stamp && stamp <= now) {
+		lb_stats.lat_cnt++;
+		lb_stats.lat_total += now - stamp;
+		lb_stats.lat_min = min(lb_stats.lat_min, now - stamp);
+		lb_stats.lat_max = max(lb_stats.lat_max, now - stamp);
+	}
+	spin_unlock(&lb_stats_lock);
+}
+
+static void rpbuf_loopback_drain(struct kthread_work *work)
+{
+	struct rpbuf_loopback_buf *lb_buf =
+		container_of(work, struct rpbuf_loopback_buf, drain);
+	struct rpbuf_buffer *buffer = lb_buf->buffer;
+	int budget = RPBUF_LOOPBACK_DRAIN_BUDGET;
+	int len;
+
+	if (!lb_buf->ring_setup) {
+		if (rpbuf_ring_setup(buffer, 0, false) < 0)
+			return;
+		lb_buf->ring_setup = true;
+	}
+
+	while (budget--) {
+		len = rpbuf_ring_read(buffer, lb_buf->frame, rpbuf_buffer_len(buffer));
+		if (len < 0) {
+			if (len != -EAGAIN)
+				dev_warn(lb_peer.dev, "buffer \"%s\" ring read failed: %d\n",
+					 rpbuf_buffer_name(buffer), len);
+			return;
+		}
+		rpbuf_loopback_account(lb_buf->frame, len);
+	}
+
+	kthread_queue_work(lb_peer.worker, &lb_buf->drain);
+}
+
+static int rpbuf_loopback_peer_rx_cb(struct rpbuf_buffer *buffer,
+				     void *data, int data_len, void *priv)
+{
+	struct rpbuf_loopback_buf *lb_buf = priv;
+	u64 stamp;
+	int ret;
+
+	if (data) {
+		spin_lock(&lb_stats_lock);
+		lb_stats.transmits++;
+		spin_unlock(&lb_stats_lock);
+		rpbuf_loopback_account(data, data_len);
+
+		if (!READ_ONCE(echo))
+			return 0;
+		if (data_len >= sizeof(stamp)) {
+			stamp = ktime_get_ns();
+			memcpy(data, &stamp, sizeof(stamp));
+		}
+		ret = rpbuf_transmit_buffer(buffer, data - rpbuf_buffer_va(buffer),
+					    data_len);
+		if (ret < 0)
+			dev_warn(lb_peer.dev, "buffer \"%s\" echo failed: %d\n",
+				 rpbuf_buffer_name(buffer), ret);
+		return 0;
+	}
+
+	spin_lock(&lb_stats_lock);
+	lb_stats.kicks++;
+	spin_unlock(&lb_stats_lock);
+	kthread_queue_work(lb_peer.worker, &lb_buf->drain);
+
+	return 0;
+}
+
+static int rpbuf_loopback_peer_destroyed_cb(struct rpbuf_buffer *buffer, void *priv)
+{
+	struct rpbuf_loopback_buf *lb_buf = priv;
+
+	/* local formats a new ring when it creates the buffer again */
+	lb_buf->ring_setup = false;
+
+	return 0;
+}
+
+static const struct rpbuf_buffer_cbs rpbuf_loopback_peer_cbs = {
+	.rx_cb = rpbuf_loopback_peer_rx_cb,
+	.destroyed_cb = rpbuf_loopback_peer_destroyed_cb,
+};
+
+static void rpbuf_loopback_peer_create(struct rpbuf_service_content_buffer_created *cont)
+{
+	struct rpbuf_loopback_buf *lb_buf;
+	char name[RPBUF_NAME_SIZE];
+
+	strscpy(name, (const char *)cont->name, RPBUF_NAME_SIZE);
+
+	/* kept from before, the core links it up again */
+	list_for_each_entry(lb_buf, &lb_bufs, list) {
+		if (!strcmp(rpbuf_buffer_name(lb_buf->buffer), name))
+			return;
+	}
+
+	lb_buf = kzalloc(sizeof(*lb_buf), GFP_KERNEL);
+	if (!lb_buf)
+		return;
+
+	kthread_init_work(&lb_buf->drain, rpbuf_loopback_drain);
+	lb_buf->frame = kvmalloc(cont->len, GFP_KERNEL);
+	if (!lb_buf->frame)
+		goto err_free_lb_buf;
+
+	lb_buf->buffer = rpbuf_alloc_buffer(lb_peer.controller, name, cont->len,
+					    NULL, &rpbuf_loopback_peer_cbs, lb_buf);
+	if (!lb_buf->buffer) {
+		dev_err(lb_peer.dev, "rpbuf_alloc_buffer for %s failed\n", name);
+		goto err_free_frame;
+	}
+
+	list_add_tail(&lb_buf->list, &lb_bufs);
+	return;
+
+err_free_frame:
+	kvfree(lb_buf->frame);
+err_free_lb_buf:
+	kfree(lb_buf);
+}
+
+static void rpbuf_loopback_deliver(struct kthread_work *work)
+{
+	struct rpbuf_loopback_msg *m =
+		container_of(work, struct rpbuf_loopback_msg, work);
+	struct rpbuf_service_message_header *header = (void *)m->data;
+
+	rpbuf_service_get_notification(m->to->service, m->data, m->len);
+
+	/* the peer plays the remote, answer like its firmware would */
+	if (m->to == &lb_peer && header->command == RPBUF_SERVICE_CMD_BUFFER_CREATED)
+		rpbuf_loopback_peer_create((void *)(header + 1));
+
+	kfree(m);
+}
+
+static int rpbuf_loopback_notify(void *msg, int msg_len, void *priv)
+{
+	struct rpbuf_loopback_end *end = priv;
+	struct rpbuf_loopback_msg *m;
+
+	if (msg_len > RPBUF_SERVICE_MESSAGE_LENGTH_MAX)
+		return -EINVAL;
+
+	m = kmalloc(sizeof(*m), GFP_ATOMIC);
+	if (!m)
+		return -ENOMEM;
+
+	kthread_init_work(&m->work, rpbuf_loopback_deliver);
+	m->to = end->peer;
+	m->len = msg_len;
+	memcpy(m->data, msg, msg_len);
+	kthread_queue_work(m->to->worker, &m->work);
+
+	return 0;
+}
+
+static const struct rpbuf_service_ops rpbuf_loopback_service_ops = {
+	.notify = rpbuf_loopback_notify,
+};
+
+static int rpbuf_loopback_alloc_payload_memory(struct rpbuf_controller *controller,
+					       struct rpbuf_buffer *buffer,
+					       void *priv)
+{
+	void *va;
+
+	va = alloc_pages_exact(PAGE_ALIGN(buffer->len), GFP_KERNEL | __GFP_ZERO);
+	if (!va) {
+		dev_err(controller->dev, "alloc_pages_exact for len %d failed\n",
+			buffer->len);
+		return -ENOMEM;
+	}
+
+	buffer->va = va;
+	buffer->pa = virt_to_phys(va);
+	buffer->da = (u64)buffer->pa;
+
+	return 0;
+}
+
+static void rpbuf_loopback_free_payload_memory(struct rpbuf_controller *controller,
+					       struct rpbuf_buffer *buffer,
+					       void *priv)
+{
+	free_pages_exact(buffer->va, PAGE_ALIGN(buffer->len));
+}
+
+/* both ends see the same kernel memory */
+static void *rpbuf_loopback_addr_remap(struct rpbuf_controller *controller,
+				       phys_addr_t pa, u64 da, int len, void *priv)
+{
+	return phys_to_virt(pa);
+}
+
+static int rpbuf_loopback_buf_dev_mmap(struct rpbuf_controller *controller,
+				       struct rpbuf_buffer *buffer, void *priv,
+				       struct vm_area_struct *vma)
+{
+	unsigned long size = vma->vm_end - vma->vm_start;
+
+	if (size > PAGE_ALIGN(buffer->len))
+		return -EINVAL;
+
+	/* only cpus share it, so unlike the default it stays cached */
+	return remap_pfn_range(vma, vma->vm_start, PHYS_PFN(buffer->pa),
+			       size, vma->vm_page_prot);
+}
+
+static const struct rpbuf_controller_ops rpbuf_loopback_controller_ops = {
+	.alloc_payload_memory = rpbuf_loopback_alloc_payload_memory,
+	.free_payload_memory = rpbuf_loopback_free_payload_memory,
+	.addr_remap = rpbuf_loopback_addr_remap,
+	.buf_dev_mmap = rpbuf_loopback_buf_dev_mmap,
+};
+
+struct rpbuf_controller *rpbuf_loopback_get_controller(void)
+{
+	return lb_local.controller;
+}
+EXPORT_SYMBOL(rpbuf_loopback_get_controller);
+
+void rpbuf_loopback_set_echo(bool enable)
+{
+	WRITE_ONCE(echo, enable);
+}
+EXPORT_SYMBOL(rpbuf_loopback_set_echo);
+
+static ssize_t stats_show(struct device *dev, struct device_attribute *attr,
+			  char *buf)
+{
+	struct rpbuf_loopback_stats st;
+
+	spin_lock(&lb_stats_lock);
+	st = lb_stats;
+	spin_unlock(&lb_stats_lock);
+
+	return sprintf(buf,
+		       "transmits: %llu\nkicks: %llu\nframes: %llu\nbytes: %llu\n"
+		       "latency(ns) min/avg/max: %llu/%llu/%llu\n",
+		       st.transmits, st.kicks, st.frames, st.bytes,
+		       st.lat_cnt ? st.lat_min : 0,
+		       st.lat_cnt ? div64_u64(st.lat_total, st.lat_cnt) : 0,
+		       st.lat_max);
+}
+
+static ssize_t stats_store(struct device *dev, struct device_attribute *attr,
+			   const char *buf, size_t count)
+{
+	spin_lock(&lb_stats_lock);
+	memset(&lb_stats, 0, sizeof(lb_stats));
+	lb_stats.lat_min = U64_MAX;
+	spin_unlock(&lb_stats_lock);
+
+	return count;
+}
+static DEVICE_ATTR_RW(stats);
+
+static void rpbuf_loopback_end_exit(struct rpbuf_loopback_end *end)
+{
+	if (end->controller) {
+		rpbuf_unregister_controller(end->controller);
+		rpbuf_destroy_controller(end->controller);
+		end->controller = NULL;
+	}
+	if (end->service) {
+		rpbuf_unregister_service(end->service);
+		rpbuf_destroy_service(end->service);
+		end->service = NULL;
+	}
+	if (end->worker) {
+		kthread_destroy_worker(end->worker);
+		end->worker = NULL;
+	}
+	if (end->dev) {
+		root_device_unregister(end->dev);
+		end->dev = NULL;
+	}
+}
+
+static int rpbuf_loopback_end_init(struct rpbuf_loopback_end *end,
+				   const char *name, enum rpbuf_role role,
+				   int cpu)
+{
+	int ret;
+
+	end->dev = root_device_register(name);
+	if (IS_ERR(end->dev)) {
+		ret = PTR_ERR(end->dev);
+		end->dev = NULL;
+		pr_err("root_device_register %s failed\n", name);
+		return ret;
+	}
+
+	if (cpu >= 0)
+		end->worker = kthread_create_worker_on_cpu(cpu, 0, "%s", name);
+	else
+		end->worker = kthread_create_worker(0, "%s", name);
+	if (IS_ERR(end->worker)) {
+		ret = PTR_ERR(end->worker);
+		end->worker = NULL;
+		dev_err(end->dev, "kthread_create_worker failed\n");
+		goto err_out;
+	}
+
+	/* each end links its own service and controller, by the end itself */
+	end->service = rpbuf_create_service(end->dev, &rpbuf_loopback_service_ops, end);
+	if (!end->service) {
+		ret = -ENOMEM;
+		goto err_out;
+	}
+	ret = rpbuf_register_service(end->service, end);
+	if (ret < 0) {
+		dev_err(end->dev, "rpbuf_register_service failed\n");
+		rpbuf_destroy_service(end->service);
+		end->service = NULL;
+		goto err_out;
+	}
+
+	end->controller = rpbuf_create_controller(end->dev,
+						  &rpbuf_loopback_controller_ops, end);
+	if (!end->controller) {
+		ret = -ENOMEM;
+		goto err_out;
+	}
+	ret = rpbuf_register_controller(end->controller, end, role);
+	if (ret < 0) {
+		dev_err(end->dev, "rpbuf_register_controller failed\n");
+		rpbuf_destroy_controller(end->controller);
+		end->controller = NULL;
+		goto err_out;
+	}
+
+	dev_set_drvdata(end->dev, end->controller);
+
+	return 0;
+
+err_out:
+	rpbuf_loopback_end_exit(end);
+	return ret;
+}
+
+static void rpbuf_loopback_free_bufs(void)
+{
+	struct rpbuf_loopback_buf *lb_buf, *tmp;
+
+	list_for_each_entry_safe(lb_buf, tmp, &lb_bufs, list) {
+		kthread_cancel_work_sync(&lb_buf->drain);
+		list_del(&lb_buf->list);
+		rpbuf_free_buffer(lb_buf->buffer);
+		kvfree(lb_buf->frame);
+		kfree(lb_buf);
+	}
+}
+
+static int __init rpbuf_loopback_init(void)
+{
+	int ret;
+
+	if (peer_cpu >= 0 && !cpu_online(peer_cpu)) {
+		pr_err("peer_cpu %d not online\n", peer_cpu);
+		return -EINVAL;
+	}
+
+	lb_local.peer = &lb_peer;
+	lb_peer.peer = &lb_local;
+
+	ret = rpbuf_loopback_end_init(&lb_local, "rpbuf_loopback", RPBUF_ROLE_MASTER, -1);
+	if (ret < 0)
+		return ret;
+
+	ret = rpbuf_loopback_end_init(&lb_peer, "rpbuf_loopback_peer", RPBUF_ROLE_SLAVE,
+				      peer_cpu);
+	if (ret < 0)
+		goto err_local_exit;
+
+	ret = device_create_file(lb_peer.dev, &dev_attr_stats);
+	if (ret < 0)
+		goto err_peer_exit;
+
+	ret = rpbuf_register_ctrl_dev(lb_local.dev, ctrl_id, lb_local.controller);
+	if (ret < 0) {
+		dev_err(lb_local.dev, "rpbuf_register_ctrl_dev failed\n");
+		goto err_remove_file;
+	}
+
+	return 0;
+
+err_remove_file:
+	device_remove_file(lb_peer.dev, &dev_attr_stats);
+err_peer_exit:
+	rpbuf_loopback_end_exit(&lb_peer);
+err_local_exit:
+	rpbuf_loopback_end_exit(&lb_local);
+	return ret;
+}
+module_init(rpbuf_loopback_init);
+
+static void __exit rpbuf_loopback_exit(void)
+{
+	rpbuf_unregister_ctrl_dev(lb_local.dev, ctrl_id);
+
+	/* let the messages in flight land before tearing the links down */
+	kthread_flush_worker(lb_local.worker);
+	kthread_flush_worker(lb_peer.worker);
+	rpbuf_loopback_free_bufs();
+	kthread_flush_worker(lb_local.worker);
+
+	device_remove_file(lb_peer.dev, &dev_attr_stats);
+	rpbuf_loopback_end_exit(&lb_peer);
+	rpbuf_loopback_end_exit(&lb_local);
+}
+module_exit(rpbuf_loopback_exit);
+
+MODULE_DESCRIPTION("RPBuf loopback controller");
+MODULE_LICENSE("GPL v2");
+MODULE_VERSION(SUNXI_RPBUF_LOOPBACK_VERSION);
@@ -26,10 +26,11 @@
 #include <linux/of.h>
 #include <linux/platform_device.h>
 #include <linux/dma-mapping.h>
+#include <linux/log2.h>
 
 #include "rpbuf_internal.h"
 
-#define SUNXI_RPBUF_CORE_VERSION "1.2.4"
+#define SUNXI_RPBUF_CORE_VERSION "1.3.0"
 
 typedef int (*rpbuf_service_command_handler_t)(struct rpbuf_service *service,
 					       enum rpbuf_service_command cmd,
@@ -1117,6 +1118,15 @@ static int rpbuf_service_command_buffer_transmitted_handler(struct rpbuf_service
 		goto err_out;
 	}
 
+	/* a ring kick carries no data, the frames are in the ring already */
+	if (cont->flags & BUFFER_RING_KICK) {
+		if (buffer->ring.enabled)
+			buffer->ring.kicks_recv++;
+		if (buffer->cbs && buffer->cbs->rx_cb)
+			buffer->cbs->rx_cb(buffer, NULL, 0, buffer->priv);
+		goto out;
+	}
+
 	if ((cont->flags & BUFFER_SYNC_TRANSMIT)) {
 		buffer->need_ack = true;
 	}
@@ -1138,6 +1148,7 @@ static int rpbuf_service_command_buffer_transmitted_handler(struct rpbuf_service
 		}
 	}
 
+out:
 	buffer->state &= ~RPBUF_FLAGS_WORKING;
 	if (buffer->state & RPBUF_FLAGS_DESTROYED)
 		wake_up_interruptible(&buffer->wait);
@@ -1720,6 +1731,278 @@ int rpbuf_transmit_buffer(struct rpbuf_buffer *buffer,
 }
 EXPORT_SYMBOL(rpbuf_transmit_buffer);
 
+static inline bool rpbuf_ring_need_event(u32 event, u32 new, u32 old)
+{
+	return (u32)(new - event - 1) < (u32)(new - old);
+}
+
+static inline struct rpbuf_ring_slot *rpbuf_ring_slot(struct rpbuf_buffer *buffer,
+						      u32 idx)
+{
+	struct rpbuf_ring *ring = &buffer->ring;
+
+	return buffer->va + ring->data_offset +
+	       (idx & (ring->slot_num - 1)) * ring->stride;
+}
+
+/*
+ * The consumer may have set up before the producer formatted the ring,
+ * then it takes the layout over here once the magic shows up.
+ */
+static bool rpbuf_ring_ready(struct rpbuf_buffer *buffer)
+{
+	struct rpbuf_ring *ring = &buffer->ring;
+	struct rpbuf_ring_hdr *hdr = buffer->va;
+	u32 slot_size, slot_num, stride, data_offset;
+
+	if (ring->ready)
+		return true;
+
+	if (READ_ONCE(hdr->magic) != RPBUF_RING_MAGIC)
+		return false;
+	rmb();
+
+	slot_size = READ_ONCE(hdr->slot_size);
+	slot_num = READ_ONCE(hdr->slot_num);
+	stride = READ_ONCE(hdr->stride);
+	data_offset = READ_ONCE(hdr->data_offset);
+
+	if (!is_power_of_2(slot_num) || data_offset < sizeof(*hdr) ||
+	    stride < sizeof(struct rpbuf_ring_slot) + (u64)slot_size ||
+	    (u64)slot_num * stride + data_offset > buffer->len ||
+	    (ring->slot_size && ring->slot_size != slot_size)) {
+		dev_err(buffer->controller->dev,
+			"buffer \"%s\" invalid ring layout (slot %u x %u, stride %u, offset %u)\n",
+			buffer->name, slot_num, slot_size, stride, data_offset);
+		return false;
+	}
+
+	ring->slot_size = slot_size;
+	ring->slot_num = slot_num;
+	ring->stride = stride;
+	ring->data_offset = data_offset;
+	ring->kicked = READ_ONCE(hdr->tail);
+	ring->ready = true;
+
+	return true;
+}
+
+int rpbuf_ring_setup(struct rpbuf_buffer *buffer, unsigned int slot_size,
+		     bool producer)
+{
+	struct rpbuf_ring *ring = &buffer->ring;
+	struct rpbuf_ring_hdr *hdr = buffer->va;
+	u32 data_offset = ALIGN(sizeof(*hdr), RPBUF_RING_ALIGN);
+	size_t stride;
+
+	if (!buffer->va || (producer && !slot_size)) {
+		pr_err("invalid arguments\n");
+		return -EINVAL;
+	}
+	if (!rpbuf_buffer_is_available(buffer))
+		return -EACCES;
+
+	/* slot_size comes from userspace, keep the stride from wrapping */
+	if (buffer->len < data_offset + sizeof(struct rpbuf_ring_slot) ||
+	    slot_size > buffer->len - data_offset - sizeof(struct rpbuf_ring_slot)) {
+		dev_err(buffer->controller->dev,
+			"buffer \"%s\" too small for %u bytes ring slots\n",
+			buffer->name, slot_size);
+		return -EINVAL;
+	}
+
+	stride = ALIGN(sizeof(struct rpbuf_ring_slot) + slot_size, 8);
+	if (producer && buffer->len < data_offset + 2 * stride) {
+		dev_err(buffer->controller->dev,
+			"buffer \"%s\" too small for a ring of %u bytes slots\n",
+			buffer->name, slot_size);
+		return -EINVAL;
+	}
+
+	/*
+	 * Setting up again (e.g. after the remote re-created the buffer)
+	 * starts over, the caller must not be using the ring meanwhile.
+	 */
+	memset(ring, 0, sizeof(*ring));
+	ring->producer = producer;
+	ring->slot_size = slot_size;
+	ring->enabled = true;
+
+	if (!producer) {
+		rpbuf_ring_ready(buffer);
+		return 0;
+	}
+
+	ring->stride = stride;
+	ring->data_offset = data_offset;
+	ring->slot_num = rounddown_pow_of_two((buffer->len - data_offset) / stride);
+
+	WRITE_ONCE(hdr->magic, 0);
+	wmb();
+	hdr->slot_size = ring->slot_size;
+	hdr->slot_num = ring->slot_num;
+	hdr->stride = ring->stride;
+	hdr->data_offset = ring->data_offset;
+	hdr->head = 0;
+	hdr->tail = 0;
+	/* kick on the first frame, the consumer may be waiting already */
+	hdr->head_event = 0;
+	hdr->tail_event = U32_MAX;
+	wmb();
+	WRITE_ONCE(hdr->magic, RPBUF_RING_MAGIC);
+
+	ring->ready = true;
+
+	return 0;
+}
+EXPORT_SYMBOL(rpbuf_ring_setup);
+
+int rpbuf_ring_kick(struct rpbuf_buffer *buffer)
+{
+	struct rpbuf_ring *ring = &buffer->ring;
+	struct rpbuf_ring_hdr *hdr = buffer->va;
+	struct rpbuf_service_content_buffer_transmitted content;
+	u32 new, old, event;
+	int ret;
+
+	if (!ring->enabled)
+		return -EINVAL;
+	if (!ring->ready)
+		return 0;
+	if (buffer->state & RPBUF_FLAGS_DESTROYED)
+		return -ECONNRESET;
+
+	/* publish our index before looking at the peer's event */
+	mb();
+	if (ring->producer) {
+		new = READ_ONCE(hdr->head);
+		event = READ_ONCE(hdr->head_event);
+	} else {
+		new = READ_ONCE(hdr->tail);
+		event = READ_ONCE(hdr->tail_event);
+	}
+	old = ring->kicked;
+	ring->kicked = new;
+
+	if (!rpbuf_ring_need_event(event, new, old))
+		return 0;
+
+	content.id = buffer->id;
+	content.offset = 0;
+	content.data_len = new;
+	content.flags = BUFFER_RING_KICK;
+
+	ret = rpbuf_notify_by_link(buffer->controller->link,
+				   RPBUF_SERVICE_CMD_BUFFER_TRANSMITTED,
+				   (void *)&content);
+	if (ret < 0) {
+		dev_err(buffer->controller->dev,
+			"buffer \"%s\" ring kick failed: %d\n", buffer->name, ret);
+		return ret;
+	}
+	ring->kicks_sent++;
+
+	return 1;
+}
+EXPORT_SYMBOL(rpbuf_ring_kick);
+
+bool rpbuf_ring_arm(struct rpbuf_buffer *buffer)
+{
+	struct rpbuf_ring *ring = &buffer->ring;
+	struct rpbuf_ring_hdr *hdr = buffer->va;
+	u32 head, tail;
+
+	if (!ring->enabled || !rpbuf_ring_ready(buffer))
+		return false;
+
+	if (ring->producer) {
+		head = READ_ONCE(hdr->head);
+		tail = READ_ONCE(hdr->tail);
+		if (head - tail < ring->slot_num)
+			return true;
+		WRITE_ONCE(hdr->tail_event, tail);
+		mb();
+		return head - READ_ONCE(hdr->tail) < ring->slot_num;
+	}
+
+	tail = READ_ONCE(hdr->tail);
+	WRITE_ONCE(hdr->head_event, tail);
+	mb();
+	return READ_ONCE(hdr->head) != tail;
+}
+EXPORT_SYMBOL(rpbuf_ring_arm);
+
+int rpbuf_ring_write(struct rpbuf_buffer *buffer, const void *data,
+		     unsigned int len, bool more)
+{
+	struct rpbuf_ring *ring = &buffer->ring;
+	struct rpbuf_ring_hdr *hdr = buffer->va;
+	struct rpbuf_ring_slot *slot;
+	u32 head;
+	int ret;
+
+	if (!ring->enabled || !ring->producer)
+		return -EINVAL;
+	if (len > ring->slot_size)
+		return -EMSGSIZE;
+
+	head = READ_ONCE(hdr->head);
+	if (head - READ_ONCE(hdr->tail) >= ring->slot_num &&
+	    !rpbuf_ring_arm(buffer))
+		return -ENOSPC;
+
+	slot = rpbuf_ring_slot(buffer, head);
+	memcpy(slot->data, data, len);
+	WRITE_ONCE(slot->len, len);
+	/* the frame must be visible before the new head */
+	wmb();
+	WRITE_ONCE(hdr->head, head + 1);
+	ring->frames++;
+
+	if (more)
+		return 0;
+
+	ret = rpbuf_ring_kick(buffer);
+	return ret < 0 ? ret : 0;
+}
+EXPORT_SYMBOL(rpbuf_ring_write);
+
+int rpbuf_ring_read(struct rpbuf_buffer *buffer, void *data, unsigned int len)
+{
+	struct rpbuf_ring *ring = &buffer->ring;
+	struct rpbuf_ring_hdr *hdr = buffer->va;
+	struct rpbuf_ring_slot *slot;
+	u32 tail, frame_len;
+	int ret;
+
+	if (!ring->enabled || ring->producer)
+		return -EINVAL;
+	if (!rpbuf_ring_ready(buffer))
+		return -EAGAIN;
+
+	tail = READ_ONCE(hdr->tail);
+	if (READ_ONCE(hdr->head) == tail && !rpbuf_ring_arm(buffer))
+		return -EAGAIN;
+	/* don't read the frame before we saw the head */
+	rmb();
+
+	slot = rpbuf_ring_slot(buffer, tail);
+	frame_len = READ_ONCE(slot->len);
+	if (frame_len > ring->slot_size)
+		return -EIO;
+	if (frame_len > len)
+		return -EMSGSIZE;
+	memcpy(data, slot->data, frame_len);
+	/* done with the slot before handing it back */
+	mb();
+	WRITE_ONCE(hdr->tail, tail + 1);
+	ring->frames++;
+
+	ret = rpbuf_ring_kick(buffer);
+	return ret < 0 ? ret : frame_len;
+}
+EXPORT_SYMBOL(rpbuf_ring_read);
+
 const char *rpbuf_buffer_name(struct rpbuf_buffer *buffer)
 {
 	return buffer->name;
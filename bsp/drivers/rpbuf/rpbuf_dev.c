@@ -38,7 +38,7 @@
 
 #include "rpbuf_internal.h"
 
-#define SUNXI_RPBUF_DEV_VERSION "1.1.2"
+#define SUNXI_RPBUF_DEV_VERSION "1.2.0"
 
 #define RPBUF_DEV_MAX	(MINORMASK + 1)
 
@@ -133,6 +133,13 @@ static int rpbuf_buf_dev_buffer_rx_cb(struct rpbuf_buffer *buffer,
 	unsigned long flags;
 	int print_warn = 0;
 
+	/* ring kick, the waiters look at the ring indices themselves */
+	if (!data) {
+		wake_up_interruptible(&buf_dev->recv_wq);
+		kill_fasync(&buf_dev->async_queue, SIGIO, POLLIN | POLLRDNORM);
+		return 0;
+	}
+
 	spin_lock_irqsave(&buf_dev->recv_lock, flags);
 	if (buf_dev->recv_data_offset >= 0 || buf_dev->recv_data_len >= 0)
 		print_warn = 1;
@@ -321,6 +328,13 @@ static unsigned int rpbuf_buf_dev_poll(struct file *file, struct poll_table_stru
 
 	poll_wait(file, &buf_dev->recv_wq, wait);
 
+	if (buf_dev->buffer->ring.enabled) {
+		if (rpbuf_ring_arm(buf_dev->buffer))
+			mask |= buf_dev->buffer->ring.producer ?
+				POLLOUT | POLLWRNORM : POLLIN | POLLRDNORM;
+		return mask;
+	}
+
 	if (buf_dev->recv_data_offset > 0 && buf_dev->recv_data_len > 0)
 		mask |= POLLIN | POLLRDNORM;
 
@@ -478,6 +492,70 @@ err_out:
 	return ret;
 }
 
+static int rpbuf_buf_dev_ioctl_setup_ring(struct rpbuf_buf_dev *buf_dev,
+					 void __user *argp)
+{
+	struct device *dev = &buf_dev->dev;
+	struct rpbuf_ring_info __user *ring_info_user = argp;
+	struct rpbuf_ring_info ring_info;
+	struct rpbuf_buffer *buffer = buf_dev->buffer;
+	struct rpbuf_ring *ring = &buffer->ring;
+	int ret;
+
+	if (copy_from_user(&ring_info, ring_info_user, sizeof(struct rpbuf_ring_info))) {
+		dev_err(dev, "copy_from_user rpbuf_ring_info failed\n");
+		return -EIO;
+	}
+
+	ret = rpbuf_ring_setup(buffer, ring_info.slot_size, !!ring_info.producer);
+	if (ret < 0) {
+		dev_err(dev, "rpbuf_ring_setup failed (ret: %d)\n", ret);
+		return ret;
+	}
+
+	/*
+	 * Zero if the producer hasn't formatted the ring yet, the consumer
+	 * then reads the layout from the mmap'd rpbuf_ring_hdr later.
+	 */
+	ring_info.slot_size = ring->slot_size;
+	ring_info.slot_num = ring->slot_num;
+	ring_info.stride = ring->stride;
+	ring_info.data_offset = ring->data_offset;
+
+	if (copy_to_user(ring_info_user, &ring_info, sizeof(struct rpbuf_ring_info))) {
+		dev_err(dev, "copy_to_user rpbuf_ring_info failed\n");
+		return -EIO;
+	}
+
+	return 0;
+}
+
+static int rpbuf_buf_dev_ioctl_wait_ring(struct rpbuf_buf_dev *buf_dev,
+					void __user *argp)
+{
+	struct rpbuf_buffer *buffer = buf_dev->buffer;
+	s32 timeout_ms;
+	long remain;
+
+	if (!buffer->ring.enabled)
+		return -EINVAL;
+	if (get_user(timeout_ms, (s32 __user *)argp))
+		return -EFAULT;
+
+	/* rpbuf_ring_arm() leaves the event index for the peer's kick */
+	if (timeout_ms < 0)
+		return wait_event_interruptible(buf_dev->recv_wq,
+						rpbuf_ring_arm(buffer));
+
+	remain = wait_event_interruptible_timeout(buf_dev->recv_wq,
+						  rpbuf_ring_arm(buffer),
+						  msecs_to_jiffies(timeout_ms));
+	if (remain < 0)
+		return remain;
+
+	return remain ? 0 : -ETIMEDOUT;
+}
+
 static long rpbuf_buf_dev_ioctl(struct file *file, unsigned int cmd,
 				void __user *argp)
 {
@@ -501,6 +579,15 @@ static long rpbuf_buf_dev_ioctl(struct file *file, unsigned int cmd,
 	case RPBUF_BUF_DEV_IOCTL_SET_SYNC_BUF:
 		ret = rpbuf_buf_dev_ioctl_set_sync_buf(buf_dev, argp);
 		break;
+	case RPBUF_BUF_DEV_IOCTL_SETUP_RING:
+		ret = rpbuf_buf_dev_ioctl_setup_ring(buf_dev, argp);
+		break;
+	case RPBUF_BUF_DEV_IOCTL_KICK_RING:
+		ret = rpbuf_ring_kick(buf_dev->buffer);
+		break;
+	case RPBUF_BUF_DEV_IOCTL_WAIT_RING:
+		ret = rpbuf_buf_dev_ioctl_wait_ring(buf_dev, argp);
+		break;
 	default:
 		dev_err(dev, "invalid rpbuf buf_dev ioctl cmd: 0x%x\n", cmd);
 		return -EINVAL;
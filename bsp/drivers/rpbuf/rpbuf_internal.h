@@ -23,6 +23,7 @@
 #include <linux/spinlock.h>
 #include <linux/idr.h>
 #include <linux/rpbuf.h>
+#include <uapi/linux/rpbuf.h>
 
 #define RPBUF_SERVICE_MESSAGE_LENGTH_MAX 128
 
@@ -117,6 +118,25 @@ struct rpbuf_controller {
 	void *priv;
 };
 
+/*
+ * Local state of a buffer in ring mode, the indices themselves only live
+ * in the shared struct rpbuf_ring_hdr.
+ */
+struct rpbuf_ring {
+	u32 slot_size;
+	u32 slot_num;
+	u32 stride;
+	u32 data_offset;
+	bool enabled;
+	bool producer;
+	bool ready;	/* consumer has seen the producer's layout */
+	u32 kicked;	/* local index when the peer was last considered */
+
+	u64 frames;
+	u64 kicks_sent;
+	u64 kicks_recv;
+};
+
 struct rpbuf_buffer {
 	char name[RPBUF_NAME_SIZE];
 	int id;
@@ -148,7 +168,9 @@ struct rpbuf_buffer {
 	wait_queue_head_t wait;
 
 #define BUFFER_SYNC_TRANSMIT			0x01
+#define BUFFER_RING_KICK			0x02	/* only in BUFFER_TRANSMITTED */
 	u32 flags;
+	struct rpbuf_ring ring;
 	bool allocated;
 	bool need_ack;
 	/* In order to distinguish whether user space use this buffer by rpbuf buf dev */
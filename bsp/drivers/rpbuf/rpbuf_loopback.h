@@ -0,0 +1,35 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* Copyright(c) 2020 - 2023 Allwinner Technology Co.,Ltd. All rights reserved. */
+/*
+ *
+ * (C) Copyright 2020-2025
+ * Allwinner Technology Co., Ltd. <www.allwinnertech.com>
+ *
+ * RPBuf loopback controller header, for in-kernel users like the
+ * benchmark.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ */
+
+#ifndef __RPBUF_LOOPBACK_H__
+#define __RPBUF_LOOPBACK_H__
+
+#include <linux/rpbuf.h>
+
+/*
+ * Get the local (MASTER) end of the loopback pair, its buffers are
+ * mirrored by the in-kernel peer.
+ */
+struct rpbuf_controller *rpbuf_loopback_get_controller(void);
+
+/*
+ * Set whether the peer transmits every received payload back, stamped
+ * with its own ktime_get_ns() in the first 8 bytes.
+ */
+void rpbuf_loopback_set_echo(bool enable);
+
+#endif
@@ -0,0 +1,343 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright(c) 2020 - 2023 Allwinner Technology Co.,Ltd. All rights reserved. */
+/*
+ * Compare one BUFFER_TRANSMITTED per frame with the ring mode of rpbuf.
+ *
+ * Runs against the loopback controller (CONFIG_AW_RPBUF_CONTROLLER_LOOPBACK),
+ * whose in-kernel peer consumes the frames. Every frame starts with its
+ * CLOCK_MONOTONIC timestamp, so the peer reports the latency as well.
+ *
+ *  - transmit: the frame is copied to the buffer and sent with the
+ *    synchronous TRANSMIT_BUF ioctl, one notification and one ack each.
+ *  - ring: the frames go through the mmap'd ring, the peer is only kicked
+ *    when its event index says it is waiting.
+ *
+ * usage: rpbuf_ring_bench [-c ctrl_id] [-s frame_size] [-n frames] [-l buf_len]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <linux/types.h>
+
+/* keep in sync with include/uapi/linux/rpbuf.h */
+#define RPBUF_NAME_SIZE	32
+
+struct rpbuf_buffer_info {
+	char name[RPBUF_NAME_SIZE];
+	__u32 len;
+};
+
+struct rpbuf_buffer_xfer {
+	__u32 offset;
+	__u32 data_len;
+	__s32 timeout_ms;
+};
+
+#define RPBUF_RING_MAGIC	0x52504252
+
+struct rpbuf_ring_hdr {
+	__u32 magic;
+	__u32 slot_size;
+	__u32 slot_num;
+	__u32 stride;
+	__u32 data_offset;
+	__u32 reserved[11];
+	__u32 head;
+	__u32 tail_event;
+	__u32 reserved_prod[14];
+	__u32 tail;
+	__u32 head_event;
+	__u32 reserved_cons[14];
+};
+
+struct rpbuf_ring_slot {
+	__u32 len;
+	__u32 reserved;
+	__u8 data[];
+};
+
+struct rpbuf_ring_info {
+	__u32 slot_size;
+	__u32 producer;
+	__u32 slot_num;
+	__u32 stride;
+	__u32 data_offset;
+};
+
+#define RPBUF_CTRL_DEV_IOCTL_MAGIC	0xb8
+#define RPBUF_CTRL_DEV_IOCTL_CREATE_BUF \
+	_IOW(RPBUF_CTRL_DEV_IOCTL_MAGIC, 0x1, struct rpbuf_buffer_info)
+#define RPBUF_CTRL_DEV_IOCTL_DESTROY_BUF \
+	_IOW(RPBUF_CTRL_DEV_IOCTL_MAGIC, 0x2, struct rpbuf_buffer_info)
+
+#define RPBUF_BUF_DEV_IOCTL_MAGIC	0xb9
+#define RPBUF_BUF_DEV_IOCTL_TRANSMIT_BUF \
+	_IOW(RPBUF_BUF_DEV_IOCTL_MAGIC, 0x2, struct rpbuf_buffer_xfer)
+#define RPBUF_BUF_DEV_IOCTL_SET_SYNC_BUF \
+	_IOW(RPBUF_BUF_DEV_IOCTL_MAGIC, 0x4, struct rpbuf_buffer_xfer)
+#define RPBUF_BUF_DEV_IOCTL_SETUP_RING \
+	_IOWR(RPBUF_BUF_DEV_IOCTL_MAGIC, 0x5, struct rpbuf_ring_info)
+#define RPBUF_BUF_DEV_IOCTL_KICK_RING \
+	_IO(RPBUF_BUF_DEV_IOCTL_MAGIC, 0x6)
+#define RPBUF_BUF_DEV_IOCTL_WAIT_RING \
+	_IOW(RPBUF_BUF_DEV_IOCTL_MAGIC, 0x7, __s32)
+
+#define BENCH_BUF_NAME		"ring-bench"
+#define PEER_STATS		"/sys/devices/rpbuf_loopback_peer/stats"
+
+struct result {
+	double fps;
+	double mbps;
+	unsigned long kicks;
+	int err;
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void peer_stats_clear(void)
+{
+	int fd = open(PEER_STATS, O_WRONLY);
+
+	if (fd < 0)
+		return;
+	if (write(fd, "0", 1) < 0)
+		printf("clear %s fail: %s\n", PEER_STATS, strerror(errno));
+	close(fd);
+}
+
+static void peer_stats_print(void)
+{
+	char buf[512];
+	ssize_t len;
+	int fd = open(PEER_STATS, O_RDONLY);
+
+	if (fd < 0) {
+		printf("  no %s, not the loopback controller?\n", PEER_STATS);
+		return;
+	}
+	len = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (len <= 0)
+		return;
+	buf[len] = '\0';
+	printf("  peer: %s", buf);
+}
+
+static void fill_frame(uint8_t *frame, size_t size)
+{
+	uint64_t stamp = now_ns();
+
+	memcpy(frame, &stamp, sizeof(stamp));
+}
+
+static void bench_transmit(int fd, uint8_t *va, size_t size, int frames,
+			   struct result *res)
+{
+	struct rpbuf_buffer_xfer xfer = { .offset = 0, .data_len = size };
+	uint32_t sync = 1;
+	uint64_t start, wall;
+	int i;
+
+	res->err = 0;
+	if (ioctl(fd, RPBUF_BUF_DEV_IOCTL_SET_SYNC_BUF, &sync) < 0) {
+		res->err = errno;
+		return;
+	}
+
+	start = now_ns();
+	for (i = 0; i < frames; i++) {
+		fill_frame(va, size);
+		if (ioctl(fd, RPBUF_BUF_DEV_IOCTL_TRANSMIT_BUF, &xfer) < 0) {
+			res->err = errno;
+			return;
+		}
+	}
+	wall = now_ns() - start;
+
+	res->kicks = frames;
+	res->fps = frames * 1e9 / wall;
+	res->mbps = res->fps * size / (1 << 20);
+}
+
+static void bench_ring(int fd, uint8_t *va, size_t size, int frames,
+		       struct result *res)
+{
+	struct rpbuf_ring_info info = { .slot_size = size, .producer = 1 };
+	struct rpbuf_ring_hdr *hdr = (struct rpbuf_ring_hdr *)va;
+	struct rpbuf_ring_slot *slot;
+	uint32_t head, tail, kicked = 0;
+	int32_t timeout_ms = 1000;
+	uint64_t start, wall;
+	int i, ret;
+
+	res->err = 0;
+	res->kicks = 0;
+	if (ioctl(fd, RPBUF_BUF_DEV_IOCTL_SETUP_RING, &info) < 0) {
+		res->err = errno;
+		return;
+	}
+
+	start = now_ns();
+	for (i = 0; i < frames; i++) {
+		head = hdr->head;
+		tail = __atomic_load_n(&hdr->tail, __ATOMIC_ACQUIRE);
+		if (head - tail >= info.slot_num) {
+			if (ioctl(fd, RPBUF_BUF_DEV_IOCTL_WAIT_RING, &timeout_ms) < 0) {
+				res->err = errno;
+				return;
+			}
+			i--;
+			continue;
+		}
+
+		slot = (struct rpbuf_ring_slot *)(va + info.data_offset +
+				(head & (info.slot_num - 1)) * info.stride);
+		fill_frame(slot->data, size);
+		slot->len = size;
+		__atomic_store_n(&hdr->head, head + 1, __ATOMIC_RELEASE);
+
+		/* only enter the kernel when the peer asked for a kick */
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		if ((uint32_t)(head - __atomic_load_n(&hdr->head_event, __ATOMIC_RELAXED)) <
+		    (uint32_t)(head + 1 - kicked)) {
+			ret = ioctl(fd, RPBUF_BUF_DEV_IOCTL_KICK_RING);
+			if (ret < 0) {
+				res->err = errno;
+				return;
+			}
+			res->kicks += ret;
+		}
+		kicked = head + 1;
+	}
+	wall = now_ns() - start;
+
+	/* let the peer catch up before its stats are read */
+	while (__atomic_load_n(&hdr->tail, __ATOMIC_ACQUIRE) != hdr->head)
+		usleep(1000);
+
+	res->fps = frames * 1e9 / wall;
+	res->mbps = res->fps * size / (1 << 20);
+}
+
+static void print_result(const char *name, struct result *res)
+{
+	if (res->err)
+		printf("%-9s fail (%s)\n", name, strerror(res->err));
+	else
+		printf("%-9s %10.0f frames/s %8.1f MB/s %8lu notifications\n",
+		       name, res->fps, res->mbps, res->kicks);
+}
+
+static void usage(const char *name)
+{
+	printf("usage: %s [-c ctrl_id] [-s frame_size] [-n frames] [-l buf_len]\n", name);
+	printf("  -c  id of /dev/rpbuf_ctrl<id>, default 15 (loopback)\n");
+	printf("  -s  bytes per frame, default 256\n");
+	printf("  -n  frames per mode, default 100000\n");
+	printf("  -l  buffer length, default 65536\n");
+}
+
+int main(int argc, char *argv[])
+{
+	struct rpbuf_buffer_info info;
+	struct result res;
+	char path[64];
+	int ctrl_id = 15;
+	size_t size = 256;
+	size_t len = 64 << 10;
+	int frames = 100000;
+	int ctrl_fd, buf_fd;
+	uint8_t *va;
+	int opt, ret = 0;
+
+	while ((opt = getopt(argc, argv, "c:s:n:l:h")) != -1) {
+		switch (opt) {
+		case 'c':
+			ctrl_id = atoi(optarg);
+			break;
+		case 's':
+			size = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			frames = atoi(optarg);
+			break;
+		case 'l':
+			len = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : -1;
+		}
+	}
+	if (frames <= 0 || size < sizeof(uint64_t) || size > len / 4) {
+		usage(argv[0]);
+		return -1;
+	}
+
+	snprintf(path, sizeof(path), "/dev/rpbuf_ctrl%d", ctrl_id);
+	ctrl_fd = open(path, O_RDWR);
+	if (ctrl_fd < 0) {
+		printf("open %s fail: %s\n", path, strerror(errno));
+		return -1;
+	}
+
+	memset(&info, 0, sizeof(info));
+	strncpy(info.name, BENCH_BUF_NAME, RPBUF_NAME_SIZE - 1);
+	info.len = len;
+	if (ioctl(ctrl_fd, RPBUF_CTRL_DEV_IOCTL_CREATE_BUF, &info) < 0) {
+		printf("create buffer fail: %s\n", strerror(errno));
+		close(ctrl_fd);
+		return -1;
+	}
+
+	buf_fd = open("/dev/rpbuf-" BENCH_BUF_NAME, O_RDWR);
+	if (buf_fd < 0) {
+		printf("open /dev/rpbuf-%s fail: %s\n", BENCH_BUF_NAME, strerror(errno));
+		ret = -1;
+		goto out_destroy;
+	}
+
+	va = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, buf_fd, 0);
+	if (va == MAP_FAILED) {
+		printf("mmap fail: %s\n", strerror(errno));
+		ret = -1;
+		goto out_close;
+	}
+
+	printf("%d frames of %zu bytes, buffer %zu bytes\n", frames, size, len);
+
+	peer_stats_clear();
+	bench_transmit(buf_fd, va, size, frames, &res);
+	print_result("transmit", &res);
+	peer_stats_print();
+	ret |= res.err;
+
+	peer_stats_clear();
+	bench_ring(buf_fd, va, size, frames, &res);
+	print_result("ring", &res);
+	peer_stats_print();
+	ret |= res.err;
+
+	munmap(va, len);
+out_close:
+	close(buf_fd);
+out_destroy:
+	ioctl(ctrl_fd, RPBUF_CTRL_DEV_IOCTL_DESTROY_BUF, &info);
+	close(ctrl_fd);
+	return ret ? -1 : 0;
+}
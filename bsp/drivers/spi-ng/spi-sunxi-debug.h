@@ -26,6 +26,7 @@
 enum {
 	SUNXI_SPI_DEBUG_DUMP_REG	= BIT(0),
 	SUNXI_SPI_DEBUG_DUMP_DATA	= BIT(1),
+	SUNXI_SPI_DEBUG_LATENCY		= BIT(2),
 };
 
 __maybe_unused static void sunxi_spi_dump_reg(struct device *dev, void __iomem *vaddr, u32 paddr, u32 len)
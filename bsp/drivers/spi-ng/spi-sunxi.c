@@ -23,6 +23,15 @@
 static int sunxi_spi_debug_mask;
 module_param_named(spi_debug_mask, sunxi_spi_debug_mask, int, 0664);
 
+/* Short master transfers busy-poll TC instead of sleeping on the irq */
+static unsigned int sunxi_spi_poll_len = 16;
+module_param_named(spi_poll_len, sunxi_spi_poll_len, uint, 0664);
+MODULE_PARM_DESC(spi_poll_len, "longest transfer in bytes completed by polling, 0 to disable (default: 16)");
+
+static unsigned int sunxi_spi_poll_us = 50;
+module_param_named(spi_poll_us, sunxi_spi_poll_us, uint, 0664);
+MODULE_PARM_DESC(spi_poll_us, "polling time cap in usec before falling back to irq (default: 50)");
+
 static const u32 sunxi_spi_sample_mode[] = {
 	0x100, /* SUNXI_SPI_SAMP_DELAY_CYCLE_0_0 */
 	0x000, /* SUNXI_SPI_SAMP_DELAY_CYCLE_0_5 */
@@ -1057,6 +1066,14 @@ static int sunxi_spi_setup(struct spi_device *spi)
 {
 	struct sunxi_spi *sspi = spi_controller_get_devdata(spi->controller);
 	sspi->xfer_setup = false;
+
+	if (spi->chip_select < 32) {
+		if (of_property_read_bool(spi->dev.of_node, "sunxi,spi-poll-mode"))
+			sspi->poll_cs |= BIT(spi->chip_select);
+		else
+			sspi->poll_cs &= ~BIT(spi->chip_select);
+	}
+
 	return sunxi_spi_xfer_setup(spi, NULL);
 }
 
@@ -1549,11 +1566,71 @@ static int sunxi_spi_dma_tx(struct sunxi_spi *sspi, struct spi_transfer *t)
 	return ret;
 }
 
+/*
+ * A transfer that fits the fifo and is over on the wire within the poll cap
+ * costs less spinning on TC than two context switches through the irq.
+ */
+static bool sunxi_spi_xfer_use_poll(struct sunxi_spi *sspi, struct spi_device *spi,
+				    struct spi_transfer *t, bool can_dma)
+{
+	u32 speed_hz = t->speed_hz ? t->speed_hz : spi->max_speed_hz;
+	u64 wire_ns;
+
+	if (can_dma || !sunxi_spi_poll_us || !speed_hz)
+		return false;
+
+	if (spi->chip_select < 32 && (sspi->poll_cs & BIT(spi->chip_select)))
+		return true;
+
+	if (t->len > sunxi_spi_poll_len)
+		return false;
+
+	wire_ns = div_u64((u64)t->len * BITS_PER_BYTE * NSEC_PER_SEC, speed_hz);
+
+	return wire_ns <= (u64)sunxi_spi_poll_us * NSEC_PER_USEC;
+}
+
+static bool sunxi_spi_poll_tc(struct sunxi_spi *sspi)
+{
+	ktime_t timeout = ktime_add_us(ktime_get(), sunxi_spi_poll_us);
+
+	do {
+		if (sunxi_spi_qry_irq_pending(sspi) & SUNXI_SPI_INT_STA_TC) {
+			sunxi_spi_clr_irq_pending(sspi, SUNXI_SPI_INT_STA_TC);
+			return true;
+		}
+		/* the error irq is still armed and completes the transfer */
+		if (completion_done(&sspi->done))
+			return true;
+		cpu_relax();
+	} while (ktime_before(ktime_get(), timeout));
+
+	return false;
+}
+
+static void sunxi_spi_lat_record(struct sunxi_spi *sspi, int path, ktime_t start)
+{
+	u64 us;
+	int bucket = 0;
+
+	sspi->lat.count[path]++;
+	if (!start)
+		return;
+
+	us = ktime_us_delta(ktime_get(), start);
+	if (us)
+		bucket = min_t(int, ilog2(us) + 1, SUNXI_SPI_LAT_BUCKETS - 1);
+	sspi->lat.hist[path][bucket]++;
+}
+
 static int sunxi_spi_xfer_master(struct spi_device *spi, struct spi_transfer *t)
 {
 	struct sunxi_spi *sspi = spi_controller_get_devdata(spi->controller);
 	bool can_dma = sunxi_spi_can_dma(spi->controller, spi, t);
+	bool poll = sunxi_spi_xfer_use_poll(sspi, spi, t, can_dma);
+	int path = poll ? SUNXI_SPI_PATH_POLL : SUNXI_SPI_PATH_IRQ;
 	unsigned long timeout = 0;
+	ktime_t start = 0;
 	int ret = 0;
 
 	/* ready gpio sync logic between master & slave */
@@ -1566,7 +1643,11 @@ static int sunxi_spi_xfer_master(struct spi_device *spi, struct spi_transfer *t)
 		}
 	}
 
-	sunxi_spi_enable_irq(sspi, SUNXI_SPI_INT_CTL_TC_EN);
+	if (sunxi_spi_debug_mask & SUNXI_SPI_DEBUG_LATENCY)
+		start = ktime_get();
+
+	if (!poll)
+		sunxi_spi_enable_irq(sspi, SUNXI_SPI_INT_CTL_TC_EN);
 	sunxi_spi_start_xfer(sspi);
 
 	switch (sspi->mode_type) {
@@ -1610,7 +1691,17 @@ static int sunxi_spi_xfer_master(struct spi_device *spi, struct spi_transfer *t)
 		goto out;
 	}
 
-	timeout = wait_for_completion_timeout(&sspi->done, msecs_to_jiffies(SUNXI_SPI_XFER_TIMEOUT));
+	if (poll && sunxi_spi_poll_tc(sspi)) {
+		sunxi_debug(sspi->dev, "master xfer done by poll %d\n", t->len);
+		timeout = 1;
+	} else {
+		if (poll) {
+			sunxi_debug(sspi->dev, "master xfer poll over %uus, wait for irq\n", sunxi_spi_poll_us);
+			path = SUNXI_SPI_PATH_POLL_IRQ;
+			sunxi_spi_enable_irq(sspi, SUNXI_SPI_INT_CTL_TC_EN);
+		}
+		timeout = wait_for_completion_timeout(&sspi->done, msecs_to_jiffies(SUNXI_SPI_XFER_TIMEOUT));
+	}
 	if (timeout == 0) {
 		sunxi_err(sspi->dev, "master transfer timeout type %d\n", sspi->mode_type);
 		ret = -ETIME;
@@ -1621,6 +1712,8 @@ static int sunxi_spi_xfer_master(struct spi_device *spi, struct spi_transfer *t)
 		goto out;
 	}
 
+	sunxi_spi_lat_record(sspi, path, start);
+
 out:
 	if (ret < 0 && can_dma) {
 		dmaengine_terminate_sync(spi->controller->dma_tx);
@@ -2178,6 +2271,274 @@ out:
 	return ret;
 }
 
+/*
+ * spi-mem ops run the whole op as one burst: the cpu writes cmd, addr and
+ * dummy bytes into the txfifo, the data phase goes by dma when it is long
+ * enough. STC bytes go out in single mode, the rest of the burst at the
+ * dual/quad width, so single phases must all come before the wide ones.
+ */
+static u8 sunxi_spi_mem_buswidth(const struct spi_mem_op *op)
+{
+	u8 width = op->cmd.buswidth;
+
+	if (op->addr.nbytes)
+		width = max(width, op->addr.buswidth);
+	if (op->dummy.nbytes)
+		width = max(width, op->dummy.buswidth);
+	if (op->data.nbytes)
+		width = max(width, op->data.buswidth);
+
+	return width;
+}
+
+static bool sunxi_spi_mem_phase_ok(u8 buswidth, u8 width, bool *wide)
+{
+	if (width > 1 && buswidth == width) {
+		*wide = true;
+		return true;
+	}
+
+	return buswidth == 1 && !*wide;
+}
+
+static bool sunxi_spi_mem_supports_op(struct spi_mem *mem, const struct spi_mem_op *op)
+{
+	u8 width = sunxi_spi_mem_buswidth(op);
+	bool wide = false;
+
+	if (!spi_mem_default_supports_op(mem, op))
+		return false;
+
+	if (op->cmd.dtr || op->addr.dtr || op->dummy.dtr || op->data.dtr)
+		return false;
+
+	if (op->cmd.buswidth != 1 || op->cmd.nbytes > 2)
+		return false;
+
+	if (op->cmd.nbytes + op->addr.nbytes + op->dummy.nbytes > SUNXI_SPI_MEM_HDR_MAX)
+		return false;
+
+	if (op->addr.nbytes && !sunxi_spi_mem_phase_ok(op->addr.buswidth, width, &wide))
+		return false;
+	if (op->dummy.nbytes && !sunxi_spi_mem_phase_ok(op->dummy.buswidth, width, &wide))
+		return false;
+	if (op->data.nbytes && !sunxi_spi_mem_phase_ok(op->data.buswidth, width, &wide))
+		return false;
+
+	return true;
+}
+
+static int sunxi_spi_mem_adjust_op_size(struct spi_mem *mem, struct spi_mem_op *op)
+{
+	op->data.nbytes = min_t(unsigned int, op->data.nbytes, SUNXI_SPI_MEM_DATA_MAX);
+
+	return 0;
+}
+
+/* Return the header length, stc_len gets the single mode part of it */
+static u32 sunxi_spi_mem_fill_hdr(struct sunxi_spi *sspi, const struct spi_mem_op *op, u32 *stc_len)
+{
+	u8 *hdr = sspi->mem_hdr;
+	u32 len = 0;
+	int i;
+
+	for (i = op->cmd.nbytes - 1; i >= 0; i--)
+		hdr[len++] = op->cmd.opcode >> (8 * i);
+	*stc_len = len;
+
+	for (i = op->addr.nbytes - 1; i >= 0; i--)
+		hdr[len++] = op->addr.val >> (8 * i);
+	if (op->addr.nbytes && op->addr.buswidth == 1)
+		*stc_len = len;
+
+	memset(hdr + len, 0xff, op->dummy.nbytes);
+	len += op->dummy.nbytes;
+	if (op->dummy.nbytes && op->dummy.buswidth == 1)
+		*stc_len = len;
+
+	return len;
+}
+
+static int sunxi_spi_mem_exec_op(struct spi_mem *mem, const struct spi_mem_op *op)
+{
+	struct spi_device *spi = mem->spi;
+	struct spi_controller *ctlr = spi->controller;
+	struct sunxi_spi *sspi = spi_controller_get_devdata(ctlr);
+	u8 width = sunxi_spi_mem_buswidth(op);
+	struct spi_transfer hdr = { }, data = { };
+	struct sg_table *sgt = NULL;
+	u32 stc_len, tx_len, rx_len = 0;
+	unsigned long timeout;
+	int ret;
+
+	ret = sunxi_spi_xfer_setup(spi, NULL);
+	if (ret < 0) {
+		sunxi_err(sspi->dev, "failed to setup spi-mem op %d\n", ret);
+		return ret;
+	}
+
+	hdr.tx_buf = sspi->mem_hdr;
+	hdr.len = sunxi_spi_mem_fill_hdr(sspi, op, &stc_len);
+	tx_len = hdr.len;
+
+	data.len = op->data.nbytes;
+	if (op->data.dir == SPI_MEM_DATA_IN) {
+		data.rx_buf = op->data.buf.in;
+		rx_len = data.len;
+	} else if (op->data.dir == SPI_MEM_DATA_OUT) {
+		data.tx_buf = op->data.buf.out;
+		tx_len += data.len;
+	}
+	if (width == 1)
+		stc_len = tx_len;
+
+	if (data.len && sunxi_spi_can_dma(ctlr, spi, &data)) {
+		sgt = data.rx_buf ? &data.rx_sg : &data.tx_sg;
+		if (spi_controller_dma_map_mem_op_data(ctlr, op, sgt))
+			sgt = NULL;
+	}
+
+	sunxi_spi_set_cs(spi, false);
+
+	/* reset fifo */
+	sunxi_spi_reset_fifo(sspi);
+	sunxi_spi_set_fifo_trig_level_rx(sspi, sspi->rx_triglevel);
+	sunxi_spi_set_fifo_trig_level_tx(sspi, sspi->tx_triglevel);
+
+	sunxi_spi_disable_irq(sspi, SUNXI_SPI_INT_CTL_MASK);
+	sunxi_spi_clr_irq_pending(sspi, SUNXI_SPI_INT_STA_MASK);
+	sunxi_spi_enable_irq(sspi, SUNXI_SPI_INT_CTL_ERR);
+	sunxi_spi_disable_dma_irq(sspi, SUNXI_SPI_FIFO_CTL_DRQ_EN);
+
+	sunxi_spi_set_discard_burst(sspi, true);
+	switch (width) {
+	case SPI_NBITS_QUAD:
+		sunxi_spi_disable_dual(sspi);
+		sunxi_spi_enable_quad(sspi);
+		break;
+	case SPI_NBITS_DUAL:
+		sunxi_spi_disable_quad(sspi);
+		sunxi_spi_enable_dual(sspi);
+		break;
+	default:
+		sunxi_spi_disable_quad(sspi);
+		sunxi_spi_disable_dual(sspi);
+	}
+	sunxi_spi_set_bc_tc_stc(sspi, tx_len, rx_len, stc_len, 0);
+
+	sspi->result = 0;
+	reinit_completion(&sspi->done);
+
+	if (sunxi_spi_debug_mask & SUNXI_SPI_DEBUG_DUMP_DATA)
+		sunxi_spi_dump_data(sspi->dev, (void *)hdr.tx_buf, hdr.len);
+	if (sunxi_spi_debug_mask & SUNXI_SPI_DEBUG_DUMP_REG)
+		sunxi_spi_dump_regs(sspi);
+
+	sunxi_spi_enable_irq(sspi, SUNXI_SPI_INT_CTL_TC_EN);
+	sunxi_spi_start_xfer(sspi);
+
+	ret = sunxi_spi_cpu_tx(sspi, &hdr);
+	if (ret < 0)
+		goto out;
+
+	if (data.tx_buf) {
+		if (sgt) {
+			sunxi_debug(sspi->dev, "mem op tx by dma %d\n", data.len);
+			sunxi_spi_enable_dma_irq(sspi, SUNXI_SPI_FIFO_CTL_TX_DRQ_EN);
+			ret = sunxi_spi_dma_tx(sspi, &data);
+		} else {
+			sunxi_debug(sspi->dev, "mem op tx by cpu %d\n", data.len);
+			ret = sunxi_spi_cpu_tx(sspi, &data);
+		}
+	} else if (data.rx_buf) {
+		if (sgt) {
+			sunxi_debug(sspi->dev, "mem op rx by dma %d\n", data.len);
+			sunxi_spi_enable_dma_irq(sspi, SUNXI_SPI_FIFO_CTL_RX_DRQ_EN);
+			/* the dma callback completes the op once the rxfifo is drained */
+			sunxi_spi_disable_irq(sspi, SUNXI_SPI_INT_CTL_TC_EN);
+			ret = sunxi_spi_dma_rx(sspi, &data);
+		} else {
+			sunxi_debug(sspi->dev, "mem op rx by cpu %d\n", data.len);
+			ret = sunxi_spi_cpu_rx(sspi, &data);
+		}
+	}
+	if (ret < 0)
+		goto out;
+
+	timeout = wait_for_completion_timeout(&sspi->done, msecs_to_jiffies(SUNXI_SPI_XFER_TIMEOUT));
+	if (timeout == 0) {
+		sunxi_err(sspi->dev, "mem op %#x timeout\n", op->cmd.opcode);
+		ret = -ETIME;
+	} else if (sspi->result < 0) {
+		sunxi_err(sspi->dev, "mem op %#x failed %d\n", op->cmd.opcode, sspi->result);
+		ret = -EINVAL;
+	}
+
+out:
+	if (ret < 0) {
+		if (sgt)
+			dmaengine_terminate_sync(data.rx_buf ? ctlr->dma_rx : ctlr->dma_tx);
+		sunxi_spi_dump_regs(sspi);
+		sunxi_spi_handle_err(ctlr, NULL);
+	}
+	sunxi_spi_disable_irq(sspi, SUNXI_SPI_INT_CTL_MASK);
+	sunxi_spi_set_cs(spi, true);
+	if (sgt)
+		spi_controller_dma_unmap_mem_op_data(ctlr, op, sgt);
+	if (!ret && data.rx_buf && (sunxi_spi_debug_mask & SUNXI_SPI_DEBUG_DUMP_DATA))
+		sunxi_spi_dump_data(sspi->dev, data.rx_buf, data.len);
+
+	return ret;
+}
+
+/* There is no memory mapped window, a dirmap runs its template as one burst */
+static int sunxi_spi_mem_dirmap_create(struct spi_mem_dirmap_desc *desc)
+{
+	if (!sunxi_spi_mem_supports_op(desc->mem, &desc->info.op_tmpl))
+		return -EOPNOTSUPP;
+
+	return 0;
+}
+
+static ssize_t sunxi_spi_mem_dirmap_read(struct spi_mem_dirmap_desc *desc,
+					 u64 offs, size_t len, void *buf)
+{
+	struct spi_mem_op op = desc->info.op_tmpl;
+	int ret;
+
+	op.addr.val = desc->info.offset + offs;
+	op.data.buf.in = buf;
+	op.data.nbytes = min_t(size_t, len, SUNXI_SPI_MEM_DATA_MAX);
+
+	ret = sunxi_spi_mem_exec_op(desc->mem, &op);
+
+	return ret ? ret : op.data.nbytes;
+}
+
+static ssize_t sunxi_spi_mem_dirmap_write(struct spi_mem_dirmap_desc *desc,
+					  u64 offs, size_t len, const void *buf)
+{
+	struct spi_mem_op op = desc->info.op_tmpl;
+	int ret;
+
+	op.addr.val = desc->info.offset + offs;
+	op.data.buf.out = buf;
+	op.data.nbytes = min_t(size_t, len, SUNXI_SPI_MEM_DATA_MAX);
+
+	ret = sunxi_spi_mem_exec_op(desc->mem, &op);
+
+	return ret ? ret : op.data.nbytes;
+}
+
+static const struct spi_controller_mem_ops sunxi_spi_mem_ops = {
+	.adjust_op_size	= sunxi_spi_mem_adjust_op_size,
+	.supports_op	= sunxi_spi_mem_supports_op,
+	.exec_op	= sunxi_spi_mem_exec_op,
+	.dirmap_create	= sunxi_spi_mem_dirmap_create,
+	.dirmap_read	= sunxi_spi_mem_dirmap_read,
+	.dirmap_write	= sunxi_spi_mem_dirmap_write,
+};
+
 #if IS_ENABLED(CONFIG_AW_SPI_NG_ATOMIC_XFER)
 static int sunxi_spi_xfer_atomic(struct spi_device *spi, struct spi_transfer *t)
 {
@@ -2730,11 +3091,51 @@ static ssize_t sunxi_spi_dump_show(struct device *dev, struct device_attribute *
 	return 0;
 }
 
+static ssize_t sunxi_spi_latency_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct sunxi_spi *sspi = spi_controller_get_devdata(dev_get_drvdata(dev));
+	static const char * const path_name[SUNXI_SPI_PATH_MAX] = { "irq", "poll", "poll->irq" };
+	ssize_t len = 0;
+	int i, j;
+
+	len += scnprintf(buf + len, PAGE_SIZE - len,
+			"poll len %u bytes, cap %uus, histogram %s\n",
+			sunxi_spi_poll_len, sunxi_spi_poll_us,
+			sunxi_spi_debug_mask & SUNXI_SPI_DEBUG_LATENCY ? "on" : "off");
+	for (i = 0; i < SUNXI_SPI_PATH_MAX; i++)
+		len += scnprintf(buf + len, PAGE_SIZE - len, "%-9s: %llu\n", path_name[i], sspi->lat.count[i]);
+
+	len += scnprintf(buf + len, PAGE_SIZE - len, "\n%-9s", "<us");
+	for (i = 0; i < SUNXI_SPI_PATH_MAX; i++)
+		len += scnprintf(buf + len, PAGE_SIZE - len, " %10s", path_name[i]);
+	for (j = 0; j < SUNXI_SPI_LAT_BUCKETS; j++) {
+		if (j == SUNXI_SPI_LAT_BUCKETS - 1)
+			len += scnprintf(buf + len, PAGE_SIZE - len, "\n%-9s", "inf");
+		else
+			len += scnprintf(buf + len, PAGE_SIZE - len, "\n%-9lu", 1UL << j);
+		for (i = 0; i < SUNXI_SPI_PATH_MAX; i++)
+			len += scnprintf(buf + len, PAGE_SIZE - len, " %10u", sspi->lat.hist[i][j]);
+	}
+	len += scnprintf(buf + len, PAGE_SIZE - len, "\n");
+
+	return len;
+}
+
+static ssize_t sunxi_spi_latency_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct sunxi_spi *sspi = spi_controller_get_devdata(dev_get_drvdata(dev));
+
+	memset(&sspi->lat, 0, sizeof(sspi->lat));
+
+	return count;
+}
+
 static struct device_attribute sunxi_spi_debug_attr[] = {
 	__ATTR(info, 0444, sunxi_spi_info_show, NULL),
 	__ATTR(status, 0444, sunxi_spi_status_show, NULL),
 	__ATTR(fifo, 0644, sunxi_spi_fifo_show, sunxi_spi_fifo_store),
 	__ATTR(dump, 0444, sunxi_spi_dump_show, NULL),
+	__ATTR(latency, 0644, sunxi_spi_latency_show, sunxi_spi_latency_store),
 };
 
 static void sunxi_spi_create_sysfs(struct sunxi_spi *sspi)
@@ -2857,9 +3258,12 @@ static int sunxi_spi_probe(struct platform_device *pdev)
 	case SUNXI_SPI_BUS_NAND:
 		/* Optimize transfer logic for nand flash to get faster speed and performance */
 		sspi->ctlr->transfer_one_message = sunxi_spi_transfer_one_message;
+		sspi->ctlr->mem_ops = &sunxi_spi_mem_ops;
 		break;
 	case SUNXI_SPI_BUS_MASTER:
 	case SUNXI_SPI_BUS_NOR:
+		sspi->ctlr->mem_ops = &sunxi_spi_mem_ops;
+		break;
 	case SUNXI_SPI_BUS_DBI:
 		break;
 	case SUNXI_SPI_BUS_BIT:
@@ -13,6 +13,7 @@
 #include <linux/module.h>
 #include <linux/ctype.h>
 #include <linux/bitfield.h>
+#include <linux/sizes.h>
 #include <linux/err.h>
 #include <linux/delay.h>
 #include <linux/device.h>
@@ -24,6 +25,7 @@
 #include <linux/of_device.h>
 #include <linux/of_gpio.h>
 #include <linux/spi/spi.h>
+#include <linux/spi/spi-mem.h>
 #include <dt-bindings/spi/sunxi-spi.h>
 
 #define SUNXI_SPI_XFER_TIMEOUT	(5000)
@@ -33,6 +35,8 @@
 #define SUNXI_SPI_FIFO_DEFAULT	(64)		/* SPI Controller default fifo depth */
 #define SUNXI_SPI_MAX_FREQUENCY	(150000000)	/* SPI Controller support max freq 150Mhz */
 #define SUNXI_SPI_MIN_FREQUENCY	(187500)	/* SPI Controller support min freq 187.5Khz(24M/8/16) */
+#define SUNXI_SPI_MEM_HDR_MAX	(32)		/* spi-mem cmd + addr + dummy bytes, written by cpu */
+#define SUNXI_SPI_MEM_DATA_MAX	(SZ_64K)	/* spi-mem data bytes in one burst */
 
 /* SPI Version Number Register */
 #define SUNXI_SPI_VER_REG		(0x00)
@@ -227,6 +231,21 @@ enum sunxi_spi_quirk_flags {
 	NEW_SAMPLE_MODE_RST = BIT(3),	/* workaround for invisible fifo under new sample mode synchronize issue. */
 };
 
+/* Master transfer completion path */
+enum sunxi_spi_xfer_path {
+	SUNXI_SPI_PATH_IRQ = 0,
+	SUNXI_SPI_PATH_POLL,
+	SUNXI_SPI_PATH_POLL_IRQ,	/* polling ran over its time cap and fell back to irq */
+	SUNXI_SPI_PATH_MAX,
+};
+
+#define SUNXI_SPI_LAT_BUCKETS	(12)	/* log2 us buckets, the last one takes everything from 1ms */
+
+struct sunxi_spi_lat_stats {
+	u64 count[SUNXI_SPI_PATH_MAX];
+	u32 hist[SUNXI_SPI_PATH_MAX][SUNXI_SPI_LAT_BUCKETS];
+};
+
 struct sunxi_spi_hw_data {
 	u32 master_mode_extra;	/* flag to identify hardware controller slave mode extra support */
 	u32 slave_mode_extra;	/* flag to identify hardware controller master mode extra support */
@@ -289,6 +308,8 @@ struct sunxi_spi {
 	bool slave_aborted;
 	u32 pre_speed_hz;
 	int result;	/* 0: succeed -1:fail */
+	u32 poll_cs;	/* chip selects flagged latency sensitive, always polled */
+	struct sunxi_spi_lat_stats lat;
 
 	/* spi dbi function */
 	struct spi_device *dbi_dev;
@@ -298,6 +319,9 @@ struct sunxi_spi {
 	/* spi camera function */
 	u32 camera_mode;
 	int camera_framehead_len;
+
+	/* spi-mem function */
+	u8 mem_hdr[SUNXI_SPI_MEM_HDR_MAX];
 };
 
 #include "dbi/spi-sunxi-dbi.h"
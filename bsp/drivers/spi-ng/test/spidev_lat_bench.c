@@ -0,0 +1,148 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright(c) 2020 - 2023 Allwinner Technology Co.,Ltd. All rights reserved. */
+/*
+ * Latency of short transfers through spidev.
+ *
+ * Every size from 2 bytes up to the max is sent as a single transfer
+ * message, loops times, and the min/avg/p50/p99/max time of the ioctl is
+ * printed. Compare the polling fast path with the irq path by running it
+ * with the default spi_poll_len and again with
+ *
+ *   echo 0 > /sys/module/spi_sunxi_ng/parameters/spi_poll_len
+ *
+ * usage: spidev_lat_bench [-D device] [-s speed] [-n loops] [-m max_len] [-d]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <linux/spi/spidev.h>
+
+#define MIN_LEN		2
+#define MAX_LEN		64
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void usage(const char *name)
+{
+	printf("usage: %s [-D device] [-s speed] [-n loops] [-m max_len] [-d]\n", name);
+	printf("  -D  spidev node, default /dev/spidev0.0\n");
+	printf("  -s  speed in Hz, default 10000000\n");
+	printf("  -n  loops per size, default 10000\n");
+	printf("  -m  largest transfer in bytes, default %d\n", MAX_LEN);
+	printf("  -d  full duplex, tx and rx in the same transfer\n");
+}
+
+int main(int argc, char *argv[])
+{
+	const char *device = "/dev/spidev0.0";
+	struct spi_ioc_transfer xfer;
+	uint8_t tx[MAX_LEN], rx[MAX_LEN];
+	uint32_t speed = 10000000;
+	uint64_t *lat, total, t;
+	int loops = 10000, max_len = MAX_LEN;
+	int duplex = 0;
+	int fd, opt, len, i, ret = 0;
+
+	while ((opt = getopt(argc, argv, "D:s:n:m:dh")) != -1) {
+		switch (opt) {
+		case 'D':
+			device = optarg;
+			break;
+		case 's':
+			speed = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			loops = atoi(optarg);
+			break;
+		case 'm':
+			max_len = atoi(optarg);
+			break;
+		case 'd':
+			duplex = 1;
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : -1;
+		}
+	}
+	if (loops <= 0 || max_len < MIN_LEN || max_len > MAX_LEN || !speed) {
+		usage(argv[0]);
+		return -1;
+	}
+
+	fd = open(device, O_RDWR);
+	if (fd < 0) {
+		printf("open %s fail: %s\n", device, strerror(errno));
+		return -1;
+	}
+	if (ioctl(fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed) < 0) {
+		printf("set speed %u fail: %s\n", speed, strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	lat = calloc(loops, sizeof(*lat));
+	if (!lat) {
+		printf("calloc %d loops fail\n", loops);
+		close(fd);
+		return -1;
+	}
+
+	for (i = 0; i < MAX_LEN; i++)
+		tx[i] = i;
+
+	printf("%s, %u Hz, %d loops, %s\n", device, speed, loops,
+	       duplex ? "full duplex" : "tx only");
+	printf("%5s %10s %10s %10s %10s %10s (us)\n", "bytes", "min", "avg", "p50", "p99", "max");
+	for (len = MIN_LEN; len <= max_len; len <<= 1) {
+		memset(&xfer, 0, sizeof(xfer));
+		xfer.tx_buf = (uintptr_t)tx;
+		xfer.rx_buf = duplex ? (uintptr_t)rx : 0;
+		xfer.len = len;
+		xfer.speed_hz = speed;
+		xfer.bits_per_word = 8;
+
+		total = 0;
+		for (i = 0; i < loops; i++) {
+			t = now_ns();
+			if (ioctl(fd, SPI_IOC_MESSAGE(1), &xfer) < 0) {
+				printf("%5d transfer fail: %s\n", len, strerror(errno));
+				ret = -1;
+				goto out;
+			}
+			lat[i] = now_ns() - t;
+			total += lat[i];
+		}
+
+		qsort(lat, loops, sizeof(*lat), cmp_u64);
+		printf("%5d %10.1f %10.1f %10.1f %10.1f %10.1f\n", len,
+		       lat[0] / 1e3, total / 1e3 / loops, lat[loops / 2] / 1e3,
+		       lat[(uint64_t)loops * 99 / 100] / 1e3, lat[loops - 1] / 1e3);
+	}
+
+out:
+	free(lat);
+	close(fd);
+	return ret;
+}
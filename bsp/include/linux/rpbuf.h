@@ -40,6 +40,9 @@ typedef void (*rpbuf_available_cb_t)(struct rpbuf_buffer *buffer, void *priv);
  * @data: the virtual address of buffer payload data
  * @data_len: the valid length of data (should be <= total length of buffer)
  * @priv: private data for user
+ *
+ * In ring mode the remote kicks the ring instead, then @data is NULL and
+ * @data_len is 0, see rpbuf_ring_setup().
  */
 typedef int (*rpbuf_rx_cb_t)(struct rpbuf_buffer *buffer, void *data, int data_len, void *priv);
 
@@ -186,4 +189,68 @@ void rpbuf_buffer_set_da(struct rpbuf_buffer *buffer, u64 da);
  */
 int rpbuf_buffer_set_sync(struct rpbuf_buffer *buffer, bool sync);
 
+/**
+ * rpbuf_ring_setup - use an available rpbuf buffer as a SPSC ring
+ * @buffer: rpbuf buffer
+ * @slot_size: max frame length, the consumer may pass 0 to take the
+ *	       producer's layout
+ * @producer: whether local is the producer
+ *
+ * The producer formats the ring, the consumer picks the layout up on its
+ * first read if the producer hasn't formatted it yet. Frames are then
+ * moved with rpbuf_ring_write()/rpbuf_ring_read(), and the peer is only
+ * notified when it is waiting for them (event index suppression). A kick
+ * from the peer calls rx_cb with NULL data. Setting up again starts the
+ * ring over, e.g. after the remote re-created the buffer.
+ *
+ * Return 0 on success, or a negative number on failure.
+ */
+int rpbuf_ring_setup(struct rpbuf_buffer *buffer, unsigned int slot_size,
+		     bool producer);
+
+/**
+ * rpbuf_ring_write - copy a frame into the ring
+ * @buffer: rpbuf buffer set up as producer
+ * @data: frame
+ * @len: frame length, no more than the slot size
+ * @more: more frames follow, don't kick the consumer yet
+ *
+ * Return 0 on success, -ENOSPC if the ring is full (the consumer will kick
+ * once it frees a slot), or another negative number on failure.
+ */
+int rpbuf_ring_write(struct rpbuf_buffer *buffer, const void *data,
+		     unsigned int len, bool more);
+
+/**
+ * rpbuf_ring_read - copy the oldest frame out of the ring
+ * @buffer: rpbuf buffer set up as consumer
+ * @data: destination
+ * @len: size of @data
+ *
+ * Return the frame length, -EAGAIN if the ring is empty (the producer will
+ * kick on the next frame), or another negative number on failure.
+ */
+int rpbuf_ring_read(struct rpbuf_buffer *buffer, void *data, unsigned int len);
+
+/**
+ * rpbuf_ring_kick - notify the peer if it waits for what local published
+ * @buffer: rpbuf buffer in ring mode
+ *
+ * Needed after rpbuf_ring_write() with @more set, or after the indices
+ * were moved by someone else (e.g. user space through mmap).
+ *
+ * Return 1 if the peer was notified, 0 if it wasn't waiting, or a negative
+ * number on failure.
+ */
+int rpbuf_ring_kick(struct rpbuf_buffer *buffer);
+
+/**
+ * rpbuf_ring_arm - ask the peer for a kick before going to sleep
+ * @buffer: rpbuf buffer in ring mode
+ *
+ * Return true if there is something to read (consumer) or room to write
+ * (producer) already, then the caller should not sleep.
+ */
+bool rpbuf_ring_arm(struct rpbuf_buffer *buffer);
+
 #endif
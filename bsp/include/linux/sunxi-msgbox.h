@@ -0,0 +1,42 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright(c) 2020 - 2023 Allwinner Technology Co.,Ltd. All rights reserved. */
+/*
+ * Allwinner msgbox extensions for mailbox clients.
+ *
+ * This file is licensed under the terms of the GNU General Public
+ * License version 2. This program is licensed "as is" without any
+ * warranty of any kind, whether express or implied.
+ */
+
+#ifndef __SUNXI_MSGBOX_H__
+#define __SUNXI_MSGBOX_H__
+
+#include <linux/types.h>
+#include <linux/errno.h>
+#include <linux/mailbox_client.h>
+
+#if IS_ENABLED(CONFIG_AW_MSGBOX)
+/*
+ * sunxi_msgbox_send_batch - write several u32 messages to the remote FIFO
+ * @chan: channel got by mbox_request_channel()
+ * @msgs: messages to send
+ * @count: number of messages
+ *
+ * Writes as many messages as the FIFO has room for, in one go, without
+ * going through the one message per tx done round of the mailbox core.
+ * It does not wait and no tx_done callback is called for these messages.
+ *
+ * Return the number of messages written (may be less than @count),
+ * -EBUSY if messages sent by mbox_send_message() are still queued on
+ * the channel (they must go first), or -EINVAL.
+ */
+int sunxi_msgbox_send_batch(struct mbox_chan *chan, const u32 *msgs, int count);
+#else
+static inline int sunxi_msgbox_send_batch(struct mbox_chan *chan,
+					  const u32 *msgs, int count)
+{
+	return -ENODEV;
+}
+#endif
+
+#endif /* __SUNXI_MSGBOX_H__ */
@@ -504,6 +504,23 @@ struct mixer_para {
 	g2d_ck ck_para;
 };
 
+/**
+ * g2d_async_submit - asynchronous job submission
+ * @cmd: G2D_CMD_BITBLT_H (non-rotate), G2D_CMD_BLD_H, G2D_CMD_FILLRECT_H,
+ *       G2D_CMD_MASK_H or G2D_CMD_MIXER_TASK
+ * @frame_cnt: number of struct mixer_para at @para for G2D_CMD_MIXER_TASK
+ * @para: user pointer to the parameter of @cmd
+ * @in_fence: sync_file fd the job waits for before it starts, -1 for none
+ * @out_fence: [out] sync_file fd signalled when the job completes
+ */
+struct g2d_async_submit {
+	__u32 cmd;
+	__u32 frame_cnt;
+	__u64 para;
+	__s32 in_fence;
+	__s32 out_fence;
+};
+
 struct g2d_hardware_version {
 	uint32_t g2d_version;
 	uint32_t chip_version;
@@ -538,6 +555,7 @@ typedef enum {
 	G2D_CMD_TASK_APPLY = SUNXI_G2D_IOW(0x2, unsigned int),
 	G2D_CMD_TASK_DESTROY = SUNXI_G2D_IOW(0x3, unsigned int),
 	G2D_CMD_TASK_GET_PARA = SUNXI_G2D_IOR(0x4, struct mixer_para),
+	G2D_CMD_ASYNC_SUBMIT = SUNXI_G2D_IOWR(0x5, struct g2d_async_submit),
 	/* qurey g2d hardware version and soc chip version */
 	G2D_CMD_QUERY_VERSION = _IOR(SUNXI_G2D_IOC_MAGIC, 0x9F, struct g2d_hardware_version),
 } g2d_cmd;
@@ -34,6 +34,59 @@ struct rpbuf_buffer_xfer {
 	__s32 timeout_ms;
 };
 
+/*
+ * Ring mode: the buffer holds a single-producer/single-consumer ring of
+ * fixed size slots, so many frames move per notification.
+ *
+ * The buffer starts with struct rpbuf_ring_hdr, slot i starts at
+ * data_offset + (i & (slot_num - 1)) * stride and is a struct
+ * rpbuf_ring_slot followed by up to slot_size bytes of frame.
+ *
+ * head and tail are free running. The producer fills the slot at head,
+ * then publishes it by incrementing head; the consumer does the same with
+ * tail. Each side notifies the other (virtio event index style) only when
+ * its new index passes the event index the other side left before going
+ * to sleep:
+ *
+ *   (__u32)(new - event - 1) < (__u32)(new - old)
+ *
+ * The consumer writes head_event = tail when it finds the ring empty, the
+ * producer writes tail_event = tail when it finds the ring full.
+ */
+#define RPBUF_RING_MAGIC	0x52504252	/* "RPBR" */
+#define RPBUF_RING_ALIGN	64
+
+struct rpbuf_ring_hdr {
+	__u32 magic;
+	__u32 slot_size;
+	__u32 slot_num;
+	__u32 stride;
+	__u32 data_offset;
+	__u32 reserved[11];
+	/* written by producer */
+	__u32 head;
+	__u32 tail_event;
+	__u32 reserved_prod[14];
+	/* written by consumer */
+	__u32 tail;
+	__u32 head_event;
+	__u32 reserved_cons[14];
+};
+
+struct rpbuf_ring_slot {
+	__u32 len;
+	__u32 reserved;
+	__u8 data[];
+};
+
+struct rpbuf_ring_info {
+	__u32 slot_size;	/* in: 0 for the consumer to take the producer's */
+	__u32 producer;		/* in: 1 for the producer side */
+	__u32 slot_num;		/* out */
+	__u32 stride;		/* out */
+	__u32 data_offset;	/* out */
+};
+
 #define RPBUF_CTRL_DEV_IOCTL_MAGIC	0xb8
 #define RPBUF_CTRL_DEV_IOCTL_CREATE_BUF \
 	_IOW(RPBUF_CTRL_DEV_IOCTL_MAGIC, 0x1, struct rpbuf_buffer_info)
@@ -49,5 +102,11 @@ struct rpbuf_buffer_xfer {
 	_IOWR(RPBUF_BUF_DEV_IOCTL_MAGIC, 0x3, struct rpbuf_buffer_xfer)
 #define RPBUF_BUF_DEV_IOCTL_SET_SYNC_BUF \
 	_IOW(RPBUF_BUF_DEV_IOCTL_MAGIC, 0x4, struct rpbuf_buffer_xfer)
+#define RPBUF_BUF_DEV_IOCTL_SETUP_RING \
+	_IOWR(RPBUF_BUF_DEV_IOCTL_MAGIC, 0x5, struct rpbuf_ring_info)
+#define RPBUF_BUF_DEV_IOCTL_KICK_RING \
+	_IO(RPBUF_BUF_DEV_IOCTL_MAGIC, 0x6)
+#define RPBUF_BUF_DEV_IOCTL_WAIT_RING \
+	_IOW(RPBUF_BUF_DEV_IOCTL_MAGIC, 0x7, __s32)
 
 #endif